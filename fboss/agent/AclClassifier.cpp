@@ -0,0 +1,230 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/AclClassifier.h"
+
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/PktUtil.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/AclMap.h"
+
+#include <folly/Hash.h>
+#include <folly/io/Cursor.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+using folly::IPAddress;
+using folly::IPAddressV6;
+using folly::io::Cursor;
+using std::shared_ptr;
+
+namespace facebook { namespace fboss {
+
+bool AclClassifier::Tuple::operator==(const Tuple& other) const {
+  return family == other.family &&
+    srcIpLen == other.srcIpLen &&
+    dstIpLen == other.dstIpLen &&
+    l4SrcPort == other.l4SrcPort &&
+    l4DstPort == other.l4DstPort &&
+    proto == other.proto &&
+    tcpFlagsMask == other.tcpFlagsMask;
+}
+
+bool AclClassifier::Key::operator==(const Key& other) const {
+  return srcIp == other.srcIp &&
+    dstIp == other.dstIp &&
+    l4SrcPort == other.l4SrcPort &&
+    l4DstPort == other.l4DstPort &&
+    proto == other.proto &&
+    tcpFlags == other.tcpFlags;
+}
+
+size_t AclClassifier::KeyHash::operator()(const Key& key) const {
+  return folly::hash::hash_combine(key.srcIp, key.dstIp, key.l4SrcPort,
+                                   key.l4DstPort, key.proto, key.tcpFlags);
+}
+
+AclClassifier::AclClassifier(const shared_ptr<AclMap>& acls) {
+  for (const auto& entry : *acls) {
+    auto tuple = getTuple(*entry);
+    auto group = std::find_if(groups_.begin(), groups_.end(),
+                              [&](const Group& g) { return g.tuple == tuple; });
+    if (group == groups_.end()) {
+      groups_.emplace_back();
+      group = groups_.end() - 1;
+      group->tuple = tuple;
+      group->minID = entry->getID();
+    }
+
+    auto ret = group->entries.emplace(getKey(tuple, *entry), entry);
+    if (!ret.second) {
+      if (entry->getID() > ret.first->second->getID()) {
+        VLOG(2) << "ACL entry " << entry->getID() << " is shadowed by entry "
+                << ret.first->second->getID();
+        continue;
+      }
+      VLOG(2) << "ACL entry " << ret.first->second->getID()
+              << " is shadowed by entry " << entry->getID();
+      ret.first->second = entry;
+    }
+    group->minID = std::min(group->minID, entry->getID());
+  }
+
+  std::sort(groups_.begin(), groups_.end(),
+            [](const Group& a, const Group& b) { return a.minID < b.minID; });
+  for (const auto& group : groups_) {
+    numEntries_ += group.entries.size();
+  }
+  VLOG(1) << "built ACL classifier with " << numEntries_ << " entries in "
+          << groups_.size() << " tuples";
+}
+
+const AclEntry* AclClassifier::match(const Fields& fields) const {
+  const AclEntry* best = nullptr;
+  for (const auto& group : groups_) {
+    if (best && best->getID() < group.minID) {
+      // Nothing in this or any later group can take priority over best
+      break;
+    }
+    const auto& tuple = group.tuple;
+    if ((tuple.family == 4 && !fields.srcIp.isV4()) ||
+        (tuple.family == 6 && !fields.srcIp.isV6())) {
+      continue;
+    }
+    auto it = group.entries.find(getKey(tuple, fields));
+    if (it == group.entries.end()) {
+      continue;
+    }
+    if (!best || it->second->getID() < best->getID()) {
+      best = it->second.get();
+    }
+  }
+  return best;
+}
+
+cfg::AclAction AclClassifier::getAction(const Fields& fields) const {
+  auto entry = match(fields);
+  return entry ? entry->getAction() : cfg::AclAction::PERMIT;
+}
+
+AclClassifier::Tuple AclClassifier::getTuple(const AclEntry& entry) {
+  Tuple tuple;
+  auto srcIp = entry.getSrcIp();
+  auto dstIp = entry.getDstIp();
+  if (!srcIp.first.empty()) {
+    tuple.family = srcIp.first.isV4() ? 4 : 6;
+    tuple.srcIpLen = srcIp.second;
+  }
+  if (!dstIp.first.empty()) {
+    tuple.family = dstIp.first.isV4() ? 4 : 6;
+    tuple.dstIpLen = dstIp.second;
+  }
+  tuple.l4SrcPort = entry.getL4SrcPort() != 0;
+  tuple.l4DstPort = entry.getL4DstPort() != 0;
+  tuple.proto = entry.getProto() != 0;
+  tuple.tcpFlagsMask = entry.getTcpFlagsMask();
+  if (tuple.tcpFlagsMask == 0 && entry.getTcpFlags() != 0) {
+    // Flags without a mask have to match exactly
+    tuple.tcpFlagsMask = 0xff;
+  }
+  return tuple;
+}
+
+AclClassifier::Key AclClassifier::getKey(const Tuple& tuple,
+                                         const AclEntry& entry) {
+  Key key;
+  if (tuple.srcIpLen) {
+    key.srcIp = maskIp(entry.getSrcIp().first, tuple.srcIpLen);
+  }
+  if (tuple.dstIpLen) {
+    key.dstIp = maskIp(entry.getDstIp().first, tuple.dstIpLen);
+  }
+  key.l4SrcPort = entry.getL4SrcPort();
+  key.l4DstPort = entry.getL4DstPort();
+  key.proto = entry.getProto();
+  key.tcpFlags = entry.getTcpFlags() & tuple.tcpFlagsMask;
+  return key;
+}
+
+AclClassifier::Key AclClassifier::getKey(const Tuple& tuple,
+                                         const Fields& fields) {
+  Key key;
+  if (tuple.srcIpLen) {
+    key.srcIp = maskIp(fields.srcIp, tuple.srcIpLen);
+  }
+  if (tuple.dstIpLen) {
+    key.dstIp = maskIp(fields.dstIp, tuple.dstIpLen);
+  }
+  if (tuple.l4SrcPort) {
+    key.l4SrcPort = fields.l4SrcPort;
+  }
+  if (tuple.l4DstPort) {
+    key.l4DstPort = fields.l4DstPort;
+  }
+  if (tuple.proto) {
+    key.proto = fields.proto;
+  }
+  key.tcpFlags = fields.tcpFlags & tuple.tcpFlagsMask;
+  return key;
+}
+
+IPAddressV6 AclClassifier::maskIp(const IPAddress& ip, uint8_t len) {
+  if (ip.isV4()) {
+    return ip.asV4().mask(len).createIPv6();
+  }
+  return ip.asV6().mask(len);
+}
+
+bool AclClassifier::parsePacket(Cursor cursor, uint16_t etherType,
+                                Fields* fields) {
+  try {
+    if (etherType == ETHERTYPE_IPV4) {
+      uint8_t versionAndIhl = cursor.read<uint8_t>();
+      uint8_t ihl = versionAndIhl & 0xf;
+      if ((versionAndIhl >> 4) != 4 || ihl < 5) {
+        return false;
+      }
+      cursor.skip(8);
+      fields->proto = cursor.read<uint8_t>();
+      cursor.skip(2);
+      fields->srcIp = PktUtil::readIPv4(&cursor);
+      fields->dstIp = PktUtil::readIPv4(&cursor);
+      cursor.skip((ihl - 5) * 4);
+    } else if (etherType == ETHERTYPE_IPV6) {
+      if ((cursor.read<uint8_t>() >> 4) != 6) {
+        return false;
+      }
+      cursor.skip(5);
+      fields->proto = cursor.read<uint8_t>();
+      cursor.skip(1);
+      fields->srcIp = PktUtil::readIPv6(&cursor);
+      fields->dstIp = PktUtil::readIPv6(&cursor);
+    } else {
+      return false;
+    }
+
+    if (fields->proto == IP_PROTO_TCP || fields->proto == IP_PROTO_UDP) {
+      fields->l4SrcPort = cursor.readBE<uint16_t>();
+      fields->l4DstPort = cursor.readBE<uint16_t>();
+    }
+    if (fields->proto == IP_PROTO_TCP) {
+      // Skip the sequence and acknowledgement numbers and the data offset
+      cursor.skip(9);
+      fields->tcpFlags = cursor.read<uint8_t>();
+    }
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+  return true;
+}
+
+}} // facebook::fboss
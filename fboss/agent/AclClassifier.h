@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/gen-cpp/switch_config_types.h"
+#include "fboss/agent/types.h"
+
+#include <folly/IPAddress.h>
+#include <folly/IPAddressV6.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace folly { namespace io {
+class Cursor;
+}}
+
+namespace facebook { namespace fboss {
+
+class AclEntry;
+class AclMap;
+
+/*
+ * AclClassifier matches packets against the entries of an AclMap, the way
+ * the ASIC's ingress ACL table would.
+ *
+ * Entries are grouped by which fields they match on and how many bits of
+ * each (their "tuple"), and each group is a hash table keyed by the masked
+ * field values.  Classifying a packet is then one hash lookup per group
+ * instead of a comparison against every entry.  Groups are searched in
+ * order of the highest priority entry in them, so the search stops as soon
+ * as no remaining group can beat the best match found.
+ *
+ * An AclClassifier is immutable once built; it is rebuilt whenever the
+ * AclMap changes, and may be used from several threads at once.
+ */
+class AclClassifier {
+ public:
+  /*
+   * The parts of a packet ACLs look at.  L4 ports are 0 for anything
+   * other than TCP and UDP, and tcpFlags is 0 for anything but TCP.
+   */
+  struct Fields {
+    folly::IPAddress srcIp;
+    folly::IPAddress dstIp;
+    uint8_t proto{0};
+    uint16_t l4SrcPort{0};
+    uint16_t l4DstPort{0};
+    uint8_t tcpFlags{0};
+  };
+
+  explicit AclClassifier(const std::shared_ptr<AclMap>& acls);
+
+  /*
+   * The highest priority (lowest ID) entry matching fields, or null if none
+   * does.  The entry is owned by the classifier.
+   */
+  const AclEntry* match(const Fields& fields) const;
+
+  /*
+   * The action of the entry matching fields.  Packets no entry matches are
+   * permitted.
+   */
+  cfg::AclAction getAction(const Fields& fields) const;
+
+  /*
+   * Parse the fields of the IPv4 or IPv6 packet at cursor.
+   *
+   * Returns false if etherType is not IP, or the packet is malformed or
+   * truncated.
+   */
+  static bool parsePacket(folly::io::Cursor cursor, uint16_t etherType,
+                          Fields* fields);
+
+  bool empty() const {
+    return numEntries_ == 0;
+  }
+  size_t getNumEntries() const {
+    return numEntries_;
+  }
+  size_t getNumTuples() const {
+    return groups_.size();
+  }
+
+ private:
+  // Which fields the entries of a group match on, and with how many bits
+  struct Tuple {
+    // 0 for entries that match no IP address, otherwise 4 or 6
+    uint8_t family{0};
+    uint8_t srcIpLen{0};
+    uint8_t dstIpLen{0};
+    bool l4SrcPort{false};
+    bool l4DstPort{false};
+    bool proto{false};
+    uint8_t tcpFlagsMask{0};
+
+    bool operator==(const Tuple& other) const;
+  };
+  // The field values of an entry, or a packet, masked by a Tuple.  IPv4
+  // addresses are stored mapped into IPv6 so both families share a key.
+  struct Key {
+    folly::IPAddressV6 srcIp;
+    folly::IPAddressV6 dstIp;
+    uint16_t l4SrcPort{0};
+    uint16_t l4DstPort{0};
+    uint8_t proto{0};
+    uint8_t tcpFlags{0};
+
+    bool operator==(const Key& other) const;
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+  struct Group {
+    Tuple tuple;
+    // The highest priority entry in the group
+    AclEntryID minID{0};
+    // Only the highest priority entry of several with the same key can
+    // ever match, so the others are not kept.
+    std::unordered_map<Key, std::shared_ptr<AclEntry>, KeyHash> entries;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  AclClassifier(AclClassifier const &) = delete;
+  AclClassifier& operator=(AclClassifier const &) = delete;
+
+  static Tuple getTuple(const AclEntry& entry);
+  static Key getKey(const Tuple& tuple, const AclEntry& entry);
+  static Key getKey(const Tuple& tuple, const Fields& fields);
+  static folly::IPAddressV6 maskIp(const folly::IPAddress& ip, uint8_t len);
+
+  // Sorted by minID
+  std::vector<Group> groups_;
+  size_t numEntries_{0};
+};
+
+}} // facebook::fboss
@@ -59,11 +59,13 @@ class ThriftConfigApplier {
   ThriftConfigApplier(const std::shared_ptr<SwitchState>& orig,
                       const cfg::SwitchConfig* config,
                       const Platform* platform,
-                      const cfg::SwitchConfig* prevCfg)
+                      const cfg::SwitchConfig* prevCfg,
+                      bool incremental)
     : orig_(orig),
       cfg_(config),
       platform_(platform),
-      prevCfg_(prevCfg) {}
+      prevCfg_(prevCfg),
+      incremental_(incremental) {}
 
   std::shared_ptr<SwitchState> run();
 
@@ -129,6 +131,9 @@ class ThriftConfigApplier {
   const cfg::SwitchConfig* cfg_{nullptr};
   const Platform* platform_{nullptr};
   const cfg::SwitchConfig* prevCfg_{nullptr};
+  // Whether orig_ is known to have been built from prevCfg_, so that
+  // sections of the config that have not changed can be skipped.
+  bool incremental_{false};
 
   struct VlanIpInfo {
     VlanIpInfo(uint8_t mask, MacAddress mac, InterfaceID intf)
@@ -155,6 +160,26 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
   auto newState = orig_->clone();
   bool changed = false;
 
+  // If the original state was built from prevCfg_, any section of the
+  // config that is identical there has nothing to change, and we can avoid
+  // walking every VLAN and interface just to find that out.
+  //
+  // The ports are always redone: their admin state can also be changed
+  // through thrift (ThriftHandler::setPortState()), and reapplying the
+  // config has to undo that.  Comparing each port is cheap anyway.
+  bool intfsChanged = true;
+  bool vlansChanged = true;
+  bool aclsChanged = true;
+  if (incremental_) {
+    bool vlanPortsChanged = cfg_->vlanPorts != prevCfg_->vlanPorts;
+    intfsChanged = cfg_->interfaces != prevCfg_->interfaces;
+    // The VLANs hold the neighbor response entries for their interfaces'
+    // addresses, so they have to be redone when the interfaces change.
+    vlansChanged = vlanPortsChanged || intfsChanged ||
+      cfg_->vlans != prevCfg_->vlans;
+    aclsChanged = cfg_->acls != prevCfg_->acls;
+  }
+
   processVlanPorts();
 
   {
@@ -165,17 +190,23 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
     }
   }
 
-  {
+  if (intfsChanged) {
     auto newIntfs = updateInterfaces();
     if (newIntfs) {
       newState->resetIntfs(std::move(newIntfs));
       changed = true;
     }
+  } else if (vlansChanged) {
+    // The interfaces are unchanged, but updateVlans() still needs to know
+    // which of them are on each VLAN.
+    for (const auto& intf : *orig_->getInterfaces()) {
+      updateVlanInterfaces(intf.get());
+    }
   }
 
   // Note: updateInterfaces() must be called before updateVlans(),
   // as updateInterfaces() populates the vlanInterfaces_ data structure.
-  {
+  if (vlansChanged) {
     auto newVlans = updateVlans();
     if (newVlans) {
       newState->resetVlans(std::move(newVlans));
@@ -186,11 +217,15 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
   // Note: updateInterfaces() must be called before updateInterfaceRoutes(),
   // as updateInterfaces() populates the intfRouteTables_ data structure.
   {
-    auto newTables = updateInterfaceRoutes();
-    if (newTables) {
-      newState->resetRouteTables(newTables);
-      changed = true;
+    shared_ptr<RouteTableMap> newTables;
+    if (intfsChanged) {
+      newTables = updateInterfaceRoutes();
+      if (newTables) {
+        newState->resetRouteTables(newTables);
+        changed = true;
+      }
     }
+    // Static routes are diffed against prevCfg_ by the RouteUpdater
     auto newerTables = updateStaticRoutes(newTables ? newTables :
         orig_->getRouteTables());
     if (newerTables) {
@@ -209,7 +244,15 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
     changed = true;
   }
 
-  // Make sure all interfaces refer to valid VLANs.
+  // Make sure all interfaces refer to valid VLANs.  vlanInterfaces_ is only
+  // populated if the interfaces or VLANs changed; otherwise the state
+  // already passed these checks when prevCfg_ was applied, unless the
+  // default VLAN moved.
+  if (!intfsChanged && !vlansChanged && orig_->getDefaultVlan() != dfltVlan) {
+    for (const auto& intf : *orig_->getInterfaces()) {
+      updateVlanInterfaces(intf.get());
+    }
+  }
   for (const auto& vlanInfo : vlanInterfaces_) {
     if (newVlans->getVlanIf(vlanInfo.first) == nullptr) {
       throw FbossError("Interface ",
@@ -228,7 +271,7 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
    }
   }
 
-  {
+  if (aclsChanged) {
     auto newAcls = updateAcls();
     if (newAcls) {
       newState->resetAcls(std::move(newAcls));
@@ -839,7 +882,7 @@ shared_ptr<SwitchState> applyThriftConfig(
     const cfg::SwitchConfig* prevConfig) {
   cfg::SwitchConfig emptyConfig;
   return ThriftConfigApplier(state, config, platform,
-      prevConfig ? prevConfig : &emptyConfig).run();
+      prevConfig ? prevConfig : &emptyConfig, prevConfig != nullptr).run();
 }
 
 std::pair<std::shared_ptr<SwitchState>, std::string> applyThriftConfigFile(
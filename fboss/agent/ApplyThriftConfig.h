@@ -26,6 +26,11 @@ class SwitchState;
  *
  * Returns a new SwitchState object with the resulting state, or null if
  * the config file results in no changes.
+ *
+ * If prevConfig is given, state must be the result of applying it.  Only
+ * the sections of config that differ from prevConfig are then applied,
+ * apart from the ports, which can also be changed outside of the config
+ * and so are always checked.
  */
 std::shared_ptr<SwitchState> applyThriftConfig(
   const std::shared_ptr<SwitchState>& state,
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/AsyncStateObserver.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/SwitchStats.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/ExceptionString.h>
+#include <folly/ThreadName.h>
+
+using std::chrono::steady_clock;
+using std::shared_ptr;
+using std::string;
+
+namespace facebook { namespace fboss {
+
+AsyncStateObserver::AsyncStateObserver(StateObserver* observer,
+                                       const string& name,
+                                       size_t maxPending)
+  : observer_(observer),
+    name_(name),
+    maxPending_(maxPending),
+    lagCounter_(SwitchStats::kCounterPrefix + "state_observer." + name +
+                ".lag_ms"),
+    pendingCounter_(SwitchStats::kCounterPrefix + "state_observer." + name +
+                    ".pending") {
+  if (maxPending_ == 0) {
+    throw FbossError("async state observer ", name,
+                     " must allow at least one pending update");
+  }
+  thread_.reset(new std::thread([this] { this->threadLoop(); }));
+}
+
+AsyncStateObserver::~AsyncStateObserver() {
+  // Anything already scheduled via runInEventBaseThread() runs before the
+  // loop terminates, so updates queued before now are still delivered.
+  evb_.runInEventBaseThread([this] { evb_.terminateLoopSoon(); });
+  thread_->join();
+}
+
+void AsyncStateObserver::threadLoop() {
+  // pthread names are limited to 15 bytes
+  folly::setThreadName(pthread_self(), name_.substr(0, 15));
+  evb_.loopForever();
+}
+
+void AsyncStateObserver::stateUpdated(const StateDelta& delta) {
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (pending_.size() >= maxPending_) {
+      // The observer has fallen behind. Collapse everything still queued
+      // into one update from the oldest old state to this new state, and
+      // keep the oldest queue time so the lag reflects how stale it is.
+      coalesced_ += pending_.size();
+      pending_.front().newState = delta.newState();
+      pending_.resize(1);
+    } else {
+      pending_.emplace_back(delta.oldState(), delta.newState());
+    }
+    if (!scheduled_) {
+      scheduled_ = true;
+      schedule = true;
+    }
+    publishLag();
+  }
+  if (schedule) {
+    evb_.runInEventBaseThread([this] { this->processPending(); });
+  }
+}
+
+void AsyncStateObserver::processPending() {
+  while (true) {
+    shared_ptr<SwitchState> oldState;
+    shared_ptr<SwitchState> newState;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (pending_.empty()) {
+        scheduled_ = false;
+        return;
+      }
+      auto& front = pending_.front();
+      oldState = std::move(front.oldState);
+      newState = std::move(front.newState);
+      pending_.pop_front();
+    }
+
+    try {
+      observer_->stateUpdated(StateDelta(oldState, newState));
+    } catch (const std::exception& ex) {
+      // Same policy as synchronous observers in SwSwitch
+      LOG(FATAL) << "error notifying " << name_ << " of update: "
+                 << folly::exceptionStr(ex);
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    publishLag();
+  }
+}
+
+void AsyncStateObserver::publishLag() {
+  // Nothing undelivered means no lag, however old the last update was.
+  std::chrono::milliseconds lag(0);
+  if (!pending_.empty()) {
+    lag = std::chrono::duration_cast<std::chrono::milliseconds>(
+        steady_clock::now() - pending_.front().queued);
+  }
+  fbData->setCounter(lagCounter_, lag.count());
+  fbData->setCounter(pendingCounter_, pending_.size());
+}
+
+size_t AsyncStateObserver::getPendingCount() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return pending_.size();
+}
+
+uint64_t AsyncStateObserver::getCoalescedCount() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return coalesced_;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/EventBase.h>
+#include "fboss/agent/StateObserver.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace facebook { namespace fboss {
+
+class SwitchState;
+
+/*
+ * AsyncStateObserver forwards state updates to another StateObserver on a
+ * thread of its own, so that a slow observer does not hold up the update
+ * thread.
+ *
+ * stateUpdated() is called on the update thread and only queues the old and
+ * new states. Once more than maxPending updates are queued, the queue is
+ * collapsed into a single update spanning from the oldest old state to the
+ * newest new state. The wrapped observer therefore always sees a consistent
+ * sequence of deltas, but may not see every intermediate state.
+ *
+ * Use SwSwitch::registerAsyncStateObserver() rather than creating these
+ * directly.
+ */
+class AsyncStateObserver : public StateObserver {
+ public:
+  AsyncStateObserver(StateObserver* observer,
+                     const std::string& name,
+                     size_t maxPending);
+
+  /*
+   * Delivers any updates that are still queued and stops the observer
+   * thread. The wrapped observer must not block waiting on the update
+   * thread, since this is normally destroyed from there.
+   */
+  ~AsyncStateObserver() override;
+
+  void stateUpdated(const StateDelta& delta) override;
+
+  StateObserver* getObserver() const {
+    return observer_;
+  }
+  const std::string& getName() const {
+    return name_;
+  }
+
+  /*
+   * The number of updates queued but not yet delivered.
+   */
+  size_t getPendingCount() const;
+
+  /*
+   * The number of updates that were merged into another queued update
+   * because the observer fell behind.
+   */
+  uint64_t getCoalescedCount() const;
+
+ private:
+  struct PendingUpdate {
+    PendingUpdate(std::shared_ptr<SwitchState> oldState,
+                  std::shared_ptr<SwitchState> newState)
+      : oldState(std::move(oldState)),
+        newState(std::move(newState)),
+        queued(std::chrono::steady_clock::now()) {}
+
+    std::shared_ptr<SwitchState> oldState;
+    std::shared_ptr<SwitchState> newState;
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  AsyncStateObserver(AsyncStateObserver const &) = delete;
+  AsyncStateObserver& operator=(AsyncStateObserver const &) = delete;
+
+  void threadLoop();
+  void processPending();
+  // Publishes the age of the oldest queued update and the queue length.
+  // Must be called with lock_ held.
+  void publishLag();
+
+  StateObserver* observer_{nullptr};
+  const std::string name_;
+  const size_t maxPending_{0};
+  const std::string lagCounter_;
+  const std::string pendingCounter_;
+
+  folly::EventBase evb_;
+  std::unique_ptr<std::thread> thread_;
+
+  /*
+   * lock_ protects pending_, scheduled_ and coalesced_. It is held only to
+   * push or pop an entry, never while the wrapped observer runs.
+   */
+  mutable std::mutex lock_;
+  std::deque<PendingUpdate> pending_;
+  bool scheduled_{false};
+  uint64_t coalesced_{0};
+};
+
+}} // facebook::fboss
@@ -9,6 +9,7 @@
  */
 #include "DHCPv4Handler.h"
 #include <arpa/inet.h>
+#include <algorithm>
 #include <string>
 #include <folly/io/IOBuf.h>
 #include <folly/io/Cursor.h>
@@ -19,6 +20,7 @@
 #include "fboss/agent/packet/IPProto.h"
 #include "fboss/agent/packet/EthHdr.h"
 #include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/PktUtil.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/SwitchState.h"
@@ -107,6 +109,115 @@ void sendDHCPPacket(SwSwitch* sw, const EthHdr& ethHdr, const IPv4Hdr& ipHdr,
   sw->sendPacketSwitched(std::move(txPacket));
 }
 
+// Offsets of the fields the relay reads or edits in place
+enum : size_t {
+  kHopsOffset = 3,
+  kGiaddrOffset = 24,
+  kChaddrOffset = 28,
+};
+
+// The partial checksum of some bytes starting at an even offset into the
+// checksummed data, for PktUtil::updateChecksum()
+uint32_t partialCsum(const uint8_t* data, size_t length) {
+  return static_cast<uint16_t>(~PktUtil::internetChecksum(data, length));
+}
+
+uint32_t partialCsum(Cursor cursor, size_t length) {
+  return static_cast<uint16_t>(~PktUtil::finalizeChecksum(cursor, length, 0));
+}
+
+/*
+ * Relay the DHCP packet at dhcp by copying it into the TX buffer and editing
+ * the copy there, rather than parsing it and serializing it again.
+ *
+ * The first headLength bytes are copied unchanged apart from the hops and
+ * giaddr fields.  writeTail(tail, cursor) is then given cursor positioned
+ * just past them, writes whatever should follow and returns how many bytes
+ * it wrote, and the rest of the packet is padded.  Since nothing else
+ * changes, the UDP checksum is updated from the received one instead of
+ * being computed over the whole packet again.
+ */
+template<typename WriteTailFn>
+void relayDHCPPacket(SwSwitch* sw, const EthHdr& ethHdr, const IPv4Hdr& ipHdr,
+    const UDPHeader& udpHdr, const IPv4Hdr& origIPHdr,
+    const UDPHeader& origUDPHdr, Cursor dhcp, size_t headLength,
+    uint8_t hops, IPAddressV4 giaddr, WriteTailFn writeTail) {
+  const size_t origLength = dhcp.totalLength();
+  const size_t dhcpLength = udpHdr.length - UDPHeader::size();
+  // Allocate packet
+  auto txPacket = sw->allocatePacket(
+      18 + // ethernet header
+      ipHdr.size() +
+      udpHdr.size() +
+      dhcpLength);
+  const auto& vlanTags = ethHdr.getVlanTags();
+  CHECK(!vlanTags.empty());
+
+  RWPrivateCursor rwCursor(txPacket->buf());
+  // Write data to packet buffer
+  txPacket->writeEthHeader(&rwCursor, ethHdr.getDstMac(), ethHdr.getSrcMac(),
+                      VlanID(vlanTags[0].vid()), ethHdr.getEtherType());
+  ipHdr.write(&rwCursor);
+  rwCursor.writeBE<uint16_t>(udpHdr.srcPort);
+  rwCursor.writeBE<uint16_t>(udpHdr.dstPort);
+  rwCursor.writeBE<uint16_t>(udpHdr.length);
+  folly::io::RWPrivateCursor csumCursor(rwCursor);
+  rwCursor.skip(2);
+  folly::io::Cursor payloadStart(rwCursor);
+
+  CHECK_GE(rwCursor.length(), dhcpLength);
+  uint8_t* out = rwCursor.writableData();
+  Cursor origTail(dhcp);
+  dhcp.pull(out, headLength);
+
+  // The checksum can only be updated if the sender filled it in (it is
+  // optional over IPv4) and it covers exactly the bytes we were given.
+  // Everything from the end of the head on may change; it is summed from an
+  // even offset so that the words line up.
+  const bool updateCsum = origUDPHdr.csum != 0 &&
+    origUDPHdr.length == UDPHeader::size() + origLength;
+  const size_t tailOffset = headLength & ~1;
+  uint32_t removed = 0;
+  if (updateCsum) {
+    origTail.skip(tailOffset);
+    removed = origIPHdr.pseudoHdrPartialCsum(origUDPHdr.length) +
+      origUDPHdr.srcPort + origUDPHdr.dstPort + origUDPHdr.length +
+      partialCsum(out + (kHopsOffset & ~1), 2) +
+      partialCsum(out + kGiaddrOffset, IPAddressV4::byteCount()) +
+      partialCsum(origTail, origLength - tailOffset);
+  }
+
+  out[kHopsOffset] = hops;
+  memcpy(out + kGiaddrOffset, giaddr.bytes(), IPAddressV4::byteCount());
+  auto tailLength = writeTail(out + headLength, dhcp);
+  memset(out + headLength + tailLength, DHCPv4Handler::PAD,
+         dhcpLength - headLength - tailLength);
+
+  uint16_t csum;
+  if (updateCsum) {
+    uint32_t added = ipHdr.pseudoHdrPartialCsum(udpHdr.length) +
+      udpHdr.srcPort + udpHdr.dstPort + udpHdr.length +
+      partialCsum(out + (kHopsOffset & ~1), 2) +
+      partialCsum(out + kGiaddrOffset, IPAddressV4::byteCount()) +
+      partialCsum(out + tailOffset, dhcpLength - tailOffset);
+    csum = PktUtil::updateChecksum(origUDPHdr.csum, removed, added);
+    // A 0 checksum should be transmitted as all ones
+    if (csum == 0) {
+      csum = 0xffff;
+    }
+  } else {
+    csum = udpHdr.computeChecksum(ipHdr, payloadStart);
+  }
+  csumCursor.writeBE<uint16_t>(csum);
+
+  VLOG (4) << " Relayed dhcp packet :"
+    << " Eth header : " << ethHdr
+    << " IPv4 Header : "<< ipHdr
+    << " UDP Header : " << udpHdr;
+  // Send packet
+  sw->sendPacketSwitched(std::move(txPacket));
+}
+
 int processOption(const DHCPv4Packet::Options& optionsIn, int optIndex,
     DHCPv4Packet& dhcpPacketOut, bool toAppend) {
 
@@ -149,26 +260,27 @@ void DHCPv4Handler::handlePacket(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
     return;
   }
 
-  // Parse dhcp packet
-  DHCPv4Packet dhcpPkt;
-  try {
-    dhcpPkt.parse(&cursor);
-  } catch (const FbossError& err) {
-     sw->stats()->port(pkt->getSrcPort())->dhcpV4BadPkt();
-     throw; // Rethrow
+  // Look at just what the relay needs, without parsing the packet
+  RelayInfo info;
+  if (!readRelayInfo(cursor, cursor.totalLength(), &info)) {
+    sw->stats()->port(pkt->getSrcPort())->dhcpV4BadPkt();
+    throw FbossError("Bad DHCP packet of ", cursor.totalLength(),
+        " bytes, expected minimum ", DHCPv4Packet::minSize(),
+        " bytes and no truncated options");
   }
-  if (dhcpPkt.hasDhcpCookie()) {
-    switch(dhcpPkt.op) {
+  if (info.hasCookie) {
+    switch(info.op) {
       case BOOTREQUEST:
         VLOG(4) << " Got boot request ";
-        processRequest(sw, std::move(pkt), srcMac, ipHdr, dhcpPkt);
+        processRequest(sw, std::move(pkt), srcMac, ipHdr, udpHdr, cursor,
+            info);
         break;
       case BOOTREPLY:
         VLOG(4) << " Got boot reply";
-        processReply(sw, std::move(pkt), ipHdr, dhcpPkt);
+        processReply(sw, std::move(pkt), ipHdr, udpHdr, cursor, info);
         break;
       default:
-        VLOG(4)<<" Unknown DHCP Packet type "<<(uint)dhcpPkt.op;
+        VLOG(4)<<" Unknown DHCP Packet type "<<(uint)info.op;
         sw->stats()->port(pkt->getSrcPort())->dhcpV4BadPkt();
         break;
     }
@@ -181,11 +293,76 @@ void DHCPv4Handler::handlePacket(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
 
 }
 
+bool DHCPv4Handler::readRelayInfo(Cursor cursor, size_t length,
+    RelayInfo* info) {
+  if (length < DHCPv4Packet::minSize()) {
+    return false;
+  }
+  info->op = cursor.read<uint8_t>();
+  cursor.skip(2); // htype, hlen
+  info->hops = cursor.read<uint8_t>();
+  cursor.skip(6); // xid, secs
+  info->flags = cursor.readBE<uint16_t>();
+  cursor.skip(4); // ciaddr
+  info->yiaddr = IPAddressV4::fromLong(cursor.read<uint32_t>());
+  cursor.skip(8); // siaddr, giaddr
+  info->chaddr = PktUtil::readMac(&cursor);
+  // The rest of chaddr, sname and file
+  cursor.skip(DHCPv4Packet::kFixedPartBytes - kChaddrOffset - MacAddress::SIZE);
+  uint8_t cookie[DHCPv4Packet::kOptionsCookieSize];
+  cursor.pull(cookie, DHCPv4Packet::kOptionsCookieSize);
+  info->hasCookie = !memcmp(cookie, DHCPv4Packet::kOptionsCookie,
+                            DHCPv4Packet::kOptionsCookieSize);
+  if (!info->hasCookie) {
+    return true;
+  }
+
+  size_t offset = DHCPv4Packet::minSize();
+  while (offset < length) {
+    uint8_t op = cursor.read<uint8_t>();
+    if (op == END) {
+      info->end = offset;
+      info->hasEnd = true;
+      return true;
+    }
+    if (op == PAD) {
+      ++offset;
+      continue;
+    }
+    if (offset + 2 > length) {
+      return false;
+    }
+    uint8_t optLen = cursor.read<uint8_t>();
+    if (offset + 2 + optLen > length) {
+      return false;
+    }
+    switch (op) {
+      case DHCP_MESSAGE_TYPE:
+        info->isDHCP = true;
+        break;
+      case DHCP_MAX_MESSAGE_SIZE:
+        if (optLen >= 2) {
+          Cursor value(cursor);
+          info->maxMsgSize = value.readBE<uint16_t>();
+        }
+        break;
+      case DHCP_AGENT_OPTIONS:
+        if (info->isDHCP && info->numAgentOptions++ == 0) {
+          info->agentOptions = offset;
+          info->agentOptionsLength = 2 + optLen;
+        }
+        break;
+    }
+    cursor.skip(optLen);
+    offset += 2 + optLen;
+  }
+  info->end = length;
+  return true;
+}
 
 void DHCPv4Handler::processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
-    MacAddress srcMac, const IPv4Hdr& origIPHdr,
-    const DHCPv4Packet& dhcpPacket) {
-  auto dhcpPacketOut(dhcpPacket);
+    MacAddress srcMac, const IPv4Hdr& origIPHdr, const UDPHeader& origUDPHdr,
+    Cursor cursor, const RelayInfo& info) {
   auto vlan = sw->getState()->getVlans()->getVlanIf(pkt->getSrcVlan());
   if (!vlan) {
     sw->stats()->dhcpV4DropPkt();
@@ -229,9 +406,18 @@ void DHCPv4Handler::processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
   }
 
   VLOG(4) << " Got switch ip : " << switchIp;
-  // Prepare DHCP packet to relay
-  if (!addAgentOptions(sw, pkt->getSrcPort(), switchIp, dhcpPacket,
-        dhcpPacketOut)) {
+  if (info.numAgentOptions) {
+    // FIXME We should really forward this along unchanged.
+    // see t3862629 for details.
+    LOG (INFO) <<" Agent options already present dropping DHCP packet";
+  }
+  // The agent options go where the END option was, followed by a new END
+  // option and as much padding as the packet needs
+  const uint8_t agentOptionsLength = 4 + switchIp.byteCount();
+  const size_t dhcpLength = std::max<size_t>(DHCPv4Packet::kMinSize,
+      info.end + agentOptionsLength + 1);
+  if (!info.isDHCP || info.numAgentOptions ||
+      (info.maxMsgSize && dhcpLength > info.maxMsgSize)) {
     sw->stats()->port(pkt->getSrcPort())->dhcpV4BadPkt();
     VLOG(4) << "Bad DHCP packet, error adding agent options."
       << " DHCP packet dropped";
@@ -242,50 +428,51 @@ void DHCPv4Handler::processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
   // where not incrementing this on the DHCP request causes
   // the server to drop our request.
   const int kMaxHops = 255;
-  if (dhcpPacketOut.hops < kMaxHops) {
-    dhcpPacketOut.hops++;
-  } else {
+  if (info.hops >= kMaxHops) {
     VLOG(4) << "Max hops exceeded for dhcp packet";
     sw->stats()->port(pkt->getSrcPort())->dhcpV4BadPkt();
     return;
   }
-  dhcpPacketOut.giaddr = switchIp;
   // Look up cpu mac from platform
   MacAddress cpuMac = sw->getPlatform()->getLocalMac();
 
   // Prepare the packet to be sent out
   EthHdr ethHdr = makeEthHdr(cpuMac, cpuMac, pkt->getSrcVlan());
   auto ipHdr = makeIpv4Header(switchIp, dhcpServer, origIPHdr.ttl - 1,
-      IPv4Hdr::minSize() + UDPHeader::size() + dhcpPacketOut.size());
+      IPv4Hdr::minSize() + UDPHeader::size() + dhcpLength);
   UDPHeader udpHdr(kBootPSPort, kBootPSPort,
-      UDPHeader::size() + dhcpPacketOut.size());
+      UDPHeader::size() + dhcpLength);
+  auto writeAgentOptions = [&](uint8_t* tail, Cursor /*rest*/) {
+    tail[0] = DHCP_AGENT_OPTIONS;
+    tail[1] = agentOptionsLength - 2;
+    tail[2] = AGENT_CIRCUIT_ID;
+    tail[3] = switchIp.byteCount();
+    memcpy(tail + 4, switchIp.bytes(), switchIp.byteCount());
+    tail[agentOptionsLength] = END;
+    return agentOptionsLength + 1;
+  };
   // Send packet
-  sendDHCPPacket(sw, ethHdr, ipHdr, udpHdr, dhcpPacketOut);
+  relayDHCPPacket(sw, ethHdr, ipHdr, udpHdr, origIPHdr, origUDPHdr, cursor,
+      info.end, info.hops + 1, switchIp, writeAgentOptions);
 }
 
 void DHCPv4Handler::processReply(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
-      const IPv4Hdr& origIPHdr, const DHCPv4Packet& dhcpPacket) {
-  auto dhcpPacketOut(dhcpPacket);
-  if (!stripAgentOptions(sw, pkt->getSrcPort(), dhcpPacket, dhcpPacketOut)) {
+    const IPv4Hdr& origIPHdr, const UDPHeader& origUDPHdr, Cursor cursor,
+    const RelayInfo& info) {
+  if (!info.isDHCP) {
     sw->stats()->port(pkt->getSrcPort())->dhcpV4BadPkt();
     VLOG(4) << "Bad DHCP packet, error stripping agent options."
       << " DHCP packet dropped";
     return;
   }
   IPAddressV4 clientIP = IPAddressV4::fromLong(INADDR_BROADCAST);
-  if (!(dhcpPacket.flags & DHCPv4Packet::kFlagBroadcast)) {
-    clientIP = dhcpPacket.yiaddr;
+  if (!(info.flags & DHCPv4Packet::kFlagBroadcast)) {
+    clientIP = info.yiaddr;
   }
   auto switchIp = origIPHdr.dstAddr;
   MacAddress cpuMac = sw->getPlatform()->getLocalMac();
-  // Extract client MAC address from dhcp reply
-  uint8_t chaddr[MacAddress::SIZE];
-  memcpy(chaddr, dhcpPacketOut.chaddr.data(), MacAddress::SIZE);
-  MacAddress dstMac = MacAddress::fromBinary(
-    folly::ByteRange(chaddr, MacAddress::SIZE));
-
-  // Clear out the relay address field
-  dhcpPacketOut.giaddr = IPAddressV4();
+  // The client MAC address from the dhcp reply
+  MacAddress dstMac = info.chaddr;
 
   // TODO we should add router id information to the packet
   // to get the VRF of the interface that this packet came
@@ -298,68 +485,49 @@ void DHCPv4Handler::processReply(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
       << "DHCP packet dropped ";
     return;
   }
-
-  // Prepare the packet to be sent out
   EthHdr ethHdr = makeEthHdr(cpuMac, dstMac, intf->getVlanID());
-  auto ipHdr = makeIpv4Header(switchIp, clientIP, origIPHdr.ttl - 1,
-      IPv4Hdr::minSize() + UDPHeader::size() + dhcpPacketOut.size());
-  UDPHeader udpHdr(kBootPSPort, kBootPCPort,
-      UDPHeader::size() + dhcpPacketOut.size());
-
-  sendDHCPPacket(sw, ethHdr, ipHdr, udpHdr, dhcpPacketOut);
-}
 
+  if (info.numAgentOptions > 1) {
+    // Rare enough that it isn't worth editing in place
+    DHCPv4Packet dhcpPacket;
+    dhcpPacket.parse(&cursor);
+    auto dhcpPacketOut(dhcpPacket);
+    stripAgentOptions(sw, pkt->getSrcPort(), dhcpPacket, dhcpPacketOut);
+    // Clear out the relay address field
+    dhcpPacketOut.giaddr = IPAddressV4();
+    auto ipHdr = makeIpv4Header(switchIp, clientIP, origIPHdr.ttl - 1,
+        IPv4Hdr::minSize() + UDPHeader::size() + dhcpPacketOut.size());
+    UDPHeader udpHdr(kBootPSPort, kBootPCPort,
+        UDPHeader::size() + dhcpPacketOut.size());
+    sendDHCPPacket(sw, ethHdr, ipHdr, udpHdr, dhcpPacketOut);
+    return;
+  }
 
-bool DHCPv4Handler::addAgentOptions(SwSwitch* sw, PortID port,
-    IPAddressV4 relayAddr, const DHCPv4Packet& dhcpPacketIn,
-    DHCPv4Packet& dhcpPacketOut) {
-  dhcpPacketOut.clearOptions();
-  const auto& optionsIn = dhcpPacketIn.options;
-  auto optIndex = 0;
-  bool isDHCP = false;
-  bool done = false;
-  uint16_t maxMsgSize = 0;
-  while (optIndex < optionsIn.size() && !done) {
-    bool appendOption = true;
-    switch(optionsIn[optIndex]) {
-      case DHCP_MESSAGE_TYPE:
-        isDHCP = true;
-        break;
-      case DHCP_MAX_MESSAGE_SIZE:
-        maxMsgSize = ntohs(optionsIn[optIndex + 2]);
-        break;
-      case DHCP_AGENT_OPTIONS:
-        if (isDHCP) {
-          // FIXME We should really forward this along unchanged.
-          // see t3862629 for details.
-          LOG (INFO) <<" Agent options already present dropping DHCP packet";
-          return false; //Options already present discard packet
-        }
-        break;
-      case END:
-        done = true;
-        appendOption = false;
-        break;
+  // Copy up to the agent options, skip them and copy the rest, up to and
+  // including the END option
+  const size_t optionsEnd = info.end + (info.hasEnd ? 1 : 0);
+  const size_t headLength = info.numAgentOptions ?
+    info.agentOptions : optionsEnd;
+  const size_t restLength = info.numAgentOptions ?
+    optionsEnd - info.agentOptions - info.agentOptionsLength : 0;
+  const size_t dhcpLength = std::max<size_t>(DHCPv4Packet::kMinSize,
+      headLength + restLength);
+  auto skipAgentOptions = [&](uint8_t* tail, Cursor rest) {
+    if (restLength) {
+      rest.skip(info.agentOptionsLength);
+      rest.pull(tail, restLength);
     }
-    optIndex += processOption(optionsIn, optIndex, dhcpPacketOut,
-        appendOption);
-  }
-  if (isDHCP) {
-    //Append agent option
-    uint8_t optlen = 2 + relayAddr.byteCount();
-    uint8_t subOptArray[optlen];
-    subOptArray[0] = AGENT_CIRCUIT_ID;
-    subOptArray[1] = relayAddr.byteCount();
-    memcpy(subOptArray + 2, relayAddr.bytes(), relayAddr.byteCount());
-    dhcpPacketOut.appendOption(DHCP_AGENT_OPTIONS, optlen, subOptArray);
-  }
-  dhcpPacketOut.appendOption(END, 0, nullptr);
-  dhcpPacketOut.padToMinLength();
-  if (isDHCP && maxMsgSize && dhcpPacketOut.size() > maxMsgSize) {
-    return false;
-  }
+    return restLength;
+  };
 
-  return isDHCP;
+  // Prepare the packet to be sent out
+  auto ipHdr = makeIpv4Header(switchIp, clientIP, origIPHdr.ttl - 1,
+      IPv4Hdr::minSize() + UDPHeader::size() + dhcpLength);
+  UDPHeader udpHdr(kBootPSPort, kBootPCPort,
+      UDPHeader::size() + dhcpLength);
+  // Clear out the relay address field
+  relayDHCPPacket(sw, ethHdr, ipHdr, udpHdr, origIPHdr, origUDPHdr, cursor,
+      headLength, info.hops, IPAddressV4(), skipAgentOptions);
 }
 
 bool DHCPv4Handler::stripAgentOptions(SwSwitch* sw, PortID port,
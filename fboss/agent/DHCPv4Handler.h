@@ -43,14 +43,46 @@ class DHCPv4Handler {
       folly::MacAddress dstMac,
       const IPv4Hdr& ipHdr, const UDPHeader& udpHdr, folly::io::Cursor cursor);
  private:
+  /*
+   * What relaying a DHCP packet depends on, read from the fixed part of the
+   * header and by walking the options where they are in the received
+   * buffer, so that most packets never need to be parsed into a
+   * DHCPv4Packet.
+   */
+  struct RelayInfo {
+    uint8_t op{0};
+    uint8_t hops{0};
+    uint16_t flags{0};
+    folly::IPAddressV4 yiaddr;
+    folly::MacAddress chaddr;
+    // Whether the options start with the DHCP cookie
+    bool hasCookie{false};
+    // Whether there is a message type option, i.e. this is DHCP not BOOTP
+    bool isDHCP{false};
+    uint16_t maxMsgSize{0};
+    // Where the first agent options following the message type are, and
+    // how many of them there are
+    size_t agentOptions{0};
+    size_t agentOptionsLength{0};
+    size_t numAgentOptions{0};
+    // Offset of the END option, or the length of the packet if it has none
+    size_t end{0};
+    bool hasEnd{false};
+  };
+
+  /*
+   * Fill in info from the DHCP packet at cursor, of length bytes.  Returns
+   * false if the packet is too short or an option runs past its end.
+   */
+  static bool readRelayInfo(folly::io::Cursor cursor, size_t length,
+      RelayInfo* info);
+
   static void processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
-      folly::MacAddress srcMac, const IPv4Hdr& ipHdr,
-      const DHCPv4Packet& dhcpPacket);
+      folly::MacAddress srcMac, const IPv4Hdr& ipHdr, const UDPHeader& udpHdr,
+      folly::io::Cursor cursor, const RelayInfo& info);
   static void processReply(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
-      const IPv4Hdr& ipHdr, const DHCPv4Packet& dhcpPacket);
-  static bool addAgentOptions(SwSwitch* sw, PortID port,
-      folly::IPAddressV4 relayAddr,
-      const DHCPv4Packet& dhcpPacketIn, DHCPv4Packet& dhcpPacketOut);
+      const IPv4Hdr& ipHdr, const UDPHeader& udpHdr,
+      folly::io::Cursor cursor, const RelayInfo& info);
   static bool stripAgentOptions(SwSwitch* sw, PortID port,
       const DHCPv4Packet& dhcpPacketIn, DHCPv4Packet& dhcpPacketOut);
 };
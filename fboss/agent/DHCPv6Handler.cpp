@@ -19,6 +19,7 @@
 #include "fboss/agent/packet/IPProto.h"
 #include "fboss/agent/packet/EthHdr.h"
 #include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/PktUtil.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/SwitchState.h"
@@ -114,31 +115,40 @@ void DHCPv6Handler::handlePacket(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
     MacAddress srcMac, MacAddress dstMac, const IPv6Hdr& ipHdr,
     const UDPHeader& udpHdr, Cursor cursor) {
   sw->stats()->port(pkt->getSrcPort())->dhcpV6Pkt();
-  // Parse dhcp packet
-  DHCPv6Packet dhcp6Pkt;
-  try {
-    dhcp6Pkt.parse(&cursor);
-  } catch (const FbossError& err) {
-     sw->stats()->port(pkt->getSrcPort())->dhcpV6BadPkt();
-     throw; // Rethrow
+  // Relaying only needs the fixed part of the header and, for relay replies,
+  // a couple of options, so the packet is read in place rather than parsed
+  // into a DHCPv6Packet.
+  auto length = cursor.totalLength();
+  uint8_t type = length ? Cursor(cursor).read<uint8_t>() : 0;
+  bool isRelay = type == DHCPv6_RELAY_FORWARD || type == DHCPv6_RELAY_REPLY;
+  size_t minLength = isRelay ?
+    DHCPv6Packet::TYPE_BYTES + DHCPv6Packet::HOPCOUNT_BYTES +
+    DHCPv6Packet::LINKADDR_BYTES + DHCPv6Packet::PEERADDR_BYTES :
+    DHCPv6Packet::TYPE_BYTES + DHCPv6Packet::TRANSACTIONID_BYTES;
+  if (length < minLength) {
+    sw->stats()->port(pkt->getSrcPort())->dhcpV6BadPkt();
+    throw FbossError("DHCPv6 packet parse error: too small packet");
   }
-  if (dhcp6Pkt.type == DHCPv6_RELAY_FORWARD) {
-    VLOG(4) << "Received DHCPv6 relay forward packet: " << dhcp6Pkt.toString();
+  if (type == DHCPv6_RELAY_FORWARD) {
+    VLOG(4) << "Received DHCPv6 relay forward packet of " << length
+            << " bytes";
     processDHCPv6RelayForward(sw, std::move(pkt), srcMac, dstMac,
-                             ipHdr, dhcp6Pkt);
-  } else if (dhcp6Pkt.type == DHCPv6_RELAY_REPLY) {
-    VLOG(4) << "Received DHCPv6 relay reply packet: " << dhcp6Pkt.toString();
+                             ipHdr, cursor);
+  } else if (type == DHCPv6_RELAY_REPLY) {
+    VLOG(4) << "Received DHCPv6 relay reply packet of " << length
+            << " bytes";
     processDHCPv6RelayReply(sw, std::move(pkt), srcMac, dstMac,
-                             ipHdr, dhcp6Pkt);
+                             ipHdr, cursor);
   } else {
-    VLOG(4) << "Received DHCPv6 packet: " << dhcp6Pkt.toString();
-    processDHCPv6Packet(sw, std::move(pkt), srcMac, dstMac, ipHdr, dhcp6Pkt);
+    VLOG(4) << "Received DHCPv6 packet of type " << (int)type << ", "
+            << length << " bytes";
+    processDHCPv6Packet(sw, std::move(pkt), srcMac, dstMac, ipHdr, cursor);
   }
 }
 
 void DHCPv6Handler::processDHCPv6Packet(SwSwitch* sw,
     std::unique_ptr<RxPacket> pkt, MacAddress srcMac, MacAddress dstMac,
-    const IPv6Hdr& ipHdr, const DHCPv6Packet& dhcpPacket) {
+    const IPv6Hdr& ipHdr, Cursor cursor) {
   auto vlanId = pkt->getSrcVlan();
   auto states = sw->getState();
   auto vlan = states->getVlans()->getVlanIf(vlanId);
@@ -178,11 +188,13 @@ void DHCPv6Handler::processDHCPv6Packet(SwSwitch* sw,
 
   // use the client src mac address as the interface id
   relayFwdPkt.addInterfaceIDOption(srcMac);
-  // add relay message option
-  relayFwdPkt.addRelayMessageOption(dhcpPacket);
+  // The relay message option is written straight from the received packet
+  // rather than added to relayFwdPkt, to save serializing the packet again
+  // and copying it into the options.
+  auto msgLength = cursor.totalLength();
+  auto dhcpLength = relayFwdPkt.computePacketLength() + 4 + msgLength;
 
-  if (relayFwdPkt.computePacketLength() >
-      DHCPv6Packet::MAX_DHCPV6_MSG_LENGTH) {
+  if (dhcpLength > DHCPv6Packet::MAX_DHCPV6_MSG_LENGTH) {
     VLOG(2) << "DHCPv6 relay forward message exceeds max length, drop it.";
     sw->stats()->port(pkt->getSrcPort())->dhcpV6BadPkt();
     return;
@@ -193,42 +205,49 @@ void DHCPv6Handler::processDHCPv6Packet(SwSwitch* sw,
   MacAddress cpuMac = sw->getPlatform()->getLocalMac();
   auto serializeBody = [&](RWPrivateCursor* sendCursor) {
     relayFwdPkt.write(sendCursor);
+    sendCursor->writeBE<uint16_t>(DHCPv6_OPTION_RELAY_MSG);
+    sendCursor->writeBE<uint16_t>(msgLength);
+    sendCursor->push(cursor, msgLength);
   };
 
   sendDHCPv6Packet(sw, cpuMac, cpuMac, vlanId, dhcp6ServerIp, switchIp,
       DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
       DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
-      relayFwdPkt.computePacketLength(), serializeBody);
+      dhcpLength, serializeBody);
 }
 
 void DHCPv6Handler::processDHCPv6RelayForward(SwSwitch* sw,
     std::unique_ptr<RxPacket> pkt, MacAddress srcMac, MacAddress dstMac,
-    const IPv6Hdr& ipHdr, DHCPv6Packet& dhcpPacket) {
+    const IPv6Hdr& ipHdr, Cursor cursor) {
   /**
    * NOTE: relay forward packet handling is not tested thoroughly since we
    * don't have other relay agents running in the cluster;
    */
   // relay forward from other agent
-  if (dhcpPacket.hopCount >= MAX_RELAY_HOPCOUNT) {
+  auto dhcpLength = cursor.totalLength();
+  auto type = cursor.read<uint8_t>();
+  auto hopCount = cursor.read<uint8_t>();
+  if (hopCount >= MAX_RELAY_HOPCOUNT) {
     VLOG(2) << "Received DHCPv6 relay foward packet with max relay hopcount";
     sw->stats()->port(pkt->getSrcPort())->dhcpV6BadPkt();
     return;
   }
-  // increment the hopcount and forward it
-  dhcpPacket.hopCount ++;
+  // increment the hopcount and forward the rest unchanged
   auto vlan = pkt->getSrcVlan();
   auto serializeBody = [&](RWPrivateCursor* sendCursor) {
-    dhcpPacket.write(sendCursor);
+    sendCursor->write<uint8_t>(type);
+    sendCursor->write<uint8_t>(hopCount + 1);
+    sendCursor->push(cursor, dhcpLength - 2);
   };
   sendDHCPv6Packet(sw, dstMac, srcMac, vlan, ipHdr.dstAddr,
       ipHdr.srcAddr, DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
       DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
-      dhcpPacket.computePacketLength(), serializeBody);
+      dhcpLength, serializeBody);
 }
 
 void DHCPv6Handler::processDHCPv6RelayReply(SwSwitch* sw,
     std::unique_ptr<RxPacket> pkt, MacAddress srcMac, MacAddress dstMac,
-    const IPv6Hdr& ipHdr, DHCPv6Packet& dhcpPacket) {
+    const IPv6Hdr& ipHdr, Cursor cursor) {
 
   IPAddressV6 switchIp = ipHdr.dstAddr;
   auto intf = sw->getState()->getInterfaces()->getInterface(RouterID(0),
@@ -241,21 +260,31 @@ void DHCPv6Handler::processDHCPv6RelayReply(SwSwitch* sw,
   }
 
   // relay reply from the server
+  cursor.skip(DHCPv6Packet::TYPE_BYTES + DHCPv6Packet::HOPCOUNT_BYTES +
+              DHCPv6Packet::LINKADDR_BYTES);
+  IPAddressV6 peerAddr = PktUtil::readIPv6(&cursor);
   MacAddress destMac;
-  const uint8_t* relayData;
+  // Where the relayed message is in the received packet
+  Cursor relayData(cursor);
   uint16_t relayLen = 0;
-  std::unordered_set<uint16_t> selector = { DHCPv6_OPTION_INTERFACE_ID,
-    DHCPv6_OPTION_RELAY_MSG };
-  auto dhcpOptions = dhcpPacket.extractOptions(selector);
-  for(int i = 0; i < dhcpOptions.size(); i++) {
-    if (dhcpOptions[i].op == DHCPv6_OPTION_INTERFACE_ID) {
-      DCHECK(dhcpOptions[i].len == MacAddress::SIZE);
-      destMac = MacAddress::fromBinary(
-          folly::ByteRange(dhcpOptions[i].data, MacAddress::SIZE));
-    } else if (dhcpOptions[i].op == DHCPv6_OPTION_RELAY_MSG) {
-      relayData = dhcpOptions[i].data;
-      relayLen = dhcpOptions[i].len;
+  auto remaining = cursor.totalLength();
+  while (remaining >= 4) {
+    auto op = cursor.readBE<uint16_t>();
+    auto len = cursor.readBE<uint16_t>();
+    remaining -= 4;
+    if (len > remaining) {
+      break;
+    }
+    if (op == DHCPv6_OPTION_INTERFACE_ID && len == MacAddress::SIZE) {
+      destMac = PktUtil::readMac(&cursor);
+    } else {
+      if (op == DHCPv6_OPTION_RELAY_MSG) {
+        relayData = cursor;
+        relayLen = len;
+      }
+      cursor.skip(len);
     }
+    remaining -= len;
   }
   if (destMac == MacAddress::ZERO || relayLen == 0) {
     sw->stats()->port(pkt->getSrcPort())->dhcpV6DropPkt();
@@ -273,7 +302,7 @@ void DHCPv6Handler::processDHCPv6RelayReply(SwSwitch* sw,
     sendCursor->push(relayData, relayLen);
   };
   sendDHCPv6Packet(sw, destMac, cpuMac, intf->getVlanID(),
-      dhcpPacket.peerAddr, switchIp, DHCPv6Packet::DHCP6_CLIENT_UDPPORT,
+      peerAddr, switchIp, DHCPv6Packet::DHCP6_CLIENT_UDPPORT,
       DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
       relayLen, serializeBody);
 }
@@ -42,7 +42,7 @@ class DHCPv6Handler {
   static void processDHCPv6Packet(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
       folly::MacAddress srcMac,
       folly::MacAddress dstMac,
-      const IPv6Hdr& ipHdr, const DHCPv6Packet& dhcpPacket);
+      const IPv6Hdr& ipHdr, folly::io::Cursor cursor);
 
   /**
    * process relay reply from server or relay forward message from other agents
@@ -51,13 +51,13 @@ class DHCPv6Handler {
       std::unique_ptr<RxPacket> pkt,
       folly::MacAddress srcMac,
       folly::MacAddress dstMac,
-      const IPv6Hdr& ipHdr, DHCPv6Packet& dhcpPacket);
+      const IPv6Hdr& ipHdr, folly::io::Cursor cursor);
 
   static void processDHCPv6RelayReply(SwSwitch* sw,
       std::unique_ptr<RxPacket> pkt,
       folly::MacAddress srcMac,
       folly::MacAddress dstMac,
-      const IPv6Hdr& ipHdr, DHCPv6Packet& dhcpPacket);
+      const IPv6Hdr& ipHdr, folly::io::Cursor cursor);
 
 };
 
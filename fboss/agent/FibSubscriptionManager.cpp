@@ -0,0 +1,344 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/FibSubscriptionManager.h"
+
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/Utils.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteDelta.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/MoveWrapper.h>
+
+#include <deque>
+
+using apache::thrift::ClientReceiveState;
+using apache::thrift::server::TConnectionContext;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+namespace facebook { namespace fboss {
+
+/*
+ * The sending side of one subscription.  Apart from construction and
+ * destruction, everything here runs in the event base of the subscriber's
+ * connection, so none of it needs locking.
+ */
+class FibSubscriptionManager::Subscriber
+  : public std::enable_shared_from_this<Subscriber> {
+ public:
+  typedef vector<vector<RouteChanges>> Batches;
+
+  Subscriber(shared_ptr<FibUpdateClientAsyncClient> client,
+             folly::EventBase* eventBase)
+    : client_(std::move(client)),
+      eventBase_(eventBase) {}
+
+  /*
+   * The client has to be destroyed in the event base thread.
+   */
+  ~Subscriber() {
+    auto wrappedClient = folly::makeMoveWrapper(std::move(client_));
+    eventBase_->runInEventBaseThread(
+        [wrappedClient]() mutable { (*wrappedClient).reset(); });
+  }
+
+  folly::EventBase* getEventBase() const {
+    return eventBase_;
+  }
+
+  /*
+   * Send the whole route table in state, dropping any changes that are
+   * still queued.
+   */
+  void resync(shared_ptr<SwitchState> state) {
+    if (closed_) {
+      return;
+    }
+    queued_.clear();
+    snapshot_ = std::move(state);
+    snapshotStarted_ = false;
+    const auto& tables = snapshot_->getRouteTables();
+    table_ = tables->begin();
+    if (table_ != tables->end()) {
+      startTable();
+    }
+    sendMore();
+  }
+
+  /*
+   * Queue the changes that bring the subscriber up to newState.
+   */
+  void enqueue(shared_ptr<const Batches> batches,
+               shared_ptr<SwitchState> newState) {
+    if (closed_) {
+      return;
+    }
+    for (size_t n = 0; n < batches->size(); ++n) {
+      queued_.emplace_back(batches, n);
+    }
+    if (queued_.size() > kMaxQueuedUpdates) {
+      LOG(WARNING) << "FIB subscriber has " << queued_.size()
+                   << " updates queued, resyncing it";
+      resync(std::move(newState));
+      return;
+    }
+    sendMore();
+  }
+
+  void close() {
+    closed_ = true;
+    queued_.clear();
+    snapshot_.reset();
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  Subscriber(Subscriber const &) = delete;
+  Subscriber& operator=(Subscriber const &) = delete;
+
+  void sendMore() {
+    while (!closed_ && inFlight_ < kMaxInFlight) {
+      FibUpdate update;
+      if (snapshot_) {
+        update.resync = !snapshotStarted_;
+        snapshotStarted_ = true;
+        if (!fillSnapshot(&update.changes)) {
+          snapshot_.reset();
+        }
+      } else if (!queued_.empty()) {
+        const auto& next = queued_.front();
+        update.changes = (*next.first)[next.second];
+        queued_.pop_front();
+      } else {
+        return;
+      }
+      send(std::move(update));
+    }
+  }
+
+  void send(FibUpdate update) {
+    update.seqNum = seqNum_++;
+    ++inFlight_;
+    auto self = shared_from_this();
+    client_->fibUpdated([self](ClientReceiveState&& state) {
+        self->updateDone(std::move(state));
+      }, update);
+  }
+
+  void updateDone(ClientReceiveState&& state) {
+    --inFlight_;
+    try {
+      FibUpdateClientAsyncClient::recv_fibUpdated(state);
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Error sending FIB update, dropping subscriber: "
+                 << ex.what();
+      close();
+      return;
+    }
+    sendMore();
+  }
+
+  void startTable() {
+    v4_ = (*table_)->getRibV4()->routes().begin();
+    v6_ = (*table_)->getRibV6()->routes().begin();
+  }
+
+  /*
+   * Add the next kMaxRoutesPerUpdate routes from snapshot_ to changes.
+   * Returns false once the whole table has been added.
+   *
+   * The snapshot is never modified, so the iterators into it stay valid
+   * for as long as we hold on to it.
+   */
+  bool fillSnapshot(vector<RouteChanges>* changes) {
+    const auto& tables = snapshot_->getRouteTables();
+    size_t count = 0;
+    while (table_ != tables->end()) {
+      RouteChanges vrfChanges;
+      vrfChanges.vrf = (*table_)->getID();
+      for (; !v4_.atEnd() && count < kMaxRoutesPerUpdate; ++v4_, ++count) {
+        vrfChanges.updated.push_back(toUnicastRoute(*v4_->value()));
+      }
+      for (; v4_.atEnd() && !v6_.atEnd() && count < kMaxRoutesPerUpdate;
+           ++v6_, ++count) {
+        vrfChanges.updated.push_back(toUnicastRoute(*v6_->value()));
+      }
+      if (!vrfChanges.updated.empty()) {
+        changes->push_back(std::move(vrfChanges));
+      }
+      if (!v4_.atEnd() || !v6_.atEnd()) {
+        return true;
+      }
+      if (++table_ != tables->end()) {
+        startTable();
+      }
+    }
+    return false;
+  }
+
+  shared_ptr<FibUpdateClientAsyncClient> client_;
+  folly::EventBase* const eventBase_{nullptr};
+  bool closed_{false};
+  int64_t seqNum_{0};
+  size_t inFlight_{0};
+
+  // Batches of changes waiting to be sent, and which batch of each
+  std::deque<std::pair<shared_ptr<const Batches>, size_t>> queued_;
+
+  // The state being sent in full, if there is one, and how far we've got
+  shared_ptr<SwitchState> snapshot_;
+  bool snapshotStarted_{false};
+  RouteTableMap::Iterator table_;
+  RouteTableRib<IPAddressV4>::Routes::ConstIterator v4_;
+  RouteTableRib<IPAddressV6>::Routes::ConstIterator v6_;
+};
+
+FibSubscriptionManager::FibSubscriptionManager(SwSwitch* sw) : sw_(sw) {
+  sw_->registerAsyncStateObserver(this, "FibSubscriptionManager");
+}
+
+FibSubscriptionManager::~FibSubscriptionManager() {
+  sw_->unregisterStateObserver(this);
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& entry : subscribers_) {
+    auto subscriber = entry.second.subscriber;
+    subscriber->getEventBase()->runInEventBaseThread(
+        [subscriber] { subscriber->close(); });
+  }
+}
+
+void FibSubscriptionManager::addSubscriber(
+    const TConnectionContext* ctx,
+    shared_ptr<FibUpdateClientAsyncClient> client,
+    folly::EventBase* eventBase) {
+  CHECK(eventBase->isInEventBaseThread());
+  auto subscriber = make_shared<Subscriber>(std::move(client), eventBase);
+  shared_ptr<SwitchState> state;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    // If we haven't seen an update yet, an update that is already on its
+    // way to us may start from an older state than this.  stateUpdated()
+    // spots that and resyncs the subscriber.
+    state = lastState_ ? lastState_ : sw_->getState();
+    auto& entry = subscribers_[ctx];
+    if (entry.subscriber) {
+      entry.subscriber->close();
+    }
+    entry.subscriber = subscriber;
+    entry.synced = state;
+  }
+  // Any updates from here on are queued behind this in the event base
+  subscriber->resync(std::move(state));
+}
+
+void FibSubscriptionManager::removeSubscriber(const TConnectionContext* ctx) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto iter = subscribers_.find(ctx);
+  if (iter == subscribers_.end()) {
+    return;
+  }
+  auto subscriber = iter->second.subscriber;
+  subscriber->getEventBase()->runInEventBaseThread(
+      [subscriber] { subscriber->close(); });
+  subscribers_.erase(iter);
+}
+
+size_t FibSubscriptionManager::getSubscriberCount() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return subscribers_.size();
+}
+
+void FibSubscriptionManager::stateUpdated(const StateDelta& delta) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (subscribers_.empty()) {
+      lastState_ = delta.newState();
+      return;
+    }
+  }
+
+  // Work out the changes without holding the lock, so that subscribing
+  // doesn't have to wait for it.  Anyone who subscribes in the meantime
+  // starts from delta.oldState(), so gets these changes too.
+  auto batches = make_shared<const Subscriber::Batches>(
+      getRouteChanges(delta));
+  const auto& newState = delta.newState();
+
+  std::lock_guard<std::mutex> guard(lock_);
+  for (auto& entry : subscribers_) {
+    auto subscriber = entry.second.subscriber;
+    if (entry.second.synced != delta.oldState()) {
+      subscriber->getEventBase()->runInEventBaseThread(
+          [subscriber, newState] { subscriber->resync(newState); });
+    } else if (!batches->empty()) {
+      subscriber->getEventBase()->runInEventBaseThread(
+          [subscriber, batches, newState] {
+            subscriber->enqueue(batches, newState);
+          });
+    }
+    entry.second.synced = newState;
+  }
+  lastState_ = newState;
+}
+
+namespace {
+
+template<typename RoutesDelta, typename GetChanges>
+void addRouteChanges(const RoutesDelta& delta, GetChanges& getChanges) {
+  for (const auto& entry : delta) {
+    const auto& newRoute = entry.getNew();
+    if (newRoute) {
+      getChanges().updated.push_back(toUnicastRoute(*newRoute));
+    } else {
+      getChanges().deleted.push_back(toIpPrefix(*entry.getOld()));
+    }
+  }
+}
+
+} // unnamed namespace
+
+vector<vector<RouteChanges>> FibSubscriptionManager::getRouteChanges(
+    const StateDelta& delta) {
+  vector<vector<RouteChanges>> batches;
+  size_t count = kMaxRoutesPerUpdate;
+  RouterID vrf(0);
+  // The RouteChanges for vrf that the next change should go in
+  auto getChanges = [&]() -> RouteChanges& {
+    if (count == kMaxRoutesPerUpdate) {
+      batches.emplace_back();
+      count = 0;
+    }
+    ++count;
+    auto& batch = batches.back();
+    if (batch.empty() || batch.back().vrf != vrf) {
+      batch.emplace_back();
+      batch.back().vrf = vrf;
+    }
+    return batch.back();
+  };
+
+  for (const auto& tableDelta : delta.getRouteTablesDelta()) {
+    vrf = tableDelta.getOld() ? tableDelta.getOld()->getID()
+                              : tableDelta.getNew()->getID();
+    addRouteChanges(tableDelta.getRoutesV4Delta(), getChanges);
+    addRouteChanges(tableDelta.getRoutesV6Delta(), getChanges);
+  }
+  return batches;
+}
+
+}} // facebook::fboss
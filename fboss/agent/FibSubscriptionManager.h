@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/if/gen-cpp2/FibUpdateClient.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace apache { namespace thrift { namespace server {
+class TConnectionContext;
+}}}
+
+namespace facebook { namespace fboss {
+
+class SwSwitch;
+class SwitchState;
+
+/*
+ * FibSubscriptionManager sends the route table to clients that called
+ * subscribeToFib(), and then the routes that change with each state update.
+ *
+ * It watches the state as an async state observer, so the route deltas are
+ * computed off the update thread, and only once no matter how many clients
+ * are subscribed.  Each subscriber is then fed from its own connection's
+ * event base, with at most kMaxInFlight updates outstanding.  Changes that
+ * can't be sent yet are queued, and if more than kMaxQueuedUpdates batches
+ * pile up the queue is dropped and the subscriber is resynced from the
+ * latest state instead.
+ */
+class FibSubscriptionManager : public StateObserver {
+ public:
+  enum : size_t {
+    // The most routes sent in one FibUpdate
+    kMaxRoutesPerUpdate = 10000,
+    // Updates sent to a subscriber before waiting for it to acknowledge them
+    kMaxInFlight = 4,
+    // Batches queued for a subscriber before we give up and resync it
+    kMaxQueuedUpdates = 64,
+  };
+
+  explicit FibSubscriptionManager(SwSwitch* sw);
+  ~FibSubscriptionManager() override;
+
+  /*
+   * Start sending FIB updates to client.  This must be called from eventBase,
+   * the thread the client's connection is served from.
+   */
+  void addSubscriber(
+      const apache::thrift::server::TConnectionContext* ctx,
+      std::shared_ptr<FibUpdateClientAsyncClient> client,
+      folly::EventBase* eventBase);
+
+  /*
+   * Stop sending updates on the connection ctx, if there is a subscription
+   * on it.
+   */
+  void removeSubscriber(const apache::thrift::server::TConnectionContext* ctx);
+
+  size_t getSubscriberCount() const;
+
+  void stateUpdated(const StateDelta& delta) override;
+
+  /*
+   * The route changes in delta, split into batches of no more than
+   * kMaxRoutesPerUpdate routes.
+   */
+  static std::vector<std::vector<RouteChanges>> getRouteChanges(
+      const StateDelta& delta);
+
+ private:
+  class Subscriber;
+  struct SubscriberEntry {
+    std::shared_ptr<Subscriber> subscriber;
+    // The state the updates queued for the subscriber bring it up to
+    std::shared_ptr<SwitchState> synced;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  FibSubscriptionManager(FibSubscriptionManager const &) = delete;
+  FibSubscriptionManager& operator=(FibSubscriptionManager const &) = delete;
+
+  SwSwitch* sw_{nullptr};
+
+  /*
+   * lock_ protects lastState_ and subscribers_.  Updates are handed to the
+   * subscribers' event bases while it is held, so that a new subscriber's
+   * snapshot is always queued before the first delta that follows it.
+   */
+  mutable std::mutex lock_;
+  std::shared_ptr<SwitchState> lastState_;
+  std::unordered_map<const apache::thrift::server::TConnectionContext*,
+                     SubscriberEntry> subscribers_;
+};
+
+}} // facebook::fboss
@@ -9,6 +9,10 @@
  */
 #include "fboss/agent/HighresCounterSubscriptionHandler.h"
 
+#include "fboss/agent/Utils.h"
+
+#include <algorithm>
+
 using folly::EventBase;
 using folly::make_unique;
 using std::shared_ptr;
@@ -23,7 +27,7 @@ using std::chrono::seconds;
 namespace facebook { namespace fboss {
 
 // Wrapper for the actual Thrift call
-inline void SampleSender::publish(unique_ptr<CounterPublication> pub) {
+void SampleSender::publish(unique_ptr<CounterPublication> pub) {
   if (!killSwitch_->isSet()) {
     // Note that it's okay to give the callback a shared_ptr to the client
     // without the eventBase because the actual call and callback are run in
@@ -45,7 +49,9 @@ inline void SampleSender::publish(unique_ptr<CounterPublication> pub) {
           }
         },
         *pub);
-    rateCalc_.finishedSamples(pub->times.size() * numCounters_);
+    auto numSamples = pub->__isset.columnar ? pub->columnar.numSamples
+                                            : pub->times.size();
+    rateCalc_.finishedSamples(numSamples * numCounters_);
   }
 }
 
@@ -61,79 +67,40 @@ string getLocalHostname() {
   return hostname;
 }
 
-SampleProducer::SampleProducer(unique_ptr<HighresSamplerList> samplers,
-                               shared_ptr<SampleSender> sender,
+SampleProducer::SampleProducer(shared_ptr<SampleSender> sender,
                                shared_ptr<Signal> killSwitch,
                                EventBase* const eventBase,
                                const CounterSubscribeRequest& req,
                                const int numCounters)
-    : samplers_(std::move(samplers)),
-      killSwitch_(std::move(killSwitch)),
+    : killSwitch_(std::move(killSwitch)),
       sender_(std::move(sender)),
       eventBase_(eventBase),
+      counters_(req.counters),
       hostname_(getLocalHostname()),
       maxTime_(seconds(req.maxTime)),
       maxCount_(req.maxCount),
       interval_(nanoseconds(req.intervalInNs)),
       batchSize_(req.batchSize),
       sleepMethod_(req.sleepMethod),
+      format_(req.format),
       rateCalc_("SampleProducer"),
       numCounters_(numCounters) {
-  overloadWarningCounter_ = 0;
-  numSamplesAtLastOverloadWarning_ = 0;
 }
 
-inline void SampleProducer::nanosleepHelper(const nanoseconds& timeLeft) {
-  const int64_t kNsPerS = 1000 * 1000 * 1000;
-  const auto count = timeLeft.count();
-
-  timespec ts;
-  ts.tv_sec = count / kNsPerS;
-  ts.tv_nsec = count % kNsPerS;
+void SampleProducer::start(const high_resolution_clock::time_point& now) {
+  pub_ = make_unique<CounterPublication>();
+  pub_->hostname = hostname_;
+  batchCounter_ = 0;
 
-  // Ignore signals
-  if (nanosleep(&ts, nullptr)) {
-    PCHECK(errno == EINTR);
-  }
-}
-
-inline void SampleProducer::sleepNs(high_resolution_clock::time_point* start) {
-  auto endTime = *start + interval_;
-  auto currentTime = high_resolution_clock::now();
-  auto timeLeft = endTime - currentTime;
-
-  if (timeLeft < nanoseconds(0)) {
-    // If processing took longer than an interval, warn of a possible overload
-    if (++overloadWarningCounter_ % kOverloadWarningEveryN == 0) {
-      double percent = ((double)kOverloadWarningEveryN) /
-                       (numSamples_ - numSamplesAtLastOverloadWarning_) * 100;
-      LOG(WARNING) << "Interval is too small for " << percent
-                   << "% of samples. Exceeded by "
-                   << -duration_cast<nanoseconds>(timeLeft).count() << " ns.";
-
-      numSamplesAtLastOverloadWarning_ = numSamples_;
-      overloadWarningCounter_ = 0;
-    }
-  } else {
-    // Else, we need to sleep for a bit.  There are two ways to do it:
-    if (sleepMethod_ == SleepMethod::NANOSLEEP) {
-      nanosleepHelper(duration_cast<nanoseconds>(timeLeft));
-      currentTime = high_resolution_clock::now();
-    } else if (sleepMethod_ == SleepMethod::PAUSE) {
-      do {
-        // If we need to have *precise* timing, and it's not achievable with any
-        // other means like 'nanosleep' or EventBase.
-        asm volatile("pause");
-        currentTime = high_resolution_clock::now();
-      } while (currentTime < endTime);
-    }
-  }
-
-  *start = currentTime;
+  sender_->initialize();
+  rateCalc_.initialize();
+  timeout_ = now + maxTime_;
+  nextSample_ = now;
 }
 
 inline void SampleProducer::buildPublication(
     CounterPublication* pub,
+    const CounterPublication& round,
     const high_resolution_clock::time_point& currentTime) {
   auto duration = duration_cast<nanoseconds>(currentTime.time_since_epoch());
 
@@ -143,13 +110,51 @@ inline void SampleProducer::buildPublication(
   pub->times.emplace_back(
       apache::thrift::FragileConstructor::FRAGILE, time_s, time_ns);
 
-  // Add a round of values
-  for (const auto& sampler : (*samplers_.get())) {
-    sampler->sample(pub);
+  // Add our counters from the round of values
+  for (const auto& counter : counters_) {
+    auto values = round.counters.find(counter);
+    if (values != round.counters.end() && !values->second.empty()) {
+      pub->counters[counter].push_back(values->second.back());
+    }
+  }
+}
+
+void SampleProducer::addSample(const CounterPublication& round,
+                               const high_resolution_clock::time_point& time) {
+  buildPublication(pub_.get(), round, time);
+
+  // Check if we have a full batch.  If so move it to the queue and make a new
+  // publication.
+  if (++batchCounter_ >= batchSize_) {
+    publish(std::move(pub_));
+    pub_ = make_unique<CounterPublication>();
+    pub_->hostname = hostname_;
+    batchCounter_ = 0;
+  }
+
+  // Print out the sampling rate every second
+  rateCalc_.finishedSamples(numCounters_);
+  ++numSamples_;
+  nextSample_ = time + interval_;
+}
+
+bool SampleProducer::isDone(const high_resolution_clock::time_point& now)
+    const {
+  return killSwitch_->isSet() || numSamples_ >= maxCount_ || now >= timeout_;
+}
+
+void SampleProducer::finish() {
+  if (batchCounter_ > 0) {
+    publish(std::move(pub_));
+    batchCounter_ = 0;
   }
 }
 
 void SampleProducer::publish(unique_ptr<CounterPublication> pub) {
+  if (format_ == PublicationFormat::COLUMNAR) {
+    encoder_.encode(pub.get());
+  }
+
   auto& sender = sender_;
   auto wrappedPub = folly::makeMoveWrapper(std::move(pub));
   // Schedule the send in a eb thread.  We include the a shared pointer to the
@@ -158,41 +163,186 @@ void SampleProducer::publish(unique_ptr<CounterPublication> pub) {
       [sender, wrappedPub]() mutable { sender->publish(wrappedPub.move()); });
 }
 
-void SampleProducer::produce() {
-  auto pub = make_unique<CounterPublication>();
+HighresSamplingService::HighresSamplingService(SamplerFactory getSamplers)
+    : getSamplers_(std::move(getSamplers)),
+      rateCalc_("HighresSamplingService") {
+}
 
-  pub->hostname = hostname_;
-  auto batchCounter = 0;
+HighresSamplingService::~HighresSamplingService() {
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    stopping_ = true;
+    changed_ = true;
+  }
+  subscribed_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
 
-  sender_->initialize();
+void HighresSamplingService::subscribe(unique_ptr<SampleProducer> producer,
+                                       bool veryNice) {
+  std::lock_guard<std::mutex> g(lock_);
+  for (const auto& counter : producer->getCounters()) {
+    if (++counterRefs_[counter] == 1) {
+      countersChanged_ = true;
+    }
+  }
+  producer->start(high_resolution_clock::now());
+  producers_.push_back(std::move(producer));
+  changed_ = true;
+
+  if (running_) {
+    subscribed_.notify_one();
+    return;
+  }
+
+  // The previous thread has given up the lock for the last time, so this
+  // won't block for long
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  running_ = true;
+  thread_ = std::thread([this, veryNice]() {
+    if (veryNice) {
+      incNiceValue(20);
+    }
+    run();
+  });
+}
+
+size_t HighresSamplingService::getNumSubscriptions() const {
+  std::lock_guard<std::mutex> g(lock_);
+  return producers_.size();
+}
+
+void HighresSamplingService::removeCounters(
+    const std::set<std::string>& counters) {
+  for (const auto& counter : counters) {
+    auto ref = counterRefs_.find(counter);
+    if (--ref->second == 0) {
+      counterRefs_.erase(ref);
+      countersChanged_ = true;
+    }
+  }
+}
+
+void HighresSamplingService::updateSamplers(std::unique_lock<std::mutex>* g) {
+  while (countersChanged_ && !stopping_) {
+    countersChanged_ = false;
+    std::set<std::string> counters;
+    for (const auto& ref : counterRefs_) {
+      counters.insert(ref.first);
+    }
+
+    // Building samplers may have to talk to the hardware, so don't make new
+    // subscribers wait for it
+    HighresSamplerList samplers;
+    g->unlock();
+    auto numCounters = getSamplers_(&samplers, counters);
+    g->lock();
+
+    samplers_ = std::move(samplers);
+    numCounters_ = numCounters;
+    round_.counters.clear();
+  }
+}
+
+void HighresSamplingService::sleepUntil(
+    std::unique_lock<std::mutex>* g,
+    const high_resolution_clock::time_point& time,
+    bool pause) {
+  if (pause) {
+    // If we need to have *precise* timing, and it's not achievable with any
+    // other means like 'nanosleep' or EventBase.
+    g->unlock();
+    while (!changed_.load(std::memory_order_acquire) &&
+           high_resolution_clock::now() < time) {
+      asm volatile("pause");
+    }
+    g->lock();
+  } else {
+    subscribed_.wait_until(*g, time, [this]() { return changed_.load(); });
+  }
+}
+
+void HighresSamplingService::run() {
+  std::unique_lock<std::mutex> g(lock_);
   rateCalc_.initialize();
-  auto currentTime = high_resolution_clock::now();
-  auto timeout = currentTime + maxTime_;
-
-  for (int i = 0;
-       !killSwitch_->isSet() && i < maxCount_ && currentTime < timeout;
-       ++i) {
-    buildPublication(pub.get(), currentTime);
-
-    // Check if we have a full batch.  If so move it to the queue and make a new
-    // publication.
-    if (++batchCounter >= batchSize_) {
-      publish(std::move(pub));
-      pub = make_unique<CounterPublication>();
-      pub->hostname = hostname_;
-      batchCounter = 0;
+
+  while (!stopping_ && !producers_.empty()) {
+    changed_ = false;
+    updateSamplers(&g);
+    if (stopping_) {
+      break;
     }
 
-    // Print out the sampling rate every second
-    rateCalc_.finishedSamples(numCounters_);
-    ++numSamples_;
+    // Take one round of samples if anyone is due
+    auto now = high_resolution_clock::now();
+    bool due = false;
+    for (const auto& producer : producers_) {
+      due |= producer->getNextSampleTime() <= now;
+    }
+    if (due) {
+      for (auto& counter : round_.counters) {
+        counter.second.clear();
+      }
+      for (const auto& sampler : samplers_) {
+        sampler->sample(&round_);
+      }
+      rateCalc_.finishedSamples(numCounters_);
+      ++numRounds_;
+    }
+
+    // Hand the round out, and work out when the next one is due
+    auto next = high_resolution_clock::time_point::max();
+    bool pause = false;
+    for (auto it = producers_.begin(); it != producers_.end();) {
+      auto& producer = *it;
+      if (due && producer->getNextSampleTime() <= now) {
+        producer->addSample(round_, now);
+      }
+      if (producer->isDone(now)) {
+        producer->finish();
+        removeCounters(producer->getCounters());
+        it = producers_.erase(it);
+        continue;
+      }
+      next = std::min(next, producer->getNextSampleTime());
+      pause |= producer->getSleepMethod() == SleepMethod::PAUSE;
+      ++it;
+    }
+    if (producers_.empty()) {
+      break;
+    }
+
+    auto timeLeft = next - high_resolution_clock::now();
+    if (timeLeft < nanoseconds(0)) {
+      // If processing took longer than an interval, warn of a possible overload
+      if (++overloadWarningCounter_ % kOverloadWarningEveryN == 0) {
+        double percent = ((double)kOverloadWarningEveryN) /
+                         (numRounds_ - numRoundsAtLastOverloadWarning_) * 100;
+        LOG(WARNING) << "Interval is too small for " << percent
+                     << "% of samples. Exceeded by "
+                     << -duration_cast<nanoseconds>(timeLeft).count()
+                     << " ns.";
 
-    // Sleep for the remaining portion of interval
-    sleepNs(&currentTime);
+        numRoundsAtLastOverloadWarning_ = numRounds_;
+        overloadWarningCounter_ = 0;
+      }
+    } else if (!changed_) {
+      sleepUntil(&g, next, pause);
+    }
   }
 
-  if (batchCounter > 0) {
-    publish(std::move(pub));
+  // Anything left over is only there because we are being destroyed
+  for (const auto& producer : producers_) {
+    producer->finish();
   }
+  producers_.clear();
+  counterRefs_.clear();
+  samplers_.clear();
+  running_ = false;
 }
+
 }} // facebook::fboss
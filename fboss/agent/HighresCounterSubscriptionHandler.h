@@ -12,6 +12,12 @@
 #include "fboss/agent/if/gen-cpp2/FbossHighresClient.h"
 #include "fboss/agent/HighresCounterUtil.h"
 
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
 namespace facebook { namespace fboss {
 
 // How often to print out load warnings
@@ -70,7 +76,7 @@ class SampleSender {
    * Destructor that ensures that the client is destroyed in the event base
    * thread.
    */
-  ~SampleSender() {
+  virtual ~SampleSender() {
     auto wrappedClient = folly::makeMoveWrapper(std::move(client_));
     eventBase_->runInEventBaseThread(
         [wrappedClient]() mutable { (*wrappedClient).reset(); });
@@ -88,7 +94,7 @@ class SampleSender {
    * @param[in]   pub    The finished publication to send. It will be destroyed
    *                     after this function returns.
    */
-  void publish(std::unique_ptr<CounterPublication> pub);
+  virtual void publish(std::unique_ptr<CounterPublication> pub);
 
  private:
   // Non-copyable
@@ -104,9 +110,10 @@ class SampleSender {
 
 /*
  * The class that builds updates for the subscribed client. When a thrift
- * server gets a subscription request, it spawns a Producer and (mostly) forgets
- * about it. The producer will then continue on its own for a preset amount of
- * time or until a kill signal is received.
+ * server gets a subscription request, it hands a Producer to the
+ * HighresSamplingService and (mostly) forgets about it. The service will then
+ * feed it samples for a preset amount of time or until a kill signal is
+ * received.
  */
 class SampleProducer {
  public:
@@ -114,8 +121,6 @@ class SampleProducer {
    * Constructor.  It pulls out information from the request and sets up a bunch
    * of internal state
    *
-   * @param[in]     samplers    The entire set of samplers to query in each
-   *                            round.
    * @param[out]    sender      The SampleSender that we call to publish data
    *                            back to the client.
    * @param[in]     killSwitch  A shared kill switch that lets different
@@ -128,43 +133,62 @@ class SampleProducer {
    * @param[in]     numCounters The total number of counters that we are
    *                            sampling. Used for rate calculations.
    */
-  SampleProducer(std::unique_ptr<HighresSamplerList> samplers,
-                 std::shared_ptr<SampleSender> sender,
+  SampleProducer(std::shared_ptr<SampleSender> sender,
                  std::shared_ptr<Signal> killSwitch,
                  folly::EventBase* const eventBase,
                  const CounterSubscribeRequest& req,
                  const int numCounters);
 
   /*
-   * Continue producing until we get a kill signal or for a fixed amount of
-   * time/samples, whichever comes first.
+   * Start the subscription clock.  The first sample is due immediately.
+   */
+  void start(const std::chrono::high_resolution_clock::time_point& now);
+
+  /*
+   * Add this subscription's counters from a round of samples taken at time,
+   * and publish if that completes a batch.
+   *
+   * @param[in]    round    A publication holding the latest sample of every
+   *                        counter as the last value of its list.
+   * @param[in]    time     When the round was sampled.
+   */
+  void addSample(const CounterPublication& round,
+                 const std::chrono::high_resolution_clock::time_point& time);
+
+  /*
+   * Whether the subscription is over because of a kill signal, or because it
+   * ran for its fixed amount of time/samples.
+   */
+  bool isDone(const std::chrono::high_resolution_clock::time_point& now) const;
+
+  /*
+   * Publish the last, partial batch.  Called once the subscription is done.
    */
-  void produce();
+  void finish();
+
+  const std::chrono::high_resolution_clock::time_point& getNextSampleTime()
+      const {
+    return nextSample_;
+  }
+  const std::set<std::string>& getCounters() const { return counters_; }
+  SleepMethod getSleepMethod() const { return sleepMethod_; }
 
  private:
   // Non-copyable
   SampleProducer(const SampleProducer&) = delete;
   SampleProducer& operator=(const SampleProducer&) = delete;
 
-  // A wrapper for nanosleep that takes std::chrono::nanoseconds
-  inline void nanosleepHelper(const std::chrono::nanoseconds& timeLeft);
-
-  // Sleep until we are ready to take another sample.  We will try to sleep
-  // until start + interval_.  It takes a start time so we can account for the
-  // time that has already elapsed while taking samples.  After this function
-  // executes, start >= start + interval.
-  inline void sleepNs(std::chrono::high_resolution_clock::time_point* start);
-
-  // Iteratively build the publication by querying all the samplers once
+  // Add this subscription's counters from a round of samples to the
+  // publication
   inline void buildPublication(
       CounterPublication* pub,
+      const CounterPublication& round,
       const std::chrono::high_resolution_clock::time_point& time);
 
-  // Schedule the SampleSender in a tm thread
+  // Encode the publication in the requested format and schedule the
+  // SampleSender in a tm thread
   inline void publish(std::unique_ptr<CounterPublication> pub);
 
-  // For the normal polling loop
-  std::unique_ptr<HighresSamplerList> samplers_;
   std::shared_ptr<Signal> killSwitch_;
 
   // For sending the publications
@@ -172,18 +196,105 @@ class SampleProducer {
   folly::EventBase* const eventBase_;
 
   // For storing information about the subscription
+  const std::set<std::string> counters_;
   const std::string hostname_;
   const std::chrono::seconds maxTime_;
   const int64_t maxCount_;
   const std::chrono::nanoseconds interval_;
   const int32_t batchSize_;
   const SleepMethod sleepMethod_;
+  const PublicationFormat format_;
+
+  // Assigns counter IDs for the COLUMNAR format
+  ColumnarCounterEncoder encoder_;
+
+  // The batch being built
+  std::unique_ptr<CounterPublication> pub_;
+  int32_t batchCounter_{0};
+  std::chrono::high_resolution_clock::time_point timeout_;
+  std::chrono::high_resolution_clock::time_point nextSample_;
 
   // For keeping track of the rate at which we are processing updates
   SingleThreadRateCalculator rateCalc_;
   const int numCounters_;
-  int numSamples_;
-  int overloadWarningCounter_;
-  int numSamplesAtLastOverloadWarning_;
+  int64_t numSamples_{0};
+};
+
+/*
+ * Samples the counters of all the active subscriptions from one thread.
+ *
+ * A counter requested by several subscriptions is only sampled once per
+ * tick, and each round of samples is handed to every subscription that is
+ * due, so the sampling cost does not grow with the number of subscribers.
+ * The thread ticks as often as the finest interval requested; it is started
+ * by the first subscription and exits after the last one is done.
+ */
+class HighresSamplingService {
+ public:
+  /*
+   * Builds the samplers for a set of counters and returns how many counters
+   * they handle, like SwSwitch::getHighresSamplers().
+   */
+  typedef std::function<int(HighresSamplerList*,
+                            const std::set<std::string>&)> SamplerFactory;
+
+  explicit HighresSamplingService(SamplerFactory getSamplers);
+  ~HighresSamplingService();
+
+  /*
+   * Add a subscription.  The producer is started right away.
+   *
+   * @param[in]    producer    The producer for the new subscription.
+   * @param[in]    veryNice    Whether to lower the priority of the sampling
+   *                           thread.  This only has an effect if the thread
+   *                           is not already running.
+   */
+  void subscribe(std::unique_ptr<SampleProducer> producer, bool veryNice);
+
+  size_t getNumSubscriptions() const;
+
+ private:
+  // Non-copyable
+  HighresSamplingService(const HighresSamplingService&) = delete;
+  HighresSamplingService& operator=(const HighresSamplingService&) = delete;
+
+  void run();
+
+  // Rebuild the samplers if the set of subscribed counters changed.  The
+  // samplers are built without holding lock_.
+  void updateSamplers(std::unique_lock<std::mutex>* g);
+
+  // Sleep until time, or until a new subscription comes in
+  void sleepUntil(std::unique_lock<std::mutex>* g,
+                  const std::chrono::high_resolution_clock::time_point& time,
+                  bool pause);
+
+  void removeCounters(const std::set<std::string>& counters);
+
+  const SamplerFactory getSamplers_;
+
+  // lock_ protects everything below, and is held by the sampling thread
+  // while it is not sleeping
+  mutable std::mutex lock_;
+  std::condition_variable subscribed_;
+  std::atomic<bool> changed_{false};
+  bool stopping_{false};
+  bool running_{false};
+  std::thread thread_;
+
+  std::vector<std::unique_ptr<SampleProducer>> producers_;
+  // {counter name} -> {number of subscriptions that want it}
+  std::map<std::string, int> counterRefs_;
+  bool countersChanged_{false};
+  HighresSamplerList samplers_;
+  int numCounters_{0};
+  // The latest round of samples
+  CounterPublication round_;
+
+  // For keeping track of the rate at which we are sampling
+  SingleThreadRateCalculator rateCalc_;
+  int64_t numRounds_{0};
+  int overloadWarningCounter_{0};
+  int64_t numRoundsAtLastOverloadWarning_{0};
 };
 }} // facebook::fboss
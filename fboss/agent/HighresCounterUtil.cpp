@@ -9,12 +9,60 @@
  */
 #include "fboss/agent/HighresCounterUtil.h"
 
-#include <sys/stat.h>
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/HwSwitch.h"
+
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/Varint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
 
 DEFINE_bool(print_rates,
             false,
             "Whether to enable RateCalculator calculations and printouts.");
 
+namespace {
+
+const int64_t kNsPerS = 1000 * 1000 * 1000;
+// Enough for /proc/net/dev with a few dozen interfaces
+const size_t kInitialBufSize = 16 * 1024;
+
+void appendValue(int64_t value, std::string* out) {
+  // zigzag, so small negative values stay small
+  uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^
+    static_cast<uint64_t>(value >> 63);
+  uint8_t buf[folly::kMaxVarintLength64];
+  auto len = folly::encodeVarint(zigzag, buf);
+  out->append(reinterpret_cast<const char*>(buf), len);
+}
+
+int64_t readValue(folly::ByteRange* in) {
+  if (in->empty()) {
+    throw facebook::fboss::FbossError("truncated columnar counter data");
+  }
+  uint64_t zigzag = folly::decodeVarint(*in);
+  return static_cast<int64_t>((zigzag >> 1) ^ -(zigzag & 1));
+}
+
+// The deltas are computed on unsigned values so they wrap instead of
+// overflowing
+int64_t delta(int64_t value, int64_t prev) {
+  return static_cast<int64_t>(static_cast<uint64_t>(value) -
+                              static_cast<uint64_t>(prev));
+}
+
+int64_t undelta(int64_t delta, int64_t prev) {
+  return static_cast<int64_t>(static_cast<uint64_t>(prev) +
+                              static_cast<uint64_t>(delta));
+}
+
+}
+
 namespace facebook { namespace fboss {
 
 void DumbCounterSampler::sample(CounterPublication* pub) {
@@ -22,57 +70,301 @@ void DumbCounterSampler::sample(CounterPublication* pub) {
 }
 
 InterfaceRateSampler::InterfaceRateSampler(
-    const std::set<folly::StringPiece>& counters) {
+    const std::set<folly::StringPiece>& counters,
+    const char* path) {
   for (const auto& c : counters) {
-    if (c.compare(kTxBytesCounterName) == 0 ||
-        c.compare(kRxBytesCounterName) == 0) {
-      counters_.insert(c.toString());
+    if (c.compare(kTxBytesCounterName) == 0) {
+      sampleTx_ = true;
+      ++numCounters_;
+    } else if (c.compare(kRxBytesCounterName) == 0) {
+      sampleRx_ = true;
+      ++numCounters_;
     }
   }
+  if (numCounters_ == 0) {
+    return;
+  }
 
-  struct stat buffer;
-
-  if (!counters_.empty() && (stat("/proc/net/dev", &buffer) == 0)) {
-    numCounters_ = counters_.size();
-  } else {
+  fd_ = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    PLOG(WARNING) << "Cannot open " << path;
     numCounters_ = 0;
+    return;
+  }
+  buf_.resize(kInitialBufSize);
+  auto len = readFile();
+  if (len < 0) {
+    numCounters_ = 0;
+    return;
+  }
+  parseLayout(folly::StringPiece(buf_.data(), len));
+}
+
+InterfaceRateSampler::~InterfaceRateSampler() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+ssize_t InterfaceRateSampler::readFile() {
+  while (true) {
+    if (lseek(fd_, 0, SEEK_SET) < 0) {
+      return -1;
+    }
+    auto len = folly::readFull(fd_, buf_.data(), buf_.size());
+    if (len < 0 || static_cast<size_t>(len) < buf_.size()) {
+      return len;
+    }
+    // The buffer might have been too small.  This only happens when
+    // interfaces are added, so just start over with a bigger one.
+    buf_.resize(buf_.size() * 2);
+  }
+}
+
+void InterfaceRateSampler::parseLayout(folly::StringPiece contents) {
+  // The second line names the columns of the receive and transmit sections:
+  //  face |bytes    packets errs ...|bytes    packets errs ...
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines);
+  if (lines.size() < 2) {
+    return;
   }
+  std::vector<folly::StringPiece> sections;
+  folly::split('|', lines[1], sections);
+  if (sections.size() < 3) {
+    return;
+  }
+  std::vector<folly::StringPiece> rxColumns;
+  std::vector<folly::StringPiece> txColumns;
+  folly::split(' ', sections[1], rxColumns, true);
+  folly::split(' ', sections[2], txColumns, true);
+  auto rx = std::find(rxColumns.begin(), rxColumns.end(), "bytes");
+  auto tx = std::find(txColumns.begin(), txColumns.end(), "bytes");
+  if (rx == rxColumns.end() || tx == txColumns.end()) {
+    LOG(WARNING) << "Unexpected interface stats header: " << lines[1];
+    return;
+  }
+  rxBytesColumn_ = rx - rxColumns.begin();
+  txBytesColumn_ = rxColumns.size() + (tx - txColumns.begin());
 }
 
 void InterfaceRateSampler::sample(CounterPublication* pub) {
   uint64_t sin = -1;
   uint64_t sout = -1;
 
-  ifs_.open("/proc/net/dev");
-  std::string line, buf;
-  if (ifs_.is_open()) {
-    // In/out traffic in bytes are located at the 1st and the 9th tokens
-    // for each interface. Indexes start at 0.
-    // We consider only ethN interfaces.
+  auto len = readFile();
+  if (len >= 0) {
+    // In/out traffic in bytes are located at rxBytesColumn_ and
+    // txBytesColumn_ after the interface name.  We consider only ethN
+    // interfaces.
     sin = sout = 0;
-    while (getline(ifs_, line)) {
-      std::istringstream iss(line);
-
-      iss >> buf;
-      const std::string prefix = "eth";
-
-      if (buf.substr(0, prefix.size()) == prefix) {
-        iss >> buf;
-        sin += atoll(buf.c_str());
-
-        for (int tokid = 2; tokid < 10; ++tokid)
-          iss >> buf;
-        sout += atoll(buf.c_str());
+    const char* pos = buf_.data();
+    const char* const end = buf_.data() + len;
+    while (pos < end) {
+      const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+      if (!eol) {
+        eol = end;
       }
+      const char* colon = static_cast<const char*>(memchr(pos, ':', eol - pos));
+      while (pos < eol && *pos == ' ') {
+        ++pos;
+      }
+      if (colon && eol - pos > 3 && strncmp(pos, "eth", 3) == 0) {
+        pos = colon + 1;
+        for (size_t column = 0; pos < eol; ++column) {
+          while (pos < eol && *pos == ' ') {
+            ++pos;
+          }
+          uint64_t value = 0;
+          while (pos < eol && *pos >= '0' && *pos <= '9') {
+            value = value * 10 + (*pos - '0');
+            ++pos;
+          }
+          if (column == rxBytesColumn_) {
+            sin += value;
+          } else if (column == txBytesColumn_) {
+            sout += value;
+            break;
+          }
+          // Skip anything that isn't a number
+          while (pos < eol && *pos != ' ') {
+            ++pos;
+          }
+        }
+      }
+      pos = eol + 1;
     }
-    ifs_.close();
   }
 
-  if (counters_.count(kTxBytesCounterName)) {
+  if (sampleTx_) {
     pub->counters[kTxBytesCounterFullName].push_back(sout);
   }
-  if (counters_.count(kRxBytesCounterName)) {
+  if (sampleRx_) {
     pub->counters[kRxBytesCounterFullName].push_back(sin);
   }
 }
+
+namespace {
+
+// The names of the HwPortCounters, as BcmPort exports them
+const char* const kHwPortCounterNames[] = {
+  "in_bytes",
+  "in_unicast_pkts",
+  "in_multicast_pkts",
+  "in_broadcast_pkts",
+  "in_discards",
+  "in_errors",
+  "out_bytes",
+  "out_unicast_pkts",
+  "out_multicast_pkts",
+  "out_broadcast_pkts",
+  "out_discards",
+  "out_errors",
+};
+static_assert(sizeof(kHwPortCounterNames) / sizeof(kHwPortCounterNames[0]) ==
+              static_cast<size_t>(HwPortCounter::NUM_COUNTERS),
+              "kHwPortCounterNames must cover every HwPortCounter");
+
+}
+
+PortCounterSampler::PortCounterSampler(
+    HwSwitch* hw,
+    const std::set<folly::StringPiece>& counters)
+    : hw_(hw) {
+  // Group the counters by port, so each port is read with one call
+  std::map<PortID, PortCounters> ports;
+  for (const auto& c : counters) {
+    folly::StringPiece portName;
+    folly::StringPiece statName;
+    if (!folly::split('.', c, portName, statName) ||
+        !portName.removePrefix("port")) {
+      LOG(ERROR) << "Bad port counter: " << c;
+      continue;
+    }
+    PortID port;
+    try {
+      port = PortID(folly::to<uint16_t>(portName));
+    } catch (const std::range_error&) {
+      LOG(ERROR) << "Bad port counter: " << c;
+      continue;
+    }
+    auto name = std::find(std::begin(kHwPortCounterNames),
+                          std::end(kHwPortCounterNames), statName);
+    if (name == std::end(kHwPortCounterNames)) {
+      LOG(ERROR) << "Bad port counter: " << c;
+      continue;
+    }
+
+    auto& portCounters = ports[port];
+    portCounters.port = port;
+    portCounters.counters.push_back(static_cast<HwPortCounter>(
+        name - std::begin(kHwPortCounterNames)));
+    portCounters.names.push_back(folly::to<std::string>(kIdentifier, "::", c));
+  }
+
+  for (auto& entry : ports) {
+    auto& portCounters = entry.second;
+    portCounters.values.resize(portCounters.counters.size());
+    if (!hw_->readPortCounters(portCounters.port, portCounters.counters,
+                               portCounters.values.data())) {
+      LOG(WARNING) << "Cannot read counters of port " << portCounters.port;
+      continue;
+    }
+    numCounters_ += portCounters.counters.size();
+    ports_.push_back(std::move(portCounters));
+  }
+}
+
+void PortCounterSampler::sample(CounterPublication* pub) {
+  for (auto& port : ports_) {
+    auto& values = port.values;
+    if (!hw_->readPortCounters(port.port, port.counters, values.data())) {
+      std::fill(values.begin(), values.end(), -1);
+    }
+    for (size_t idx = 0; idx < values.size(); ++idx) {
+      pub->counters[port.names[idx]].push_back(values[idx]);
+    }
+  }
+}
+
+void ColumnarCounterEncoder::encode(CounterPublication* pub) {
+  ColumnarCounters columnar;
+  columnar.numSamples = pub->times.size();
+
+  int64_t prevTime = 0;
+  int64_t prevDelta = 0;
+  for (size_t i = 0; i < pub->times.size(); ++i) {
+    const auto& t = pub->times[i];
+    int64_t time = t.seconds * kNsPerS + t.nanoseconds;
+    if (i == 0) {
+      appendValue(time, &columnar.times);
+    } else {
+      int64_t timeDelta = delta(time, prevTime);
+      appendValue(delta(timeDelta, prevDelta), &columnar.times);
+      prevDelta = timeDelta;
+    }
+    prevTime = time;
+  }
+
+  for (const auto& counter : pub->counters) {
+    auto ret = ids_.emplace(counter.first, ids_.size());
+    auto id = ret.first->second;
+    if (ret.second) {
+      columnar.newIds[id] = counter.first;
+    }
+    auto& column = columnar.values[id];
+    int64_t prev = 0;
+    for (auto value : counter.second) {
+      appendValue(delta(value, prev), &column);
+      prev = value;
+    }
+  }
+
+  pub->times.clear();
+  pub->counters.clear();
+  pub->columnar = std::move(columnar);
+  pub->__isset.columnar = true;
+}
+
+void ColumnarCounterDecoder::decode(CounterPublication* pub) {
+  if (!pub->__isset.columnar) {
+    return;
+  }
+  const auto& columnar = pub->columnar;
+  for (const auto& newId : columnar.newIds) {
+    names_[newId.first] = newId.second;
+  }
+
+  pub->times.clear();
+  folly::ByteRange times(folly::StringPiece(columnar.times));
+  int64_t time = 0;
+  int64_t timeDelta = 0;
+  for (int32_t i = 0; i < columnar.numSamples; ++i) {
+    if (i == 0) {
+      time = readValue(&times);
+    } else {
+      timeDelta = undelta(readValue(&times), timeDelta);
+      time = undelta(timeDelta, time);
+    }
+    pub->times.emplace_back(apache::thrift::FragileConstructor::FRAGILE,
+                            time / kNsPerS, time % kNsPerS);
+  }
+
+  pub->counters.clear();
+  for (const auto& column : columnar.values) {
+    auto name = names_.find(column.first);
+    if (name == names_.end()) {
+      throw FbossError("unknown counter ID ", column.first);
+    }
+    auto& values = pub->counters[name->second];
+    folly::ByteRange in(folly::StringPiece(column.second));
+    int64_t value = 0;
+    for (int32_t i = 0; i < columnar.numSamples; ++i) {
+      value = undelta(readValue(&in), value);
+      values.push_back(value);
+    }
+  }
+  pub->__isset.columnar = false;
+}
+
 }} // facebook::fboss
@@ -12,15 +12,21 @@
 #include <folly/Synchronized.h>
 
 #include "fboss/agent/if/gen-cpp2/highres_types.h"
+#include "fboss/agent/types.h"
+
+#include <sys/types.h>
 
 #include <chrono>
-#include <fstream>
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 
 DECLARE_bool(print_rates);
 
 namespace facebook { namespace fboss {
 
+class HwSwitch;
+enum class HwPortCounter : uint8_t;
+
 class HighresSampler;
 typedef std::vector<std::unique_ptr<HighresSampler>> HighresSamplerList;
 
@@ -82,8 +88,9 @@ class DumbCounterSampler : public HighresSampler {
  */
 class InterfaceRateSampler : public HighresSampler {
  public:
-  explicit InterfaceRateSampler(const std::set<folly::StringPiece>& counters);
-  ~InterfaceRateSampler() override {}
+  explicit InterfaceRateSampler(const std::set<folly::StringPiece>& counters,
+                                const char* path = "/proc/net/dev");
+  ~InterfaceRateSampler() override;
   void sample(CounterPublication* pub) override;
 
   int numCounters() const override { return numCounters_; }
@@ -99,12 +106,102 @@ class InterfaceRateSampler : public HighresSampler {
       "interface_rate::rx";
 
  private:
-  // We save an ifstream for reading counters without needing to repeatedly call
-  // the constructor
-  std::ifstream ifs_;
-  std::unordered_set<std::string> counters_;
+  // Non-copyable
+  InterfaceRateSampler(const InterfaceRateSampler&) = delete;
+  InterfaceRateSampler& operator=(const InterfaceRateSampler&) = delete;
+
+  // Read the whole file into buf_, returning its length or -1 on error
+  ssize_t readFile();
+  // Work out which columns hold the byte counts from the header
+  void parseLayout(folly::StringPiece contents);
+
+  // We keep the file open, and just seek back to the start for every sample
+  int fd_{-1};
+  std::vector<char> buf_;
+  // The column of the rx and tx byte counts, not counting the interface name
+  size_t rxBytesColumn_{0};
+  size_t txBytesColumn_{8};
+
+  bool sampleRx_{false};
+  bool sampleTx_{false};
+  int numCounters_{0};
+};
 
-  int numCounters_;
+/*
+ * A sampler that reads front panel port counters through the HwSwitch.
+ *
+ * Counters are named after the port stats BcmPort exports, for instance
+ * "port_counters::port1.in_bytes".  All the counters of a port are read with a
+ * single HwSwitch::readPortCounters() call.
+ */
+class PortCounterSampler : public HighresSampler {
+ public:
+  PortCounterSampler(HwSwitch* hw, const std::set<folly::StringPiece>& counters);
+  ~PortCounterSampler() override {}
+  void sample(CounterPublication* pub) override;
+
+  int numCounters() const override { return numCounters_; }
+
+  static constexpr const char* const kIdentifier = "port_counters";
+
+ private:
+  // Non-copyable
+  PortCounterSampler(const PortCounterSampler&) = delete;
+  PortCounterSampler& operator=(const PortCounterSampler&) = delete;
+
+  struct PortCounters {
+    PortID port{0};
+    std::vector<HwPortCounter> counters;
+    // Full names, in the same order as counters
+    std::vector<std::string> names;
+    std::vector<uint64_t> values;
+  };
+
+  HwSwitch* const hw_{nullptr};
+  std::vector<PortCounters> ports_;
+  int numCounters_{0};
+};
+
+/*
+ * Converts publications to the COLUMNAR format.  Samplers fill in times and
+ * counters as usual, and encode() moves them into pub->columnar.
+ *
+ * Counter IDs are assigned the first time a counter is encoded and never
+ * change afterwards, so there should be one encoder per subscription and
+ * publications must be encoded in the order they are sent.
+ */
+class ColumnarCounterEncoder {
+ public:
+  ColumnarCounterEncoder() {}
+
+  void encode(CounterPublication* pub);
+
+ private:
+  // Non-copyable
+  ColumnarCounterEncoder(const ColumnarCounterEncoder&) = delete;
+  ColumnarCounterEncoder& operator=(const ColumnarCounterEncoder&) = delete;
+
+  std::unordered_map<std::string, int32_t> ids_;
+};
+
+/*
+ * The client side of ColumnarCounterEncoder.  decode() restores times and
+ * counters from pub->columnar, and throws FbossError if the publication
+ * can't be decoded.  Publications must be decoded in the order they were
+ * sent.
+ */
+class ColumnarCounterDecoder {
+ public:
+  ColumnarCounterDecoder() {}
+
+  void decode(CounterPublication* pub);
+
+ private:
+  // Non-copyable
+  ColumnarCounterDecoder(const ColumnarCounterDecoder&) = delete;
+  ColumnarCounterDecoder& operator=(const ColumnarCounterDecoder&) = delete;
+
+  std::unordered_map<int32_t, std::string> names_;
 };
 
 /*
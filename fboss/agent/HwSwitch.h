@@ -17,8 +17,10 @@
 #include <folly/IPAddress.h>
 #include <folly/dynamic.h>
 
+#include <chrono>
 #include <memory>
 #include <utility>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -28,6 +30,26 @@ class StateDelta;
 class RxPacket;
 class TxPacket;
 
+/*
+ * The port counters a HwSwitch can read directly for high resolution
+ * sampling.  These are the same counters BcmPort::updateStats() exports.
+ */
+enum class HwPortCounter : uint8_t {
+  IN_BYTES,
+  IN_UNICAST_PKTS,
+  IN_MULTICAST_PKTS,
+  IN_BROADCAST_PKTS,
+  IN_DISCARDS,
+  IN_ERRORS,
+  OUT_BYTES,
+  OUT_UNICAST_PKTS,
+  OUT_MULTICAST_PKTS,
+  OUT_BROADCAST_PKTS,
+  OUT_DISCARDS,
+  OUT_ERRORS,
+  NUM_COUNTERS
+};
+
 /*
  * HwSwitch contains the hardware-specific switching logic.
  *
@@ -72,6 +94,16 @@ class HwSwitch {
      */
     virtual void linkStateChanged(PortID port, bool up) noexcept = 0;
 
+    /*
+     * linkDownEcmpPruned() is invoked by the HwSwitch once a port that went
+     * down has been removed from all ECMP groups in hardware.  This happens
+     * before linkStateChanged() is called for the same event, and so before
+     * any software reconvergence.  elapsed is the time from the HwSwitch
+     * first seeing the link down to traffic being rebalanced.
+     */
+    virtual void linkDownEcmpPruned(
+        PortID port, std::chrono::microseconds elapsed) noexcept = 0;
+
     /*
      * Used to notify the SwSwitch of a fatal error so the implementation can
      * provide special behavior when a crash occurs.
@@ -161,6 +193,21 @@ class HwSwitch {
       const folly::StringPiece namespaceString,
       const std::set<folly::StringPiece>& counterSet) = 0;
 
+  /*
+   * Read the current values of some of a port's counters.  This is used by
+   * the high-resolution port counter sampler, so it is called far more often
+   * than updateStats(), and from a different thread.
+   *
+   * @return     false if the port doesn't exist or the counters couldn't be
+   *             read.
+   * @param[in]  port      The port to read the counters of.
+   * @param[in]  counters  The counters to read.
+   * @param[out] values    The counter values, in the same order as counters.
+   */
+  virtual bool readPortCounters(PortID port,
+                                const std::vector<HwPortCounter>& counters,
+                                uint64_t* values) = 0;
+
   virtual void fetchL2Table(std::vector<L2EntryThrift> *l2Table) = 0;
 
   /*
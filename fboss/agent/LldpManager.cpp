@@ -82,14 +82,74 @@ void LldpManager::timeoutExpired() noexcept {
 void LldpManager::sendLldpOnAllPorts(bool checkPortStatusFlag) {
   // send lldp frames through all the ports here.
   std::shared_ptr<SwitchState> state = sw_->getState();
+  updateSystemInfo();
   for (const auto& port : *state->getPorts()) {
     if (checkPortStatusFlag == false || sw_->isPortUp(port->getID())) {
-      sendLldpInfo(sw_, state, port);
+      sendLldpInfo(port);
     } else {
       VLOG(5) << "Skipping LLDP send as this port is disabled " <<
         port->getID();
     }
   }
+  pruneFrames(state->getPorts());
+}
+
+void LldpManager::updateSystemInfo() {
+  // The frames only depend on the system info and the port, so they are
+  // encoded once and then reused until one of them changes.
+  MacAddress cpuMac = sw_->getPlatform()->getLocalMac();
+  const size_t kMaxLen = 64;
+  char hostname[kMaxLen];
+
+  if (0 == gethostname(hostname, kMaxLen)) {
+    // make sure it is null terminated
+    hostname[kMaxLen - 1] = '\0';
+  } else {
+    hostname[0] = '\0';
+  }
+
+  if (cpuMac != cpuMac_ || hostname_ != hostname) {
+    VLOG(2) << "LLDP system info changed, re-encoding all LLDP frames";
+    cpuMac_ = cpuMac;
+    hostname_ = hostname;
+    frames_.clear();
+  }
+}
+
+const folly::IOBuf* LldpManager::getFrame(const shared_ptr<Port>& port) {
+  auto& entry = frames_[port->getID()];
+  if (entry.port == port) {
+    return entry.frame.get();
+  }
+  // The port changed, but possibly not in a way that affects its frame
+  if (entry.port &&
+      entry.port->getName() == port->getName() &&
+      entry.port->getIngressVlan() == port->getIngressVlan()) {
+    entry.port = port;
+    return entry.frame.get();
+  }
+
+  VLOG(4) << "encoding LLDP frame for port " << port->getID();
+  auto frame = folly::IOBuf::create(LLDP_FRAME_LENGTH);
+  frame->append(LLDP_FRAME_LENGTH);
+  writeLldpFrame(cpuMac_, hostname_, port.get(), frame.get());
+  entry.port = port;
+  entry.frame = std::move(frame);
+  return entry.frame.get();
+}
+
+void LldpManager::pruneFrames(const shared_ptr<PortMap>& ports) {
+  if (frames_.size() <= ports->size()) {
+    return;
+  }
+  auto it = frames_.begin();
+  while (it != frames_.end()) {
+    if (!ports->getPortIf(it->first)) {
+      it = frames_.erase(it);
+    } else {
+      ++it;
+    }
+  }
 }
 
 uint16_t tlvHeader(uint16_t type, uint16_t length) {
@@ -128,28 +188,13 @@ void writeTlv(uint16_t type, const ByteRange& value,
   cursor->push(value.data(), value.size());
 }
 
-void LldpManager::sendLldpInfo(SwSwitch* sw,
-                               const std::shared_ptr<SwitchState>& swState,
-                               const std::shared_ptr<Port>& port) {
-  MacAddress cpuMac = sw->getPlatform()->getLocalMac();
-  const size_t kMaxLen = 64;
-  char hostname[kMaxLen];
-
-  if (0 == gethostname(hostname, kMaxLen)) {
-    // make sure it is null terminated
-    hostname[kMaxLen - 1] = '\0';
-  } else {
-    hostname[0] = '\0';
-  }
-
-  // The minimum packet length is 64.We use 68 on the assumption that
-  // the packet will go out untagged, which will remove 4 bytes.
-  uint32_t frameLen = 98;
-  auto pkt = sw->allocatePacket(frameLen);
-  PortID thisPortID = port->getID();
-  RWPrivateCursor cursor(pkt->buf());
-  pkt->writeEthHeader(&cursor, LLDP_DEST_MAC,
-                      cpuMac, port->getIngressVlan(), ETHERTYPE_LLDP);
+void LldpManager::writeLldpFrame(MacAddress cpuMac,
+                                 const std::string& hostname,
+                                 const Port* port,
+                                 folly::IOBuf* buf) {
+  RWPrivateCursor cursor(buf);
+  TxPacket::writeEthHeader(&cursor, LLDP_DEST_MAC,
+                           cpuMac, port->getIngressVlan(), ETHERTYPE_LLDP);
   // now write chassis ID TLV
   writeTlv(CHASSIS_TLV_TYPE, CHASSIS_TLV_SUB_TYPE_MAC,
            ByteRange(cpuMac.bytes(), 6), &cursor);
@@ -166,7 +211,7 @@ void LldpManager::sendLldpInfo(SwSwitch* sw,
 
   // now write optional TLVs
   // system name TLV
-  if (strlen(hostname) > 0) {
+  if (!hostname.empty()) {
     writeTlv(SYSTEM_NAME_TLV_TYPE,
              StringPiece(hostname), &cursor);
   }
@@ -184,11 +229,17 @@ void LldpManager::sendLldpInfo(SwSwitch* sw,
 
   // Fill the padding with 0s
   memset(cursor.writableData(), 0, cursor.length());
+}
+
+void LldpManager::sendLldpInfo(const std::shared_ptr<Port>& port) {
+  const auto* frame = getFrame(port);
+  auto pkt = sw_->allocatePacket(LLDP_FRAME_LENGTH);
+  memcpy(pkt->buf()->writableData(), frame->data(), LLDP_FRAME_LENGTH);
   // this LLDP packet HAS to exit out of the port specified here.
-  sw->sendPacketOutOfPort(std::move(pkt), thisPortID);
+  sw_->sendPacketOutOfPort(std::move(pkt), port->getID());
   VLOG(4) << "sent LLDP "
     << " on port " << port->getID()
-    << " with CPU MAC " << cpuMac.toString()
+    << " with CPU MAC " << cpuMac_.toString()
     << " port id " << port->getName()
     << " and vlan " << port->getIngressVlan();
 }
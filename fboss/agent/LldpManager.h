@@ -10,8 +10,12 @@
 // Copyright 2014-present Facebook. All Rights Reserved.
 #pragma once
 #include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/IOBuf.h>
+#include <folly/MacAddress.h>
+#include <map>
 #include <unordered_map>
 #include <memory>
+#include <string>
 #include "fboss/agent/Platform.h"
 #include "fboss/agent/lldp/LinkNeighborDB.h"
 #include "fboss/agent/state/Port.h"
@@ -84,18 +88,51 @@ class LldpManager : private folly::AsyncTimeout {
   // This function is internal.  It is only public for use in unit tests.
   void sendLldpOnAllPorts(bool checkPortStatusFlag);
 
+  /*
+   * Encode the LLDP frame we send out of a port into buf, which must have
+   * room for LLDP_FRAME_LENGTH bytes.
+   */
+  static void writeLldpFrame(folly::MacAddress cpuMac,
+                             const std::string& hostname,
+                             const Port* port,
+                             folly::IOBuf* buf);
+
   LinkNeighborDB* getDB() {
     return &db_;
   }
 
+  enum : uint32_t {
+    // The minimum packet length is 64.  We use 68 on the assumption that
+    // the packet will go out untagged, which will remove 4 bytes.
+    LLDP_FRAME_LENGTH = 98,
+  };
+
  private:
+  /*
+   * The encoded frame for a port, along with the Port node it was built
+   * from.  Port nodes are copy-on-write, so as long as the state holds the
+   * same node the frame is still good.
+   */
+  struct FrameTemplate {
+    std::shared_ptr<Port> port;
+    std::unique_ptr<folly::IOBuf> frame;
+  };
+
   void timeoutExpired() noexcept override;
-  void sendLldpInfo(SwSwitch* sw, const std::shared_ptr<SwitchState>& swState,
-                    const std::shared_ptr<Port>& port);
+  void updateSystemInfo();
+  const folly::IOBuf* getFrame(const std::shared_ptr<Port>& port);
+  void pruneFrames(const std::shared_ptr<PortMap>& ports);
+  void sendLldpInfo(const std::shared_ptr<Port>& port);
 
   SwSwitch* sw_{nullptr};
   std::chrono::milliseconds interval_;
   LinkNeighborDB db_;
+
+  // Only accessed from sendLldpOnAllPorts(), which runs on the background
+  // thread.
+  folly::MacAddress cpuMac_;
+  std::string hostname_;
+  std::map<PortID, FrameTemplate> frames_;
 };
 
 }} // facebook::fboss
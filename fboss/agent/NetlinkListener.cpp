@@ -1,4 +1,5 @@
 #include "NetlinkListener.h"
+#include "fboss/agent/packet/PktUtil.h"
 
 namespace facebook { namespace fboss {
 
@@ -920,11 +921,16 @@ int NetlinkListener::read_packet_from_port(NetlinkListener * nll, TapIntf * ifac
 		return 0; /* silently fail */
 	}
 
-	pkt = nll->sw_->allocateL2TxPacket(interface->getMtu());
+	/*
+	 * Leave room for one byte past the MTU, so that an oversized frame is
+	 * noticed instead of being forwarded.
+	 */
+	int mtu = interface->getMtu();
+	pkt = nll->sw_->allocateL2TxPacket(mtu + 1);
 	auto buf = pkt->buf();
 
 	/* read one packet per call; assumes level-triggered epoll() */
-	if ((len = read(iface->getIfaceFD(), buf->writableTail(), buf->tailroom())) < 0)
+	if ((len = PktUtil::readPacket(iface->getIfaceFD(), buf, mtu)) < 0)
 	{
 		if ((errno == EWOULDBLOCK) || (errno == EAGAIN))
 		{
@@ -936,9 +942,9 @@ int NetlinkListener::read_packet_from_port(NetlinkListener * nll, TapIntf * ifac
 			return -1;
 		}
 	}
-	else if (len > 0 && len > buf->tailroom())
+	else if (len > 0 && len > mtu)
 	{
-		std::cout << "Too large packet (" << std::to_string(len) << " > " << buf->tailroom() << ") received from host. Dropping packet" << std::endl;
+		std::cout << "Too large packet (" << std::to_string(len) << " > " << mtu << ") received from host. Dropping packet" << std::endl;
 	}
 	else if (len > 0)
 	{
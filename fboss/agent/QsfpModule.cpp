@@ -10,6 +10,7 @@
 #include "QsfpModule.h"
 
 #include <boost/assign.hpp>
+#include <cstring>
 #include <string>
 #include <limits>
 #include <iomanip>
@@ -18,6 +19,7 @@
 #include "fboss/agent/SffFieldInfo.h"
 
 namespace facebook { namespace fboss {
+  using std::memcmp;
   using std::memcpy;
   using std::mutex;
   using std::lock_guard;
@@ -425,9 +427,33 @@ void QsfpModule::getTransceiverInfo(TransceiverInfo &info) {
   }
 }
 
+void QsfpModule::startDetectTransceiver() {
+  lock_guard<std::mutex> g(qsfpModuleMutex_);
+  if (!pendingPresence_) {
+    pendingPresence_ = qsfpImpl_->detectTransceiverAsync();
+  }
+}
+
+void QsfpModule::startUpdateTransceiverInfoFields() {
+  lock_guard<std::mutex> g(qsfpModuleMutex_);
+  // Only the polls of a module whose cache is good read just the dynamic
+  // bytes; anything else reads all the pages, synchronously.
+  if (present_ && !dirty_ && !pendingDynamic_) {
+    pendingDynamic_ = qsfpImpl_->readTransceiverAsync(
+        0x50, DYNAMIC_OFFSET, DYNAMIC_LENGTH);
+  }
+}
+
 void QsfpModule::detectTransceiver() {
   lock_guard<std::mutex> g(qsfpModuleMutex_);
-  auto currentQsfpStatus = qsfpImpl_->detectTransceiver();
+  bool currentQsfpStatus;
+  if (pendingPresence_) {
+    auto presence = std::move(*pendingPresence_);
+    pendingPresence_.clear();
+    currentQsfpStatus = presence.get();
+  } else {
+    currentQsfpStatus = qsfpImpl_->detectTransceiver();
+  }
   if (currentQsfpStatus != present_) {
     LOG(INFO) << "Port: " << folly::to<std::string>(qsfpImpl_->getName()) <<
                   " QSFP status changed to " << currentQsfpStatus;
@@ -467,26 +493,17 @@ void QsfpModule::updateTransceiverInfoFields() {
 void QsfpModule::updateQsfpData() {
   if (present_) {
     try {
-      qsfpImpl_->readTransceiver(0x50, 0, sizeof(qsfpIdprom_), qsfpIdprom_);
-      dirty_ = false;
-      setQsfpIdprom();
-      /*
-       * XXX:  Should we bother to read this other data every time?
-       *       Surely, it isn't changing?  Is there some other utility to
-       *       update this stuff?  Perhaps just reading the base 128 bytes
-       *       is enough after we initially determine that somethings there?
-       */
-
-      // If we have flat memory, we don't have to set the page
-      if (!flatMem_) {
-        uint8_t page = 0;
-        qsfpImpl_->writeTransceiver(0x50, 127, sizeof(page), &page);
-      }
-      qsfpImpl_->readTransceiver(0x50, 128, sizeof(qsfpPage0_), qsfpPage0_);
-      if (!flatMem_) {
-        uint8_t page = 3;
-        qsfpImpl_->writeTransceiver(0x50, 127, sizeof(page), &page);
-        qsfpImpl_->readTransceiver(0x50, 128, sizeof(qsfpPage3_), qsfpPage3_);
+      if (dirty_) {
+        // A read queued while the cache was still good is of no use now
+        pendingDynamic_.clear();
+        readAllPages();
+      } else if (readDynamicBytes()) {
+        setQsfpIdprom();
+      } else {
+        // A different module, which has to be set up just like one that
+        // was inserted.
+        readAllPages();
+        customizeTransceiver();
       }
     } catch (const std::exception& ex) {
       dirty_ = true;
@@ -496,6 +513,81 @@ void QsfpModule::updateQsfpData() {
   }
 }
 
+void QsfpModule::readAllPages() {
+  // A failed or short read throws, and updateQsfpData() then leaves the
+  // cache dirty, so that it is all read again on the next refresh.
+  readPage(0, sizeof(qsfpIdprom_), qsfpIdprom_);
+  controlStale_ = false;
+  dirty_ = false;
+  setQsfpIdprom();
+
+  // If we have flat memory, we don't have to set the page
+  if (!flatMem_) {
+    writePage(0);
+  }
+  readPage(128, sizeof(qsfpPage0_), qsfpPage0_);
+  if (!flatMem_) {
+    writePage(3);
+    readPage(128, sizeof(qsfpPage3_), qsfpPage3_);
+  }
+}
+
+void QsfpModule::readPage(int offset, int length, uint8_t* data) {
+  int len = qsfpImpl_->readTransceiver(0x50, offset, length, data);
+  if (len != length) {
+    throw FbossError("QSFP read at offset ", offset, " failed, got ", len,
+                     " of ", length, " bytes");
+  }
+}
+
+void QsfpModule::writePage(uint8_t page) {
+  int len = qsfpImpl_->writeTransceiver(0x50, 127, sizeof(page), &page);
+  if (len != sizeof(page)) {
+    throw FbossError("QSFP page select of page ", int(page), " failed");
+  }
+}
+
+bool QsfpModule::readDynamicBytes() {
+  std::vector<uint8_t> dynamic;
+  if (pendingDynamic_) {
+    auto read = std::move(*pendingDynamic_);
+    pendingDynamic_.clear();
+    dynamic = read.get();
+  } else {
+    dynamic = qsfpImpl_->readTransceiverAsync(
+        0x50, DYNAMIC_OFFSET, DYNAMIC_LENGTH).get();
+  }
+  if (dynamic.size() != DYNAMIC_LENGTH) {
+    throw FbossError("QSFP dynamic bytes read failed, got ", dynamic.size(),
+                     " of ", DYNAMIC_LENGTH, " bytes");
+  }
+
+  // A different identifier means the module was swapped between two
+  // presence checks, and none of what we have cached can be trusted.
+  int offset;
+  int length;
+  int dataAddress;
+  getQsfpFieldAddress(SffField::IDENTIFIER, dataAddress, offset, length);
+  CHECK_LE(offset + length, DYNAMIC_LENGTH);
+  if (memcmp(dynamic.data() + offset, qsfpIdprom_ + offset, length) != 0) {
+    LOG(INFO) << "Port: " << folly::to<std::string>(qsfpImpl_->getName()) <<
+                 " QSFP identifier changed, re-reading all pages";
+    return false;
+  }
+  memcpy(qsfpIdprom_ + DYNAMIC_OFFSET, dynamic.data(), dynamic.size());
+
+  if (controlStale_) {
+    int len = qsfpImpl_->readTransceiver(0x50, CONTROL_OFFSET, CONTROL_LENGTH,
+                                     qsfpIdprom_ + CONTROL_OFFSET);
+    if (len != CONTROL_LENGTH) {
+      throw FbossError("QSFP control bytes read failed, got ", len, " of ",
+                       CONTROL_LENGTH, " bytes");
+    }
+    controlStale_ = false;
+  }
+  return true;
+}
+
 void QsfpModule::customizeTransceiver() {
   /*
    * Determine whether we need to customize any of the QSFP registers.
@@ -563,6 +655,7 @@ void QsfpModule::customizeTransceiver() {
       }
 
       qsfpImpl_->writeTransceiver(0x50, pwrCtrlOffset, sizeof(power), &power);
+      controlStale_ = true;
       LOG(INFO) << "Port: " << folly::to<std::string>(qsfpImpl_->getName()) <<
                 " QSFP set to override low power";
   }
@@ -10,7 +10,10 @@
 #pragma once
 #include <cstdint>
 #include <mutex>
+#include <vector>
 #include <boost/container/flat_map.hpp>
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
 #include "fboss/agent/Transceiver.h"
 #include "fboss/agent/if/gen-cpp2/optic_types.h"
 
@@ -61,6 +64,12 @@ class QsfpModule : public Transceiver {
    * Check if the QSFP is present or not
    */
   void detectTransceiver() override;
+  /*
+   * Queue the presence check, or the read of the dynamic bytes, for the
+   * next detectTransceiver() or updateTransceiverInfoFields() to pick up.
+   */
+  void startDetectTransceiver() override;
+  void startUpdateTransceiverInfoFields() override;
   /*
    * Returns if the QSFP supports DOM
    */
@@ -107,6 +116,21 @@ class QsfpModule : public Transceiver {
     // Maximum cable length reported
     MAX_CABLE_LEN = 255,
   };
+  /*
+   * Not all of the EEPROM changes at the same rate.  Following the
+   * SFF-8436 layout, the lower page bytes up to the end of the channel
+   * monitors (status, interrupt flags, module and per-channel monitors)
+   * are dynamic and re-read on every poll.  The lower page control bytes
+   * are semi-static:  they only change when we write them.  Upper page 0
+   * (vendor info) and page 3 (thresholds) are static and only read when
+   * the module is inserted, or after a read error.
+   */
+  enum : unsigned int {
+    DYNAMIC_OFFSET = 0,
+    DYNAMIC_LENGTH = 50,
+    CONTROL_OFFSET = 86,
+    CONTROL_LENGTH = 13,
+  };
   // QSFP+ requires a bottom 128 byte page describing important monitoring
   // information, and then an upper 128 byte page with less frequently
   // referenced information, including vendor identifiers.  There are
@@ -122,6 +146,12 @@ class QsfpModule : public Transceiver {
   bool dirty_{false};
   // Flat memory systems don't support paged access to extra data
   bool flatMem_{false};
+  // The cached lower page control bytes need to be re-read
+  bool controlStale_{false};
+  // I/O queued by startDetectTransceiver() and
+  // startUpdateTransceiverInfoFields(), not yet picked up
+  folly::Optional<folly::Future<bool>> pendingPresence_;
+  folly::Optional<folly::Future<std::vector<uint8_t>>> pendingDynamic_;
   /* Qsfp Internal Implementation */
   std::unique_ptr<TransceiverImpl> qsfpImpl_;
 
@@ -215,8 +245,31 @@ class QsfpModule : public Transceiver {
   bool cacheIsValid() const;
   /*
    * Update the cached data with the information from the physical QSFP.
+   * Only the dynamic bytes are read unless the cache is dirty, or the
+   * module was swapped, in which case the new one is also customized.
+   * Any failure leaves the cache dirty.
    */
   void updateQsfpData();
+  /*
+   * Re-read the whole lower page and the static upper pages.  Throws if
+   * any read fails or comes up short.
+   */
+  void readAllPages();
+  /*
+   * Read length bytes at offset of the currently selected page, or throw.
+   */
+  void readPage(int offset, int length, uint8_t* data);
+  /*
+   * Select the upper page to read, or throw.
+   */
+  void writePage(uint8_t page);
+  /*
+   * Re-read the dynamic lower page bytes, or pick up the read queued by
+   * startUpdateTransceiverInfoFields(), and any stale control bytes.
+   * Returns false if the module looks to have been swapped, in which
+   * case nothing is updated.  Throws if a read fails or comes up short.
+   */
+  bool readDynamicBytes();
 };
 
 }} //namespace facebook::fboss
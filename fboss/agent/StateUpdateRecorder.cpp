@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StateUpdateRecorder.h"
+
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/RouteDelta.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/VlanMapDelta.h"
+
+#include <glog/logging.h>
+
+namespace {
+
+template<typename Delta>
+uint32_t countDelta(const Delta& delta) {
+  uint32_t count = 0;
+  for (auto it = delta.begin(); it != delta.end(); ++it) {
+    ++count;
+  }
+  return count;
+}
+
+}
+
+namespace facebook { namespace fboss {
+
+StateUpdateRecorder::StateUpdateRecorder(size_t capacity)
+  : capacity_(capacity) {
+  CHECK_GT(capacity_, 0);
+  records_.reserve(capacity_);
+}
+
+void StateUpdateRecorder::record(Record record) {
+  std::lock_guard<std::mutex> g(lock_);
+  if (records_.size() < capacity_) {
+    records_.push_back(std::move(record));
+    return;
+  }
+  records_[next_] = std::move(record);
+  next_ = (next_ + 1) % capacity_;
+}
+
+std::vector<StateUpdateRecorder::Record>
+StateUpdateRecorder::getRecords() const {
+  std::vector<Record> records;
+  std::lock_guard<std::mutex> g(lock_);
+  records.reserve(records_.size());
+  records.insert(records.end(), records_.begin() + next_, records_.end());
+  records.insert(records.end(), records_.begin(), records_.begin() + next_);
+  return records;
+}
+
+void StateUpdateRecorder::countChanges(const StateDelta& delta,
+                                       Record* record) {
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    record->routesChanged += countDelta(rtDelta.getRoutesV4Delta());
+    record->routesChanged += countDelta(rtDelta.getRoutesV6Delta());
+  }
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    ++record->otherNodesChanged;
+    record->neighborsChanged += countDelta(vlanDelta.getArpDelta());
+    record->neighborsChanged += countDelta(vlanDelta.getNdpDelta());
+  }
+  record->otherNodesChanged += countDelta(delta.getPortsDelta());
+  record->otherNodesChanged += countDelta(delta.getIntfsDelta());
+  record->otherNodesChanged += countDelta(delta.getAclsDelta());
+}
+
+}} // facebook::fboss
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class StateDelta;
+
+/*
+ * StateUpdateRecorder keeps a record of the last few StateUpdates the
+ * SwSwitch applied: what they were called, how long each phase of applying
+ * them took, and how much of the state they changed.
+ *
+ * It is a fixed size ring buffer, so recording never allocates once it has
+ * filled up, and the oldest records are simply overwritten.  Records are
+ * added from the update thread and read from thrift threads.
+ */
+class StateUpdateRecorder {
+ public:
+  enum : size_t {
+    kDefaultCapacity = 1024,
+  };
+
+  struct Record {
+    // The generation of the state the update produced, or of the state it
+    // was applied to if it changed nothing
+    uint32_t generation{0};
+    std::chrono::system_clock::time_point start;
+    // The StateUpdates applied together in this update
+    std::vector<std::string> names;
+
+    // Running the StateUpdate functions
+    std::chrono::microseconds updateFns{0};
+    // Publishing the states they returned
+    std::chrono::microseconds publish{0};
+    // Programming the HwSwitch
+    std::chrono::microseconds hwStateChanged{0};
+    // Notifying the state observers
+    std::chrono::microseconds observers{0};
+    std::chrono::microseconds total{0};
+
+    uint32_t routesChanged{0};
+    uint32_t neighborsChanged{0};
+    // Ports, VLANs, interfaces and ACLs
+    uint32_t otherNodesChanged{0};
+  };
+
+  explicit StateUpdateRecorder(size_t capacity = kDefaultCapacity);
+
+  void record(Record record);
+
+  /*
+   * The records currently held, oldest first.
+   */
+  std::vector<Record> getRecords() const;
+
+  /*
+   * Fill in the change counts in record from delta.
+   */
+  static void countChanges(const StateDelta& delta, Record* record);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  StateUpdateRecorder(StateUpdateRecorder const &) = delete;
+  StateUpdateRecorder& operator=(StateUpdateRecorder const &) = delete;
+
+  const size_t capacity_{0};
+  mutable std::mutex lock_;
+  std::vector<Record> records_;
+  // Where the next record goes once records_ is full
+  size_t next_{0};
+};
+
+}} // facebook::fboss
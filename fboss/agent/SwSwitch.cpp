@@ -9,6 +9,8 @@
  */
 #include "fboss/agent/SwSwitch.h"
 
+#include "fboss/agent/AclClassifier.h"
+#include "fboss/agent/AsyncStateObserver.h"
 #include "fboss/agent/ArpHandler.h"
 #include "fboss/agent/Constants.h"
 #include "fboss/agent/IPv4Handler.h"
@@ -27,6 +29,9 @@
 #include "fboss/agent/capture/PktCaptureManager.h"
 #include "fboss/agent/packet/EthHdr.h"
 #include "fboss/agent/packet/PktUtil.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/ClientRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
 #include "fboss/agent/state/StateDelta.h"
 #include "fboss/agent/state/StateUpdateHelpers.h"
 #include "fboss/agent/state/SwitchState.h"
@@ -41,8 +46,10 @@
 #include <folly/MacAddress.h>
 #include <folly/String.h>
 #include <folly/Demangle.h>
+#include <folly/ScopeGuard.h>
 #include <chrono>
 #include <condition_variable>
+#include <future>
 #include <glog/logging.h>
 
 using folly::EventBase;
@@ -122,6 +129,7 @@ SwSwitch::SwSwitch(std::unique_ptr<Platform> platform, bool initNeighborUpdater)
     ipv4_(new IPv4Handler(this)),
     ipv6_(new IPv6Handler(this)),
     pcapMgr_(new PktCaptureManager(this)),
+    clientRib_(new ClientRib()),
     transceiverMap_(new TransceiverMap()) {
   // Create the platform-specific state directories if they
   // don't exist already.
@@ -395,6 +403,19 @@ void SwSwitch::registerStateObserver(StateObserver* observer,
   }
 }
 
+void SwSwitch::registerAsyncStateObserver(StateObserver* observer,
+                                          const string name,
+                                          size_t maxPending) {
+  VLOG(2) << "Registering async state observer: " << name;
+  if (!updateEventBase_.isInEventBaseThread()) {
+    updateEventBase_.runInEventBaseThreadAndWait([=]() {
+        addAsyncStateObserver(observer, name, maxPending);
+    });
+  } else {
+    addAsyncStateObserver(observer, name, maxPending);
+  }
+}
+
 void SwSwitch::unregisterStateObserver(StateObserver* observer) {
   if (!updateEventBase_.isInEventBaseThread()) {
     updateEventBase_.runInEventBaseThreadAndWait([=]() {
@@ -407,11 +428,20 @@ void SwSwitch::unregisterStateObserver(StateObserver* observer) {
 
 bool SwSwitch::stateObserverRegistered(StateObserver* observer) {
   DCHECK(updateEventBase_.isInEventBaseThread());
-  return stateObservers_.find(observer) != stateObservers_.end();
+  return stateObservers_.find(observer) != stateObservers_.end() ||
+    asyncStateObservers_.find(observer) != asyncStateObservers_.end();
 }
 
 void SwSwitch::removeStateObserver(StateObserver* observer) {
   DCHECK(updateEventBase_.isInEventBaseThread());
+  auto asyncIter = asyncStateObservers_.find(observer);
+  if (asyncIter != asyncStateObservers_.end()) {
+    // Stop queueing updates for it first, then let the wrapper drain and
+    // join its thread as it is destroyed.
+    stateObservers_.erase(asyncIter->second.get());
+    asyncStateObservers_.erase(asyncIter);
+    return;
+  }
   auto nErased = stateObservers_.erase(observer);
   if (!nErased) {
     throw FbossError("State observer remove failed: observer does not exist");
@@ -426,6 +456,19 @@ void SwSwitch::addStateObserver(StateObserver* observer, const string& name) {
   stateObservers_.emplace(observer, name);
 }
 
+void SwSwitch::addAsyncStateObserver(StateObserver* observer,
+                                     const string& name,
+                                     size_t maxPending) {
+  DCHECK(updateEventBase_.isInEventBaseThread());
+  if (stateObserverRegistered(observer)) {
+    throw FbossError("State observer add failed: ", name, " already exists");
+  }
+  auto async = folly::make_unique<AsyncStateObserver>(
+      observer, name, maxPending);
+  stateObservers_.emplace(async.get(), name);
+  asyncStateObservers_.emplace(observer, std::move(async));
+}
+
 void SwSwitch::notifyStateObservers(const StateDelta& delta) {
   CHECK(updateEventBase_.inRunningEventBaseThread());
   if (isExiting()) {
@@ -502,6 +545,14 @@ void SwSwitch::handlePendingUpdates() {
   // not initialized yet
   DCHECK(isInitialized());
 
+  StateUpdateRecorder::Record record;
+  record.start = std::chrono::system_clock::now();
+  auto start = std::chrono::steady_clock::now();
+  auto elapsedSince = [](std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - since);
+  };
+
   // Call all of the update functions to prepare the new SwitchState
   auto origState = getState();
   auto state = origState;
@@ -512,6 +563,8 @@ void SwSwitch::handlePendingUpdates() {
 
     shared_ptr<SwitchState> newState;
     VLOG(3) << "preparing state update " << update->getName();
+    record.names.push_back(update->getName());
+    auto phaseStart = std::chrono::steady_clock::now();
     try {
       newState = update->applyUpdate(state);
     } catch (const std::exception& ex) {
@@ -521,21 +574,27 @@ void SwSwitch::handlePendingUpdates() {
       update->onError(ex);
       delete update;
     }
+    record.updateFns += elapsedSince(phaseStart);
     if (newState) {
       // Call publish after applying each StateUpdate.  This guarantees that
       // the next StateUpdate function will have clone the SwitchState before
       // making any changes.  This ensures that if a StateUpdate function ever
       // fails partway through it can't have partially modified our existing
       // state, leaving it in an invalid state.
+      phaseStart = std::chrono::steady_clock::now();
       newState->publish();
+      record.publish += elapsedSince(phaseStart);
       state = newState;
     }
   }
 
   // Now apply the update and notify subscribers
+  record.generation = state->getGeneration();
   if (state != origState) {
-    applyUpdate(origState, state);
+    applyUpdate(origState, state, &record);
   }
+  record.total = elapsedSince(start);
+  updateRecorder_.record(std::move(record));
 
   // Notify all of the updates of success, and delete them
   while (!updates.empty()) {
@@ -571,6 +630,8 @@ int SwSwitch::getHighresSamplers(HighresSamplerList* samplers,
     } else if (namespaceString.compare(InterfaceRateSampler::kIdentifier) ==
                0) {
       sampler = make_unique<InterfaceRateSampler>(counterSet);
+    } else if (namespaceString.compare(PortCounterSampler::kIdentifier) == 0) {
+      sampler = make_unique<PortCounterSampler>(hw_, counterSet);
     }
 
     if (sampler) {
@@ -596,14 +657,98 @@ int SwSwitch::getHighresSamplers(HighresSamplerList* samplers,
 
 void SwSwitch::setStateInternal(std::shared_ptr<SwitchState> newState) {
   // This is one of the only two places that should ever directly access
-  // stateDontUseDirectly_.  (getState() being the other one.)
+  // stateDontUseDirectly_.  (refreshStateCache() being the other one.)
   CHECK(newState->isPublished());
+  // The ACL classifier is published along with the state, so that no
+  // packet is ever filtered with the ACLs of a different state.  Only the
+  // update thread sets the state, so it can look at the current one
+  // without stateLock_, and build the classifier before taking the lock;
+  // with thousands of entries this is far too slow to do while holding up
+  // packet processing.
+  auto classifier = aclClassifier_;
+  if (!stateDontUseDirectly_ ||
+      stateDontUseDirectly_->getAcls() != newState->getAcls()) {
+    classifier.reset();
+    if (newState->getAcls()->size() > 0) {
+      classifier = std::make_shared<AclClassifier>(newState->getAcls());
+    }
+  }
   folly::SpinLockGuard guard(stateLock_);
   stateDontUseDirectly_.swap(newState);
+  aclClassifier_.swap(classifier);
+  stateVersion_.fetch_add(1, std::memory_order_release);
+}
+
+void SwSwitch::refreshStateCache(CachedState* cached) const {
+  std::shared_ptr<SwitchState> state;
+  std::shared_ptr<const AclClassifier> classifier;
+  uint64_t version;
+  {
+    folly::SpinLockGuard guard(stateLock_);
+    state = stateDontUseDirectly_;
+    classifier = aclClassifier_;
+    version = stateVersion_.load(std::memory_order_relaxed);
+  }
+  // Give this thread its own control blocks for the state and classifier,
+  // so that the copies handed out by getState() and getAclClassifier()
+  // don't all increment the same reference count.
+  auto holder = std::make_shared<std::shared_ptr<SwitchState>>(
+      std::move(state));
+  auto* ptr = holder->get();
+  cached->state = std::shared_ptr<SwitchState>(std::move(holder), ptr);
+  cached->aclClassifier.reset();
+  if (classifier) {
+    auto classifierHolder =
+      std::make_shared<std::shared_ptr<const AclClassifier>>(
+          std::move(classifier));
+    auto* classifierPtr = classifierHolder->get();
+    cached->aclClassifier = std::shared_ptr<const AclClassifier>(
+        std::move(classifierHolder), classifierPtr);
+  }
+  cached->version = version;
+}
+
+void SwSwitch::releaseStaleStates() {
+  auto version = stateVersion_.load(std::memory_order_acquire);
+  std::vector<shared_ptr<SwitchState>> stale;
+  std::vector<shared_ptr<const AclClassifier>> staleClassifiers;
+  for (auto& cached : stateCache_.accessAllThreads()) {
+    folly::SpinLockGuard guard(cached.lock);
+    if (cached.state && cached.version != version) {
+      stale.push_back(std::move(cached.state));
+      staleClassifiers.push_back(std::move(cached.aclClassifier));
+      cached.version = 0;
+    }
+  }
+  // The old states are destroyed here, without holding up anyone's
+  // getState().
+}
+
+shared_ptr<const AclClassifier> SwSwitch::getAclClassifier() const {
+  auto* cached = stateCache_.get();
+  folly::SpinLockGuard guard(cached->lock);
+  if (cached->version != stateVersion_.load(std::memory_order_acquire)) {
+    refreshStateCache(cached);
+  }
+  return cached->aclClassifier;
+}
+
+bool SwSwitch::isDeniedByAcl(const Cursor& cursor, uint16_t ethertype) const {
+  auto classifier = getAclClassifier();
+  if (!classifier) {
+    return false;
+  }
+  AclClassifier::Fields fields;
+  if (!AclClassifier::parsePacket(cursor, ethertype, &fields)) {
+    // Leave it to the IP handlers to deal with
+    return false;
+  }
+  return classifier->getAction(fields) == cfg::AclAction::DENY;
 }
 
 void SwSwitch::applyUpdate(const shared_ptr<SwitchState>& oldState,
-                           const shared_ptr<SwitchState>& newState) {
+                           const shared_ptr<SwitchState>& newState,
+                           StateUpdateRecorder::Record* record) {
   DCHECK_EQ(oldState, getState());
   auto start = std::chrono::steady_clock::now();
   LOG(INFO) << "Updating state: old_gen=" << oldState->getGeneration() <<
@@ -620,6 +765,33 @@ void SwSwitch::applyUpdate(const shared_ptr<SwitchState>& oldState,
   // Publish the configuration as our active state.
   setStateInternal(newState);
 
+  // Diffing the route tables is the most expensive part of the delta. Start
+  // on it in the prefetch thread now; the HwSwitch and the observers pick up
+  // the saved result from the delta, or wait for whatever is still in
+  // progress.  The prefetch is waited for before the delta is destroyed.
+  std::future<void> routePrefetch;
+  SCOPE_EXIT {
+    if (routePrefetch.valid()) {
+      routePrefetch.wait();
+    }
+  };
+  if (prefetchThread_ &&
+      oldState->getRouteTables() != newState->getRouteTables()) {
+    auto done = std::make_shared<std::promise<void>>();
+    routePrefetch = done->get_future();
+    prefetchEventBase_.runInEventBaseThread([&delta, done] {
+      try {
+        delta.prefetchRoutes();
+      } catch (const std::exception& ex) {
+        // Whoever needs the route deltas computes them again, and sees
+        // the error then.
+        LOG(ERROR) << "error prefetching route deltas: " <<
+          folly::exceptionStr(ex);
+      }
+      done->set_value();
+    });
+  }
+
   // Inform the HwSwitch of the change.
   //
   // Note that at this point we have already updated the state pointer and
@@ -632,6 +804,7 @@ void SwSwitch::applyUpdate(const shared_ptr<SwitchState>& oldState,
   // take a non-trivial amount of time, and blocking other users seems
   // undesirable.  So far I don't think this brief discrepancy should cause
   // major issues.
+  auto phaseStart = std::chrono::steady_clock::now();
   try {
     hw_->stateChanged(delta);
   } catch (const std::exception& ex) {
@@ -644,14 +817,25 @@ void SwSwitch::applyUpdate(const shared_ptr<SwitchState>& oldState,
       folly::exceptionStr(ex);
   }
 
+  auto hwEnd = std::chrono::steady_clock::now();
+  record->hwStateChanged =
+    std::chrono::duration_cast<std::chrono::microseconds>(hwEnd - phaseStart);
+
   // Notifies all observers of the current state update.
   notifyStateObservers(delta);
 
   auto end = std::chrono::steady_clock::now();
+  record->observers =
+    std::chrono::duration_cast<std::chrono::microseconds>(end - hwEnd);
+  StateUpdateRecorder::countChanges(delta, record);
   auto duration =
     std::chrono::duration_cast<std::chrono::microseconds>(end - start);
   stats()->stateUpdate(duration);
   VLOG(0) << "Update state took " << duration.count() << "us";
+
+  // Threads which haven't looked at the state since the update would
+  // otherwise keep the old one, and all its tables, alive until they do.
+  releaseStaleStates();
 }
 
 PortStats* SwSwitch::portStats(PortID portID) {
@@ -748,12 +932,20 @@ void SwSwitch::addTransceiverMapping(PortID portID, ChannelID channelID,
 }
 
 void SwSwitch::detectTransceiver() {
+  // Queue every module's I/O before waiting on any of it, so that the I2C
+  // scheduler sees it all at once and can batch it by mux.
+  for (const auto& t : *transceiverMap_) {
+    t.second.get()->startDetectTransceiver();
+  }
   for (const auto& t : *transceiverMap_) {
     t.second.get()->detectTransceiver();
   }
 }
 
 void SwSwitch::updateTransceiverInfoFields() {
+  for (const auto& t : *transceiverMap_) {
+    t.second.get()->startUpdateTransceiverInfoFields();
+  }
   for (const auto& t : *transceiverMap_) {
     t.second.get()->updateTransceiverInfoFields();
   }
@@ -832,6 +1024,13 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
     " ethertype=0x" << std::hex << ethertype <<
     " :: " << pkt->describeDetails();
 
+  if ((ethertype == IPv4Handler::ETHERTYPE_IPV4 ||
+       ethertype == IPv6Handler::ETHERTYPE_IPV6) &&
+      isDeniedByAcl(c, ethertype)) {
+    stats()->port(port)->pktDropped();
+    return;
+  }
+
   switch (ethertype) {
   case ArpHandler::ETHERTYPE_ARP:
     arp_->handlePacket(std::move(pkt), dstMac, srcMac, c);
@@ -879,30 +1078,48 @@ void SwSwitch::linkStateChanged(PortID port, bool up) noexcept {
   }
   updateState("port down",
               [=](const std::shared_ptr<SwitchState>& state) {
-    bool modified = false;
-    shared_ptr<SwitchState> newState{state};
-    for (const auto& vlanAutoPtr : *state->getVlans()) {
-      auto vlan = vlanAutoPtr.get();
-      auto arpTable = vlan->getArpTable().get();
-      auto newArpTable = arpTable->modify(&vlan, &newState);
-      if (newArpTable->setEntriesPendingForPort(port)) {
-        modified = true;
-      }
-      auto ndpTable = vlan->getNdpTable().get();
-      auto newNdpTable = ndpTable->modify(&vlan, &newState);
-      if (newNdpTable->setEntriesPendingForPort(port)) {
-        modified = true;
-      }
-    }
-    return modified ? newState : nullptr;
+    return setNeighborsPendingForPort(state, port);
   });
 }
 
+shared_ptr<SwitchState> SwSwitch::setNeighborsPendingForPort(
+    const shared_ptr<SwitchState>& state, PortID port) {
+  // Check the port index before calling modify(), so that VLANs with no
+  // neighbors on the port don't get their tables cloned.
+  shared_ptr<SwitchState> newState{state};
+  bool modified = false;
+  for (const auto& vlanAutoPtr : *state->getVlans()) {
+    auto vlan = vlanAutoPtr.get();
+    auto arpTable = vlan->getArpTable().get();
+    if (arpTable->hasEntriesForPort(port)) {
+      arpTable->modify(&vlan, &newState)->setEntriesPendingForPort(port);
+      modified = true;
+    }
+    auto ndpTable = vlan->getNdpTable().get();
+    if (ndpTable->hasEntriesForPort(port)) {
+      ndpTable->modify(&vlan, &newState)->setEntriesPendingForPort(port);
+      modified = true;
+    }
+  }
+  return modified ? newState : nullptr;
+}
+
+void SwSwitch::linkDownEcmpPruned(
+    PortID port, std::chrono::microseconds elapsed) noexcept {
+  // Called from the HwSwitch linkscan context, so only touch thread-local
+  // stats here.
+  VLOG(2) << "port " << port << " pruned from ECMP groups in "
+          << elapsed.count() << "us";
+  stats()->linkDownEcmpPrune(elapsed);
+}
+
 void SwSwitch::startThreads() {
   backgroundThread_.reset(new std::thread([=] {
       this->threadLoop("fbossBgThread", &backgroundEventBase_); }));
   updateThread_.reset(new std::thread([=] {
       this->threadLoop("fbossUpdateThread", &updateEventBase_); }));
+  prefetchThread_.reset(new std::thread([=] {
+      this->threadLoop("fbossPrefetchThread", &prefetchEventBase_); }));
 }
 
 void SwSwitch::stopThreads() {
@@ -931,6 +1148,11 @@ void SwSwitch::stopThreads() {
   if (updateThread_) {
     updateThread_->join();
   }
+  // Only the update thread waits on the prefetch thread, so stop it last.
+  if (prefetchThread_) {
+    prefetchEventBase_.runInEventBaseThread(stopThread, &prefetchEventBase_);
+    prefetchThread_->join();
+  }
 }
 
 void SwSwitch::threadLoop(StringPiece name, EventBase* eventBase) {
@@ -971,7 +1193,7 @@ std::unique_ptr<TxPacket> SwSwitch::allocateL2TxPacket(uint32_t l2Len) {
 
 void SwSwitch::sendPacketOutOfPort(std::unique_ptr<TxPacket> pkt,
                                    PortID portID) noexcept {
-  pcapMgr_->packetSent(pkt.get());
+  pcapMgr_->packetSent(pkt.get(), portID);
   if (!hw_->sendPacketOutOfPort(std::move(pkt), portID)) {
     // Just log an error for now.  There's not much the caller can do about
     // send failures--even on successful return from sendPacket*() the
@@ -1131,21 +1353,46 @@ void SwSwitch::applyConfig(const std::string& reason) {
       reason,
       [&](const shared_ptr<SwitchState>& state) {
         std::string configFilename = FLAGS_config;
+        // Until a config has been applied, the state may not match
+        // curConfig_ (e.g. after a warm boot), so the first apply is a
+        // full one.
+        auto prevConfig = curConfigStr_.empty() ? nullptr : &curConfig_;
         std::pair<shared_ptr<SwitchState>, std::string> rval;
         if (!configFilename.empty()) {
           LOG(INFO) << "Loading config from local config file "
                     << configFilename;
           rval = applyThriftConfigFile(state, configFilename, platform_.get(),
-              &curConfig_);
+              prevConfig);
         } else {
           // Loading config from default location. The message will be printed
           // there.
           rval = applyThriftConfigDefault(state, platform_.get(),
-              &curConfig_);
+              prevConfig);
         }
+        cfg::SwitchConfig newConfig;
+        newConfig.readFromJson(rval.second.c_str());
+
+        // Routes clients have already added may rank differently under the
+        // new admin distances.
+        auto newState = rval.first;
+        RouteUpdater updater((newState ? newState : state)->getRouteTables());
+        SCOPE_FAIL {
+          clientRib_->rollback();
+        };
+        clientRib_->setAdminDistances(newConfig.clientIdToAdminDistance,
+                                      &updater);
+        auto newRt = updater.updateDone();
+        if (newRt) {
+          if (!newState) {
+            newState = state->clone();
+          }
+          newState->resetRouteTables(std::move(newRt));
+        }
+        clientRib_->commit();
+
         curConfigStr_ = rval.second;
-        curConfig_.readFromJson(curConfigStr_.c_str());
-        return rval.first;
+        curConfig_ = std::move(newConfig);
+        return newState;
       });
   return;
 }
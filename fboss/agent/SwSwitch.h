@@ -11,6 +11,7 @@
 
 #include "fboss/agent/HighresCounterUtil.h"
 #include "fboss/agent/HwSwitch.h"
+#include "fboss/agent/StateUpdateRecorder.h"
 #include "fboss/agent/state/StateUpdate.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/Transceiver.h"
@@ -22,6 +23,7 @@
 #include <folly/IntrusiveList.h>
 #include <folly/Range.h>
 #include <folly/ThreadLocal.h>
+#include <folly/io/Cursor.h>
 #include <folly/io/async/EventBase.h>
 
 #include <atomic>
@@ -31,7 +33,9 @@
 
 namespace facebook { namespace fboss {
 
+class AclClassifier;
 class ArpHandler;
+class ClientRib;
 class IPv4Handler;
 class IPv6Handler;
 class LldpManager;
@@ -49,6 +53,7 @@ class TransceiverImpl;
 class StateDelta;
 class NeighborUpdater;
 class StateObserver;
+class AsyncStateObserver;
 class TunManager;
 class NetlinkListener;
 
@@ -155,10 +160,24 @@ class SwSwitch : public HwSwitch::Callback {
    * in which case the caller may now have an out-of-date copy of the state.
    * See the comments in SwitchState.h for more details about the copy-on-write
    * semantics of SwitchState.
+   *
+   * This is called for every trapped packet and every thrift read, so the
+   * common case neither takes stateLock_ nor touches a cache line shared
+   * with other threads: each thread keeps its own reference to the current
+   * state, tagged with the stateVersion_ it was taken at, and only goes
+   * back to stateLock_ once a newer state has been published.  The
+   * shared_ptr handed out shares ownership with that thread-local
+   * reference, so copying it only bumps a thread-private reference count.
+   * The update thread drops references to old states after every update,
+   * so idle threads don't keep them alive.
    */
   std::shared_ptr<SwitchState> getState() const {
-    folly::SpinLockGuard guard(stateLock_);
-    return stateDontUseDirectly_;
+    auto* cached = stateCache_.get();
+    folly::SpinLockGuard guard(cached->lock);
+    if (cached->version != stateVersion_.load(std::memory_order_acquire)) {
+      refreshStateCache(cached);
+    }
+    return cached->state;
   }
 
   /**
@@ -250,6 +269,34 @@ class SwSwitch : public HwSwitch::Callback {
    * count on this always being called from the update thread.
    */
   void registerStateObserver(StateObserver* observer, const std::string name);
+
+  enum : size_t {
+    // Default queue bound for registerAsyncStateObserver()
+    kMaxPendingStateUpdates = 16,
+  };
+
+  /*
+   * Registers an observer that is notified on a thread of its own instead
+   * of the update thread, so that it can not delay subsequent updates.
+   *
+   * At most maxPending updates are queued for the observer. If it falls
+   * further behind, the queued updates are merged into a single delta from
+   * the oldest old state to the newest new state. Observers that need to see
+   * every intermediate state, or that modify the state themselves, should
+   * use registerStateObserver() instead.
+   *
+   * The lag and queue depth of each async observer are exported as
+   * state_observer.<name>.lag_ms and state_observer.<name>.pending.
+   */
+  void registerAsyncStateObserver(StateObserver* observer,
+                                  const std::string name,
+                                  size_t maxPending = kMaxPendingStateUpdates);
+
+  /*
+   * Unregisters an observer, whether it was registered synchronously or
+   * asynchronously. For async observers this blocks until the updates still
+   * queued for it have been delivered.
+   */
   void unregisterStateObserver(StateObserver* observer);
 
   /*
@@ -403,8 +450,21 @@ class SwSwitch : public HwSwitch::Callback {
   // HwSwitch::Callback methods
   void packetReceived(std::unique_ptr<RxPacket> pkt) noexcept override;
   void linkStateChanged(PortID port, bool up) noexcept override;
+  void linkDownEcmpPruned(
+      PortID port, std::chrono::microseconds elapsed) noexcept override;
   void exitFatal() const noexcept override;
 
+  /*
+   * Return a copy of the state with the neighbor entries on the given port
+   * marked pending, or null if no VLAN has any entries on the port.
+   *
+   * Only the VLANs with entries on the port are modified.  This is the
+   * update done by linkStateChanged() on link down; it is public so that it
+   * can be benchmarked.
+   */
+  static std::shared_ptr<SwitchState> setNeighborsPendingForPort(
+      const std::shared_ptr<SwitchState>& state, PortID port);
+
   /*
    * Allocate a new TxPacket.
    */
@@ -522,6 +582,33 @@ class SwSwitch : public HwSwitch::Callback {
     return lldpManager_.get();
   }
 
+  /*
+   * Get the per-client routes added over thrift.
+   *
+   * This must only be accessed from state update functions, which all run
+   * on the update thread.
+   */
+  ClientRib* getClientRib() {
+    return clientRib_.get();
+  }
+
+  /*
+   * Get the timings of the most recent state updates.
+   */
+  const StateUpdateRecorder& getUpdateRecorder() const {
+    return updateRecorder_;
+  }
+
+  /*
+   * Get the classifier for the ACLs in the current state, or null if there
+   * are none.  It is rebuilt whenever the ACLs change, so callers should
+   * not hold on to it.
+   *
+   * Like getState(), this is cheap enough to call for every packet: it is
+   * cached per thread along with the state.
+   */
+  std::shared_ptr<const AclClassifier> getAclClassifier() const;
+
   /*
    * Are we operating in FBOSS-managed or netlink-managed mode?
    */
@@ -590,10 +677,38 @@ class SwSwitch : public HwSwitch::Callback {
   SwSwitch& operator=(SwSwitch const &) = delete;
 
   /*
-   * Update the current state pointer.
+   * A thread's cached reference to the current state. See getState().
+   */
+  struct CachedState {
+    // Only ever contended by releaseStaleStates()
+    folly::SpinLock lock;
+    uint64_t version{0};
+    std::shared_ptr<SwitchState> state;
+    std::shared_ptr<const AclClassifier> aclClassifier;
+  };
+
+  /*
+   * Update the current state pointer, and the ACL classifier with it.
    */
   void setStateInternal(std::shared_ptr<SwitchState> newState);
 
+  /*
+   * Re-read the current state pointer into this thread's cache.
+   */
+  void refreshStateCache(CachedState* cached) const;
+
+  /*
+   * Drop the cached references to anything but the current state, from
+   * every thread.  Called from the update thread after each update.
+   */
+  void releaseStaleStates();
+
+  /*
+   * Whether the ACLs deny the IP packet at cursor.
+   */
+  bool isDeniedByAcl(const folly::io::Cursor& cursor,
+                     uint16_t ethertype) const;
+
   /*
    * This function publishes the SFP Dom data (real time values
    * and thresholds to the local in-memory ServiceData Structure
@@ -613,7 +728,8 @@ class SwSwitch : public HwSwitch::Callback {
   static void handlePendingUpdatesHelper(SwSwitch* sw);
   void handlePendingUpdates();
   void applyUpdate(const std::shared_ptr<SwitchState>& oldState,
-                   const std::shared_ptr<SwitchState>& newState);
+                   const std::shared_ptr<SwitchState>& newState,
+                   StateUpdateRecorder::Record* record);
 
   void startThreads();
   void stopThreads();
@@ -627,6 +743,9 @@ class SwSwitch : public HwSwitch::Callback {
    */
   bool stateObserverRegistered(StateObserver* observer);
   void addStateObserver(StateObserver* observer, const std::string& name);
+  void addAsyncStateObserver(StateObserver* observer,
+                             const std::string& name,
+                             size_t maxPending);
   void removeStateObserver(StateObserver* observer);
 
   /*
@@ -673,6 +792,11 @@ class SwSwitch : public HwSwitch::Callback {
   folly::SpinLock pendingUpdatesLock_;
   StateUpdateList pendingUpdates_;
 
+  /*
+   * Phase timings of the last few state updates.
+   */
+  StateUpdateRecorder updateRecorder_;
+
   /*
    * The current switch state.
    *
@@ -687,6 +811,20 @@ class SwSwitch : public HwSwitch::Callback {
   std::shared_ptr<SwitchState> stateDontUseDirectly_;
   mutable folly::SpinLock stateLock_;
 
+  /*
+   * Bumped every time stateDontUseDirectly_ changes.  Version 0 is never
+   * used, so a freshly created CachedState is always refreshed.
+   */
+  std::atomic<uint64_t> stateVersion_{0};
+  mutable folly::ThreadLocal<CachedState, SwSwitch> stateCache_;
+
+  /*
+   * Classifier for the ACLs in stateDontUseDirectly_, used to filter the
+   * packets sent to us, or null if there are no ACLs.  Protected by
+   * stateLock_, and read through stateCache_.
+   */
+  std::shared_ptr<const AclClassifier> aclClassifier_;
+
   /*
    * A thread for performing various background tasks.
    */
@@ -699,6 +837,13 @@ class SwSwitch : public HwSwitch::Callback {
   std::unique_ptr<std::thread> updateThread_;
   folly::EventBase updateEventBase_;
 
+  /*
+   * A thread for diffing the route tables of each update while the update
+   * thread gets on with programming the HwSwitch.  See applyUpdate().
+   */
+  std::unique_ptr<std::thread> prefetchThread_;
+  folly::EventBase prefetchEventBase_;
+
   /*
    * A callback for listening to neighbors coming and going.
    */
@@ -714,11 +859,20 @@ class SwSwitch : public HwSwitch::Callback {
    */
   std::map<StateObserver*, std::string> stateObservers_;
 
+  /*
+   * Observers registered with registerAsyncStateObserver(), keyed by the
+   * observer itself. The AsyncStateObserver wrapper is what is actually
+   * stored in stateObservers_. Only accessed from the update thread.
+   */
+  std::map<StateObserver*, std::unique_ptr<AsyncStateObserver>>
+    asyncStateObservers_;
+
   std::unique_ptr<ArpHandler> arp_;
   std::unique_ptr<IPv4Handler> ipv4_;
   std::unique_ptr<IPv6Handler> ipv6_;
   std::unique_ptr<NeighborUpdater> nUpdater_;
   std::unique_ptr<PktCaptureManager> pcapMgr_;
+  std::unique_ptr<ClientRib> clientRib_;
 
   std::unique_ptr<TransceiverMap> transceiverMap_;
 
@@ -195,6 +195,10 @@ class SwitchStats : public boost::noncopyable {
     routeUpdate_.addRepeatedValue(us.count() / routes, routes);
   }
 
+  void linkDownEcmpPrune(std::chrono::microseconds us) {
+    linkDownEcmpPrune_.addValue(us.count());
+  }
+
  private:
   // Forbidden copy constructor and assignment operator
   SwitchStats(SwitchStats const &) = delete;
@@ -306,6 +310,12 @@ class SwitchStats : public boost::noncopyable {
    */
   TLHistogram routeUpdate_;
 
+  /**
+   * Histogram for time from a link down event to the port being pruned
+   * from all ECMP groups in hardware (in microsecond)
+   */
+  TLHistogram linkDownEcmpPrune_;
+
   // Create a PortStats object for the given PortID
   PortStats* createPortStats(PortID portID);
 
@@ -27,6 +27,7 @@
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 #include "fboss/agent/state/ArpEntry.h"
 #include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/ClientRib.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/NdpTable.h"
@@ -45,8 +46,11 @@
 #include <folly/io/IOBuf.h>
 #include <folly/MoveWrapper.h>
 #include <folly/Range.h>
+#include <folly/ScopeGuard.h>
 #include <thrift/lib/cpp2/async/DuplexChannel.h>
 
+#include <tuple>
+
 using apache::thrift::ClientReceiveState;
 using facebook::fb303::cpp2::fb_status;
 using folly::fbstring;
@@ -98,7 +102,111 @@ class RouteUpdateStats {
   std::chrono::time_point<std::chrono::steady_clock> start_;
 };
 
-ThriftHandler::ThriftHandler(SwSwitch* sw) : FacebookBase2("FBOSS"), sw_(sw) {
+static RouteNextHops toRouteNextHops(const UnicastRoute& route) {
+  RouteNextHops nexthops;
+  nexthops.reserve(route.nextHopAddrs.size());
+  for (const auto& nh : route.nextHopAddrs) {
+    nexthops.emplace(toIPAddress(nh));
+  }
+  return nexthops;
+}
+
+/*
+ * Build the new state from updater, and keep the matching ClientRib changes.
+ * Update functions must roll the ClientRib back if they fail before this.
+ */
+static shared_ptr<SwitchState> updateRouteTables(
+    const shared_ptr<SwitchState>& state, RouteUpdater* updater,
+    ClientRib* rib) {
+  auto newRt = updater->updateDone();
+  shared_ptr<SwitchState> newState;
+  if (newRt) {
+    newState = state->clone();
+    newState->resetRouteTables(std::move(newRt));
+  }
+  rib->commit();
+  return newState;
+}
+
+// The most routes a single getRouteTablePage() call will return
+static const int32_t kMaxRouteTablePageSize = 10000;
+
+static folly::CIDRNetwork toCIDRNetwork(const IpPrefix& prefix) {
+  auto ip = toIPAddress(prefix.ip);
+  if (prefix.prefixLength < 0 ||
+      static_cast<size_t>(prefix.prefixLength) > ip.bitCount()) {
+    throw FbossError("invalid prefix length ", prefix.prefixLength,
+                     " for ", ip);
+  }
+  return std::make_pair(ip.mask(prefix.prefixLength), prefix.prefixLength);
+}
+
+template<typename AddrT>
+static RoutePrefix<AddrT> toRoutePrefix(const folly::CIDRNetwork& network);
+
+template<>
+RoutePrefixV4 toRoutePrefix(const folly::CIDRNetwork& network) {
+  return RoutePrefixV4{network.first.asV4(), network.second};
+}
+
+template<>
+RoutePrefixV6 toRoutePrefix(const folly::CIDRNetwork& network) {
+  return RoutePrefixV6{network.first.asV6(), network.second};
+}
+
+/*
+ * Add the routes in rib to page, starting just after the prefix `after`
+ * if it is set, and skipping any not inside `filter` if that is set.
+ * Returns false if the page filled up before we ran out of routes.
+ *
+ * The rib iterates in address then mask length order, which is also the
+ * order routes are handed out in, so resuming is a lookup rather than a
+ * walk over the routes already returned.  The routes inside filter are
+ * contiguous in that order, so we can stop at the first one outside it.
+ */
+template<typename AddrT>
+static bool addRoutesToPage(const RouteTableRib<AddrT>& rib,
+                            const folly::CIDRNetwork* after,
+                            const folly::CIDRNetwork* filter,
+                            size_t limit,
+                            RouteTablePage* page) {
+  const auto& routes = rib.routes();
+  auto itr = routes.begin();
+  RoutePrefix<AddrT> start;
+  if (after) {
+    start = toRoutePrefix<AddrT>(*after);
+    itr = routes.upperBound(start.network, start.mask);
+  }
+  RoutePrefix<AddrT> inside;
+  if (filter) {
+    inside = toRoutePrefix<AddrT>(*filter);
+    if (!after || std::tie(start.network, start.mask) <
+        std::tie(inside.network, inside.mask)) {
+      itr = routes.lowerBound(inside.network, inside.mask);
+    }
+  }
+  for (; !itr.atEnd(); ++itr) {
+    const auto& prefix = itr->value()->prefix();
+    if (filter && (prefix.mask < inside.mask ||
+                   prefix.network.mask(inside.mask) != inside.network)) {
+      break;
+    }
+    if (page->routes.size() == limit) {
+      return false;
+    }
+    page->routes.push_back(toUnicastRoute(*itr->value()));
+  }
+  return true;
+}
+
+ThriftHandler::ThriftHandler(SwSwitch* sw)
+    : FacebookBase2("FBOSS"),
+      sw_(sw),
+      highresSampler_(make_unique<HighresSamplingService>(
+          [sw](HighresSamplerList* samplers,
+               const std::set<std::string>& counters) {
+            return sw->getHighresSamplers(samplers, counters);
+          })) {
   sw->registerNeighborListener(
     [=](const std::vector<std::string>& added,
         const std::vector<std::string>& deleted) {
@@ -147,14 +255,10 @@ void ThriftHandler::addUnicastRoute(
   ensureFibSynced("addUnicastRoute");
   RouteUpdateStats stats(sw_, "Add", 1);
   RouterID routerId = RouterID(0); // TODO, default vrf for now
-  folly::IPAddress network = toIPAddress(route->dest.ip);
-  uint8_t mask = static_cast<uint8_t>(route->dest.prefixLength);
-  RouteNextHops nexthops;
-  nexthops.reserve(route->nextHopAddrs.size());
-  for (const auto& nh : route->nextHopAddrs) {
-    nexthops.emplace(toIPAddress(nh));
-  }
-  if (network.isV4()) {
+  ClientRib::Prefix prefix(routerId, toIPAddress(route->dest.ip),
+                           static_cast<uint8_t>(route->dest.prefixLength));
+  auto nexthops = toRouteNextHops(*route);
+  if (prefix.network.isV4()) {
     sw_->stats()->addRouteV4();
   } else {
     sw_->stats()->addRouteV6();
@@ -163,18 +267,13 @@ void ThriftHandler::addUnicastRoute(
   // Perform the update
   auto updateFn = [=](const shared_ptr<SwitchState>& state) {
     RouteUpdater updater(state->getRouteTables());
-    if (nexthops.size()) {
-      updater.addRoute(routerId, network, mask, std::move(nexthops));
-    } else {
-      updater.addRoute(routerId, network, mask, RouteForwardAction::DROP);
-    }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
+    auto* rib = sw_->getClientRib();
+    SCOPE_FAIL {
+      rib->rollback();
+    };
+    rib->setAdminDistance(client, getAdminDistance(client), &updater);
+    rib->addRoute(client, prefix, nexthops, &updater);
+    return updateRouteTables(state, &updater, rib);
   };
   sw_->updateStateBlocking("add unicast route", updateFn);
 }
@@ -185,9 +284,9 @@ void ThriftHandler::deleteUnicastRoute(
   ensureFibSynced("deleteUnicastRoute");
   RouteUpdateStats stats(sw_, "Delete", 1);
   RouterID routerId = RouterID(0); // TODO, default vrf for now
-  folly::IPAddress network =  toIPAddress(prefix->ip);
-  uint8_t mask = static_cast<uint8_t>(prefix->prefixLength);
-  if (network.isV4()) {
+  ClientRib::Prefix ribPrefix(routerId, toIPAddress(prefix->ip),
+                              static_cast<uint8_t>(prefix->prefixLength));
+  if (ribPrefix.network.isV4()) {
     sw_->stats()->delRouteV4();
   } else {
     sw_->stats()->delRouteV6();
@@ -196,14 +295,13 @@ void ThriftHandler::deleteUnicastRoute(
   // Perform the update
   auto updateFn = [=](const shared_ptr<SwitchState>& state) {
     RouteUpdater updater(state->getRouteTables());
-    updater.delRoute(routerId, network, mask);
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
+    auto* rib = sw_->getClientRib();
+    SCOPE_FAIL {
+      rib->rollback();
+    };
+    rib->setAdminDistance(client, getAdminDistance(client), &updater);
+    rib->delRoute(client, ribPrefix, &updater);
+    return updateRouteTables(state, &updater, rib);
   };
   sw_->updateStateBlocking("delete unicast route", updateFn);
 }
@@ -215,33 +313,23 @@ void ThriftHandler::addUnicastRoutes(
   RouteUpdateStats stats(sw_, "Add", routes->size());
   auto updateFn = [&](const shared_ptr<SwitchState>& state) {
     RouteUpdater updater(state->getRouteTables());
+    auto* rib = sw_->getClientRib();
+    SCOPE_FAIL {
+      rib->rollback();
+    };
+    rib->setAdminDistance(client, getAdminDistance(client), &updater);
     RouterID routerId = RouterID(0); // TODO, default vrf for now
     for (const auto& route : *routes) {
-      auto network = toIPAddress(route.dest.ip);
-      auto mask = static_cast<uint8_t>(route.dest.prefixLength);
-      RouteNextHops nexthops;
-      nexthops.reserve(route.nextHopAddrs.size());
-      for (const auto& nh : route.nextHopAddrs) {
-        nexthops.emplace(toIPAddress(nh));
-      }
-      if (nexthops.size()) {
-        updater.addRoute(routerId, network, mask, std::move(nexthops));
-      } else {
-        updater.addRoute(routerId, network, mask, RouteForwardAction::DROP);
-      }
-      if (network.isV4()) {
+      ClientRib::Prefix prefix(routerId, toIPAddress(route.dest.ip),
+                               static_cast<uint8_t>(route.dest.prefixLength));
+      rib->addRoute(client, prefix, toRouteNextHops(route), &updater);
+      if (prefix.network.isV4()) {
         sw_->stats()->addRouteV4();
       } else {
         sw_->stats()->addRouteV6();
       }
     }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
+    return updateRouteTables(state, &updater, rib);
   };
   sw_->updateStateBlocking("add unicast route", updateFn);
 }
@@ -258,24 +346,23 @@ void ThriftHandler::deleteUnicastRoutes(
   // Perform the update
   auto updateFn = [&](const shared_ptr<SwitchState>& state) {
     RouteUpdater updater(state->getRouteTables());
+    auto* rib = sw_->getClientRib();
+    SCOPE_FAIL {
+      rib->rollback();
+    };
+    rib->setAdminDistance(client, getAdminDistance(client), &updater);
     RouterID routerId = RouterID(0); // TODO, default vrf for now
     for (const auto& prefix : *prefixes) {
-      auto network = toIPAddress(prefix.ip);
-      auto mask = static_cast<uint8_t>(prefix.prefixLength);
-      if (network.isV4()) {
+      ClientRib::Prefix ribPrefix(routerId, toIPAddress(prefix.ip),
+                                  static_cast<uint8_t>(prefix.prefixLength));
+      if (ribPrefix.network.isV4()) {
         sw_->stats()->delRouteV4();
       } else {
         sw_->stats()->delRouteV6();
       }
-      updater.delRoute(routerId, network, mask);
-    }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
+      rib->delRoute(client, ribPrefix, &updater);
     }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
+    return updateRouteTables(state, &updater, rib);
   };
   sw_->updateStateBlocking("delete unicast route", updateFn);
 }
@@ -285,11 +372,42 @@ void ThriftHandler::syncFib(
   ensureConfigured("syncFib");
   RouteUpdateStats stats(sw_, "Sync", routes->size());
 
-  // Note that we capture routes by reference here, since it is a unique_ptr.
-  // This is safe since we use updateStateBlocking(), so routes will still
-  // be valid in our scope when updateFn() is called.
-  // We could use folly::MoveWrapper if we did need to capture routes by value.
+  RouterID routerId = RouterID(0); // TODO, default vrf for now
+  ClientRib::RouteSet routeSet;
+  for (auto const& route : *routes) {
+    ClientRib::Prefix prefix(routerId, toIPAddress(route.dest.ip),
+                             static_cast<uint8_t>(route.dest.prefixLength));
+    if (prefix.network.isV4()) {
+      sw_->stats()->addRouteV4();
+    } else {
+      sw_->stats()->addRouteV6();
+    }
+    routeSet[prefix] = toRouteNextHops(route);
+  }
+  routes.reset();
+
+  // Note that we capture routeSet by reference here. This is safe since we
+  // use updateStateBlocking(), so it will still be valid in our scope when
+  // updateFn() is called.
   auto updateFn = [&](const shared_ptr<SwitchState>& state) {
+    auto* rib = sw_->getClientRib();
+    SCOPE_FAIL {
+      rib->rollback();
+    };
+    if (sw_->isFibSynced()) {
+      // The FIB only contains routes we know the owner of, so this client's
+      // routes can be updated in place: only the prefixes that differ from
+      // its previous set get touched.
+      RouteUpdater updater(state->getRouteTables());
+      rib->setAdminDistance(client, getAdminDistance(client), &updater);
+      rib->syncClient(client, std::move(routeSet), &updater);
+      return updateRouteTables(state, &updater, rib);
+    }
+
+    // This is the first sync since we started, and the FIB may still hold
+    // routes from before a warm boot that nobody owns any more. Rebuild it
+    // from scratch.
+    //
     // create an update object starting from empty
     RouteUpdater updater(state->getRouteTables(), true);
     cfg::SwitchConfig emptyPrevConfig;
@@ -297,29 +415,10 @@ void ThriftHandler::syncFib(
     updater.updateStaticRoutes(sw_->getConfig(), emptyPrevConfig);
     // add all interface routes
     updater.addInterfaceAndLinkLocalRoutes(state->getInterfaces());
-    RouterID routerId = RouterID(0); // TODO, default vrf for now
-    for (auto const& route : *routes) {
-      folly::IPAddress network = toIPAddress(route.dest.ip);
-      uint8_t mask = static_cast<uint8_t>(route.dest.prefixLength);
-      RouteNextHops nexthops;
-      nexthops.reserve(route.nextHopAddrs.size());
-      for (const auto& nh : route.nextHopAddrs) {
-        nexthops.emplace(toIPAddress(nh));
-      }
-      updater.addRoute(routerId, network, mask, std::move(nexthops));
-      if (network.isV4()) {
-        sw_->stats()->addRouteV4();
-      } else {
-        sw_->stats()->addRouteV6();
-      }
-    }
-    auto newRt = updater.updateDone();
-    if (!newRt) {
-      return shared_ptr<SwitchState>();
-    }
-    auto newState = state->clone();
-    newState->resetRouteTables(std::move(newRt));
-    return newState;
+    rib->setAdminDistance(client, getAdminDistance(client), nullptr);
+    rib->syncClient(client, std::move(routeSet), nullptr);
+    rib->programAll(&updater);
+    return updateRouteTables(state, &updater, rib);
   };
   sw_->updateStateBlocking("sync fib", updateFn);
 
@@ -537,29 +636,80 @@ void ThriftHandler::getRouteTable(std::vector<UnicastRoute>& route) {
   ensureConfigured();
   for (const auto& routeTable : (*sw_->getState()->getRouteTables())) {
     for (const auto& ipv4Rib : routeTable->getRibV4()->routes()) {
-      UnicastRoute tempRoute;
-      auto ipv4 = ipv4Rib.value().get();
-      auto fwdInfo = ipv4->getForwardInfo();
-      tempRoute.dest.ip = toBinaryAddress(ipv4->prefix().network);
-      tempRoute.dest.prefixLength = ipv4->prefix().mask;
-      for (const auto& hop : fwdInfo.getNexthops()) {
-        tempRoute.nextHopAddrs.push_back(
-                    toBinaryAddress(hop.nexthop));
-      }
-      route.push_back(tempRoute);
+      route.push_back(toUnicastRoute(*ipv4Rib.value()));
     }
     for (const auto& ipv6Rib : routeTable->getRibV6()->routes()) {
-      UnicastRoute tempRoute;
-      auto ipv6 = ipv6Rib.value().get();
-      auto fwdInfo = ipv6->getForwardInfo();
-      tempRoute.dest.ip = toBinaryAddress(
-                                                     ipv6->prefix().network);
-      tempRoute.dest.prefixLength = ipv6->prefix().mask;
-      for (const auto& hop : fwdInfo.getNexthops()) {
-        tempRoute.nextHopAddrs.push_back(
-                    toBinaryAddress(hop.nexthop));
+      route.push_back(toUnicastRoute(*ipv6Rib.value()));
+    }
+  }
+}
+
+void ThriftHandler::getRouteTablePage(RouteTablePage& page,
+    std::unique_ptr<RouteTablePageRequest> request) {
+  ensureConfigured();
+  if (request->limit <= 0) {
+    throw FbossError("invalid route table page limit ", request->limit);
+  }
+  size_t limit = std::min(request->limit, kMaxRouteTablePageSize);
+  page.routes.reserve(limit);
+
+  folly::CIDRNetwork filter;
+  const folly::CIDRNetwork* filterPtr = nullptr;
+  if (request->__isset.filter) {
+    filter = toCIDRNetwork(request->filter);
+    filterPtr = &filter;
+  }
+  RouterID cursorVrf(0);
+  folly::CIDRNetwork after;
+  if (request->__isset.cursor) {
+    cursorVrf = RouterID(request->cursor.vrf);
+    after = toCIDRNetwork(request->cursor.lastPrefix);
+  }
+
+  // Work off the state as it is now.  Holding on to it doesn't hold up
+  // route updates, which just publish a new state alongside it.
+  auto state = sw_->getState();
+  // The cursor has to name the VRF of the last route on the page, which
+  // isn't the one we are on if the page filled up exactly at the end of
+  // the previous one.
+  RouterID lastVrf = cursorVrf;
+  for (const auto& routeTable : *state->getRouteTables()) {
+    auto vrf = routeTable->getID();
+    bool doV4 = !filterPtr || filter.first.isV4();
+    bool doV6 = !filterPtr || filter.first.isV6();
+    const folly::CIDRNetwork* afterV4 = nullptr;
+    const folly::CIDRNetwork* afterV6 = nullptr;
+    if (request->__isset.cursor) {
+      if (vrf < cursorVrf) {
+        continue;
+      } else if (vrf == cursorVrf) {
+        if (after.first.isV4()) {
+          afterV4 = &after;
+        } else {
+          doV4 = false;
+          afterV6 = &after;
+        }
       }
-      route.push_back(tempRoute);
+    }
+
+    auto numRoutes = page.routes.size();
+    bool done = true;
+    if (doV4) {
+      done = addRoutesToPage(*routeTable->getRibV4(), afterV4, filterPtr,
+                             limit, &page);
+    }
+    if (done && doV6) {
+      done = addRoutesToPage(*routeTable->getRibV6(), afterV6, filterPtr,
+                             limit, &page);
+    }
+    if (page.routes.size() > numRoutes) {
+      lastVrf = vrf;
+    }
+    if (!done) {
+      page.next.vrf = lastVrf;
+      page.next.lastPrefix = page.routes.back().dest;
+      page.__isset.next = true;
+      return;
     }
   }
 }
@@ -650,6 +800,27 @@ void ThriftHandler::getLldpNeighbors(vector<LinkNeighborThrift>& results) {
   }
 }
 
+void ThriftHandler::getStateUpdateTraces(vector<StateUpdateTrace>& traces) {
+  auto records = sw_->getUpdateRecorder().getRecords();
+  traces.reserve(records.size());
+  for (auto& record : records) {
+    StateUpdateTrace trace;
+    trace.generation = record.generation;
+    trace.names = std::move(record.names);
+    trace.startTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        record.start.time_since_epoch()).count();
+    trace.updateFnsUs = record.updateFns.count();
+    trace.publishUs = record.publish.count();
+    trace.hwStateChangedUs = record.hwStateChanged.count();
+    trace.observersUs = record.observers.count();
+    trace.totalUs = record.total.count();
+    trace.routesChanged = record.routesChanged;
+    trace.neighborsChanged = record.neighborsChanged;
+    trace.otherNodesChanged = record.otherNodesChanged;
+    traces.push_back(std::move(trace));
+  }
+}
+
 void ThriftHandler::invokeNeighborListeners(ThreadLocalListener* listener,
                                              std::vector<std::string> added,
                                              std::vector<std::string> removed) {
@@ -690,10 +861,48 @@ void ThriftHandler::async_eb_registerForNeighborChanged(
   cb->done();
 }
 
+void ThriftHandler::async_eb_subscribeToFib(ThriftCallback<void> cb) {
+  auto ctx = cb->getConnectionContext()->getConnectionContext();
+  auto client = ctx->getDuplexClient<FibUpdateClientAsyncClient>();
+  std::lock_guard<std::mutex> guard(fibSubscriptionsLock_);
+  if (!fibSubscriptions_) {
+    fibSubscriptions_ = make_unique<FibSubscriptionManager>(sw_);
+  }
+  fibSubscriptions_->addSubscriber(ctx, std::move(client),
+                                   cb->getEventBase());
+  cb->done();
+}
+
 void ThriftHandler::startPktCapture(unique_ptr<CaptureInfo> info) {
   ensureConfigured();
   auto* mgr = sw_->getCaptureMgr();
-  auto capture = make_unique<PktCapture>(info->name, info->maxPackets);
+  if (info->snaplen < 0 || info->sampleRate < 0 || info->rotateBytes < 0 ||
+      info->rotateSeconds < 0 || info->maxFiles < 0) {
+    throw FbossError("invalid capture parameters for \"", info->name, "\"");
+  }
+  PktCapture::Options options;
+  options.maxPackets = info->maxPackets;
+  options.snaplen = info->snaplen;
+  options.filter = info->filter;
+  options.sampleRate = std::max(info->sampleRate, 1);
+  for (auto port : info->ports) {
+    options.ports.insert(PortID(port));
+  }
+  switch (info->direction) {
+    case CaptureDirection::CAPTURE_ONLY_RX:
+      options.direction = PktCapture::RX;
+      break;
+    case CaptureDirection::CAPTURE_ONLY_TX:
+      options.direction = PktCapture::TX;
+      break;
+    case CaptureDirection::CAPTURE_TX_RX:
+      options.direction = PktCapture::RX_TX;
+      break;
+  }
+  options.rotateBytes = info->rotateBytes;
+  options.rotateInterval = std::chrono::seconds(info->rotateSeconds);
+  options.maxFiles = info->maxFiles;
+  auto capture = make_unique<PktCapture>(info->name, options);
   mgr->startCapture(std::move(capture));
 }
 
@@ -869,6 +1078,15 @@ void ThriftHandler::ensureFibSynced(StringPiece function) {
   throw FbossError("switch is still initializing, FIB not synced yet");
 }
 
+uint32_t ThriftHandler::getAdminDistance(int16_t client) const {
+  const auto& distances = sw_->getConfig().clientIdToAdminDistance;
+  auto it = distances.find(client);
+  if (it == distances.end()) {
+    return ClientRib::kDefaultAdminDistance;
+  }
+  return it->second;
+}
+
 // If this is a premature client disconnect from a duplex connection, we need to
 // clean up state.  Failure to do so may allow the server's duplex clients to
 // use the destroyed context => segfaults.
@@ -878,6 +1096,13 @@ void ThriftHandler::connectionDestroyed(TConnectionContext* ctx) {
     listeners_->clients.erase(ctx);
   }
 
+  {
+    std::lock_guard<std::mutex> guard(fibSubscriptionsLock_);
+    if (fibSubscriptions_) {
+      fibSubscriptions_->removeSubscriber(ctx);
+    }
+  }
+
   // If there is an ongoing high-resolution counter subscription, kill it. Don't
   // grab a write lock if there are no active calls
   if (!highresKillSwitches_.asConst()->empty()) {
@@ -895,7 +1120,9 @@ void ThriftHandler::connectionDestroyed(TConnectionContext* ctx) {
 void ThriftHandler::async_tm_subscribeToCounters(
     ThriftCallback<bool> callback, unique_ptr<CounterSubscribeRequest> req) {
 
-  // Grab the requested samplers from the underlying switch implementation
+  // Check the requested counters with the underlying switch implementation.
+  // The samplers themselves are shared with other subscriptions, and built
+  // by highresSampler_.
   auto samplers = make_unique<HighresSamplerList>();
   auto numCounters = sw_->getHighresSamplers(samplers.get(), req->counters);
 
@@ -913,19 +1140,11 @@ void ThriftHandler::async_tm_subscribeToCounters(
     auto sender = std::make_shared<SampleSender>(std::move(client), killSwitch,
                                                  eventBase, numCounters);
 
-    // Create the sample producer and send it on its way
+    // Create the sample producer and hand it to the sampling service
     auto producer = make_unique<SampleProducer>(
-        std::move(samplers), std::move(sender), std::move(killSwitch),
-        eventBase, *req.get(), numCounters);
-    auto wrappedProducer = folly::makeMoveWrapper(std::move(producer));
-    auto veryNice = req->veryNice;
-    std::thread producerThread([wrappedProducer, veryNice]() mutable {
-      if (veryNice) {
-        incNiceValue(20);
-      }
-      (*wrappedProducer)->produce();
-    });
-    producerThread.detach();
+        std::move(sender), std::move(killSwitch), eventBase, *req.get(),
+        numCounters);
+    highresSampler_->subscribe(std::move(producer), req->veryNice);
 
     callback->result(true);
   } else {
@@ -13,9 +13,11 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include "common/fb303/cpp/FacebookBase2.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/FibSubscriptionManager.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/HighresCounterSubscriptionHandler.h"
 #include "fboss/agent/if/gen-cpp2/FbossCtrl.h"
@@ -52,6 +54,12 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   void async_eb_registerForNeighborChanged(
       ThriftCallback<void> callback) override;
 
+  /*
+   * Start sending route table changes to the duplex client that called this.
+   * The subscription lasts until the connection is closed.
+   */
+  void async_eb_subscribeToFib(ThriftCallback<void> callback) override;
+
   void flushCountersNow() override;
 
   void addUnicastRoute(
@@ -95,6 +103,8 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
       std::map<int32_t, InterfaceDetail>& interfaces) override;
   void getInterfaceList(std::vector<std::string>& interfaceList) override;
   void getRouteTable(std::vector<UnicastRoute>& routeTable) override;
+  void getRouteTablePage(RouteTablePage& page,
+      std::unique_ptr<RouteTablePageRequest> request) override;
   void getPortStatus(std::map<int32_t, PortStatus>& status,
                      std::unique_ptr<std::vector<int32_t>> ports)
                      override;
@@ -125,6 +135,8 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
 
   void getLldpNeighbors(std::vector<LinkNeighborThrift>& results) override;
 
+  void getStateUpdateTraces(std::vector<StateUpdateTrace>& traces) override;
+
   void startPktCapture(std::unique_ptr<CaptureInfo> info) override;
   void stopPktCapture(std::unique_ptr<std::string> name) override;
   void stopAllPktCaptures() override;
@@ -240,6 +252,11 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
     ensureFibSynced(folly::StringPiece(nullptr, nullptr));
   }
 
+  /*
+   * The configured admin distance for a routing client.
+   */
+  uint32_t getAdminDistance(int16_t client) const;
+
   template<typename Result>
   void fail(const ThriftCallback<Result>& callback,
             const std::exception& ex) {
@@ -261,5 +278,11 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   folly::Synchronized<
       std::unordered_map<const apache::thrift::server::TConnectionContext*,
                          std::shared_ptr<Signal>>> highresKillSwitches_;
+  // Samples the counters of all high resolution subscriptions
+  std::unique_ptr<HighresSamplingService> highresSampler_;
+
+  // Created on the first call to subscribeToFib()
+  std::mutex fibSubscriptionsLock_;
+  std::unique_ptr<FibSubscriptionManager> fibSubscriptions_;
 };
 }} // facebook::fboss
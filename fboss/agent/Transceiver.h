@@ -38,6 +38,14 @@ class Transceiver {
    * Update the transceiver information in the cache
    */
   virtual void updateTransceiverInfoFields() = 0;
+  /*
+   * Start the I/O that the next detectTransceiver() or
+   * updateTransceiverInfoFields() needs without waiting for it, so that
+   * the I/O for every transceiver can be queued before any of them blocks.
+   * The default does nothing, leaving it all to the second call.
+   */
+  virtual void startDetectTransceiver() {}
+  virtual void startUpdateTransceiverInfoFields() {}
   /*
    * Tweak fields as necessary on transceiver
    */
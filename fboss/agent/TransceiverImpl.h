@@ -10,7 +10,9 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include <folly/String.h>
+#include <folly/futures/Future.h>
 #include "fboss/agent/types.h"
 #include "fboss/agent/FbossError.h"
 
@@ -35,6 +37,28 @@ class TransceiverImpl {
    * This function will check if the transceiver is present or not
    */
   virtual bool detectTransceiver() = 0;
+
+  /*
+   * Start a read or a presence check, and return a future for its result,
+   * so that the I/O for many transceivers can be in flight at once and a
+   * bus that batches transactions gets the chance to.  A failed read
+   * completes the future with an exception.
+   *
+   * The default just does the I/O synchronously.
+   */
+  virtual folly::Future<std::vector<uint8_t>> readTransceiverAsync(
+      int dataAddress, int offset, int len) {
+    std::vector<uint8_t> data(len);
+    int ret = readTransceiver(dataAddress, offset, len, data.data());
+    if (ret != len) {
+      return folly::makeFuture<std::vector<uint8_t>>(FbossError(
+          "transceiver read failed, got ", ret, " of ", len, " bytes"));
+    }
+    return folly::makeFuture(std::move(data));
+  }
+  virtual folly::Future<bool> detectTransceiverAsync() {
+    return folly::makeFuture(detectTransceiver());
+  }
   /*
    * Returns the name of the port
    */
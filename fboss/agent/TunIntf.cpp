@@ -24,6 +24,7 @@ extern "C" {
 #include "fboss/agent/SysError.h"
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/packet/EthHdr.h"
+#include "fboss/agent/packet/PktUtil.h"
 #include <folly/io/async/EventBase.h>
 #include <folly/io/async/EventHandler.h>
 
@@ -164,13 +165,12 @@ void TunIntf::handlerReady(uint16_t events) noexcept {
   bool fdFail = false;
   try {
     while (sent + dropped < MaxSentOneTime) {
+      // Leave room for one byte past the MTU, so that an oversized packet
+      // is noticed instead of being forwarded.
       std::unique_ptr<TxPacket> pkt;
-      pkt = sw_->allocateL3TxPacket(mtu_);
+      pkt = sw_->allocateL3TxPacket(mtu_ + 1);
       auto buf = pkt->buf();
-      int ret = 0;
-      do {
-        ret = read(fd_, buf->writableTail(), buf->tailroom());
-      } while (ret == -1 && errno == EINTR);
+      int ret = PktUtil::readPacket(fd_, buf, mtu_);
       if (ret < 0) {
         if (errno != EAGAIN) {
           sysLogError(ret, "Failed to read on ", fd_);
@@ -182,10 +182,10 @@ void TunIntf::handlerReady(uint16_t events) noexcept {
         // Nothing to read. It shall not happen as the fd is non-blocking.
         // Just add this case to be safe.
         break;
-      } else if (ret > buf->tailroom()) {
-        // The pkt is larger than the buffer. We don't have complete packet.
+      } else if (ret > mtu_) {
+        // The pkt is larger than the MTU. We don't have complete packet.
         // It shall not happen unless the MTU is mis-match. Drop the packet.
-        LOG(ERROR) << "Too large packet (" << ret << " > " << buf->tailroom()
+        LOG(ERROR) << "Too large packet (" << ret << " > " << mtu_
                    << ") received from host. Drop the packet.";
         dropped++;
       } else {
@@ -0,0 +1,244 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/SpinLock.h>
+#include <folly/ThreadLocal.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * TxBufferPool keeps freed packet buffers around so that they can be handed
+ * out again, instead of going back to the underlying allocator for every
+ * packet we send.
+ *
+ * Buffers are grouped in a few size classes. A request is served from the
+ * smallest class that fits it, and requests larger than the biggest class
+ * always go straight to the allocator.
+ *
+ * Each thread has a small cache per size class, so that the common case of
+ * getting or returning a buffer doesn't take any lock. When a thread cache
+ * runs dry it refills in a batch from a shared free list, and when it
+ * overflows it spills a batch back. The shared free list holds at most
+ * `watermark` buffers per size class; anything beyond that is freed. If
+ * the pool is empty we simply allocate a new buffer.
+ *
+ * The Allocator has to provide:
+ *
+ *   typedef ... Buffer;          // a pointer-like handle
+ *   Buffer allocate(uint32_t size);
+ *   void free(Buffer buf);
+ *
+ * put() needs the capacity the buffer was handed out with by get(), since
+ * that is how the pool knows which size class it belongs to.
+ *
+ * get() and put() may be called from any thread. The pool must outlive all
+ * of the buffers it has handed out.
+ */
+template<typename Allocator>
+class TxBufferPool {
+ public:
+  typedef typename Allocator::Buffer Buffer;
+
+  TxBufferPool(Allocator allocator,
+               std::vector<uint32_t> sizeClasses,
+               uint32_t watermark,
+               uint32_t threadCacheSize = kDefaultThreadCacheSize)
+    : allocator_(std::move(allocator)),
+      classes_(sizeClasses.size()),
+      watermark_(watermark),
+      threadCacheSize_(std::min(threadCacheSize, watermark)) {
+    std::sort(sizeClasses.begin(), sizeClasses.end());
+    for (size_t i = 0; i < sizeClasses.size(); ++i) {
+      classes_[i].size = sizeClasses[i];
+    }
+  }
+
+  ~TxBufferPool() {
+    // Anything still cached by other threads is freed now. Their caches
+    // are destroyed along with threadCaches_, after this.
+    for (auto& cache : threadCaches_.accessAllThreads()) {
+      for (auto& buffers : cache.buffers) {
+        freeAll(&buffers);
+      }
+    }
+    for (auto& sizeClass : classes_) {
+      freeAll(&sizeClass.buffers);
+    }
+  }
+
+  /*
+   * Get a buffer of at least the given size. The capacity of the returned
+   * buffer is stored in *capacity.
+   */
+  Buffer get(uint32_t size, uint32_t* capacity) {
+    auto idx = getClass(size);
+    if (idx == classes_.size() || threadCacheSize_ == 0) {
+      *capacity = size;
+      return allocate(size);
+    }
+    auto& sizeClass = classes_[idx];
+    *capacity = sizeClass.size;
+
+    auto& cached = getThreadCache()->buffers[idx];
+    if (cached.empty()) {
+      // Refill half of the thread cache at once, so that we don't go back
+      // to the shared list on every call.
+      folly::SpinLockGuard guard(sizeClass.lock);
+      auto n = std::min<size_t>(sizeClass.buffers.size(),
+                                std::max<uint32_t>(threadCacheSize_ / 2, 1));
+      auto begin = sizeClass.buffers.end() - n;
+      cached.insert(cached.end(), begin, sizeClass.buffers.end());
+      sizeClass.buffers.erase(begin, sizeClass.buffers.end());
+    }
+    if (cached.empty()) {
+      return allocate(sizeClass.size);
+    }
+    auto buf = cached.back();
+    cached.pop_back();
+    return buf;
+  }
+
+  /*
+   * Give back a buffer returned by get(), along with its capacity.
+   */
+  void put(Buffer buf, uint32_t capacity) {
+    auto idx = getClass(capacity);
+    if (idx == classes_.size() || classes_[idx].size != capacity ||
+        threadCacheSize_ == 0) {
+      free(buf);
+      return;
+    }
+    auto& cached = getThreadCache()->buffers[idx];
+    cached.push_back(buf);
+    if (cached.size() > threadCacheSize_) {
+      spill(idx, &cached, threadCacheSize_ / 2);
+    }
+  }
+
+  const Allocator& getAllocator() const {
+    return allocator_;
+  }
+
+  /*
+   * The number of times the pool had to go to the allocator, and the
+   * number of buffers it has given back.
+   */
+  uint64_t getAllocCount() const {
+    return allocs_.load(std::memory_order_relaxed);
+  }
+  uint64_t getFreeCount() const {
+    return frees_.load(std::memory_order_relaxed);
+  }
+
+  enum : uint32_t {
+    kDefaultThreadCacheSize = 32,
+  };
+
+ private:
+  struct SizeClass {
+    uint32_t size{0};
+    folly::SpinLock lock;
+    std::vector<Buffer> buffers;
+  };
+  struct ThreadCache {
+    ThreadCache(TxBufferPool* pool, size_t numClasses)
+      : pool(pool), buffers(numClasses) {}
+    ~ThreadCache() {
+      // The thread is exiting; hand everything back to the shared lists.
+      for (size_t i = 0; i < buffers.size(); ++i) {
+        pool->spill(i, &buffers[i], 0);
+      }
+    }
+
+    TxBufferPool* pool;
+    std::vector<std::vector<Buffer>> buffers;
+  };
+  struct ThreadCacheTag {};
+
+  // Forbidden copy constructor and assignment operator
+  TxBufferPool(TxBufferPool const &) = delete;
+  TxBufferPool& operator=(TxBufferPool const &) = delete;
+
+  size_t getClass(uint32_t size) const {
+    size_t idx = 0;
+    while (idx < classes_.size() && classes_[idx].size < size) {
+      ++idx;
+    }
+    return idx;
+  }
+
+  ThreadCache* getThreadCache() {
+    auto cache = threadCaches_.get();
+    if (!cache) {
+      cache = new ThreadCache(this, classes_.size());
+      threadCaches_.reset(cache);
+    }
+    return cache;
+  }
+
+  /*
+   * Move all but `keep` of the cached buffers to the shared list, freeing
+   * whatever doesn't fit under the watermark.
+   */
+  void spill(size_t idx, std::vector<Buffer>* cached, size_t keep) {
+    if (cached->size() <= keep) {
+      return;
+    }
+    auto& sizeClass = classes_[idx];
+    auto begin = cached->begin() + keep;
+    {
+      folly::SpinLockGuard guard(sizeClass.lock);
+      auto room = watermark_ - std::min<size_t>(watermark_,
+                                                sizeClass.buffers.size());
+      auto n = std::min<size_t>(room, cached->end() - begin);
+      sizeClass.buffers.insert(sizeClass.buffers.end(), begin, begin + n);
+      begin += n;
+    }
+    for (auto it = begin; it != cached->end(); ++it) {
+      free(*it);
+    }
+    cached->resize(keep);
+  }
+
+  void freeAll(std::vector<Buffer>* buffers) {
+    for (auto buf : *buffers) {
+      free(buf);
+    }
+    buffers->clear();
+  }
+
+  Buffer allocate(uint32_t size) {
+    allocs_.fetch_add(1, std::memory_order_relaxed);
+    return allocator_.allocate(size);
+  }
+
+  void free(Buffer buf) {
+    frees_.fetch_add(1, std::memory_order_relaxed);
+    allocator_.free(buf);
+  }
+
+  Allocator allocator_;
+  std::vector<SizeClass> classes_;
+  const uint32_t watermark_;
+  const uint32_t threadCacheSize_;
+  std::atomic<uint64_t> allocs_{0};
+  std::atomic<uint64_t> frees_{0};
+  // Declared last, so that the thread caches are destroyed while the rest
+  // of the pool is still around.
+  folly::ThreadLocalPtr<ThreadCache, ThreadCacheTag> threadCaches_;
+};
+
+}} // facebook::fboss
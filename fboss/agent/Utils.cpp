@@ -12,8 +12,11 @@
 #include <sys/resource.h>
 #include <sys/syscall.h>
 
+#include "fboss/agent/AddressUtil.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/SysError.h"
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/state/Route.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
@@ -22,6 +25,7 @@
 
 using folly::IPAddressV4;
 using folly::IPAddressV6;
+using facebook::network::toBinaryAddress;
 
 namespace facebook { namespace fboss {
 
@@ -61,6 +65,46 @@ IPAddressV6 getSwitchVlanIPv6(const std::shared_ptr<SwitchState>& state,
   throw FbossError("Cannot find IPv6 address for vlan ", vlan);
 }
 
+namespace {
+
+template<typename AddrT>
+IpPrefix toIpPrefixImpl(const Route<AddrT>& route) {
+  IpPrefix prefix;
+  prefix.ip = toBinaryAddress(route.prefix().network);
+  prefix.prefixLength = route.prefix().mask;
+  return prefix;
+}
+
+template<typename AddrT>
+UnicastRoute toUnicastRouteImpl(const Route<AddrT>& route) {
+  UnicastRoute tempRoute;
+  const auto& fwdInfo = route.getForwardInfo();
+  tempRoute.dest = toIpPrefixImpl(route);
+  tempRoute.nextHopAddrs.reserve(fwdInfo.getNexthops().size());
+  for (const auto& hop : fwdInfo.getNexthops()) {
+    tempRoute.nextHopAddrs.push_back(toBinaryAddress(hop.nexthop));
+  }
+  return tempRoute;
+}
+
+} // unnamed namespace
+
+UnicastRoute toUnicastRoute(const Route<IPAddressV4>& route) {
+  return toUnicastRouteImpl(route);
+}
+
+UnicastRoute toUnicastRoute(const Route<IPAddressV6>& route) {
+  return toUnicastRouteImpl(route);
+}
+
+IpPrefix toIpPrefix(const Route<IPAddressV4>& route) {
+  return toIpPrefixImpl(route);
+}
+
+IpPrefix toIpPrefix(const Route<IPAddressV6>& route) {
+  return toIpPrefixImpl(route);
+}
+
 void incNiceValue(const uint32_t increment) {
   if (increment == 0) {
     LOG(WARNING) << "Nice value increment is 0. Returning now.";
@@ -19,6 +19,9 @@
 namespace facebook { namespace fboss {
 
 class SwitchState;
+class IpPrefix;
+class UnicastRoute;
+template<typename AddrT> class Route;
 
 template<typename T>
 inline T readBuffer(const uint8_t* buffer, uint32_t pos, size_t buffSize) {
@@ -51,6 +54,19 @@ folly::IPAddressV4 getSwitchVlanIP(const std::shared_ptr<SwitchState>& state,
  */
 folly::IPAddressV6 getSwitchVlanIPv6(const std::shared_ptr<SwitchState>& state,
                                      VlanID vlan);
+/*
+ * Convert a route to the thrift structure that the route table is returned
+ * to clients in.
+ */
+UnicastRoute toUnicastRoute(const Route<folly::IPAddressV4>& route);
+UnicastRoute toUnicastRoute(const Route<folly::IPAddressV6>& route);
+
+/*
+ * Convert the prefix of a route to thrift
+ */
+IpPrefix toIpPrefix(const Route<folly::IPAddressV4>& route);
+IpPrefix toIpPrefix(const Route<folly::IPAddressV6>& route);
+
 /*
  * Increases the nice value of the calling thread by increment. Note that this
  * code relies on the fact that Linux is not POSIX compliant. Otherwise, there
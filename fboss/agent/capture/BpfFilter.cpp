@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/capture/BpfFilter.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/ScopeGuard.h>
+#include <folly/io/IOBuf.h>
+
+#include <mutex>
+
+namespace facebook { namespace fboss {
+
+namespace {
+// pcap_compile() isn't thread safe in older versions of libpcap
+std::mutex compileMutex;
+}
+
+BpfFilter::BpfFilter(folly::StringPiece expression)
+  : expression_(expression.str()) {
+  // We only need a pcap handle to tell the compiler the link type
+  pcap_t* pcap = pcap_open_dead(DLT_EN10MB, 0xffff);
+  if (!pcap) {
+    throw FbossError("unable to create a pcap handle to compile filter");
+  }
+  SCOPE_EXIT {
+    pcap_close(pcap);
+  };
+
+  std::lock_guard<std::mutex> guard(compileMutex);
+  int rv = pcap_compile(pcap, &program_, expression_.c_str(),
+                        1, PCAP_NETMASK_UNKNOWN);
+  if (rv != 0) {
+    throw FbossError("invalid capture filter \"", expression_, "\": ",
+                     pcap_geterr(pcap));
+  }
+}
+
+BpfFilter::~BpfFilter() {
+  pcap_freecode(&program_);
+}
+
+bool BpfFilter::matches(const folly::IOBuf* buf) const {
+  return bpf_filter(program_.bf_insns, buf->data(),
+                    buf->computeChainDataLength(), buf->length()) != 0;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <pcap/pcap.h>
+
+#include <string>
+
+namespace folly {
+class IOBuf;
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * BpfFilter is a pcap filter expression (see pcap-filter(7)), compiled once
+ * with libpcap, that can then be matched against ethernet frames.
+ *
+ * matches() only reads the packet, and may be called from several threads
+ * at once.
+ */
+class BpfFilter {
+ public:
+  /*
+   * Compile the expression.  Throws an FbossError if it isn't valid.
+   */
+  explicit BpfFilter(folly::StringPiece expression);
+  ~BpfFilter();
+
+  const std::string& expression() const {
+    return expression_;
+  }
+
+  /*
+   * Run the filter on a packet, starting from the ethernet header.
+   *
+   * The filter only sees the first buffer of a chained IOBuf; a filter that
+   * looks past it does not match.  Our RX and TX packets are never chained.
+   */
+  bool matches(const folly::IOBuf* buf) const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BpfFilter(BpfFilter const &) = delete;
+  BpfFilter& operator=(BpfFilter const &) = delete;
+
+  const std::string expression_;
+  struct bpf_program program_;
+};
+
+}} // facebook::fboss
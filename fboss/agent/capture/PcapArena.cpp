@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/capture/PcapArena.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <glog/logging.h>
+
+using folly::IOBuf;
+
+namespace facebook { namespace fboss {
+
+PcapArena::PcapArena(uint64_t maxBytes, uint32_t slabSize)
+  : slabSize_(slabSize),
+    maxSlabs_(std::max<uint64_t>(2, (maxBytes + slabSize - 1) / slabSize)) {
+}
+
+PcapArena::~PcapArena() {
+  if (current_) {
+    release(current_);
+  }
+  DCHECK_EQ(freeSlabs_.size(), slabs_.size())
+    << "PcapArena destroyed while packets still point into it";
+}
+
+bool PcapArena::copy(const IOBuf* src, uint32_t len, IOBuf* dst) {
+  len = std::min(len, slabSize_);
+  if (!current_ || slabSize_ - current_->used < len) {
+    current_ = nextSlab();
+    if (!current_) {
+      return false;
+    }
+  }
+
+  auto data = current_->data.get() + current_->used;
+  folly::io::Cursor cursor(src);
+  cursor.pull(data, len);
+  current_->used += len;
+  current_->refs.fetch_add(1, std::memory_order_relaxed);
+  *dst = IOBuf(IOBuf::TAKE_OWNERSHIP, data, len, len, freeBuf, current_);
+  return true;
+}
+
+void PcapArena::freeBuf(void* /*ptr*/, void* userData) {
+  auto slab = static_cast<Slab*>(userData);
+  slab->arena->release(slab);
+}
+
+void PcapArena::release(Slab* slab) {
+  if (slab->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    folly::SpinLockGuard guard(lock_);
+    freeSlabs_.push_back(slab);
+  }
+}
+
+PcapArena::Slab* PcapArena::nextSlab() {
+  // Let go of the current slab; it is recycled once the packets in it
+  // have been written out.
+  if (current_) {
+    release(current_);
+    current_ = nullptr;
+  }
+
+  Slab* slab{nullptr};
+  {
+    folly::SpinLockGuard guard(lock_);
+    if (!freeSlabs_.empty()) {
+      slab = freeSlabs_.back();
+      freeSlabs_.pop_back();
+    }
+  }
+  if (!slab) {
+    if (slabs_.size() >= maxSlabs_) {
+      return nullptr;
+    }
+    slabs_.emplace_back(new Slab(this, slabSize_));
+    numSlabs_.store(slabs_.size(), std::memory_order_relaxed);
+    slab = slabs_.back().get();
+  }
+  slab->used = 0;
+  slab->refs.store(1, std::memory_order_relaxed);
+  return slab;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/SpinLock.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace folly {
+class IOBuf;
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * PcapArena holds the packet data of a capture.
+ *
+ * Captured packets are copied out of the RxPacket or TxPacket buffers, which
+ * for the Broadcom switches are SDK DMA buffers that we must not hold on to
+ * while the capture is being written to disk. Rather than doing a heap
+ * allocation for each packet, the arena carves them out of large slabs.
+ *
+ * Each slab counts the packets that still point into it, and goes back on a
+ * free list once they have all been released. The arena never grows past
+ * maxBytes; copy() fails when it would, and the capture should then drop
+ * the packet.
+ *
+ * copy() may only be called from one thread at a time. The buffers it
+ * returns may be released from any thread, but the arena must outlive them.
+ */
+class PcapArena {
+ public:
+  enum : uint32_t {
+    kDefaultSlabSize = 256 * 1024,
+  };
+
+  explicit PcapArena(uint64_t maxBytes, uint32_t slabSize = kDefaultSlabSize);
+  ~PcapArena();
+
+  /*
+   * Copy the first len bytes of src into the arena, and point dst at them.
+   *
+   * len is capped to the slab size. Returns false if the arena is full.
+   */
+  bool copy(const folly::IOBuf* src, uint32_t len, folly::IOBuf* dst);
+
+  /*
+   * The amount of memory allocated for slabs so far.
+   */
+  uint64_t bytesAllocated() const {
+    return numSlabs_.load(std::memory_order_relaxed) * uint64_t(slabSize_);
+  }
+
+ private:
+  struct Slab {
+    Slab(PcapArena* arena, uint32_t size)
+      : arena(arena), data(new uint8_t[size]) {}
+
+    PcapArena* const arena;
+    std::unique_ptr<uint8_t[]> data;
+    uint32_t used{0};
+    // The packets using this slab, plus one if it's the current slab
+    std::atomic<uint32_t> refs{0};
+  };
+
+  // Forbidden copy constructor and assignment operator
+  PcapArena(PcapArena const &) = delete;
+  PcapArena& operator=(PcapArena const &) = delete;
+
+  static void freeBuf(void* ptr, void* userData);
+  void release(Slab* slab);
+  Slab* nextSlab();
+
+  const uint32_t slabSize_;
+  const uint32_t maxSlabs_;
+  Slab* current_{nullptr};
+  std::vector<std::unique_ptr<Slab>> slabs_;
+  std::atomic<uint32_t> numSlabs_{0};
+
+  folly::SpinLock lock_;
+  std::vector<Slab*> freeSlabs_;
+};
+
+}} // facebook::fboss
@@ -14,6 +14,7 @@
 #include <folly/Exception.h>
 #include <folly/FileUtil.h>
 
+#include <algorithm>
 #include <chrono>
 
 using folly::IOBuf;
@@ -33,7 +34,7 @@ PcapFile::PktHeader::PktHeader(const PcapPkt& pkt) {
   timeSec = tsSec.count();
   timeUsec = (tsUsec - tsSec).count();
   includedLen = len;
-  origLen = len;
+  origLen = std::max<uint32_t>(len, pkt.origLen());
 }
 
 PcapFile::PcapFile() {
@@ -51,7 +52,7 @@ void PcapFile::close() {
   file_.close();
 }
 
-void PcapFile::writeGlobalHeader() {
+void PcapFile::writeGlobalHeader(uint32_t snaplen) {
   struct GlobalHeader {
     uint32_t magic;
     uint16_t versionMajor;
@@ -66,7 +67,7 @@ void PcapFile::writeGlobalHeader() {
   hdr.versionMinor = 4;
   hdr.tzOffset = 0;
   hdr.sigfigs = 0;
-  hdr.snaplen = 0xffff;
+  hdr.snaplen = (snaplen == 0 || snaplen > 0xffff) ? 0xffff : snaplen;
   // Link type 1 is ethernet.  Other possible types we might want to use
   // include 113 for linux "cooked" capture format.
   hdr.linkType = 1;
@@ -75,7 +76,7 @@ void PcapFile::writeGlobalHeader() {
   folly::checkUnixError(ret, "error writing pcap global header");
 }
 
-void PcapFile::writePackets(const std::vector<PcapPkt>& pkts) {
+uint64_t PcapFile::writePackets(const std::vector<PcapPkt>& pkts) {
   folly::fbvector<PktHeader> hdrs;
   hdrs.reserve(pkts.size());
   folly::fbvector<struct iovec> iov;
@@ -92,8 +93,9 @@ void PcapFile::writePackets(const std::vector<PcapPkt>& pkts) {
     pkt.buf()->appendToIov(&iov);
   }
 
-  int ret = writevFull(file_.fd(), iov.data(), iov.size());
+  auto ret = writevFull(file_.fd(), iov.data(), iov.size());
   folly::checkUnixError(ret, "error writing pcap data");
+  return ret;
 }
 
 int PcapFile::openFlags(bool overwriteExisting) {
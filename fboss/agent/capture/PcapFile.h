@@ -32,8 +32,15 @@ class PcapFile {
 
   void close();
 
-  void writeGlobalHeader();
-  void writePackets(const std::vector<PcapPkt>& pkt);
+  /*
+   * Write the pcap file header.  snaplen is the maximum number of bytes
+   * recorded for each packet, or 0 if packets are never truncated.
+   */
+  void writeGlobalHeader(uint32_t snaplen = 0);
+  /*
+   * Write the packets, returning the number of bytes written.
+   */
+  uint64_t writePackets(const std::vector<PcapPkt>& pkt);
 
   // Move constructor and assignment operator
   PcapFile(PcapFile&&) = default;
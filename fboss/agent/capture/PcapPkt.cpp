@@ -11,6 +11,11 @@
 
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/TxPacket.h"
+#include "fboss/agent/capture/PcapArena.h"
+
+#include <folly/io/Cursor.h>
+
+using folly::IOBuf;
 
 namespace facebook { namespace fboss {
 
@@ -22,13 +27,17 @@ PcapPkt::PcapPkt(const RxPacket* pkt)
 }
 
 PcapPkt::PcapPkt(const RxPacket* pkt, TimePoint timestamp)
-  : initialized_(true),
-    rx_(true),
+  : PcapPkt(pkt, timestamp, nullptr, 0) {
+}
+
+PcapPkt::PcapPkt(const RxPacket* pkt, TimePoint timestamp,
+                 PcapArena* arena, uint32_t snaplen)
+  : rx_(true),
     port_(pkt->getSrcPort()),
     vlan_(pkt->getSrcVlan()),
     timestamp_(timestamp),
     buf_() {
-  pkt->buf()->cloneInto(buf_);
+  copyData(pkt->buf(), arena, snaplen);
 }
 
 PcapPkt::PcapPkt(const TxPacket* pkt)
@@ -36,13 +45,35 @@ PcapPkt::PcapPkt(const TxPacket* pkt)
 }
 
 PcapPkt::PcapPkt(const TxPacket* pkt, TimePoint timestamp)
-  : initialized_(true),
-    rx_(false),
+  : PcapPkt(pkt, timestamp, nullptr, 0) {
+}
+
+PcapPkt::PcapPkt(const TxPacket* pkt, TimePoint timestamp,
+                 PcapArena* arena, uint32_t snaplen)
+  : rx_(false),
     port_(0),
     vlan_(0),
     timestamp_(timestamp),
     buf_() {
-  pkt->buf()->cloneInto(buf_);
+  copyData(pkt->buf(), arena, snaplen);
+}
+
+void PcapPkt::copyData(const IOBuf* buf, PcapArena* arena, uint32_t snaplen) {
+  origLen_ = buf->computeChainDataLength();
+  uint32_t len = origLen_;
+  if (snaplen > 0 && snaplen < len) {
+    len = snaplen;
+  }
+
+  if (arena) {
+    initialized_ = arena->copy(buf, len, &buf_);
+    return;
+  }
+  buf_ = IOBuf(IOBuf::CREATE, len);
+  folly::io::Cursor cursor(buf);
+  cursor.pull(buf_.writableData(), len);
+  buf_.append(len);
+  initialized_ = true;
 }
 
 }} // facebook::fboss
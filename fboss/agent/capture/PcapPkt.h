@@ -15,11 +15,15 @@
 
 namespace facebook { namespace fboss {
 
+class PcapArena;
 class RxPacket;
 class TxPacket;
 
 /*
  * PcapPkt represents a packet captured on the wire.
+ *
+ * The packet data is always copied, so that a PcapPkt never holds on to the
+ * buffer of the RxPacket or TxPacket it was created from.
  */
 class PcapPkt {
  public:
@@ -42,6 +46,17 @@ class PcapPkt {
   explicit PcapPkt(const TxPacket* pkt);
   PcapPkt(const TxPacket* pkt, TimePoint timestamp);
 
+  /*
+   * Create a PcapPkt whose data is copied into the given arena, keeping at
+   * most snaplen bytes of it.  A snaplen of 0 keeps the whole packet.
+   *
+   * If the arena is full the PcapPkt is left uninitialized.
+   */
+  PcapPkt(const RxPacket* pkt, TimePoint timestamp,
+          PcapArena* arena, uint32_t snaplen);
+  PcapPkt(const TxPacket* pkt, TimePoint timestamp,
+          PcapArena* arena, uint32_t snaplen);
+
   bool initialized() const {
     return initialized_;
   }
@@ -63,6 +78,13 @@ class PcapPkt {
   const folly::IOBuf* buf() const {
     return &buf_;
   }
+  /*
+   * The length of the packet on the wire, which is larger than the length
+   * of buf() if the packet was truncated.
+   */
+  uint32_t origLen() const {
+    return origLen_;
+  }
 
   // Move assignment
   PcapPkt(PcapPkt&& other) noexcept {
@@ -76,6 +98,7 @@ class PcapPkt {
     port_ = other.port_;
     vlan_ = other.vlan_;
     timestamp_ = other.timestamp_;
+    origLen_ = other.origLen_;
     buf_ = std::move(other.buf_);
     return *this;
   }
@@ -85,6 +108,8 @@ class PcapPkt {
   PcapPkt(PcapPkt const&) = delete;
   PcapPkt& operator=(PcapPkt const&) = delete;
 
+  void copyData(const folly::IOBuf* buf, PcapArena* arena, uint32_t snaplen);
+
   bool initialized_{false};
   // Whether or not we received this packet, or are sending it.
   bool rx_{false};
@@ -99,6 +124,7 @@ class PcapPkt {
   // The VLAN the packet was sent or received on.
   VlanID vlan_{0};
   TimePoint timestamp_;
+  uint32_t origLen_{0};
   // The packet contents, starting from the ethernet header.
   folly::IOBuf buf_;
 };
@@ -11,20 +11,26 @@
 
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/TxPacket.h"
-#include "fboss/agent/capture/PcapPkt.h"
 
 DEFINE_int32(fboss_pcap_queue_depth, 10240,
              "When taking packet captures, the maximum number of packets "
              "to buffer in memory while waiting them to be written to the "
              "capture file");
+DEFINE_int64(fboss_pcap_queue_bytes, 64 * 1024 * 1024,
+             "When taking packet captures, the maximum number of bytes of "
+             "packet data to buffer in memory while waiting for them to be "
+             "written to the capture file");
 
 namespace facebook { namespace fboss {
 
-PcapQueue::PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity)
+PcapQueue::PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity,
+                     uint32_t snaplen)
   : pktCapacity_(pktCapacity == 0 ?
                  FLAGS_fboss_pcap_queue_depth : pktCapacity),
-    bytesCapacity_(bytesCapacity) {
-  queue_.reserve(pktCapacity_);
+    snaplen_(snaplen),
+    arena_(bytesCapacity == 0 ? FLAGS_fboss_pcap_queue_bytes : bytesCapacity),
+    // ProducerConsumerQueue holds one less than its size
+    queue_(pktCapacity_ + 1) {
 }
 
 PcapQueue::~PcapQueue() {
@@ -32,87 +38,86 @@ PcapQueue::~PcapQueue() {
 
 template<typename PktType>
 void PcapQueue::addPktInternal(const PktType* pkt) {
-  // Check to see if this would exceed the queue capacity.
-  if (queue_.size() >= pktCapacity_) {
-    pktsDropped_ += 1;
+  // Check to see if this would exceed the queue capacity, before bothering
+  // to copy the packet.
+  if (queue_.isFull()) {
+    drop(pkt->buf()->computeChainDataLength());
     return;
   }
-  auto newBytes = bytesInQueue_ + pkt->buf()->computeChainDataLength();
-  if (bytesCapacity_ > 0 && newBytes >= bytesCapacity_) {
-    pktsDropped_ += 1;
+
+  PcapPkt pcapPkt(pkt, std::chrono::system_clock::now(), &arena_, snaplen_);
+  if (!pcapPkt.initialized()) {
+    // The arena is full
+    drop(pcapPkt.origLen());
     return;
   }
-
-  queue_.emplace_back(pkt);
+  // We are the only producer, so this can't fail after the check above
+  queue_.write(std::move(pcapPkt));
+  readable_.notify();
 }
 
-void PcapQueue::addPkt(const RxPacket* pkt) {
-  {
-    std::lock_guard<std::mutex> guard(mutex_);
-    addPktInternal(pkt);
-  }
-  cv_.notify_one();
+void PcapQueue::drop(uint64_t bytes) {
+  // Only the producer updates these, so there's no need for an atomic add
+  pktsDropped_.store(pktsDropped_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  bytesDropped_.store(bytesDropped_.load(std::memory_order_relaxed) + bytes,
+                      std::memory_order_relaxed);
 }
 
-void PcapQueue::addPktLocked(const RxPacket* pkt) {
+void PcapQueue::addPkt(const RxPacket* pkt) {
   addPktInternal(pkt);
-  // It is preferred not to be holding the lock when we signal cv_,
-  // but it is okay to call it with the lock held anyway.  (Having the lock
-  // held will just prevent the reader thread from being able to acquire it
-  // immediately when the reader wakes.)
-  cv_.notify_one();
 }
 
 void PcapQueue::addPkt(const TxPacket* pkt) {
-  {
-    std::lock_guard<std::mutex> guard(mutex_);
-    addPktInternal(pkt);
-  }
-  cv_.notify_one();
-}
-
-void PcapQueue::addPktLocked(const TxPacket* pkt) {
   addPktInternal(pkt);
-  // It is preferred not to be holding the lock when we signal cv_,
-  // but it is okay to call it with the lock held anyway.  (Having the lock
-  // held will just prevent the reader thread from being able to acquire it
-  // immediately when the reader wakes.)
-  cv_.notify_one();
 }
 
 void PcapQueue::finish() {
-  std::lock_guard<std::mutex> guard(mutex_);
-  finished_ = true;
-  cv_.notify_all();
+  finished_.store(true, std::memory_order_release);
+  readable_.notifyAll();
 }
 
 bool PcapQueue::isFinished() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  return finished_;
+  return finished_.load(std::memory_order_acquire);
 }
 
 uint64_t PcapQueue::numDropped() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  return pktsDropped_;
+  return pktsDropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t PcapQueue::bytesDropped() const {
+  return bytesDropped_.load(std::memory_order_relaxed);
+}
+
+void PcapQueue::readAll(std::vector<PcapPkt>* pkts) {
+  PcapPkt pkt;
+  while (queue_.read(pkt)) {
+    pkts->push_back(std::move(pkt));
+  }
 }
 
 bool PcapQueue::wait(std::vector<PcapPkt>* swapQueue) {
   swapQueue->clear();
   swapQueue->reserve(pktCapacity_);
 
-  std::unique_lock<std::mutex> guard(mutex_);
-  while (queue_.empty() && !finished_) {
-    cv_.wait(guard);
-  }
-  if (queue_.empty()) {
-    DCHECK(finished_);
-    queue_.shrink_to_fit();
-    return false;
+  while (true) {
+    readAll(swapQueue);
+    if (!swapQueue->empty()) {
+      return true;
+    }
+    if (isFinished()) {
+      // Pick up anything added just before finish() was called
+      readAll(swapQueue);
+      return !swapQueue->empty();
+    }
+
+    auto key = readable_.prepareWait();
+    if (!queue_.isEmpty() || isFinished()) {
+      readable_.cancelWait();
+      continue;
+    }
+    readable_.wait(key);
   }
-
-  swapQueue->swap(queue_);
-  bytesInQueue_ = 0;
-  return true;
 }
 
 }} // facebook::fboss
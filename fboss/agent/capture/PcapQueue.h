@@ -9,48 +9,48 @@
  */
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include "fboss/agent/capture/PcapArena.h"
+#include "fboss/agent/capture/PcapPkt.h"
+
+#include <folly/ProducerConsumerQueue.h>
+#include <folly/experimental/EventCount.h>
+
+#include <atomic>
 #include <vector>
 
 namespace facebook { namespace fboss {
 
 class RxPacket;
 class TxPacket;
-class PcapPkt;
 
 /*
  * PcapQueue stores a queue of PcapPkt objects, for transferring packets
  * from an asynchronous capture thread to a blocking thread that will process
  * the packets.  (For instance, writing them to disk using blocking I/O.)
  *
- * There can only be a single reader.
+ * The queue is a lock-free single-producer, single-consumer ring.  There can
+ * only be a single reader, and calls to addPkt() must not run concurrently
+ * with each other.  (PktCaptureManager serializes all calls into a capture.)
+ *
+ * Packets are copied into an arena owned by the queue, so adding a packet
+ * never keeps its original buffer alive.  At most snaplen bytes of each
+ * packet are kept, if a snaplen is given.
  */
 class PcapQueue {
  public:
-  explicit PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity = 0);
+  explicit PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity = 0,
+                     uint32_t snaplen = 0);
   virtual ~PcapQueue();
 
   uint32_t getPktCapacity() const {
-    // pktCapacity_ is const, so no need for locking
     return pktCapacity_;
   }
-
-  /*
-   * Get the mutex protecting this PcapQueue.
-   *
-   * This is exposed to allow callers to also protect their own data
-   * with the same mutex if desired.  Callers should call addPktLocked()
-   * instead of addPkt() when they are already holding the PcapQueue mutex.
-   */
-  std::mutex& mutex() const {
-    return mutex_;
+  uint32_t getSnaplen() const {
+    return snaplen_;
   }
 
   void addPkt(const RxPacket* pkt);
-  void addPktLocked(const RxPacket* pkt);
   void addPkt(const TxPacket* pkt);
-  void addPktLocked(const TxPacket* pkt);
 
   /*
    * finish() signals that no more packets will be added to the queue.
@@ -62,13 +62,14 @@ class PcapQueue {
   bool isFinished() const;
 
   /*
-   * Return the number of packets dropped.
+   * Return the number of packets, and of bytes, dropped.
    *
    * If the reader is pulling packets off the queue slower than they are being
    * added, packets will be dropped once the queue reaches its maximum
-   * capacity.
+   * capacity, or once the arena holding the packet data is full.
    */
   uint64_t numDropped() const;
+  uint64_t bytesDropped() const;
 
   /*
    * Wait for new packets from the queue.
@@ -76,6 +77,9 @@ class PcapQueue {
    * Note: for best performance, the writer should re-use the same vector
    * for multiple wait() calls.  On subsequent calls the queue will already
    * have the desired capacity, and will not need to reallocate memory.
+   *
+   * The packet data lives in the queue's arena, so the returned packets
+   * must be released before the PcapQueue is destroyed.
    */
   bool wait(std::vector<PcapPkt>* swapQueue);
 
@@ -86,16 +90,17 @@ class PcapQueue {
 
   template<typename PktType>
   void addPktInternal(const PktType* pkt);
+  void drop(uint64_t bytes);
+  void readAll(std::vector<PcapPkt>* pkts);
 
-  mutable std::mutex mutex_;
-  std::condition_variable cv_;
-
-  bool finished_{false};
   const uint32_t pktCapacity_{0};
-  uint64_t bytesCapacity_{0};
-  uint64_t bytesInQueue_{0};
-  uint64_t pktsDropped_{0};
-  std::vector<PcapPkt> queue_;
+  const uint32_t snaplen_{0};
+  PcapArena arena_;
+  folly::ProducerConsumerQueue<PcapPkt> queue_;
+  folly::EventCount readable_;
+  std::atomic<bool> finished_{false};
+  std::atomic<uint64_t> pktsDropped_{0};
+  std::atomic<uint64_t> bytesDropped_{0};
 };
 
 }} // facebook::fboss
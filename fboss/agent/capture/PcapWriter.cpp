@@ -9,23 +9,31 @@
  */
 #include "fboss/agent/capture/PcapWriter.h"
 
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <folly/Exception.h>
 #include <folly/String.h>
 
+#include <stdio.h>
+#include <unistd.h>
+
 using folly::StringPiece;
 
 namespace facebook { namespace fboss {
 
-PcapWriter::PcapWriter(uint32_t maxBufferedPkts)
-  : queue_(maxBufferedPkts) {
+PcapWriter::PcapWriter(uint32_t maxBufferedPkts, uint32_t snaplen)
+  : queue_(maxBufferedPkts, 0, snaplen) {
 }
 
 PcapWriter::PcapWriter(StringPiece path,
                        bool overwriteExisting,
-                       uint32_t maxBufferedPkts)
-  : file_(path, overwriteExisting),
-    queue_(maxBufferedPkts),
+                       uint32_t maxBufferedPkts,
+                       uint32_t snaplen)
+  : path_(path.str()),
+    file_(path, overwriteExisting),
+    queue_(maxBufferedPkts, 0, snaplen),
     thread_(&PcapWriter::threadMain, this) {
 }
 
@@ -42,10 +50,27 @@ PcapWriter::~PcapWriter() {
 }
 
 void PcapWriter::start(folly::StringPiece path, bool overwriteExisting) {
+  path_ = path.str();
   file_ = PcapFile(path, overwriteExisting);
   thread_ = std::thread(&PcapWriter::threadMain, this);
 }
 
+void PcapWriter::setCounterName(StringPiece name) {
+  DCHECK(!thread_.joinable());
+  auto prefix = folly::to<std::string>(SwitchStats::kCounterPrefix,
+                                       "capture.", name);
+  pktsDroppedCounter_ = prefix + ".pkts_dropped";
+  bytesDroppedCounter_ = prefix + ".bytes_dropped";
+}
+
+void PcapWriter::setRotation(uint64_t maxBytes, std::chrono::seconds interval,
+                             uint32_t maxFiles) {
+  DCHECK(!thread_.joinable());
+  rotateBytes_ = maxBytes;
+  rotateInterval_ = interval;
+  maxFiles_ = maxFiles;
+}
+
 void PcapWriter::finish() {
   if (!thread_.joinable()) {
     // already stopped
@@ -61,7 +86,8 @@ void PcapWriter::finish() {
 
 void PcapWriter::threadMain() {
   try {
-    file_.writeGlobalHeader();
+    file_.writeGlobalHeader(queue_.getSnaplen());
+    fileStart_ = std::chrono::steady_clock::now();
     writeLoop();
     file_.close();
   } catch (const std::exception& ex) {
@@ -76,12 +102,54 @@ void PcapWriter::writeLoop() {
     pkts.clear();
     if (!queue_.wait(&pkts)) {
       DCHECK(pkts.empty());
+      updateCounters();
       return;
     }
 
     DCHECK(!pkts.empty());
-    file_.writePackets(pkts);
+    fileBytes_ += file_.writePackets(pkts);
+    updateCounters();
+    if (shouldRotate()) {
+      rotate();
+    }
+  }
+}
+
+bool PcapWriter::shouldRotate() const {
+  if (rotateBytes_ > 0 && fileBytes_ >= rotateBytes_) {
+    return true;
+  }
+  return rotateInterval_.count() > 0 &&
+    std::chrono::steady_clock::now() - fileStart_ >= rotateInterval_;
+}
+
+void PcapWriter::rotate() {
+  file_.close();
+  ++numRotations_;
+  auto rotatedPath = folly::to<std::string>(path_, ".", numRotations_);
+  folly::checkUnixError(::rename(path_.c_str(), rotatedPath.c_str()),
+                        "error rotating pcap file ", path_);
+  if (maxFiles_ > 0 && numRotations_ > maxFiles_) {
+    auto oldPath = folly::to<std::string>(path_, ".",
+                                          numRotations_ - maxFiles_);
+    if (::unlink(oldPath.c_str()) != 0) {
+      PLOG(WARNING) << "unable to remove old pcap file " << oldPath;
+    }
+  }
+  VLOG(2) << "rotated pcap file " << path_ << " to " << rotatedPath;
+
+  file_ = PcapFile(path_, true);
+  file_.writeGlobalHeader(queue_.getSnaplen());
+  fileBytes_ = 0;
+  fileStart_ = std::chrono::steady_clock::now();
+}
+
+void PcapWriter::updateCounters() {
+  if (pktsDroppedCounter_.empty()) {
+    return;
   }
+  fbData->setCounter(pktsDroppedCounter_, queue_.numDropped());
+  fbData->setCounter(bytesDroppedCounter_, queue_.bytesDropped());
 }
 
 }} // facebook::fboss
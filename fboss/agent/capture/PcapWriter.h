@@ -12,6 +12,8 @@
 #include "fboss/agent/capture/PcapFile.h"
 #include "fboss/agent/capture/PcapQueue.h"
 
+#include <chrono>
+#include <string>
 #include <thread>
 
 namespace facebook { namespace fboss {
@@ -21,40 +23,50 @@ namespace facebook { namespace fboss {
  * to a pcap file.
  *
  * It performs blocking disk I/O, so it performs the writes in its own thread.
+ *
+ * The writer can be told to rotate the file once it reaches a given size or
+ * age.  The current file is then renamed to "<path>.<N>", with N counting up
+ * from 1, and a new file is started at the original path.  The checks are
+ * made after each batch of packets is written, so files may go slightly over
+ * the size limit, and a capture that sees no packets is not rotated.
  */
 class PcapWriter {
  public:
-  explicit PcapWriter(uint32_t maxBufferedPkts = 0);
+  explicit PcapWriter(uint32_t maxBufferedPkts = 0, uint32_t snaplen = 0);
   explicit PcapWriter(folly::StringPiece path,
                       bool overwriteExisting = false,
-                      uint32_t maxBufferedPkts = 0);
+                      uint32_t maxBufferedPkts = 0,
+                      uint32_t snaplen = 0);
   virtual ~PcapWriter();
 
   void start(folly::StringPiece path, bool overwriteExisting = false);
 
   /*
-   * Get the mutex protecting this PcapWriter.
-   *
-   * This is exposed to allow callers to also protect their own data
-   * with the same mutex if desired.  Callers should call addPktLocked()
-   * instead of addPkt() when they are already holding the PcapWriter mutex.
+   * Export the number of packets and bytes dropped as counters, named
+   * after the given capture name.  The counters are updated by the writer
+   * thread.
    */
-  std::mutex& mutex() const {
-    return queue_.mutex();
-  }
+  void setCounterName(folly::StringPiece name);
+
+  /*
+   * Rotate the capture file once it holds maxBytes bytes, or after
+   * interval, keeping at most maxFiles old files.  A value of 0 disables
+   * that limit.  Must be called before start().
+   */
+  void setRotation(uint64_t maxBytes, std::chrono::seconds interval,
+                   uint32_t maxFiles);
 
+  /*
+   * Add a packet to the capture.
+   *
+   * Calls to addPkt() must be serialized by the caller; see PcapQueue.
+   */
   void addPkt(const RxPacket* pkt) {
     queue_.addPkt(pkt);
   }
-  void addPktLocked(const RxPacket* pkt) {
-    queue_.addPktLocked(pkt);
-  }
   void addPkt(const TxPacket* pkt) {
     queue_.addPkt(pkt);
   }
-  void addPktLocked(const TxPacket* pkt) {
-    queue_.addPktLocked(pkt);
-  }
   void finish();
 
   /*
@@ -66,6 +78,9 @@ class PcapWriter {
   uint64_t numDropped() const {
     return queue_.numDropped();
   }
+  uint64_t bytesDropped() const {
+    return queue_.bytesDropped();
+  }
 
  private:
   // Forbidden copy constructor and assignment operator
@@ -75,9 +90,21 @@ class PcapWriter {
   void threadMain();
   void writeHeader();
   void writeLoop();
+  void updateCounters();
+  bool shouldRotate() const;
+  void rotate();
 
+  std::string path_;
   PcapFile file_;
+  uint64_t fileBytes_{0};
+  std::chrono::steady_clock::time_point fileStart_;
+  uint64_t rotateBytes_{0};
+  std::chrono::seconds rotateInterval_{0};
+  uint32_t maxFiles_{0};
+  uint32_t numRotations_{0};
   PcapQueue queue_;
+  std::string pktsDroppedCounter_;
+  std::string bytesDroppedCounter_;
   std::exception_ptr ex_;
   std::thread thread_;
 };
@@ -9,15 +9,43 @@
  */
 #include "fboss/agent/capture/PktCapture.h"
 
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/capture/BpfFilter.h"
+
 #include <folly/Conv.h>
 
 using folly::StringPiece;
 
 namespace facebook { namespace fboss {
 
-PktCapture::PktCapture(folly::StringPiece name, uint64_t maxPackets)
+namespace {
+PktCapture::Options makeOptions(uint64_t maxPackets, uint32_t snaplen) {
+  PktCapture::Options options;
+  options.maxPackets = maxPackets;
+  options.snaplen = snaplen;
+  return options;
+}
+}
+
+PktCapture::PktCapture(folly::StringPiece name, uint64_t maxPackets,
+                       uint32_t snaplen)
+  : PktCapture(name, makeOptions(maxPackets, snaplen)) {
+}
+
+PktCapture::PktCapture(folly::StringPiece name, const Options& options)
   : name_(name.str()),
-    maxPackets_(maxPackets) {
+    options_(options),
+    writer_(0, options.snaplen) {
+  if (!options_.filter.empty()) {
+    filter_.reset(new BpfFilter(options_.filter));
+  }
+  writer_.setCounterName(name_);
+  writer_.setRotation(options_.rotateBytes, options_.rotateInterval,
+                      options_.maxFiles);
+}
+
+PktCapture::~PktCapture() {
 }
 
 void PktCapture::start(StringPiece path) {
@@ -25,21 +53,55 @@ void PktCapture::start(StringPiece path) {
 }
 
 void PktCapture::stop() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stopped_ = true;
+  }
   writer_.finish();
 }
 
-bool PktCapture::packetReceived(const RxPacket* pkt) {
-  std::lock_guard<std::mutex> guard(writer_.mutex());
-  ++numPacketsReceived_;
-  writer_.addPktLocked(pkt);
-  return numPacketsReceived_ < maxPackets_;
+bool PktCapture::selected(Direction dir, PortID port,
+                          const folly::IOBuf* buf) {
+  if (!(options_.direction & dir)) {
+    return false;
+  }
+  if (!options_.ports.empty() &&
+      options_.ports.find(port) == options_.ports.end()) {
+    return false;
+  }
+  if (filter_ && !filter_->matches(buf)) {
+    return false;
+  }
+  if (options_.sampleRate > 1) {
+    auto n = numSelected_.fetch_add(1, std::memory_order_relaxed);
+    return n % options_.sampleRate == 0;
+  }
+  return true;
 }
 
-bool PktCapture::packetSent(const TxPacket* pkt) {
-  std::lock_guard<std::mutex> guard(writer_.mutex());
+template<typename PktType>
+bool PktCapture::capture(const PktType* pkt) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (stopped_ || numPacketsReceived_ >= options_.maxPackets) {
+    return false;
+  }
   ++numPacketsReceived_;
-  writer_.addPktLocked(pkt);
-  return numPacketsReceived_ < maxPackets_;
+  writer_.addPkt(pkt);
+  return numPacketsReceived_ < options_.maxPackets;
+}
+
+bool PktCapture::packetReceived(const RxPacket* pkt) {
+  if (!selected(RX, pkt->getSrcPort(), pkt->buf())) {
+    return true;
+  }
+  return capture(pkt);
+}
+
+bool PktCapture::packetSent(const TxPacket* pkt, PortID port) {
+  if (!selected(TX, port, pkt->buf())) {
+    return true;
+  }
+  return capture(pkt);
 }
 
 }} // facebook::fboss
@@ -10,12 +10,20 @@
 #pragma once
 
 #include "fboss/agent/capture/PcapWriter.h"
+#include "fboss/agent/types.h"
 
 #include <folly/Range.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 
 namespace facebook { namespace fboss {
 
+class BpfFilter;
 class RxPacket;
 class TxPacket;
 
@@ -24,7 +32,38 @@ class TxPacket;
  */
 class PktCapture {
  public:
-  PktCapture(folly::StringPiece name, uint64_t maxPackets);
+  enum Direction : uint8_t {
+    RX = 0x1,
+    TX = 0x2,
+    RX_TX = RX | TX,
+  };
+
+  struct Options {
+    // Stop capturing after this many packets
+    uint64_t maxPackets{0};
+    // Only record the first snaplen bytes of each packet; 0 records them all
+    uint32_t snaplen{0};
+    // A pcap filter expression; packets that don't match it are ignored
+    std::string filter;
+    // Capture 1 in every sampleRate packets that pass the other checks
+    uint32_t sampleRate{1};
+    // Only capture packets received on, or sent out of, these ports.
+    // Packets sent to the whole VLAN have no port, and never match.
+    std::set<PortID> ports;
+    Direction direction{RX_TX};
+    // File rotation; see PcapWriter::setRotation()
+    uint64_t rotateBytes{0};
+    std::chrono::seconds rotateInterval{0};
+    uint32_t maxFiles{0};
+  };
+
+  PktCapture(folly::StringPiece name, uint64_t maxPackets,
+             uint32_t snaplen = 0);
+  /*
+   * Throws an FbossError if the filter expression is invalid.
+   */
+  PktCapture(folly::StringPiece name, const Options& options);
+  ~PktCapture();
 
   const std::string& name() const {
     return name_;
@@ -33,20 +72,36 @@ class PktCapture {
   void start(folly::StringPiece path);
   void stop();
 
+  /*
+   * Offer a packet to the capture.  Returns false once the capture has
+   * finished, and no longer wants packets.
+   *
+   * These may be called from any thread.  The selection checks and the
+   * filter run without any lock, so packets that aren't captured cost only
+   * the checks.  Packets that are captured are copied under a lock, since
+   * the capture queue only has a single producer.
+   */
   bool packetReceived(const RxPacket* pkt);
-  bool packetSent(const TxPacket* pkt);
+  bool packetSent(const TxPacket* pkt, PortID port = PortID(0));
 
  private:
   // Forbidden copy constructor and assignment operator
   PktCapture(PktCapture const &) = delete;
   PktCapture& operator=(PktCapture const &) = delete;
 
+  bool selected(Direction dir, PortID port, const folly::IOBuf* buf);
+  template<typename PktType>
+  bool capture(const PktType* pkt);
+
   const std::string name_;
+  const Options options_;
+  std::unique_ptr<BpfFilter> filter_;
+  std::atomic<uint64_t> numSelected_{0};
 
-  // Note: the rest of the state in this class is protcted by
-  // the PcapWriter's mutex.
+  // Protects the state below, and serializes calls into writer_
+  std::mutex lock_;
   PcapWriter writer_;
-  uint64_t maxPackets_{0};
+  bool stopped_{false};
   uint64_t numPacketsReceived_{0};
 };
 
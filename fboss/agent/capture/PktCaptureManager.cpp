@@ -18,12 +18,14 @@
 #include <folly/String.h>
 
 using folly::StringPiece;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 
 namespace facebook { namespace fboss {
 
-PktCaptureManager::PktCaptureManager(SwSwitch* sw) {
+PktCaptureManager::PktCaptureManager(SwSwitch* sw)
+  : captures_(std::make_shared<CaptureList>()) {
   auto persistDir = sw->getPlatform()->getPersistentStateDir();
   captureDir_ = folly::to<string>(persistDir, "/captures");
   utilCreateDir(captureDir_);
@@ -39,106 +41,174 @@ void PktCaptureManager::startCapture(unique_ptr<PktCapture> capture) {
   auto path = folly::to<std::string>(captureDir_, "/",
                                      capture->name(), ".pcap");
 
-  std::lock_guard<std::mutex> g(mutex_);
+  {
+    std::lock_guard<std::mutex> g(mutex_);
 
-  const auto& name = capture->name();
-  if (activeCaptures_.find(name) != activeCaptures_.end()) {
-    throw FbossError("an active capture named \"", name, "\" already exists");
-  }
+    const auto& name = capture->name();
+    if (activeCaptures_.find(name) != activeCaptures_.end()) {
+      throw FbossError("an active capture named \"", name,
+                       "\" already exists");
+    }
 
-  capture->start(path);
-  capturesRunning_.store(true, std::memory_order_release);
-  activeCaptures_[name] = std::move(capture);
+    capture->start(path);
+    activeCaptures_[name] = std::move(capture);
+    publishLocked();
+  }
+  releaseStaleCaches();
 }
 
 void PktCaptureManager::stopCapture(StringPiece name) {
-  std::lock_guard<std::mutex> g(mutex_);
+  {
+    std::lock_guard<std::mutex> g(mutex_);
 
-  auto nameStr = name.str();
-  auto it = activeCaptures_.find(nameStr);
-  if (it == activeCaptures_.end()) {
-    throw FbossError("no active capture found with name \"", name, "\"");
+    auto nameStr = name.str();
+    auto it = activeCaptures_.find(nameStr);
+    if (it == activeCaptures_.end()) {
+      throw FbossError("no active capture found with name \"", name, "\"");
+    }
+    LOG(INFO) << "stopping packet capture \"" << name << "\"";
+    it->second->stop();
+    inactiveCaptures_[nameStr] = std::move(it->second);
+    activeCaptures_.erase(it);
+    publishLocked();
   }
-  LOG(INFO) << "stopping packet capture \"" << name << "\"";
-  it->second->stop();
-  inactiveCaptures_[nameStr] = std::move(it->second);
-  activeCaptures_.erase(it);
-  capturesRunning_.store(!activeCaptures_.empty(), std::memory_order_release);
+  releaseStaleCaches();
 }
 
-unique_ptr<PktCapture> PktCaptureManager::forgetCapture(StringPiece name) {
-  std::lock_guard<std::mutex> g(mutex_);
-  auto nameStr = name.str();
-  auto activeIt = activeCaptures_.find(nameStr);
-  if (activeIt != activeCaptures_.end()) {
-    LOG(INFO) << "stopping packet capture \"" << name << "\"";
-    std::unique_ptr<PktCapture> capture = std::move(activeIt->second);
-    activeCaptures_.erase(activeIt);
-    capturesRunning_.store(!activeCaptures_.empty(),
-                           std::memory_order_release);
-    capture->stop();
-    return capture;
+shared_ptr<PktCapture> PktCaptureManager::forgetCapture(StringPiece name) {
+  shared_ptr<PktCapture> capture;
+  {
+    std::lock_guard<std::mutex> g(mutex_);
+    auto nameStr = name.str();
+    auto activeIt = activeCaptures_.find(nameStr);
+    if (activeIt != activeCaptures_.end()) {
+      LOG(INFO) << "stopping packet capture \"" << name << "\"";
+      capture = std::move(activeIt->second);
+      activeCaptures_.erase(activeIt);
+      publishLocked();
+      capture->stop();
+    } else {
+      auto inactiveIt = inactiveCaptures_.find(nameStr);
+      if (inactiveIt == inactiveCaptures_.end()) {
+        throw FbossError("no capture found with name \"", name, "\"");
+      }
+      capture = std::move(inactiveIt->second);
+      inactiveCaptures_.erase(inactiveIt);
+    }
   }
+  releaseStaleCaches();
+  return capture;
+}
+
+void PktCaptureManager::stopAllCaptures() {
+  {
+    std::lock_guard<std::mutex> g(mutex_);
 
-  auto inactiveIt = inactiveCaptures_.find(nameStr);
-  if (inactiveIt != inactiveCaptures_.end()) {
-    std::unique_ptr<PktCapture> capture = std::move(inactiveIt->second);
-    inactiveCaptures_.erase(inactiveIt);
-    return capture;
+    for (auto& entry : activeCaptures_) {
+      LOG(INFO) << "stopping packet capture \"" << entry.first << "\"";
+      entry.second->stop();
+      inactiveCaptures_[entry.first] = std::move(entry.second);
+    }
+    activeCaptures_.clear();
+    publishLocked();
   }
+  releaseStaleCaches();
+}
+
+void PktCaptureManager::forgetAllCaptures() {
+  {
+    std::lock_guard<std::mutex> g(mutex_);
 
-  throw FbossError("no capture found with name \"", name, "\"");
+    for (auto& entry : activeCaptures_) {
+      LOG(INFO) << "stopping packet capture \"" << entry.first << "\"";
+      entry.second->stop();
+    }
+    activeCaptures_.clear();
+    inactiveCaptures_.clear();
+    publishLocked();
+  }
+  releaseStaleCaches();
 }
 
-void PktCaptureManager::stopAllCaptures() {
-  std::lock_guard<std::mutex> g(mutex_);
+void PktCaptureManager::publishLocked() {
+  auto captures = std::make_shared<CaptureList>();
+  captures->reserve(activeCaptures_.size());
+  for (const auto& entry : activeCaptures_) {
+    captures->push_back(entry.second);
+  }
+  captures_ = std::move(captures);
+  version_.fetch_add(1, std::memory_order_release);
+  capturesRunning_.store(!activeCaptures_.empty(), std::memory_order_release);
+}
 
-  // FIXME
+void PktCaptureManager::releaseStaleCaches() {
+  // The packet path takes its cache's lock before mutex_, so this can't be
+  // done with mutex_ held.
+  auto version = version_.load(std::memory_order_acquire);
+  std::vector<std::shared_ptr<const CaptureList>> stale;
+  for (auto& cached : cache_.accessAllThreads()) {
+    folly::SpinLockGuard guard(cached.lock);
+    if (cached.captures && cached.version != version) {
+      stale.push_back(std::move(cached.captures));
+      cached.version = 0;
+    }
+  }
+  // Anything only the caches were holding on to is destroyed here, without
+  // holding up the packet path.
 }
 
-void PktCaptureManager::forgetAllCaptures() {
-  std::lock_guard<std::mutex> g(mutex_);
+void PktCaptureManager::deactivateCapture(PktCapture* capture) {
+  {
+    std::lock_guard<std::mutex> g(mutex_);
 
-  // FIXME
+    // Several threads may see the capture finish at once, or it may have
+    // been stopped already, so it isn't necessarily still active.
+    auto it = activeCaptures_.find(capture->name());
+    if (it == activeCaptures_.end() || it->second.get() != capture) {
+      return;
+    }
+    LOG(INFO) << "auto-stopping packet capture \"" << capture->name()
+              << "\"";
+    inactiveCaptures_[capture->name()] = std::move(it->second);
+    activeCaptures_.erase(it);
+    publishLocked();
+  }
+  releaseStaleCaches();
 }
 
 template<typename Fn>
 void PktCaptureManager::invokeCaptures(const Fn& fn) {
-  std::lock_guard<std::mutex> g(mutex_);
-
-  for (auto it = activeCaptures_.begin();
-       it != activeCaptures_.end();
-       /* increment in loop */) {
-    // Increment the iterator now, in case this capture deactivates itself and
-    // we need to remove it from the active captures.
-    auto thisIt = it;
-    ++it;
-    PktCapture* capture = thisIt->second.get();
-    bool stillActive = false;
-    try {
-      stillActive = fn(capture);
-    } catch (const std::exception& ex) {
-      LOG(ERROR) << "error when processing packet for capture " <<
-        capture->name() << " : " << folly::exceptionStr(ex);
-      stillActive = false;
+  auto* cached = cache_.get();
+  CaptureList finished;
+  {
+    folly::SpinLockGuard guard(cached->lock);
+    if (cached->version != version_.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> g(mutex_);
+      cached->captures = captures_;
+      cached->version = version_.load(std::memory_order_relaxed);
     }
 
-    if (!stillActive) {
-      LOG(INFO) << "auto-stopping packet capture \"" <<
-        capture->name() << "\"";
+    for (const auto& capture : *cached->captures) {
+      bool stillActive = false;
       try {
-        inactiveCaptures_[capture->name()] = std::move(thisIt->second);
+        stillActive = fn(capture.get());
       } catch (const std::exception& ex) {
-        LOG(ERROR) << "error adding capture " << capture->name() <<
-          " to the inactive list";
-        // Can't do much else here.  Just continue and forget the capture.
+        LOG(ERROR) << "error when processing packet for capture " <<
+          capture->name() << " : " << folly::exceptionStr(ex);
+        stillActive = false;
+      }
+
+      if (!stillActive) {
+        finished.push_back(capture);
       }
-      activeCaptures_.erase(thisIt);
     }
   }
 
-  bool running = !activeCaptures_.empty();
-  capturesRunning_.store(running, std::memory_order_release);
+  // Deactivating a capture sweeps this thread's cache too, so it has to
+  // wait until the cache is unlocked.
+  for (const auto& capture : finished) {
+    deactivateCapture(capture.get());
+  }
 }
 
 void PktCaptureManager::packetReceivedImpl(const RxPacket* pkt) {
@@ -147,9 +217,9 @@ void PktCaptureManager::packetReceivedImpl(const RxPacket* pkt) {
   });
 }
 
-void PktCaptureManager::packetSentImpl(const TxPacket* pkt) {
+void PktCaptureManager::packetSentImpl(const TxPacket* pkt, PortID port) {
   invokeCaptures([&] (PktCapture* capture) {
-    return capture->packetSent(pkt);
+    return capture->packetSent(pkt, port);
   });
 }
 
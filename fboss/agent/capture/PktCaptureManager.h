@@ -9,13 +9,18 @@
  */
 #pragma once
 
+#include "fboss/agent/types.h"
+
 #include <folly/Range.h>
+#include <folly/SpinLock.h>
+#include <folly/ThreadLocal.h>
 
 #include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -37,7 +42,7 @@ class PktCaptureManager {
   void startCapture(std::unique_ptr<PktCapture> capture);
 
   void stopCapture(folly::StringPiece name);
-  std::unique_ptr<PktCapture> forgetCapture(folly::StringPiece name);
+  std::shared_ptr<PktCapture> forgetCapture(folly::StringPiece name);
 
   void stopAllCaptures();
   void forgetAllCaptures();
@@ -58,17 +63,19 @@ class PktCaptureManager {
 
   /*
    * packetSent() is called by the SwSwitch whenever a packet is transmitted.
+   * port is the port the packet is being sent out of, or PortID(0) if it is
+   * being switched.
    *
    * This method is safe to call from any thread.
    */
-  void packetSent(const TxPacket* pkt) {
+  void packetSent(const TxPacket* pkt, PortID port = PortID(0)) {
     // We expect that in the common case there will be no active captures
     // running.  Just do a fast check to handle that case.
     if (!capturesRunning_.load(std::memory_order_acquire)) {
       return;
     }
 
-    packetSentImpl(pkt);
+    packetSentImpl(pkt, port);
   }
 
   /*
@@ -98,18 +105,46 @@ class PktCaptureManager {
   PktCaptureManager(PktCaptureManager const &) = delete;
   PktCaptureManager& operator=(PktCaptureManager const &) = delete;
 
+  typedef std::vector<std::shared_ptr<PktCapture>> CaptureList;
+  struct CachedCaptures {
+    // Only ever contended by releaseStaleCaches()
+    folly::SpinLock lock;
+    uint64_t version{0};
+    std::shared_ptr<const CaptureList> captures;
+  };
+
   template<typename Fn>
   void invokeCaptures(const Fn& fn);
   void packetReceivedImpl(const RxPacket* pkt);
-  void packetSentImpl(const TxPacket* pkt);
+  void packetSentImpl(const TxPacket* pkt, PortID port);
   void packetSentToHostImpl(const RxPacket* pkt);
+  void deactivateCapture(PktCapture* capture);
+  void publishLocked();
+  // Must be called without mutex_ held, after publishLocked()
+  void releaseStaleCaches();
 
   std::atomic<bool> capturesRunning_{false};
 
   std::mutex mutex_;
   std::string captureDir_;
-  std::map<std::string, std::unique_ptr<PktCapture>> activeCaptures_;
-  std::map<std::string, std::unique_ptr<PktCapture>> inactiveCaptures_;
+  std::map<std::string, std::shared_ptr<PktCapture>> activeCaptures_;
+  std::map<std::string, std::shared_ptr<PktCapture>> inactiveCaptures_;
+
+  /*
+   * The active captures, as seen by the packet path.
+   *
+   * The packet path doesn't take mutex_.  Each thread keeps its own
+   * reference to the list of active captures, and only goes back to
+   * mutex_ for a new one after version_ has been bumped, the same way
+   * SwSwitch::getState() works.  A capture may therefore still be offered
+   * a few packets after it has been stopped, which it ignores.  Whenever a
+   * new list is published, the references threads hold to older ones are
+   * dropped, so that stopped captures and their buffers are freed even if
+   * no packets come along.
+   */
+  std::shared_ptr<const CaptureList> captures_;
+  std::atomic<uint64_t> version_{1};
+  folly::ThreadLocal<CachedCaptures, PktCaptureManager> cache_;
 };
 
 }} // facebook::fboss
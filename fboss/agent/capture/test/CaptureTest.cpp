@@ -9,6 +9,7 @@
  */
 #include "fboss/agent/gen-cpp/switch_config_types.h"
 #include "fboss/agent/ApplyThriftConfig.h"
+#include "fboss/agent/FbossError.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/capture/PktCapture.h"
 #include "fboss/agent/capture/PktCaptureManager.h"
@@ -255,3 +256,97 @@ TEST(CaptureTest, FullCapture) {
   //
   // EXPECT_BUF_EQ(updatedIpPktData, pcapPkts.at(4).data);
 }
+
+TEST(CaptureTest, FilteredCapture) {
+  auto sw = setupSwitch();
+  auto* mgr = sw->getCaptureMgr();
+
+  // Only ARP packets received on port 3, and only every other one of those
+  PktCapture::Options options;
+  options.maxPackets = 100;
+  options.filter = "arp";
+  options.ports.insert(PortID(3));
+  options.direction = PktCapture::RX;
+  options.sampleRate = 2;
+  mgr->startCapture(make_unique<PktCapture>("filtered", options));
+
+  auto arpPkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "ff ff ff ff ff ff  02 05 00 00 01 02"
+    // ARP, htype: ethernet, ptype: IPv4, hlen: 6, plen: 4
+    "08 06  00 01  08 00  06  04"
+    // ARP Request, sender MAC, sender IP: 10.0.0.10
+    "00 01  02 05 00 00 01 02  0a 00 00 0a"
+    // Target MAC, target IP: 10.0.0.1
+    "00 00 00 00 00 00  0a 00 00 01"
+  );
+  arpPkt->padToLength(68);
+  arpPkt->setSrcVlan(VlanID(1));
+  auto ipPkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "02 01 02 03 04 05  02 05 00 00 01 02"
+    // IPv4
+    "08 00"
+    // Version(4), IHL(5), DSCP(0), ECN(0), Total Length(20)
+    "45  00  00 14"
+    // Identification(0), Flags(0), Fragment offset(0)
+    "00 00  00 00"
+    // TTL(31), Protocol(6), Checksum (0, fake)
+    "1F  06  00 00"
+    // Source IP (10.0.0.10), Destination IP (10.0.0.1)
+    "0a 00 00 0a  0a 00 00 01"
+  );
+  ipPkt->padToLength(68);
+  ipPkt->setSrcVlan(VlanID(1));
+
+  for (int i = 0; i < 10; ++i) {
+    arpPkt->setSrcPort(PortID(3));
+    mgr->packetReceived(arpPkt.get());
+    // Wrong port
+    arpPkt->setSrcPort(PortID(4));
+    mgr->packetReceived(arpPkt.get());
+    // Doesn't match the filter
+    ipPkt->setSrcPort(PortID(3));
+    mgr->packetReceived(ipPkt.get());
+  }
+  mgr->stopCapture("filtered");
+
+  string pcapPath = folly::to<string>(mgr->getCaptureDir(), "/filtered.pcap");
+  auto pcapPkts = readPcapFile(pcapPath.c_str());
+  EXPECT_EQ(5, pcapPkts.size());
+  for (const auto& pkt : pcapPkts) {
+    EXPECT_BUF_EQ(*arpPkt->buf(), pkt.data);
+  }
+}
+
+TEST(CaptureTest, InvalidFilter) {
+  PktCapture::Options options;
+  options.maxPackets = 100;
+  options.filter = "not a valid filter (";
+  EXPECT_THROW(PktCapture("invalid", options), FbossError);
+}
+
+TEST(CaptureTest, ForgottenCaptureReleased) {
+  auto sw = setupSwitch();
+  auto* mgr = sw->getCaptureMgr();
+  mgr->startCapture(make_unique<PktCapture>("forgotten", 100));
+
+  // Make this thread cache the list of running captures
+  auto pkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "ff ff ff ff ff ff  02 05 00 00 01 02"
+    // ARP, htype: ethernet, ptype: IPv4, hlen: 6, plen: 4
+    "08 06  00 01  08 00  06  04"
+    // ARP Request, sender MAC, sender IP: 10.0.0.10
+    "00 01  02 05 00 00 01 02  0a 00 00 0a"
+    // Target MAC, target IP: 10.0.0.1
+    "00 00 00 00 00 00  0a 00 00 01"
+  );
+  pkt->padToLength(68);
+  mgr->packetReceived(pkt.get());
+
+  // Nothing else holds on to the capture, and its buffers, once it is
+  // forgotten, even though no more packets come along
+  auto capture = mgr->forgetCapture("forgotten");
+  EXPECT_EQ(1, capture.use_count());
+}
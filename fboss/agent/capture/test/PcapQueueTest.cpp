@@ -7,6 +7,7 @@
  *  of patent rights can be found in the PATENTS file in the same directory.
  *
  */
+#include "fboss/agent/capture/PcapArena.h"
 #include "fboss/agent/capture/PcapPkt.h"
 #include "fboss/agent/capture/PcapQueue.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
@@ -31,6 +32,21 @@ void pktWaitThread(PcapQueue* queue, std::vector<PcapPkt>* results) {
   }
 }
 
+std::unique_ptr<MockRxPacket> makePkt(uint32_t length) {
+  auto pkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "02 00 01 00 00 01  02 00 02 01 02 03"
+    // 802.1q, VLAN 1
+    "81 00 00 01"
+    // IPv4
+    "08 00"
+  );
+  pkt->padToLength(length);
+  pkt->setSrcPort(PortID(1));
+  pkt->setSrcVlan(VlanID(1));
+  return pkt;
+}
+
 TEST(PcapQueueTest, SimpleAdd) {
   PcapQueue queue(100);
   std::vector<PcapPkt> waitedPkts;
@@ -61,6 +77,8 @@ TEST(PcapQueueTest, SimpleAdd) {
   pkt->setSrcVlan(VlanID(1));
 
   queue.addPkt(pkt.get());
+  // The queue has its own copy of the data
+  EXPECT_FALSE(pkt->buf()->isShared());
   queue.finish();
   waiter.join();
 
@@ -72,3 +90,67 @@ TEST(PcapQueueTest, SimpleAdd) {
   ByteRange waitedPktData = waitedPktBufClone->coalesce();
   EXPECT_EQ(expectedPktData, waitedPktData);
 }
+
+TEST(PcapQueueTest, Snaplen) {
+  PcapQueue queue(100, 0, 64);
+  std::vector<PcapPkt> waitedPkts;
+  std::thread waiter([&]() { pktWaitThread(&queue, &waitedPkts); });
+
+  auto jumbo = makePkt(9000);
+  auto small = makePkt(60);
+  queue.addPkt(jumbo.get());
+  queue.addPkt(small.get());
+  queue.finish();
+  waiter.join();
+
+  ASSERT_EQ(2, waitedPkts.size());
+  EXPECT_EQ(64, waitedPkts[0].buf()->computeChainDataLength());
+  EXPECT_EQ(9000, waitedPkts[0].origLen());
+  EXPECT_EQ(60, waitedPkts[1].buf()->computeChainDataLength());
+  EXPECT_EQ(60, waitedPkts[1].origLen());
+}
+
+TEST(PcapQueueTest, Drops) {
+  // Room for 4 packets, with no reader running
+  PcapQueue queue(4);
+  auto pkt = makePkt(100);
+  for (int i = 0; i < 10; ++i) {
+    queue.addPkt(pkt.get());
+  }
+  EXPECT_EQ(6, queue.numDropped());
+  EXPECT_EQ(600, queue.bytesDropped());
+
+  std::vector<PcapPkt> pkts;
+  EXPECT_TRUE(queue.wait(&pkts));
+  EXPECT_EQ(4, pkts.size());
+  pkts.clear();
+
+  // Draining the queue makes room again
+  queue.addPkt(pkt.get());
+  EXPECT_EQ(6, queue.numDropped());
+  queue.finish();
+  EXPECT_TRUE(queue.wait(&pkts));
+  EXPECT_EQ(1, pkts.size());
+  EXPECT_FALSE(queue.wait(&pkts));
+}
+
+TEST(PcapQueueTest, ArenaFull) {
+  // Two 4KB slabs of packet data at most
+  PcapArena arena(8192, 4096);
+  auto pkt = makePkt(1500);
+  std::vector<folly::IOBuf> bufs(5);
+  EXPECT_TRUE(arena.copy(pkt->buf(), 1500, &bufs[0]));
+  EXPECT_TRUE(arena.copy(pkt->buf(), 1500, &bufs[1]));
+  EXPECT_TRUE(arena.copy(pkt->buf(), 1500, &bufs[2]));
+  EXPECT_TRUE(arena.copy(pkt->buf(), 1500, &bufs[3]));
+  EXPECT_FALSE(arena.copy(pkt->buf(), 1500, &bufs[4]));
+  EXPECT_EQ(8192, arena.bytesAllocated());
+  EXPECT_EQ(pkt->buf()->coalesce(), bufs[3].coalesce());
+
+  // Once everything in the first slab is released it gets reused
+  bufs[0] = folly::IOBuf();
+  bufs[1] = folly::IOBuf();
+  EXPECT_TRUE(arena.copy(pkt->buf(), 1500, &bufs[4]));
+  EXPECT_EQ(8192, arena.bytesAllocated());
+  bufs.clear();
+}
@@ -11,6 +11,7 @@
 #include "fboss/agent/capture/test/PcapUtil.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 
+#include <folly/Conv.h>
 #include <folly/Exception.h>
 #include <gtest/gtest.h>
 
@@ -101,3 +102,38 @@ TEST(PcapWriterTest, Drop) {
     EXPECT_EQ(68, pktInfo.hdr.caplen);
   }
 }
+
+TEST(PcapWriterTest, Rotate) {
+  char tmpPath[] = "fbossPcapTest.XXXXXX";
+  int tmpFD = mkstemp(tmpPath);
+  folly::checkUnixError(tmpFD, "failed to create temporary file");
+  close(tmpFD);
+
+  // Rotate after every batch of packets, keeping at most 3 old files
+  PcapWriter writer;
+  writer.setRotation(1, std::chrono::seconds(0), 3);
+  writer.start(tmpPath, true);
+  for (int n = 0; n < 10; ++n) {
+    addPackets(&writer, 10);
+    usleep(1000);
+  }
+  writer.finish();
+
+  // The current file always exists, along with up to 3 rotated ones, the
+  // newest of which must have some packets in it.
+  std::vector<std::string> paths{tmpPath};
+  for (int n = 1; n <= 10; ++n) {
+    auto path = folly::to<std::string>(tmpPath, ".", n);
+    if (access(path.c_str(), F_OK) == 0) {
+      paths.push_back(path);
+    }
+  }
+  SCOPE_EXIT {
+    for (const auto& path : paths) {
+      unlink(path.c_str());
+    }
+  };
+  EXPECT_GE(paths.size(), 2);
+  EXPECT_LE(paths.size(), 4);
+  EXPECT_FALSE(readPcapFile(paths.back().c_str()).empty());
+}
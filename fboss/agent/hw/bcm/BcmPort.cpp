@@ -39,6 +39,26 @@ using std::shared_ptr;
 
 namespace facebook { namespace fboss {
 
+// The stats readCounters() reads, indexed by HwPortCounter.  These are the
+// same stats updateStats() exports.
+static const opennsl_stat_val_t kHwPortCounterStats[] = {
+  opennsl_spl_snmpIfHCInOctets,
+  opennsl_spl_snmpIfHCInUcastPkts,
+  opennsl_spl_snmpIfHCInMulticastPkts,
+  opennsl_spl_snmpIfHCInBroadcastPkts,
+  opennsl_spl_snmpIfInDiscards,
+  opennsl_spl_snmpIfInErrors,
+  opennsl_spl_snmpIfHCOutOctets,
+  opennsl_spl_snmpIfHCOutUcastPkts,
+  opennsl_spl_snmpIfHCOutMulticastPkts,
+  opennsl_spl_snmpIfHCOutBroadcastPckts,
+  opennsl_spl_snmpIfOutDiscards,
+  opennsl_spl_snmpIfOutErrors,
+};
+static_assert(sizeof(kHwPortCounterStats) / sizeof(kHwPortCounterStats[0]) ==
+              static_cast<size_t>(HwPortCounter::NUM_COUNTERS),
+              "kHwPortCounterStats must cover every HwPortCounter");
+
 static const std::vector<opennsl_stat_val_t> kInPktLengthStats = {
   snmpOpenNSLReceivedPkts64Octets,
   snmpOpenNSLReceivedPkts65to127Octets,
@@ -423,6 +443,25 @@ void BcmPort::updateStats() {
   updatePktLenHist(now, &outPktLengths_, kOutPktLengthStats);
 };
 
+bool BcmPort::readCounters(const std::vector<HwPortCounter>& counters,
+                           uint64_t* values) {
+  // One SDK call for all of them.  Like updateStat(), this reads the values
+  // the SDK's counter thread has accumulated.
+  opennsl_stat_val_t stats[static_cast<size_t>(HwPortCounter::NUM_COUNTERS)];
+  CHECK_LE(counters.size(), sizeof(stats) / sizeof(stats[0]));
+  for (size_t idx = 0; idx < counters.size(); ++idx) {
+    stats[idx] = kHwPortCounterStats[static_cast<size_t>(counters[idx])];
+  }
+  auto ret = opennsl_stat_multi_get(unit_, port_, counters.size(), stats,
+                                    values);
+  if (OPENNSL_FAILURE(ret)) {
+    LOG(ERROR) << "Failed to read counters for port " << port_
+               << " :" << opennsl_errmsg(ret);
+    return false;
+  }
+  return true;
+}
+
 void BcmPort::updateStat(std::chrono::seconds now,
                          stats::MonotonicCounter* stat,
                          opennsl_stat_val_t type) {
@@ -17,6 +17,7 @@ extern "C" {
 
 #include "common/stats/MonotonicCounter.h"
 #include "common/stats/ExportedHistogram.h"
+#include "fboss/agent/HwSwitch.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/gen-cpp/switch_config_types.h"
 
@@ -97,6 +98,13 @@ class BcmPort {
    */
   void updateStats();
 
+  /*
+   * Read the current values of some of this port's counters, without
+   * updating the exported statistics.  Returns false on failure.
+   */
+  bool readCounters(const std::vector<HwPortCounter>& counters,
+                    uint64_t* values);
+
  private:
   class MonotonicCounter : public stats::MonotonicCounter {
    public:
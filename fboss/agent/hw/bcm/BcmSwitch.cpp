@@ -1017,18 +1017,26 @@ void BcmSwitch::linkscanCallback(int unit,
 
 void BcmSwitch::linkStateChangedHwNotLocked(opennsl_port_t bcmPortId,
     opennsl_port_info_t* info) {
+  auto start = std::chrono::steady_clock::now();
   portTable_->setPortStatus(bcmPortId, info->linkstatus);
   // TODO: We should eventually define a more robust hardware independent
   // LinkStatus enum, so we can expose more detailed information to to the
   // callback about why the link is down.
   bool up = info->linkstatus == OPENNSL_PORT_LINK_STATUS_UP;
+  auto portId = portTable_->getPortId(bcmPortId);
   if (!up) {
     // For port up events we wait till ARP/NDP entries
     // are re resolved after port up before adding them
     // back. Adding them earlier leads to packet loss.
+    //
+    // On port down, shrink the ECMP groups right here in the linkscan
+    // context, before the SwSwitch gets to recompute neighbors and routes.
     hostTable_->linkDownHwNotLocked(bcmPortId);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    callback_->linkDownEcmpPruned(portId, elapsed);
   }
-  callback_->linkStateChanged(portTable_->getPortId(bcmPortId), up);
+  callback_->linkStateChanged(portId, up);
 }
 
 opennsl_rx_t BcmSwitch::packetRxCallback(int unit, opennsl_pkt_t* pkt,
@@ -1098,6 +1106,17 @@ void BcmSwitch::updateGlobalStats() {
   portTable_->updatePortStats();
 }
 
+bool BcmSwitch::readPortCounters(PortID port,
+                                 const std::vector<HwPortCounter>& counters,
+                                 uint64_t* values) {
+  // The port table is fixed once initPorts() is done, so this needs no lock
+  auto bcmPort = portTable_->getBcmPortIf(port);
+  if (!bcmPort) {
+    return false;
+  }
+  return bcmPort->readCounters(counters, values);
+}
+
 opennsl_if_t BcmSwitch::getDropEgressId() const {
   return BcmEgress::getDropEgressId();
 }
@@ -200,6 +200,14 @@ class BcmSwitch : public HwSwitch {
       const folly::StringPiece namespaceString,
       const std::set<folly::StringPiece>& counterSet) override;
 
+  /*
+   * Read port counters from the SDK, for the high-resolution port counter
+   * sampler.
+   */
+  bool readPortCounters(PortID port,
+                        const std::vector<HwPortCounter>& counters,
+                        uint64_t* values) override;
+
   void fetchL2Table(std::vector<L2EntryThrift> *l2Table) override;
 
   BcmHostTable* writableHostTable() const { return hostTable_.get(); }
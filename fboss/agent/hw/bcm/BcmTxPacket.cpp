@@ -9,13 +9,20 @@
  */
 #include "fboss/agent/hw/bcm/BcmTxPacket.h"
 
+#include "fboss/agent/TxBufferPool.h"
 #include "fboss/agent/hw/bcm/BcmError.h"
 #include "fboss/agent/hw/bcm/BcmStats.h"
 
+#include <gflags/gflags.h>
+
 extern "C" {
 #include <opennsl/tx.h>
 }
 
+DEFINE_int32(tx_pkt_pool_watermark, 256,
+             "Maximum number of free TX packets to keep around for reuse, "
+             "per size class. 0 disables the TX packet pool.");
+
 using folly::IOBuf;
 using std::unique_ptr;
 
@@ -23,11 +30,72 @@ namespace {
 
 using namespace facebook::fboss;
 
+/*
+ * Allocates DMA-able packets from the SDK for the TX packet pool.
+ */
+class BcmTxPktAllocator {
+ public:
+  typedef opennsl_pkt_t* Buffer;
+
+  explicit BcmTxPktAllocator(int unit) : unit_(unit) {}
+
+  int getUnit() const {
+    return unit_;
+  }
+
+  opennsl_pkt_t* allocate(uint32_t size) {
+    opennsl_pkt_t* pkt{nullptr};
+    int rv = opennsl_pkt_alloc(unit_, size,
+                               OPENNSL_TX_CRC_APPEND | OPENNSL_TX_ETHER, &pkt);
+    if (OPENNSL_FAILURE(rv)) {
+      bcmLogError(rv, "Failed to allocate packet.");
+      BcmStats::get()->txPktAllocErrors();
+    } else {
+      BcmStats::get()->txPktAlloc();
+    }
+    return pkt;
+  }
+
+  void free(opennsl_pkt_t* pkt) {
+    int rv = opennsl_pkt_free(pkt->unit, pkt);
+    bcmLogError(rv, "Failed to free packet");
+    BcmStats::get()->txPktFree();
+  }
+
+ private:
+  int unit_;
+};
+
+typedef TxBufferPool<BcmTxPktAllocator> BcmTxPktPool;
+
+// Size classes of the pool. Most of what we send (ARP, NDP, LLDP, DHCP)
+// fits in the smaller two; the last one covers a full-sized frame.
+const std::vector<uint32_t> kPoolSizeClasses = {128, 512, 2048};
+
+BcmTxPktPool* getPool(int unit) {
+  // Never destroyed, since packets may still be returned to it by the SDK's
+  // TX thread during shutdown.
+  static BcmTxPktPool* pool = new BcmTxPktPool(
+      BcmTxPktAllocator(unit), kPoolSizeClasses,
+      std::max(FLAGS_tx_pkt_pool_watermark, 0));
+  return pool;
+}
+
 void freeTxBuf(void *ptr, void* arg) {
   opennsl_pkt_t* pkt = reinterpret_cast<opennsl_pkt_t*>(arg);
-  int rv = opennsl_pkt_free(pkt->unit, pkt);
-  bcmLogError(rv, "Failed to free packet");
-  BcmStats::get()->txPktFree();
+  // pkt_data->len holds the capacity the packet was allocated with; see
+  // resetPktData().
+  getPool(pkt->unit)->put(pkt, pkt->pkt_data->len);
+}
+
+/*
+ * Point the packet data back at the whole buffer we allocated, undoing
+ * what sendAsync() did, so that the packet can be reused.
+ */
+void resetPktData(BcmTxPacket* bcmTxPkt) {
+  auto pkt = bcmTxPkt->getPkt();
+  pkt->pkt_data->data = bcmTxPkt->buf()->writableBuffer();
+  pkt->pkt_data->len = bcmTxPkt->buf()->capacity();
 }
 
 void txCallback(int unit, opennsl_pkt_t* pkt, void* cookie) {
@@ -38,7 +106,7 @@ void txCallback(int unit, opennsl_pkt_t* pkt, void* cookie) {
   DCHECK_EQ(pkt, bcmTxPkt->getPkt());
 
   // Now we reset the pkt buffer back to what was originally allocated
-  pkt->pkt_data->data = bcmTxPkt->buf()->writableBuffer();
+  resetPktData(bcmTxPkt.get());
 
   auto end = std::chrono::steady_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
@@ -52,12 +120,17 @@ namespace facebook { namespace fboss {
 
 BcmTxPacket::BcmTxPacket(int unit, uint32_t size)
     : queued_(std::chrono::time_point<std::chrono::steady_clock>::min()) {
-  int rv = opennsl_pkt_alloc(unit, size,
-                             OPENNSL_TX_CRC_APPEND | OPENNSL_TX_ETHER, &pkt_);
-  bcmLogError(rv, "Failed to allocate packet.");
-  buf_ = IOBuf::takeOwnership(pkt_->pkt_data->data, size,
+  auto pool = getPool(unit);
+  DCHECK_EQ(unit, pool->getAllocator().getUnit());
+  uint32_t capacity;
+  pkt_ = pool->get(size, &capacity);
+  // A reused packet may have been sent out of a port before
+  pkt_->flags = OPENNSL_TX_CRC_APPEND | OPENNSL_TX_ETHER;
+  OPENNSL_PBMP_CLEAR(pkt_->tx_pbmp);
+  OPENNSL_PBMP_CLEAR(pkt_->tx_upbmp);
+  pkt_->call_back = nullptr;
+  buf_ = IOBuf::takeOwnership(pkt_->pkt_data->data, capacity, size,
                               freeTxBuf, reinterpret_cast<void*>(pkt_));
-  BcmStats::get()->txPktAlloc();
 }
 
 void BcmTxPacket::enableHiGigHeader() {
@@ -88,6 +161,7 @@ int BcmTxPacket::sendAsync(unique_ptr<BcmTxPacket> pkt) noexcept {
     pkt.release();
     BcmStats::get()->txSent();
   } else {
+    resetPktData(pkt.get());
     bcmLogError(rv, "failed to send packet");
     if (rv == OPENNSL_E_MEMORY) {
       BcmStats::get()->txPktAllocErrors();
@@ -47,6 +47,12 @@ class MockHwSwitch : public HwSwitch {
     return 0;
   }
 
+  bool readPortCounters(PortID port,
+                        const std::vector<HwPortCounter>& counters,
+                        uint64_t* values) override {
+    return false;
+  }
+
   void fetchL2Table(std::vector<L2EntryThrift> *l2Table) override {
     return;
   }
@@ -9,10 +9,48 @@
  */
 #include "fboss/agent/hw/mock/MockTxPacket.h"
 
+#include "fboss/agent/TxBufferPool.h"
+
 #include <folly/io/IOBuf.h>
 
 using folly::IOBuf;
 
+namespace {
+
+using namespace facebook::fboss;
+
+class HeapAllocator {
+ public:
+  typedef uint8_t* Buffer;
+
+  uint8_t* allocate(uint32_t size) {
+    return new uint8_t[size];
+  }
+  void free(uint8_t* buf) {
+    delete[] buf;
+  }
+};
+
+typedef TxBufferPool<HeapAllocator> HeapBufferPool;
+
+// Same size classes and default watermark as the BcmTxPacket pool
+const std::vector<uint32_t> kPoolSizeClasses = {128, 512, 2048};
+const uint32_t kPoolWatermark = 256;
+
+HeapBufferPool* getPool() {
+  static HeapBufferPool* pool = new HeapBufferPool(
+      HeapAllocator(), kPoolSizeClasses, kPoolWatermark);
+  return pool;
+}
+
+void freePoolBuf(void* ptr, void* arg) {
+  // The capacity is passed through the user data pointer
+  getPool()->put(static_cast<uint8_t*>(ptr),
+                 static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg)));
+}
+
+}
+
 namespace facebook { namespace fboss {
 
 MockTxPacket::MockTxPacket(uint32_t size) {
@@ -20,4 +58,22 @@ MockTxPacket::MockTxPacket(uint32_t size) {
   buf_->append(size);
 }
 
+std::unique_ptr<MockTxPacket> MockTxPacket::fromPool(uint32_t size) {
+  uint32_t capacity;
+  auto data = getPool()->get(size, &capacity);
+  std::unique_ptr<MockTxPacket> pkt(new MockTxPacket());
+  pkt->buf_ = IOBuf::takeOwnership(
+      data, capacity, size, freePoolBuf,
+      reinterpret_cast<void*>(static_cast<uintptr_t>(capacity)));
+  return pkt;
+}
+
+uint64_t MockTxPacket::getPoolAllocCount() {
+  return getPool()->getAllocCount();
+}
+
+uint64_t MockTxPacket::getPoolFreeCount() {
+  return getPool()->getFreeCount();
+}
+
 }} // facebook::fboss
@@ -17,10 +17,24 @@ class MockTxPacket : public TxPacket {
  public:
   explicit MockTxPacket(uint32_t size);
 
+  /*
+   * Create a packet whose buffer comes from a pool of heap buffers,
+   * similar to how BcmTxPacket reuses its packets.
+   */
+  static std::unique_ptr<MockTxPacket> fromPool(uint32_t size);
+
+  /*
+   * The number of buffers the pool has allocated and freed so far.
+   */
+  static uint64_t getPoolAllocCount();
+  static uint64_t getPoolFreeCount();
+
  private:
   // Forbidden copy constructor and assignment operator
   MockTxPacket(MockTxPacket const &) = delete;
   MockTxPacket& operator=(MockTxPacket const &) = delete;
+
+  MockTxPacket() {}
 };
 
 }} // facebook::fboss
@@ -0,0 +1,522 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/sim/SimForwarding.h"
+
+#include "fboss/agent/AclClassifier.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/PktUtil.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteDelta.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/state/VlanMapDelta.h"
+
+#include <folly/Hash.h>
+#include <folly/Memory.h>
+#include <folly/io/Cursor.h>
+
+#include <stdexcept>
+
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using folly::io::Cursor;
+using folly::io::RWPrivateCursor;
+using std::shared_ptr;
+
+using facebook::fboss::DeltaFunctions::forEachAdded;
+using facebook::fboss::DeltaFunctions::forEachChanged;
+using facebook::fboss::DeltaFunctions::forEachRemoved;
+
+namespace facebook { namespace fboss {
+
+SimForwarding::SimForwarding() {}
+
+SimForwarding::~SimForwarding() {}
+
+void SimForwarding::stateChanged(const StateDelta& delta) {
+  // Same order as BcmSwitch: routes go away before the interfaces and
+  // neighbors they point at, and are added once those exist.
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    if (!rtDelta.getOld()) {
+      continue;
+    }
+    RouterID vrf = rtDelta.getOld()->getID();
+    forEachRemoved(rtDelta.getRoutesV4Delta(),
+                   &SimForwarding::processRemovedRoute<IPAddressV4>,
+                   this, vrf);
+    forEachRemoved(rtDelta.getRoutesV6Delta(),
+                   &SimForwarding::processRemovedRoute<IPAddressV6>,
+                   this, vrf);
+  }
+
+  forEachRemoved(delta.getIntfsDelta(),
+                 &SimForwarding::processRemovedIntf, this);
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    if (vlanDelta.getNew()) {
+      processVlan(vlanDelta.getNew());
+    }
+  }
+  forEachChanged(delta.getIntfsDelta(),
+                 &SimForwarding::processChangedIntf, this);
+  forEachAdded(delta.getIntfsDelta(),
+               &SimForwarding::processAddedIntf, this);
+
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    for (const auto& arpDelta : vlanDelta.getArpDelta()) {
+      processNeighbor(arpDelta.getOld().get(), arpDelta.getNew().get());
+    }
+    for (const auto& ndpDelta : vlanDelta.getNdpDelta()) {
+      processNeighbor(ndpDelta.getOld().get(), ndpDelta.getNew().get());
+    }
+  }
+
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    if (!rtDelta.getNew()) {
+      continue;
+    }
+    RouterID vrf = rtDelta.getNew()->getID();
+    forEachChanged(rtDelta.getRoutesV4Delta(),
+                   &SimForwarding::processChangedRoute<IPAddressV4>,
+                   &SimForwarding::processAddedRoute<IPAddressV4>,
+                   [&](SimForwarding*, RouterID,
+                       const shared_ptr<RouteV4>&) {},
+                   this, vrf);
+    forEachChanged(rtDelta.getRoutesV6Delta(),
+                   &SimForwarding::processChangedRoute<IPAddressV6>,
+                   &SimForwarding::processAddedRoute<IPAddressV6>,
+                   [&](SimForwarding*, RouterID,
+                       const shared_ptr<RouteV6>&) {},
+                   this, vrf);
+  }
+
+  // VLANs go last, so packets already in them are switched until the
+  // rest of the state no longer refers to them.
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    if (vlanDelta.getNew()) {
+      continue;
+    }
+    auto id = vlanDelta.getOld()->getID();
+    vlanPorts_.erase(id);
+    for (auto it = macTable_.begin(); it != macTable_.end();) {
+      if ((it->first >> 48) == static_cast<uint16_t>(id)) {
+        it = macTable_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  if (delta.oldState()->getAcls() != delta.newState()->getAcls()) {
+    acls_ = folly::make_unique<AclClassifier>(delta.newState()->getAcls());
+  }
+}
+
+void SimForwarding::processVlan(const shared_ptr<Vlan>& vlan) {
+  PortSet ports;
+  for (const auto& port : vlan->getPorts()) {
+    ports.insert(port.first);
+  }
+  vlanPorts_[vlan->getID()].swap(ports);
+}
+
+void SimForwarding::processAddedIntf(const shared_ptr<Interface>& intf) {
+  Intf entry;
+  entry.vrf = intf->getRouterID();
+  entry.vlan = intf->getVlanID();
+  entry.mac = intf->getMac();
+  intfs_[intf->getID()] = entry;
+  vlanIntfs_[entry.vlan] = intf->getID();
+  for (const auto& addr : intf->getAddresses()) {
+    localAddrs_.insert(std::make_pair(entry.vrf, addr.first));
+  }
+}
+
+void SimForwarding::processRemovedIntf(const shared_ptr<Interface>& intf) {
+  auto vrf = intf->getRouterID();
+  intfs_.erase(intf->getID());
+  auto vlanIntf = vlanIntfs_.find(intf->getVlanID());
+  if (vlanIntf != vlanIntfs_.end() && vlanIntf->second == intf->getID()) {
+    vlanIntfs_.erase(vlanIntf);
+  }
+  for (const auto& addr : intf->getAddresses()) {
+    localAddrs_.erase(std::make_pair(vrf, addr.first));
+  }
+  // Neighbors can't be reached through an interface that is gone
+  auto hosts = hosts_.find(vrf);
+  if (hosts == hosts_.end()) {
+    return;
+  }
+  for (auto it = hosts->second.begin(); it != hosts->second.end();) {
+    if (it->second.intf == intf->getID()) {
+      it = hosts->second.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void SimForwarding::processChangedIntf(const shared_ptr<Interface>& oldIntf,
+                                       const shared_ptr<Interface>& newIntf) {
+  // Keep the neighbors if only the addresses or MAC changed
+  if (oldIntf->getRouterID() == newIntf->getRouterID()) {
+    for (const auto& addr : oldIntf->getAddresses()) {
+      localAddrs_.erase(std::make_pair(oldIntf->getRouterID(), addr.first));
+    }
+    vlanIntfs_.erase(oldIntf->getVlanID());
+  } else {
+    processRemovedIntf(oldIntf);
+  }
+  processAddedIntf(newIntf);
+}
+
+template<typename NeighborEntryT>
+void SimForwarding::processNeighbor(const NeighborEntryT* oldEntry,
+                                    const NeighborEntryT* newEntry) {
+  if (oldEntry) {
+    auto intf = intfs_.find(oldEntry->getIntfID());
+    if (intf != intfs_.end()) {
+      hosts_[intf->second.vrf].erase(IPAddress(oldEntry->getIP()));
+    }
+  }
+  // Pending entries are programmed to drop in hardware.  Here they are
+  // simply left out, so traffic to them is punted as unresolved.
+  if (!newEntry || newEntry->isPending()) {
+    return;
+  }
+  auto intf = intfs_.find(newEntry->getIntfID());
+  if (intf == intfs_.end()) {
+    VLOG(2) << "ignoring neighbor " << newEntry->getIP()
+            << " on unknown interface " << newEntry->getIntfID();
+    return;
+  }
+  Host host;
+  host.port = newEntry->getPort();
+  host.intf = newEntry->getIntfID();
+  host.mac = newEntry->getMac();
+  hosts_[intf->second.vrf][IPAddress(newEntry->getIP())] = host;
+  macTable_[macKey(intf->second.vlan, host.mac)] = host.port;
+}
+
+template<typename AddrT>
+void SimForwarding::processAddedRoute(RouterID vrf,
+                                      const shared_ptr<Route<AddrT>>& route) {
+  // Like BcmSwitch, unresolved routes are not programmed
+  if (!route->isResolved()) {
+    return;
+  }
+  const auto& fwd = route->getForwardInfo();
+  FibEntry entry;
+  entry.action = fwd.getAction();
+  entry.connected = route->isConnected();
+  entry.nexthops = fwd.getNexthops();
+  const auto& prefix = route->prefix();
+  auto& tree = fibs_[vrf].get(prefix.network);
+  auto ret = tree.insert(prefix.network, prefix.mask, entry);
+  if (!ret.second) {
+    ret.first->value() = std::move(entry);
+  }
+}
+
+template<typename AddrT>
+void SimForwarding::processRemovedRoute(
+    RouterID vrf, const shared_ptr<Route<AddrT>>& route) {
+  auto fib = fibs_.find(vrf);
+  if (fib == fibs_.end()) {
+    return;
+  }
+  const auto& prefix = route->prefix();
+  fib->second.get(prefix.network).erase(prefix.network, prefix.mask);
+}
+
+template<typename AddrT>
+void SimForwarding::processChangedRoute(
+    RouterID vrf,
+    const shared_ptr<Route<AddrT>>& oldRoute,
+    const shared_ptr<Route<AddrT>>& newRoute) {
+  if (newRoute->isResolved()) {
+    processAddedRoute(vrf, newRoute);
+  } else {
+    processRemovedRoute(vrf, oldRoute);
+  }
+}
+
+void SimForwarding::flushPort(PortID port) {
+  for (auto it = macTable_.begin(); it != macTable_.end();) {
+    if (it->second == port) {
+      it = macTable_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t SimForwarding::getRouteCount() const {
+  size_t count = 0;
+  for (const auto& fib : fibs_) {
+    count += fib.second.v4.size() + fib.second.v6.size();
+  }
+  return count;
+}
+
+size_t SimForwarding::getHostCount() const {
+  size_t count = 0;
+  for (const auto& hosts : hosts_) {
+    count += hosts.second.size();
+  }
+  return count;
+}
+
+SimForwarding::Decision SimForwarding::forward(RxPacket* pkt,
+                                               const PortSet& downPorts) {
+  Decision decision;
+  try {
+    Cursor cursor(pkt->buf());
+    auto dstMac = PktUtil::readMac(&cursor);
+    auto srcMac = PktUtil::readMac(&cursor);
+    uint16_t etherType = cursor.readBE<uint16_t>();
+    size_t l3Offset = 14;
+    VlanID vlan = pkt->getSrcVlan();
+    if (etherType == ETHERTYPE_VLAN) {
+      vlan = VlanID(cursor.readBE<uint16_t>() & 0xfff);
+      etherType = cursor.readBE<uint16_t>();
+      l3Offset = 18;
+    }
+    decision.vlan = vlan;
+
+    // Ingress filtering
+    auto srcPort = pkt->getSrcPort();
+    auto ports = vlanPorts_.find(vlan);
+    if (ports == vlanPorts_.end() ||
+        ports->second.find(srcPort) == ports->second.end()) {
+      return decision;
+    }
+
+    if (!srcMac.isMulticast()) {
+      macTable_[macKey(vlan, srcMac)] = srcPort;
+    }
+
+    // Ingress ACLs apply to switched and routed traffic alike
+    if (acls_ && !acls_->empty()) {
+      Cursor l3(pkt->buf());
+      l3.skip(l3Offset);
+      AclClassifier::Fields fields;
+      if (AclClassifier::parsePacket(l3, etherType, &fields) &&
+          acls_->getAction(fields) == cfg::AclAction::DENY) {
+        return decision;
+      }
+    }
+
+    auto vlanIntf = vlanIntfs_.find(vlan);
+    if (vlanIntf != vlanIntfs_.end()) {
+      const auto& ingress = intfs_.at(vlanIntf->second);
+      if (dstMac == ingress.mac) {
+        if (etherType == ETHERTYPE_IPV4 || etherType == ETHERTYPE_IPV6) {
+          return route(pkt, l3Offset, etherType, ingress, downPorts);
+        }
+        decision.action = PUNT;
+        return decision;
+      }
+    }
+
+    // Broadcasts are multicasts too
+    if (dstMac.isMulticast()) {
+      decision.action = FLOOD;
+      decision.copyToCpu = true;
+      return decision;
+    }
+    auto entry = macTable_.find(macKey(vlan, dstMac));
+    if (entry == macTable_.end()) {
+      decision.action = FLOOD;
+      return decision;
+    }
+    if (entry->second == srcPort ||
+        downPorts.find(entry->second) != downPorts.end()) {
+      return decision;
+    }
+    decision.action = SWITCH;
+    decision.port = entry->second;
+    return decision;
+  } catch (const std::out_of_range&) {
+    VLOG(4) << "dropping truncated packet from port " << pkt->getSrcPort();
+    return Decision();
+  }
+}
+
+SimForwarding::Decision SimForwarding::route(RxPacket* pkt,
+                                             size_t l3Offset,
+                                             uint16_t etherType,
+                                             const Intf& ingress,
+                                             const PortSet& downPorts) {
+  Decision decision;
+  decision.vlan = ingress.vlan;
+  Flow flow;
+  if (!parseFlow(pkt, l3Offset, etherType, &flow)) {
+    return decision;
+  }
+
+  // Traffic for us, and traffic the CPU has to answer with an ICMP error
+  decision.action = PUNT;
+  if (flow.dst.isMulticast() ||
+      localAddrs_.find(std::make_pair(ingress.vrf, flow.dst)) !=
+        localAddrs_.end() ||
+      flow.ttl <= 1) {
+    return decision;
+  }
+
+  const Host* host = lookupHost(ingress.vrf, flow.dst);
+  if (!host) {
+    auto entry = lookupRoute(ingress.vrf, flow.dst);
+    if (!entry || entry->action == RouteForwardAction::DROP) {
+      decision.action = DROP;
+      return decision;
+    }
+    // An interface route without a host entry needs the neighbor resolved
+    if (entry->action == RouteForwardAction::TO_CPU || entry->connected) {
+      return decision;
+    }
+    std::vector<const Host*> members;
+    members.reserve(entry->nexthops.size());
+    for (const auto& nhop : entry->nexthops) {
+      auto member = lookupHost(ingress.vrf, nhop.nexthop);
+      if (member && downPorts.find(member->port) == downPorts.end()) {
+        members.push_back(member);
+      }
+    }
+    if (members.empty()) {
+      return decision;
+    }
+    size_t index = 0;
+    if (members.size() > 1) {
+      index = folly::hash::hash_combine(flow.src, flow.dst, flow.proto,
+                                        flow.srcPort, flow.dstPort) %
+        members.size();
+    }
+    host = members[index];
+  }
+
+  auto egress = intfs_.find(host->intf);
+  if (egress == intfs_.end() ||
+      downPorts.find(host->port) != downPorts.end()) {
+    decision.action = DROP;
+    return decision;
+  }
+  rewrite(pkt, l3Offset, flow, *host, egress->second);
+  decision.action = ROUTE;
+  decision.port = host->port;
+  decision.vlan = egress->second.vlan;
+  return decision;
+}
+
+bool SimForwarding::parseFlow(RxPacket* pkt, size_t l3Offset,
+                              uint16_t etherType, Flow* flow) {
+  Cursor cursor(pkt->buf());
+  cursor.skip(l3Offset);
+  if (etherType == ETHERTYPE_IPV4) {
+    uint8_t versionAndIhl = cursor.read<uint8_t>();
+    uint8_t ihl = versionAndIhl & 0xf;
+    if ((versionAndIhl >> 4) != 4 || ihl < 5) {
+      return false;
+    }
+    cursor.skip(7);
+    flow->ttl = cursor.read<uint8_t>();
+    flow->proto = cursor.read<uint8_t>();
+    cursor.skip(2);
+    flow->src = PktUtil::readIPv4(&cursor);
+    flow->dst = PktUtil::readIPv4(&cursor);
+    cursor.skip((ihl - 5) * 4);
+  } else {
+    if ((cursor.read<uint8_t>() >> 4) != 6) {
+      return false;
+    }
+    cursor.skip(5);
+    flow->proto = cursor.read<uint8_t>();
+    flow->ttl = cursor.read<uint8_t>();
+    flow->src = PktUtil::readIPv6(&cursor);
+    flow->dst = PktUtil::readIPv6(&cursor);
+  }
+  if (flow->proto == IP_PROTO_TCP || flow->proto == IP_PROTO_UDP) {
+    flow->srcPort = cursor.readBE<uint16_t>();
+    flow->dstPort = cursor.readBE<uint16_t>();
+  }
+  return true;
+}
+
+const SimForwarding::FibEntry* SimForwarding::lookupRoute(
+    RouterID vrf, const IPAddress& dst) const {
+  auto fib = fibs_.find(vrf);
+  if (fib == fibs_.end()) {
+    return nullptr;
+  }
+  if (dst.isV4()) {
+    auto it = fib->second.v4.longestMatch(dst.asV4(), IPAddressV4::bitCount());
+    return it.atEnd() ? nullptr : &it->value();
+  }
+  auto it = fib->second.v6.longestMatch(dst.asV6(), IPAddressV6::bitCount());
+  return it.atEnd() ? nullptr : &it->value();
+}
+
+const SimForwarding::Host* SimForwarding::lookupHost(
+    RouterID vrf, const IPAddress& ip) const {
+  auto hosts = hosts_.find(vrf);
+  if (hosts == hosts_.end()) {
+    return nullptr;
+  }
+  auto host = hosts->second.find(ip);
+  return host == hosts->second.end() ? nullptr : &host->second;
+}
+
+void SimForwarding::rewrite(RxPacket* pkt, size_t l3Offset, const Flow& flow,
+                            const Host& host, const Intf& egress) {
+  // Received buffers may be shared with clones made by the caller
+  pkt->buf()->unshare();
+  RWPrivateCursor cursor(pkt->buf());
+  cursor.push(host.mac.bytes(), MacAddress::SIZE);
+  cursor.push(egress.mac.bytes(), MacAddress::SIZE);
+  if (l3Offset > 14) {
+    cursor.skip(2);
+    RWPrivateCursor tagCursor(cursor);
+    uint16_t tci = cursor.readBE<uint16_t>();
+    tagCursor.writeBE<uint16_t>((tci & 0xf000) |
+                                static_cast<uint16_t>(egress.vlan));
+  }
+  cursor.skip(2);
+
+  uint8_t ttl = flow.ttl - 1;
+  if (flow.dst.isV6()) {
+    cursor.skip(7);
+    cursor.write<uint8_t>(ttl);
+    return;
+  }
+  // Fix up the header checksum for the new TTL, without going over the
+  // rest of the header again.
+  cursor.skip(8);
+  cursor.write<uint8_t>(ttl);
+  cursor.skip(1);
+  RWPrivateCursor csumCursor(cursor);
+  uint16_t csum = cursor.readBE<uint16_t>();
+  csumCursor.writeBE<uint16_t>(PktUtil::updateChecksum(
+      csum, (uint32_t(flow.ttl) << 8) | flow.proto,
+      (uint32_t(ttl) << 8) | flow.proto));
+}
+
+}} // facebook::fboss
@@ -0,0 +1,191 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/state/RouteForwardInfo.h"
+#include "fboss/agent/types.h"
+#include "fboss/lib/RadixTree.h"
+
+#include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
+#include <folly/IPAddress.h>
+#include <folly/MacAddress.h>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace facebook { namespace fboss {
+
+class AclClassifier;
+class Interface;
+class RxPacket;
+class StateDelta;
+class Vlan;
+template<typename AddrT> class Route;
+
+/*
+ * SimForwarding is the dataplane of the SimSwitch: an L2 MAC table, an LPM
+ * FIB per VRF, and a host table used to resolve nexthops, all programmed
+ * incrementally from the StateDeltas the switch is given.
+ *
+ * forward() runs a received packet through them the way the ASIC would.
+ * Packets for the router MAC are routed: the TTL is decremented, the
+ * Ethernet header rewritten, and one nexthop of an ECMP route picked by a
+ * hash of the flow.  Anything else is switched on the destination MAC,
+ * and flooded if it is not known.  The source MAC of every packet is
+ * learned, so that replies are switched rather than flooded.  IP packets
+ * the ACLs deny are dropped before any of that.
+ *
+ * This class does no locking of its own; SimSwitch serializes access to it.
+ */
+class SimForwarding {
+ public:
+  typedef boost::container::flat_set<PortID> PortSet;
+
+  enum Action {
+    DROP,    // Dropped in the pipeline
+    PUNT,    // Sent to the CPU only
+    SWITCH,  // Switched out of a single port
+    FLOOD,   // Flooded to the VLAN
+    ROUTE,   // Routed out of a single port
+    NUM_ACTIONS
+  };
+
+  struct Decision {
+    Action action{DROP};
+    // The egress port for SWITCH and ROUTE
+    PortID port{0};
+    // The egress VLAN
+    VlanID vlan{0};
+    // Whether a copy goes to the CPU as well, as for broadcasts
+    bool copyToCpu{false};
+  };
+
+  SimForwarding();
+  ~SimForwarding();
+
+  /*
+   * Bring the tables up to date with delta.newState().
+   */
+  void stateChanged(const StateDelta& delta);
+
+  /*
+   * Decide what to do with pkt, which arrived on pkt->getSrcPort().
+   *
+   * Routed packets are rewritten in place.  Ports in downPorts are never
+   * picked as the egress port.
+   */
+  Decision forward(RxPacket* pkt, const PortSet& downPorts);
+
+  /*
+   * Flush the MAC addresses learned on port, as the hardware does when a
+   * link goes down.
+   */
+  void flushPort(PortID port);
+
+  size_t getMacTableSize() const {
+    return macTable_.size();
+  }
+  size_t getRouteCount() const;
+  size_t getHostCount() const;
+
+ private:
+  struct Intf {
+    RouterID vrf{0};
+    VlanID vlan{0};
+    folly::MacAddress mac;
+  };
+  struct Host {
+    PortID port{0};
+    InterfaceID intf{0};
+    folly::MacAddress mac;
+  };
+  struct FibEntry {
+    RouteForwardAction action{RouteForwardAction::DROP};
+    bool connected{false};
+    RouteForwardNexthops nexthops;
+  };
+  struct Fib {
+    RadixTree<folly::IPAddressV4, FibEntry> v4;
+    RadixTree<folly::IPAddressV6, FibEntry> v6;
+
+    RadixTree<folly::IPAddressV4, FibEntry>& get(const folly::IPAddressV4&) {
+      return v4;
+    }
+    RadixTree<folly::IPAddressV6, FibEntry>& get(const folly::IPAddressV6&) {
+      return v6;
+    }
+  };
+  // The parts of an IP header routing looks at
+  struct Flow {
+    folly::IPAddress src;
+    folly::IPAddress dst;
+    uint8_t proto{0};
+    uint8_t ttl{0};
+    uint16_t srcPort{0};
+    uint16_t dstPort{0};
+  };
+
+  typedef std::unordered_map<folly::IPAddress, Host> HostTable;
+
+  // Forbidden copy constructor and assignment operator
+  SimForwarding(SimForwarding const &) = delete;
+  SimForwarding& operator=(SimForwarding const &) = delete;
+
+  static uint64_t macKey(VlanID vlan, folly::MacAddress mac) {
+    return (uint64_t(vlan) << 48) | mac.u64HBO();
+  }
+
+  void processVlan(const std::shared_ptr<Vlan>& vlan);
+  void processAddedIntf(const std::shared_ptr<Interface>& intf);
+  void processRemovedIntf(const std::shared_ptr<Interface>& intf);
+  void processChangedIntf(const std::shared_ptr<Interface>& oldIntf,
+                          const std::shared_ptr<Interface>& newIntf);
+  template<typename NeighborEntryT>
+  void processNeighbor(const NeighborEntryT* oldEntry,
+                       const NeighborEntryT* newEntry);
+  template<typename AddrT>
+  void processAddedRoute(RouterID vrf,
+                         const std::shared_ptr<Route<AddrT>>& route);
+  template<typename AddrT>
+  void processRemovedRoute(RouterID vrf,
+                           const std::shared_ptr<Route<AddrT>>& route);
+  template<typename AddrT>
+  void processChangedRoute(RouterID vrf,
+                           const std::shared_ptr<Route<AddrT>>& oldRoute,
+                           const std::shared_ptr<Route<AddrT>>& newRoute);
+
+  Decision route(RxPacket* pkt, size_t l3Offset, uint16_t etherType,
+                 const Intf& ingress, const PortSet& downPorts);
+  static bool parseFlow(RxPacket* pkt, size_t l3Offset, uint16_t etherType,
+                        Flow* flow);
+  const FibEntry* lookupRoute(RouterID vrf,
+                              const folly::IPAddress& dst) const;
+  const Host* lookupHost(RouterID vrf, const folly::IPAddress& ip) const;
+  static void rewrite(RxPacket* pkt, size_t l3Offset, const Flow& flow,
+                      const Host& host, const Intf& egress);
+
+  boost::container::flat_map<VlanID, PortSet> vlanPorts_;
+  boost::container::flat_map<InterfaceID, Intf> intfs_;
+  // The interface on each VLAN, which owns the router MAC there
+  boost::container::flat_map<VlanID, InterfaceID> vlanIntfs_;
+  // Addresses of our own interfaces, which are always punted
+  boost::container::flat_set<std::pair<RouterID, folly::IPAddress>>
+    localAddrs_;
+  // Learned MAC addresses, keyed by macKey()
+  std::unordered_map<uint64_t, PortID> macTable_;
+  // Resolved neighbors, per VRF
+  std::map<RouterID, HostTable> hosts_;
+  std::map<RouterID, Fib> fibs_;
+  std::unique_ptr<AclClassifier> acls_;
+};
+
+}} // facebook::fboss
@@ -9,22 +9,85 @@
  */
 #include "fboss/agent/hw/sim/SimSwitch.h"
 
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/StateDelta.h"
 #include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 #include "fboss/agent/hw/mock/MockTxPacket.h"
 
 #include <folly/Conv.h>
+#include <folly/MacAddress.h>
 #include <folly/Memory.h>
+#include <folly/io/IOBuf.h>
 
-using folly::make_unique;
+#include <algorithm>
+#include <chrono>
+
+using folly::ByteRange;
+using folly::IPAddress;
+using folly::MacAddress;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
 
+namespace {
+using namespace facebook::fboss;
+
+inline size_t counterIndex(HwPortCounter counter) {
+  return static_cast<size_t>(counter);
+}
+
+template<typename NTable>
+PortID resolvedPort(const shared_ptr<NTable>& table,
+                    const typename NTable::AddressType& ip) {
+  auto entry = table->getEntryIf(ip);
+  if (!entry || entry->isPending()) {
+    return PortID(0);
+  }
+  return entry->getPort();
+}
+
+/*
+ * Find the port a nexthop was learned on, or PortID(0) if the nexthop
+ * is not resolved yet.
+ */
+PortID nexthopPort(const shared_ptr<SwitchState>& state,
+                   const RouteForwardInfo::Nexthop& nhop) {
+  auto intf = state->getInterfaces()->getInterfaceIf(nhop.intf);
+  if (!intf) {
+    return PortID(0);
+  }
+  auto vlan = state->getVlans()->getVlanIf(intf->getVlanID());
+  if (!vlan) {
+    return PortID(0);
+  }
+  if (nhop.nexthop.isV4()) {
+    return resolvedPort(vlan->getArpTable(), nhop.nexthop.asV4());
+  }
+  return resolvedPort(vlan->getNdpTable(), nhop.nexthop.asV6());
+}
+
+template<typename AddrT>
+bool isEcmpRoute(const shared_ptr<Route<AddrT>>& route) {
+  return route && route->isResolved() &&
+    route->getForwardInfo().getNexthops().size() > 1;
+}
+
+}
+
 namespace facebook { namespace fboss {
 
 SimSwitch::SimSwitch(SimPlatform* platform, uint32_t numPorts)
-  : numPorts_(numPorts) {
+  : numPorts_(numPorts),
+    portCounters_(numPorts + 1) {
 }
 
 std::pair<std::shared_ptr<SwitchState>, BootType>
@@ -40,11 +103,144 @@ SimSwitch::init(HwSwitch::Callback* callback) {
 }
 
 void SimSwitch::stateChanged(const StateDelta& delta) {
-  // TODO
+  const auto& newState = delta.newState();
+  std::lock_guard<std::mutex> g(lock_);
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    RouterID vrf = rtDelta.getOld() ? rtDelta.getOld()->getID()
+                                    : rtDelta.getNew()->getID();
+    for (const auto& routeDelta : rtDelta.getRoutesV4Delta()) {
+      updateEcmpRefs(newState, vrf, routeDelta.getOld(), routeDelta.getNew());
+    }
+    for (const auto& routeDelta : rtDelta.getRoutesV6Delta()) {
+      updateEcmpRefs(newState, vrf, routeDelta.getOld(), routeDelta.getNew());
+    }
+  }
+  updateEcmpMembers(delta);
+  forwarding_.stateChanged(delta);
+}
+
+template<typename AddrT>
+void SimSwitch::updateEcmpRefs(
+    const shared_ptr<SwitchState>& state,
+    RouterID vrf,
+    const shared_ptr<Route<AddrT>>& oldRoute,
+    const shared_ptr<Route<AddrT>>& newRoute) {
+  // Take the new reference first, so that a group isn't torn down and
+  // rebuilt when a route using it changes in some other way.
+  if (isEcmpRoute(newRoute)) {
+    auto key = std::make_pair(vrf, newRoute->getForwardInfo().getNexthops());
+    auto& group = ecmpGroups_[key];
+    if (group.refs++ == 0) {
+      group.members = resolveEcmpMembers(state, key.second);
+    }
+  }
+  if (isEcmpRoute(oldRoute)) {
+    auto it = ecmpGroups_.find(
+        std::make_pair(vrf, oldRoute->getForwardInfo().getNexthops()));
+    if (it != ecmpGroups_.end() && --it->second.refs == 0) {
+      ecmpGroups_.erase(it);
+    }
+  }
+}
+
+void SimSwitch::updateEcmpMembers(const StateDelta& delta) {
+  const auto& oldState = delta.oldState();
+  const auto& newState = delta.newState();
+  if (oldState->getVlans() == newState->getVlans() &&
+      oldState->getInterfaces() == newState->getInterfaces()) {
+    return;
+  }
+
+  // Interfaces and VLANs rarely change, so every group is redone when they
+  // do.  Otherwise only the groups using a neighbor that changed are.
+  bool all = oldState->getInterfaces() != newState->getInterfaces();
+  boost::container::flat_set<IPAddress> neighbors;
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    if (all || !vlanDelta.getOld() || !vlanDelta.getNew()) {
+      all = true;
+      break;
+    }
+    for (const auto& arpDelta : vlanDelta.getArpDelta()) {
+      const auto& entry = arpDelta.getOld() ? arpDelta.getOld()
+                                            : arpDelta.getNew();
+      neighbors.insert(IPAddress(entry->getIP()));
+    }
+    for (const auto& ndpDelta : vlanDelta.getNdpDelta()) {
+      const auto& entry = ndpDelta.getOld() ? ndpDelta.getOld()
+                                            : ndpDelta.getNew();
+      neighbors.insert(IPAddress(entry->getIP()));
+    }
+  }
+  if (!all && neighbors.empty()) {
+    return;
+  }
+
+  for (auto& group : ecmpGroups_) {
+    const auto& nhops = group.first.second;
+    bool affected = all || std::any_of(
+        nhops.begin(), nhops.end(),
+        [&](const RouteForwardInfo::Nexthop& nhop) {
+          return neighbors.find(nhop.nexthop) != neighbors.end();
+        });
+    if (affected) {
+      group.second.members = resolveEcmpMembers(newState, nhops);
+    }
+  }
+}
+
+SimSwitch::EcmpMembers SimSwitch::resolveEcmpMembers(
+    const shared_ptr<SwitchState>& state,
+    const RouteForwardNexthops& nhops) const {
+  // Ports which went down have been pruned already and are only
+  // added back once they are up and their neighbors are resolved again.
+  EcmpMembers members;
+  for (const auto& nhop : nhops) {
+    auto port = nexthopPort(state, nhop);
+    if (port != PortID(0) && downPorts_.find(port) == downPorts_.end()) {
+      members.insert(port);
+    }
+  }
+  return members;
+}
+
+void SimSwitch::linkStateChanged(PortID port, bool up) {
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    if (up) {
+      downPorts_.erase(port);
+    } else {
+      downPorts_.insert(port);
+      for (auto& group : ecmpGroups_) {
+        group.second.members.erase(port);
+      }
+      forwarding_.flushPort(port);
+    }
+  }
+  if (!up) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    callback_->linkDownEcmpPruned(port, elapsed);
+  }
+  callback_->linkStateChanged(port, up);
+}
+
+SimSwitch::EcmpMembers SimSwitch::getEcmpMembers(
+    RouterID vrf, const RouteForwardNexthops& nhops) const {
+  std::lock_guard<std::mutex> g(lock_);
+  auto it = ecmpGroups_.find(std::make_pair(vrf, nhops));
+  return it == ecmpGroups_.end() ? EcmpMembers() : it->second.members;
+}
+
+bool SimSwitch::isPortUp(PortID port) const {
+  // Should be called only from SwSwitch which knows whether
+  // the port is enabled or not
+  std::lock_guard<std::mutex> g(lock_);
+  return downPorts_.find(port) == downPorts_.end();
 }
 
 std::unique_ptr<TxPacket> SimSwitch::allocatePacket(uint32_t size) {
-  return make_unique<MockTxPacket>(size);
+  return MockTxPacket::fromPool(size);
 }
 
 bool SimSwitch::sendPacketSwitched(std::unique_ptr<TxPacket> pkt) noexcept {
@@ -58,10 +254,77 @@ bool SimSwitch::sendPacketOutOfPort(
     PortID portID) noexcept {
   // TODO
   ++txCount_;
+  countPacket(portID, pkt->buf(), pkt->buf()->computeChainDataLength(),
+              false);
   return true;
 }
+
 void SimSwitch::injectPacket(std::unique_ptr<RxPacket> pkt) {
-  callback_->packetReceived(std::move(pkt));
+  auto srcPort = pkt->getSrcPort();
+  countPacket(srcPort, pkt->buf(), pkt->getLength(), true);
+
+  SimForwarding::Decision decision;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    decision = forwarding_.forward(pkt.get(), downPorts_);
+  }
+  ++injectedCounts_[decision.action];
+  if (decision.action == SimForwarding::DROP) {
+    if (srcPort > 0 && srcPort <= numPorts_) {
+      ++portCounters_[srcPort][counterIndex(HwPortCounter::IN_DISCARDS)];
+    }
+  } else if (decision.action == SimForwarding::SWITCH ||
+             decision.action == SimForwarding::ROUTE) {
+    countPacket(decision.port, pkt->buf(), pkt->getLength(), false);
+  }
+  if (decision.action == SimForwarding::PUNT || decision.copyToCpu) {
+    callback_->packetReceived(std::move(pkt));
+  }
+}
+
+void SimSwitch::countPacket(PortID port, const folly::IOBuf* buf,
+                            uint64_t length, bool ingress) {
+  if (port == 0 || port > numPorts_) {
+    return;
+  }
+
+  HwPortCounter pkts;
+  const uint8_t* dst = buf->data();
+  if (buf->length() >= MacAddress::SIZE &&
+      MacAddress::fromBinary(ByteRange(dst, MacAddress::SIZE)).isBroadcast()) {
+    pkts = ingress ? HwPortCounter::IN_BROADCAST_PKTS
+                   : HwPortCounter::OUT_BROADCAST_PKTS;
+  } else if (buf->length() >= MacAddress::SIZE && (dst[0] & 0x1)) {
+    pkts = ingress ? HwPortCounter::IN_MULTICAST_PKTS
+                   : HwPortCounter::OUT_MULTICAST_PKTS;
+  } else {
+    pkts = ingress ? HwPortCounter::IN_UNICAST_PKTS
+                   : HwPortCounter::OUT_UNICAST_PKTS;
+  }
+  auto bytes = ingress ? HwPortCounter::IN_BYTES : HwPortCounter::OUT_BYTES;
+
+  auto& counters = portCounters_[port];
+  counters[counterIndex(bytes)] += length;
+  ++counters[counterIndex(pkts)];
+}
+
+bool SimSwitch::readPortCounters(PortID port,
+                                 const std::vector<HwPortCounter>& counters,
+                                 uint64_t* values) {
+  if (port == 0 || port > numPorts_) {
+    return false;
+  }
+  const auto& portCounters = portCounters_[port];
+  for (size_t idx = 0; idx < counters.size(); ++idx) {
+    values[idx] = portCounters[counterIndex(counters[idx])].load();
+  }
+  return true;
+}
+
+void SimSwitch::resetInjectedCounts() {
+  for (auto& count : injectedCounts_) {
+    count = 0;
+  }
 }
 
 }} // facebook::fboss
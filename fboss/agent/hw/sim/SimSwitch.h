@@ -10,13 +10,30 @@
 #pragma once
 
 #include "fboss/agent/HwSwitch.h"
+#include "fboss/agent/hw/sim/SimForwarding.h"
+#include "fboss/agent/state/RouteForwardInfo.h"
+
+#include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace folly {
+class IOBuf;
+}
 
 namespace facebook { namespace fboss {
 
 class SimPlatform;
+template<typename AddrT> class Route;
 
 class SimSwitch : public HwSwitch {
  public:
+  typedef boost::container::flat_set<PortID> EcmpMembers;
+
   SimSwitch(SimPlatform* platform, uint32_t numPorts);
 
   std::pair<std::shared_ptr<SwitchState>, BootType>
@@ -35,7 +52,33 @@ class SimSwitch : public HwSwitch {
     return folly::dynamic::object;
   }
   void clearWarmBootCache() override {}
+
+  /*
+   * Run a packet received on pkt->getSrcPort() through the forwarding
+   * pipeline.  Packets it punts, or copies to the CPU, are handed to the
+   * SwSwitch.  Everything else is only counted, by what was done with it.
+   */
   void injectPacket(std::unique_ptr<RxPacket> pkt);
+  uint64_t getInjectedCount(SimForwarding::Action action) const {
+    return injectedCounts_[action];
+  }
+  void resetInjectedCounts();
+
+  /*
+   * Simulate a linkscan event.
+   *
+   * Like BcmSwitch, a port going down is pruned from all ECMP groups
+   * before the SwSwitch is told about the link state change.
+   */
+  void linkStateChanged(PortID port, bool up);
+
+  /*
+   * Get the ports currently used by the ECMP group for the given nexthops.
+   *
+   * Returns an empty set if there is no such ECMP group.
+   */
+  EcmpMembers getEcmpMembers(RouterID vrf,
+                             const RouteForwardNexthops& nhops) const;
   void initialConfigApplied() override {}
   cfg::PortSpeed getPortSpeed(PortID port) const override {
     return cfg::PortSpeed::GIGE;
@@ -74,20 +117,68 @@ class SimSwitch : public HwSwitch {
     return false;
   }
 
-  bool isPortUp(PortID port) const override {
-    // Should be called only from SwSwitch which knows whether
-    // the port is enabled or not
-    return true;
-  }
+  bool isPortUp(PortID port) const override;
+
+  /*
+   * Port counters are kept for packets injected on a port, and for packets
+   * sent out of a single port, either by the CPU or by the forwarding
+   * pipeline.  Flooded packets are only counted on their ingress port.
+   */
+  bool readPortCounters(PortID port,
+                        const std::vector<HwPortCounter>& counters,
+                        uint64_t* values) override;
 
  private:
   // Forbidden copy constructor and assignment operator
   SimSwitch(SimSwitch const &) = delete;
   SimSwitch& operator=(SimSwitch const &) = delete;
 
+  typedef std::pair<RouterID, RouteForwardNexthops> EcmpKey;
+  struct EcmpGroup {
+    EcmpMembers members;
+    // The number of resolved routes using the group
+    uint32_t refs{0};
+  };
+  typedef boost::container::flat_map<EcmpKey, EcmpGroup> EcmpGroups;
+
+  typedef std::array<std::atomic<uint64_t>,
+                     static_cast<size_t>(HwPortCounter::NUM_COUNTERS)>
+    PortCounters;
+
+  void countPacket(PortID port, const folly::IOBuf* buf, uint64_t length,
+                   bool ingress);
+
+  /*
+   * ECMP groups are kept up to date from the route and neighbor deltas,
+   * so the cost of an update doesn't grow with the size of the tables.
+   * Both must be called with lock_ held.
+   */
+  template<typename AddrT>
+  void updateEcmpRefs(const std::shared_ptr<SwitchState>& state, RouterID vrf,
+                      const std::shared_ptr<Route<AddrT>>& oldRoute,
+                      const std::shared_ptr<Route<AddrT>>& newRoute);
+  void updateEcmpMembers(const StateDelta& delta);
+  EcmpMembers resolveEcmpMembers(const std::shared_ptr<SwitchState>& state,
+                                 const RouteForwardNexthops& nhops) const;
+
   HwSwitch::Callback* callback_{nullptr};
   uint32_t numPorts_{0};
   uint64_t txCount_{0};
+  // Indexed by PortID; port 0 doesn't exist
+  std::vector<PortCounters> portCounters_;
+
+  std::array<std::atomic<uint64_t>, SimForwarding::NUM_ACTIONS>
+    injectedCounts_{};
+
+  /*
+   * ECMP groups, forwarding tables and link state, accessed from the
+   * update thread, whoever simulates linkscan events, and whoever is
+   * injecting packets.
+   */
+  mutable std::mutex lock_;
+  EcmpGroups ecmpGroups_;
+  SimForwarding forwarding_;
+  SimForwarding::PortSet downPorts_;
 };
 
 }} // facebook::fboss
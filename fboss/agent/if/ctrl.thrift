@@ -25,6 +25,56 @@ struct UnicastRoute {
   2: required list<Address.BinaryAddress> nextHopAddrs,
 }
 
+/*
+ * Where a paginated route table dump picks up from.  Routes are returned
+ * VRF by VRF, IPv4 before IPv6, and in prefix order within each of those,
+ * so the cursor is just the last route handed out.
+ */
+struct RouteTableCursor {
+  1: i32 vrf
+  2: IpPrefix lastPrefix
+}
+
+struct RouteTablePageRequest {
+  // The most routes to return.  At most 10000.
+  1: i32 limit = 1000
+  // Resume after this route.  Leave unset to start from the beginning.
+  2: optional RouteTableCursor cursor
+  // Only return routes equal to or more specific than this prefix
+  3: optional IpPrefix filter
+}
+
+struct RouteTablePage {
+  1: list<UnicastRoute> routes
+  // Pass back in the next request to get the next page.  Unset at the end.
+  2: optional RouteTableCursor next
+}
+
+/*
+ * The routes that changed in one VRF
+ */
+struct RouteChanges {
+  1: i32 vrf
+  // Routes that were added, or whose nexthops changed
+  2: list<UnicastRoute> updated
+  3: list<IpPrefix> deleted
+}
+
+/*
+ * A batch of FIB changes sent to a subscriber of subscribeToFib()
+ */
+struct FibUpdate {
+  // Goes up by one with each update sent to the subscriber
+  1: i64 seqNum
+  /*
+   * The subscriber should forget every route it knows about before applying
+   * this update.  This and the updates following it then hold the complete
+   * route table, before any further changes are sent.
+   */
+  2: bool resync
+  3: list<RouteChanges> changes
+}
+
 struct ArpEntryThrift {
   1: string mac,
   2: i32 port,
@@ -145,6 +195,12 @@ struct PortStatus {
   4: optional TransceiverIdxThrift transceiverIdx,
 }
 
+enum CaptureDirection {
+  CAPTURE_ONLY_RX = 0,
+  CAPTURE_ONLY_TX = 1,
+  CAPTURE_TX_RX = 2,
+}
+
 struct CaptureInfo {
   // A name identifying the packet capture
   1: string name
@@ -157,6 +213,31 @@ struct CaptureInfo {
    * large number of packets.
    */
   2: i32 maxPackets
+  /*
+   * Only record the first snaplen bytes of each packet.  This keeps the
+   * memory used by a capture of large frames down.  0 means record the
+   * whole packet.
+   */
+  3: i32 snaplen = 0
+  /*
+   * A pcap filter expression, as used by tcpdump.  Only packets that match
+   * it are captured.  An empty filter matches every packet.
+   */
+  4: string filter = ""
+  // Only capture 1 in every sampleRate packets.  0 or 1 captures them all.
+  5: i32 sampleRate = 0
+  // Only capture packets received on or sent out of these ports
+  6: list<i32> ports = []
+  7: CaptureDirection direction = CAPTURE_TX_RX
+  /*
+   * Start a new capture file once the current one reaches rotateBytes
+   * bytes, or is rotateSeconds old.  Old files are renamed to
+   * <name>.pcap.1, <name>.pcap.2, etc, and at most maxFiles of them are
+   * kept.  0 means no limit.
+   */
+  8: i64 rotateBytes = 0
+  9: i32 rotateSeconds = 0
+  10: i32 maxFiles = 0
 }
 
 /*
@@ -179,6 +260,27 @@ struct LinkNeighborThrift {
   14: optional string portDescription
 }
 
+/*
+ * How long the SwSwitch took to apply one state update, phase by phase.
+ * Updates scheduled close together are applied as one, so there may be
+ * several names.  All times are in microseconds.
+ */
+struct StateUpdateTrace {
+  1: i64 generation
+  2: list<string> names
+  // Wall clock time the update started being applied, in ms since the epoch
+  3: i64 startTimeMs
+  4: i64 updateFnsUs
+  5: i64 publishUs
+  6: i64 hwStateChangedUs
+  7: i64 observersUs
+  8: i64 totalUs
+  9: i32 routesChanged
+  10: i32 neighborsChanged
+  // Ports, VLANs, interfaces and ACLs
+  11: i32 otherNodesChanged
+}
+
 service FbossCtrl extends fb303.FacebookService {
   /*
    * Retrieve up-to-date counters from the hardware, and publish all
@@ -286,10 +388,26 @@ service FbossCtrl extends fb303.FacebookService {
     throws (1: fboss.FbossBaseError error)
   void registerForNeighborChanged()
     throws (1: fboss.FbossBaseError error) (thread='eb')
+  /*
+   * Subscribe to FIB changes over this duplex connection.  The subscriber is
+   * sent the whole route table and then the routes that change, through
+   * FibUpdateClient.fibUpdated().  A subscriber that falls too far behind
+   * is sent the whole table again rather than every change it missed.
+   */
+  void subscribeToFib()
+    throws (1: fboss.FbossBaseError error) (thread='eb')
   list<string> getInterfaceList()
     throws (1: fboss.FbossBaseError error)
   list<UnicastRoute> getRouteTable()
     throws (1: fboss.FbossBaseError error)
+  /*
+   * Return the route table a page at a time.  Each call reads the routes
+   * from the latest switch state, so pages fetched while routes are
+   * changing may miss routes added or removed between calls, but never
+   * return the same route twice.
+   */
+  RouteTablePage getRouteTablePage(1: RouteTablePageRequest request)
+    throws (1: fboss.FbossBaseError error)
   InterfaceDetail getInterfaceDetail(1: i32 interfaceId)
     throws (1: fboss.FbossBaseError error)
 
@@ -359,6 +477,12 @@ service FbossCtrl extends fb303.FacebookService {
   list<LinkNeighborThrift> getLldpNeighbors()
     throws (1: fboss.FbossBaseError error)
 
+  /*
+   * Get the timings of the most recent state updates, oldest first.
+   */
+  list<StateUpdateTrace> getStateUpdateTraces()
+    throws (1: fboss.FbossBaseError error)
+
   /*
    * Start a packet capture
    */
@@ -404,3 +528,12 @@ service NeighborListenerClient extends fb303.FacebookService {
   void neighborsChanged(1: list<string> added, 2: list<string> removed)
     throws (1: fboss.FbossBaseError error)
 }
+
+service FibUpdateClient {
+  /*
+   * Sends a batch of route changes to the subscriber.  No more than a few
+   * updates are sent before earlier ones have been acknowledged.
+   */
+  void fibUpdated(1: FibUpdate update)
+    throws (1: fboss.FbossBaseError error)
+}
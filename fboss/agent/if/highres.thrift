@@ -11,6 +11,13 @@ enum SleepMethod {
   PAUSE
 }
 
+enum PublicationFormat {
+  // Counter names and raw values in CounterPublication.counters
+  MAP,
+  // Delta encoded columns in CounterPublication.columnar
+  COLUMNAR
+}
+
 struct CounterSubscribeRequest {
   /* What to subscribe to */
   // The set of all the counters to which the client wants to subscribe
@@ -30,7 +37,11 @@ struct CounterSubscribeRequest {
   // Whether to use nanosleep() or asm ("pause")
   6 : SleepMethod sleepMethod,
   // Whether to lower the priority of the sampling thread
-  7 : bool veryNice
+  7 : bool veryNice,
+
+  /* How to publish */
+  // The format in which the client wants the publications
+  8 : PublicationFormat format = MAP
 }
 
 struct HighresTime {
@@ -38,6 +49,29 @@ struct HighresTime {
   2: i64 nanoseconds
 }
 
+/*
+ * The samples of one publication, one column per counter.
+ *
+ * Each counter is assigned an ID the first time it is published in a
+ * subscription, and the ID -> name mapping is only sent in that publication.
+ *
+ * Columns are sequences of varints holding zigzag encoded signed values.
+ * Sample times are in nanoseconds since the epoch;  the first is sent as is,
+ * the second as the delta from the first, and the rest as the difference
+ * between consecutive deltas, which is usually close to zero.  Counter values
+ * are sent as the first value followed by deltas between consecutive values.
+ */
+struct ColumnarCounters {
+  // Counters that were assigned IDs since the previous publication
+  1: map<i32, string> newIds,
+  // The number of samples in this publication
+  2: i32 numSamples,
+  // The encoded sample times
+  3: binary times,
+  // {counter ID} -> {encoded sample values}
+  4: map<i32, binary> values
+}
+
 struct CounterPublication {
   // Full hostname of the publishing server
   1: string hostname,
@@ -46,7 +80,10 @@ struct CounterPublication {
   // All of the samples for this batch:
   // {namespace::counter name} -> {list of sample values}
   // The list corresponds to the times in highres_time
-  3: map<string,list<i64>> counters
+  3: map<string,list<i64>> counters,
+  // When the subscription asked for the COLUMNAR format, this replaces
+  // times and counters
+  4: optional ColumnarCounters columnar
 }
 
 service FbossHighresClient {
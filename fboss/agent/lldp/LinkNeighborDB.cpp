@@ -1,6 +1,8 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 #include "fboss/agent/lldp/LinkNeighborDB.h"
 
+#include <algorithm>
+
 using std::chrono::steady_clock;
 using std::lock_guard;
 using std::mutex;
@@ -54,44 +56,51 @@ LinkNeighborDB::LinkNeighborDB() {
 }
 
 void LinkNeighborDB::update(const LinkNeighbor& neighbor) {
-  lock_guard<mutex> guard(mutex_);
+  auto& stripe = getStripe(neighbor.getLocalPort());
+  lock_guard<mutex> guard(stripe.mutex);
 
-  // Go ahead and prune expired neighbors each time we get updated.
-  pruneLocked(steady_clock::now());
+  // If this is the first time we have seen data for this port, this
+  // creates its entry.
+  auto& port = stripe.byLocalPort[neighbor.getLocalPort()];
 
-  auto it = byLocalPort_.find(neighbor.getLocalPort());
-  if (it == byLocalPort_.end()) {
-    // This is the first time we have seen data for this port.
-    auto ret = byLocalPort_.emplace(neighbor.getLocalPort(),
-                                    NeighborMap());
-    it = ret.first;
-  }
+  // Go ahead and prune expired neighbors on this port each time we get
+  // updated.
+  pruneLocked(&port, steady_clock::now());
 
   NeighborKey key(neighbor);
+  port.expirations.emplace(neighbor.getExpirationTime(), key);
   // It would be nicer to use insert_or_assign() once we move to C++17
-  it->second[key] = neighbor;
+  port.neighbors[key] = neighbor;
 }
 
 vector<LinkNeighbor> LinkNeighborDB::getNeighbors() {
   vector<LinkNeighbor> results;
-  lock_guard<mutex> guard(mutex_);
-
-  for (const auto& portEntry : byLocalPort_) {
-    for (const auto& entry : portEntry.second) {
-      results.push_back(entry.second);
+  for (auto& stripe : stripes_) {
+    lock_guard<mutex> guard(stripe.mutex);
+    for (const auto& portEntry : stripe.byLocalPort) {
+      for (const auto& entry : portEntry.second.neighbors) {
+        results.push_back(entry.second);
+      }
     }
   }
 
+  // Return the neighbors ordered by port, as they were when the DB was a
+  // single map.
+  std::stable_sort(results.begin(), results.end(),
+                   [](const LinkNeighbor& a, const LinkNeighbor& b) {
+    return a.getLocalPort() < b.getLocalPort();
+  });
   return results;
 }
 
 vector<LinkNeighbor> LinkNeighborDB::getNeighbors(PortID port) {
   vector<LinkNeighbor> results;
-  lock_guard<mutex> guard(mutex_);
+  auto& stripe = getStripe(port);
+  lock_guard<mutex> guard(stripe.mutex);
 
-  auto it = byLocalPort_.find(port);
-  if (it != byLocalPort_.end()) {
-    for (const auto& entry : it->second) {
+  auto it = stripe.byLocalPort.find(port);
+  if (it != stripe.byLocalPort.end()) {
+    for (const auto& entry : it->second.neighbors) {
       results.push_back(entry.second);
     }
   }
@@ -100,35 +109,33 @@ vector<LinkNeighbor> LinkNeighborDB::getNeighbors(PortID port) {
 }
 
 void LinkNeighborDB::pruneExpiredNeighbors() {
-  lock_guard<mutex> guard(mutex_);
-  pruneLocked(steady_clock::now());
+  pruneExpiredNeighbors(steady_clock::now());
 }
 
 void LinkNeighborDB::pruneExpiredNeighbors(steady_clock::time_point now) {
-  lock_guard<mutex> guard(mutex_);
-  pruneLocked(now);
+  for (auto& stripe : stripes_) {
+    lock_guard<mutex> guard(stripe.mutex);
+    pruneLocked(&stripe, now);
+  }
 }
 
-void LinkNeighborDB::pruneLocked(steady_clock::time_point now) {
-  // We just do a linear scan for now.
-  //
-  // We could maintain a priority queue of entries by expiration time,
-  // to make this scanning faster.  However, we don't expect the number of
-  // neighbors to be very large, so the extra complexity isn't worth
-  // implementing right now.
-
-  for (auto& portEntry : byLocalPort_) {
-    // Advance the iterator manually to avoid make sure we don't
-    // have invalid iterators to erased elements.
-    auto& map = portEntry.second;
-    auto it = map.begin();
-    while (it != map.end()) {
-      auto current = it;
-      ++it;
-      if (current->second.isExpired(now)) {
-        map.erase(current);
-      }
+void LinkNeighborDB::pruneLocked(Stripe* stripe, steady_clock::time_point now) {
+  for (auto& portEntry : stripe->byLocalPort) {
+    pruneLocked(&portEntry.second, now);
+  }
+}
+
+void LinkNeighborDB::pruneLocked(PortNeighbors* port,
+                                 steady_clock::time_point now) {
+  auto& expirations = port->expirations;
+  while (!expirations.empty() && now > expirations.top().first) {
+    auto it = port->neighbors.find(expirations.top().second);
+    // The neighbor may have been refreshed since this entry was pushed, in
+    // which case there is a later entry for it.
+    if (it != port->neighbors.end() && it->second.isExpired(now)) {
+      port->neighbors.erase(it);
     }
+    expirations.pop();
   }
 }
 
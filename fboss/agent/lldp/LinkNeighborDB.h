@@ -4,9 +4,12 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/lldp/LinkNeighbor.h"
 
+#include <array>
 #include <chrono>
+#include <functional>
 #include <map>
 #include <mutex>
+#include <queue>
 #include <vector>
 
 namespace facebook { namespace fboss {
@@ -17,6 +20,15 @@ class LinkNeighbor;
  * LinkNeighborDB maintains information about known neighbors.
  *
  * This class is thread-safe, and performs synchronization internally.
+ *
+ * The neighbors are split by local port across a fixed number of stripes,
+ * each with its own lock.  update() is called from the packet path, and
+ * only locks the stripe of the port the frame arrived on, so it never
+ * waits for readers or updates on other ports.  getNeighbors() locks one
+ * stripe at a time while copying it.
+ *
+ * Each port keeps a min-heap of its neighbors' expiration times, so pruning
+ * only looks at the neighbors that have actually expired.
  */
 class LinkNeighborDB {
  public:
@@ -61,15 +73,41 @@ class LinkNeighborDB {
     std::string portId_;
   };
   typedef std::map<NeighborKey, LinkNeighbor> NeighborMap;
+  typedef std::pair<std::chrono::steady_clock::time_point, NeighborKey>
+    Expiration;
+
+  struct PortNeighbors {
+    NeighborMap neighbors;
+    // Every update pushes the neighbor's new expiration time, without
+    // removing the old one.  Entries for neighbors that have since been
+    // refreshed are skipped when they reach the top.
+    std::priority_queue<Expiration, std::vector<Expiration>,
+                        std::greater<Expiration>> expirations;
+  };
+
+  struct Stripe {
+    std::mutex mutex;
+    std::map<PortID, PortNeighbors> byLocalPort;
+  };
+
+  enum : uint32_t {
+    kNumStripes = 32,
+  };
 
   // Forbidden copy constructor and assignment operator
   LinkNeighborDB(LinkNeighborDB const &) = delete;
   LinkNeighborDB& operator=(LinkNeighborDB const &) = delete;
 
-  void pruneLocked(std::chrono::steady_clock::time_point now);
+  Stripe& getStripe(PortID port) {
+    return stripes_[static_cast<uint16_t>(port) % kNumStripes];
+  }
+
+  static void pruneLocked(PortNeighbors* port,
+                          std::chrono::steady_clock::time_point now);
+  static void pruneLocked(Stripe* stripe,
+                          std::chrono::steady_clock::time_point now);
 
-  std::mutex mutex_;
-  std::map<PortID, NeighborMap> byLocalPort_;
+  std::array<Stripe, kNumStripes> stripes_;
 };
 
 }} // facebook::fboss
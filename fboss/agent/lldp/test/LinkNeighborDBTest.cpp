@@ -104,3 +104,48 @@ TEST(LinkNeighborDB, test) {
   ASSERT_EQ(1, neighbors.size());
   EXPECT_EQ("neighbor3 name", neighbors[0].getSystemName());
 }
+
+namespace {
+
+LinkNeighbor makeNeighbor(PortID port, const std::string& name,
+                          seconds ttl) {
+  LinkNeighbor n;
+  n.setProtocol(LinkProtocol::LLDP);
+  n.setLocalPort(port);
+  n.setLocalVlan(VlanID(1));
+  n.setMac(MacAddress("00:11:22:33:44:55"));
+  n.setChassisId(name, LldpChassisIdType::LOCALLY_ASSIGNED);
+  n.setPortId("1/1", LldpPortIdType::LOCALLY_ASSIGNED);
+  n.setSystemName(name);
+  n.setTTL(ttl);
+  return n;
+}
+
+} // unnamed namespace
+
+TEST(LinkNeighborDB, expiration) {
+  LinkNeighborDB db;
+
+  // Ports 1 and 33 share a lock stripe, port 2 does not
+  db.update(makeNeighbor(PortID(1), "n1", seconds(5)));
+  db.update(makeNeighbor(PortID(33), "n33", seconds(5)));
+  db.update(makeNeighbor(PortID(2), "n2", seconds(20)));
+
+  // Refreshing n1 with a longer TTL keeps it past its first expiration
+  db.update(makeNeighbor(PortID(1), "n1", seconds(30)));
+
+  db.pruneExpiredNeighbors(steady_clock::now() + seconds(10));
+  auto neighbors = db.getNeighbors();
+  ASSERT_EQ(2, neighbors.size());
+  EXPECT_EQ(PortID(1), neighbors[0].getLocalPort());
+  EXPECT_EQ(PortID(2), neighbors[1].getLocalPort());
+  EXPECT_EQ(0, db.getNeighbors(PortID(33)).size());
+
+  db.pruneExpiredNeighbors(steady_clock::now() + seconds(25));
+  neighbors = db.getNeighbors();
+  ASSERT_EQ(1, neighbors.size());
+  EXPECT_EQ("n1", neighbors[0].getSystemName());
+
+  db.pruneExpiredNeighbors(steady_clock::now() + seconds(35));
+  EXPECT_EQ(0, db.getNeighbors().size());
+}
@@ -13,8 +13,13 @@
 #include <folly/IPAddressV6.h>
 #include <folly/MacAddress.h>
 #include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
 #include "fboss/agent/FbossError.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
 using folly::IPAddressV4;
 using folly::IPAddressV6;
 using folly::MacAddress;
@@ -117,6 +122,17 @@ uint16_t PktUtil::finalizeChecksum(uint32_t sum) {
   return static_cast<uint16_t>(sum);
 }
 
+uint16_t PktUtil::updateChecksum(uint16_t csum,
+                                 uint32_t removed,
+                                 uint32_t added) {
+  // Subtracting in one's complement is adding the complement, and
+  // finalizeChecksum() folds removed down to 16 bits for us.
+  uint32_t sum = static_cast<uint16_t>(~csum);
+  sum += finalizeChecksum(removed);
+  sum += added;
+  return finalizeChecksum(sum);
+}
+
 string PktUtil::hexDump(Cursor cursor) {
   return hexDump(cursor, cursor.totalLength());
 }
@@ -190,4 +206,13 @@ void PktUtil::appendHexData(StringPiece hex, Appender* appender) {
   }
 }
 
+ssize_t PktUtil::readPacket(int fd, folly::IOBuf* buf, uint32_t mtu) {
+  auto maxLen = std::min<uint64_t>(buf->tailroom(), uint64_t(mtu) + 1);
+  ssize_t ret;
+  do {
+    ret = read(fd, buf->writableTail(), maxLen);
+  } while (ret == -1 && errno == EINTR);
+  return ret;
+}
+
 }} // facebook::fboss
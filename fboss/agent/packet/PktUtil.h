@@ -10,6 +10,7 @@
 #pragma once
 
 #include <string>
+#include <sys/types.h>
 
 #include <folly/MacAddress.h>
 #include <folly/IPAddressV4.h>
@@ -85,6 +86,18 @@ class PktUtil {
                                    uint32_t value);
   static uint16_t finalizeChecksum(uint32_t value);
 
+  /*
+   * Update a checksum for a change to the data it covers, as described in
+   * RFC 1624, rather than computing it again from scratch.
+   *
+   * removed is the partial checksum of the data as it was, and added the
+   * partial checksum of what replaced it.  Both must be computed with each
+   * byte at the same (even or odd) offset it has in the checksummed data.
+   */
+  static uint16_t updateChecksum(uint16_t csum,
+                                 uint32_t removed,
+                                 uint32_t added);
+
   /**
    * Return a string containing a human readable hex dump of the binary data.
    */
@@ -104,6 +117,18 @@ class PktUtil {
   static void appendHexData(folly::StringPiece hex,
                             folly::io::Appender* appender);
 
+  /*
+   * Read one packet from fd into the tailroom of buf, retrying on EINTR.
+   *
+   * Packet buffers come in size classes, so buf may have room for more than
+   * the MTU.  At most mtu + 1 bytes are read, whatever the tailroom, so a
+   * return value greater than mtu means the packet was too large and has
+   * been truncated.  buf needs room for mtu + 1 bytes.
+   *
+   * Returns what read() does.  Nothing is appended to buf.
+   */
+  static ssize_t readPacket(int fd, folly::IOBuf* buf, uint32_t mtu);
+
  private:
   // Forbidden copy constructor and assignment operator
   PktUtil(PktUtil const &) = delete;
@@ -17,6 +17,10 @@
 #include <folly/Random.h>
 #include <gtest/gtest.h>
 
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
 using namespace facebook::fboss;
 using folly::MacAddress;
 using folly::IPAddressV4;
@@ -212,3 +216,52 @@ TEST(Checksum, TestKnownOdd) {
   expected = ~expected;
   EXPECT_EQ(expected, PktUtil::internetChecksum(bytes, 9));
 }
+
+TEST(Checksum, TestUpdate) {
+  const uint32_t size = 300;
+  uint8_t bytes[size];
+  for (auto i = 0; i < size; ++i) {
+    bytes[i] = Random::rand32(std::numeric_limits<uint8_t>::max());
+  }
+  auto csum = PktUtil::internetChecksum(bytes, size);
+
+  // Change an even number of bytes at an even offset
+  auto offset = Random::rand32(size / 2) * 2;
+  auto length = std::min(size - offset, (Random::rand32(16) + 1) * 2);
+  uint32_t removed = static_cast<uint16_t>(
+      ~PktUtil::internetChecksum(bytes + offset, length));
+  for (auto i = offset; i < offset + length; ++i) {
+    bytes[i] = Random::rand32(std::numeric_limits<uint8_t>::max());
+  }
+  uint32_t added = static_cast<uint16_t>(
+      ~PktUtil::internetChecksum(bytes + offset, length));
+  EXPECT_EQ(PktUtil::internetChecksum(bytes, size),
+            PktUtil::updateChecksum(csum, removed, added));
+}
+
+TEST(PktUtilTest, ReadPacketCappedAtMtu) {
+  // Like a tap or tun device, a SOCK_SEQPACKET socket hands out one packet
+  // per read and drops whatever doesn't fit
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+  const uint32_t mtu = 100;
+  // Far more room than the MTU, as a buffer from a bigger size class has
+  auto buf = IOBuf::create(2048);
+  std::vector<uint8_t> data(1500, 0xab);
+
+  ASSERT_EQ(mtu, write(fds[1], data.data(), mtu));
+  EXPECT_EQ(mtu, PktUtil::readPacket(fds[0], buf.get(), mtu));
+  EXPECT_EQ(0, buf->length());
+
+  // A packet over the MTU is cut short one byte past it, so the caller can
+  // tell it apart from one that fits
+  ASSERT_EQ(data.size(), write(fds[1], data.data(), data.size()));
+  EXPECT_EQ(mtu + 1, PktUtil::readPacket(fds[0], buf.get(), mtu));
+
+  // And the rest of it is gone
+  ASSERT_EQ(50, write(fds[1], data.data(), 50));
+  EXPECT_EQ(50, PktUtil::readPacket(fds[0], buf.get(), mtu));
+
+  close(fds[0]);
+  close(fds[1]);
+}
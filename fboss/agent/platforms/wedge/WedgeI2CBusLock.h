@@ -20,15 +20,18 @@ namespace facebook { namespace fboss {
  * A small wrapper around CP2112 which is aware of the topology of wedge's QSFP
  * I2C bus, and can select specific QSFPs to query.
  */
-class WedgeI2CBusLock {
+class WedgeI2CBusLock : public TransceiverI2CApi {
  public:
   WedgeI2CBusLock();
-  void open();
-  void close();
+  void open() override;
+  void close() override;
   void moduleRead(unsigned int module, uint8_t i2cAddress,
-                  int offset, int len, uint8_t* buf);
+                  int offset, int len, uint8_t* buf) override;
   void moduleWrite(unsigned int module, uint8_t i2cAddress,
-                  int offset, int len, uint8_t* buf);
+                  int offset, int len, uint8_t* buf) override;
+  unsigned int getMux(unsigned int module) const override {
+    return wedgeI2CBus_.getMux(module);
+  }
 
  private:
 
@@ -164,13 +164,14 @@ void WedgePlatform::initTransceiverMap(SwSwitch* sw) {
     LOG(ERROR) << "failed to initialize USB to I2C interface";
     return;
   }
+  i2cScheduler_ = make_unique<I2CTransactionScheduler>(wedgeI2CBusLock_.get());
 
   // Wedge port 0 is the CPU port, so the first port associated with
   // a QSFP+ is port 1.  We start the transceiver IDs with 0, though.
 
   for (int idx = 0; idx < MAX_WEDGE_MODULES; idx++) {
     std::unique_ptr<WedgeQsfp> qsfpImpl =
-      make_unique<WedgeQsfp>(idx, wedgeI2CBusLock_.get());
+      make_unique<WedgeQsfp>(idx, i2cScheduler_.get());
     for (int channel = 0; channel < QsfpModule::CHANNEL_COUNT; ++channel) {
       qsfpImpl->setChannelPort(ChannelID(channel),
           PortID(idx * QsfpModule::CHANNEL_COUNT + channel + 1));
@@ -13,6 +13,7 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/platforms/wedge/WedgeProductInfo.h"
 #include "fboss/agent/platforms/wedge/WedgeI2CBusLock.h"
+#include "fboss/lib/usb/I2CTransactionScheduler.h"
 
 #include <folly/MacAddress.h>
 #include <boost/container/flat_map.hpp>
@@ -73,6 +74,8 @@ class WedgePlatform : public BcmPlatform {
   WedgePortMap ports_;
   WedgeProductInfo productInfo_;
   std::unique_ptr<WedgeI2CBusLock> wedgeI2CBusLock_;
+  // All QSFP I2C traffic goes through here.  Destroyed before the bus.
+  std::unique_ptr<I2CTransactionScheduler> i2cScheduler_;
 };
 
 }} // namespace facebook::fboss
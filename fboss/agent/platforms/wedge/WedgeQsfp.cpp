@@ -9,9 +9,12 @@
  */
 
 #include "WedgeQsfp.h"
+#include "fboss/lib/usb/I2CTransactionScheduler.h"
+#include "fboss/lib/usb/TransceiverI2CApi.h"
 #include "fboss/lib/usb/UsbError.h"
 #include <folly/Conv.h>
 #include <folly/Memory.h>
+#include <cstring>
 
 using namespace facebook::fboss;
 using folly::MutableByteRange;
@@ -21,9 +24,9 @@ using std::unique_ptr;
 
 namespace facebook { namespace fboss {
 
-WedgeQsfp::WedgeQsfp(int module, WedgeI2CBusLock* wedgeI2CBus)
+WedgeQsfp::WedgeQsfp(int module, I2CTransactionScheduler* i2c)
   : module_(module),
-    wedgeI2CBusLock_(wedgeI2CBus) {
+    i2c_(i2c) {
   moduleName_ = folly::to<std::string>(module);
 }
 
@@ -34,27 +37,33 @@ WedgeQsfp::~WedgeQsfp() {
 // assumes that QSFP module numbers extend from 1 to 16.
 //
 bool WedgeQsfp::detectTransceiver() {
-  uint8_t buf[1];
-  try {
-    wedgeI2CBusLock_->moduleRead(module_ + 1, TransceiverI2CApi::ADDR_QSFP,
-                                 0, sizeof(buf), buf);
-  } catch (const UsbError& ex) {
-    /*
-     * This can either mean that we failed to open the USB device
-     * because it was already in use, or that the I2C read failed.
-     * At some point we might want to return more a more accurate
-     * status value to higher-level functions.
-     */
-    return false;
-  }
-  return true;
+  return detectTransceiverAsync().get();
+}
+
+folly::Future<bool> WedgeQsfp::detectTransceiverAsync() {
+  return i2c_->read(module_ + 1, TransceiverI2CApi::ADDR_QSFP, 0, 1)
+    .then([](const std::vector<uint8_t>&) { return true; })
+    .onError([](const UsbError& ex) {
+      /*
+       * This can either mean that we failed to open the USB device
+       * because it was already in use, or that the I2C read failed.
+       * At some point we might want to return more a more accurate
+       * status value to higher-level functions.
+       */
+      return false;
+    });
+}
+
+folly::Future<std::vector<uint8_t>> WedgeQsfp::readTransceiverAsync(
+    int dataAddress, int offset, int len) {
+  return i2c_->read(module_ + 1, dataAddress, offset, len);
 }
 
 int WedgeQsfp::readTransceiver(int dataAddress, int offset,
                                int len, uint8_t* fieldValue) {
   try {
-    wedgeI2CBusLock_->moduleRead(module_ + 1, dataAddress, offset, len,
-                                  fieldValue);
+    auto data = readTransceiverAsync(dataAddress, offset, len).get();
+    memcpy(fieldValue, data.data(), len);
   } catch (const UsbError& ex) {
     return -1;
   }
@@ -64,8 +73,7 @@ int WedgeQsfp::readTransceiver(int dataAddress, int offset,
 int WedgeQsfp::writeTransceiver(int dataAddress, int offset,
                             int len, uint8_t* fieldValue) {
   try {
-    wedgeI2CBusLock_->moduleWrite(module_ + 1, dataAddress, offset, len,
-                                   fieldValue);
+    i2c_->write(module_ + 1, dataAddress, offset, len, fieldValue).get();
   } catch (const UsbError& ex) {
     return -1;
   }
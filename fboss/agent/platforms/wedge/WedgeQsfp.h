@@ -11,17 +11,18 @@
 
 #include <cstdint>
 #include "fboss/agent/TransceiverImpl.h"
-#include "fboss/agent/platforms/wedge/WedgeI2CBusLock.h"
 
 namespace facebook { namespace fboss {
 
+class I2CTransactionScheduler;
+
 /*
  * This is the Wedge Platform Specific Class
  * and contains all the Wedge QSFP Specific Functions
  */
 class WedgeQsfp : public TransceiverImpl {
  public:
-  WedgeQsfp(int module, WedgeI2CBusLock* i2c);
+  WedgeQsfp(int module, I2CTransactionScheduler* i2c);
   virtual ~WedgeQsfp() override;
 
   /* This function is used to read the SFP EEprom */
@@ -32,6 +33,10 @@ class WedgeQsfp : public TransceiverImpl {
                        int len, uint8_t* fieldValue) override;
   /* This function detects if a SFP is present on the particular port */
   bool detectTransceiver() override;
+  /* Queue the transaction on the scheduler without waiting for it */
+  folly::Future<std::vector<uint8_t>> readTransceiverAsync(
+      int dataAddress, int offset, int len) override;
+  folly::Future<bool> detectTransceiverAsync() override;
   /* Returns the name for the port */
   folly::StringPiece getName() override;
   int getNum() override;
@@ -39,7 +44,7 @@ class WedgeQsfp : public TransceiverImpl {
  private:
   int module_;
   std::string moduleName_;
-  WedgeI2CBusLock* wedgeI2CBusLock_;
+  I2CTransactionScheduler* i2c_;
 };
 
 }} // namespace facebook::fboss
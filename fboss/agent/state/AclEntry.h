@@ -30,11 +30,12 @@ struct AclEntryFields {
   const AclEntryID id{0};
   folly::CIDRNetwork srcIp;
   folly::CIDRNetwork dstIp;
-  uint16_t l4SrcPort;
-  uint16_t l4DstPort;
-  uint8_t proto;
-  uint8_t tcpFlags;
-  uint8_t tcpFlagsMask;
+  // 0 matches any value
+  uint16_t l4SrcPort{0};
+  uint16_t l4DstPort{0};
+  uint8_t proto{0};
+  uint8_t tcpFlags{0};
+  uint8_t tcpFlagsMask{0};
   cfg::AclAction action{cfg::AclAction::PERMIT};
 };
 
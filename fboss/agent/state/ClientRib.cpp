@@ -0,0 +1,232 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/ClientRib.h"
+
+#include "fboss/agent/state/RouteUpdater.h"
+
+#include <glog/logging.h>
+
+#include <memory>
+
+namespace facebook { namespace fboss {
+
+ClientRib::Client* ClientRib::getClient(ClientID client) {
+  return &clients_[client];
+}
+
+void ClientRib::setAdminDistance(ClientID client, uint32_t distance,
+                                 RouteUpdater* fib) {
+  auto* entry = getClient(client);
+  if (entry->adminDistance == distance) {
+    return;
+  }
+  auto oldDistance = entry->adminDistance;
+  undo_.push_back([=]() { getClient(client)->adminDistance = oldDistance; });
+  entry->adminDistance = distance;
+  if (!fib) {
+    return;
+  }
+  for (const auto& route : entry->routes) {
+    program(route.first, fib);
+  }
+}
+
+uint32_t ClientRib::getAdminDistance(ClientID client) const {
+  auto it = clients_.find(client);
+  if (it == clients_.end()) {
+    return kDefaultAdminDistance;
+  }
+  return it->second.adminDistance;
+}
+
+void ClientRib::setAdminDistances(
+    const std::map<ClientID, int32_t>& distances, RouteUpdater* fib) {
+  for (const auto& client : clients_) {
+    auto it = distances.find(client.first);
+    setAdminDistance(client.first,
+                     it == distances.end() ? kDefaultAdminDistance
+                                           : it->second,
+                     fib);
+  }
+}
+
+void ClientRib::addRoute(ClientID client, const Prefix& prefix,
+                         RouteNextHops nexthops, RouteUpdater* fib) {
+  auto* entry = getClient(client);
+  auto it = entry->routes.find(prefix);
+  if (it == entry->routes.end()) {
+    entry->routes.emplace(prefix, std::move(nexthops));
+    addOwner(client, prefix);
+    undo_.push_back([=]() {
+      getClient(client)->routes.erase(prefix);
+      removeOwner(client, prefix);
+    });
+  } else if (it->second == nexthops) {
+    // Nothing changed
+    return;
+  } else {
+    std::swap(it->second, nexthops);
+    undo_.push_back([=]() { getClient(client)->routes[prefix] = nexthops; });
+  }
+  program(prefix, fib);
+}
+
+void ClientRib::delRoute(ClientID client, const Prefix& prefix,
+                         RouteUpdater* fib) {
+  auto* entry = getClient(client);
+  auto it = entry->routes.find(prefix);
+  if (it == entry->routes.end()) {
+    VLOG(3) << "client " << client << " deleted non-existing route "
+            << prefix.network << "/" << (int)prefix.mask;
+    return;
+  }
+  auto nexthops = std::move(it->second);
+  entry->routes.erase(it);
+  removeOwner(client, prefix);
+  undo_.push_back([=]() {
+    getClient(client)->routes.emplace(prefix, nexthops);
+    addOwner(client, prefix);
+  });
+  program(prefix, fib);
+}
+
+void ClientRib::syncClient(ClientID client, RouteSet routes,
+                           RouteUpdater* fib) {
+  auto* entry = getClient(client);
+  auto& oldRoutes = entry->routes;
+
+  // Both sets are sorted, so walk them side by side to find the prefixes
+  // that were added, changed or removed. Prefixes whose nexthops are
+  // unchanged are not touched at all.
+  std::vector<Prefix> toProgram;
+  uint32_t added = 0, changed = 0, removed = 0;
+  auto oldIt = oldRoutes.begin();
+  auto newIt = routes.begin();
+  while (oldIt != oldRoutes.end() || newIt != routes.end()) {
+    if (newIt == routes.end() ||
+        (oldIt != oldRoutes.end() && oldIt->first < newIt->first)) {
+      removeOwner(client, oldIt->first);
+      toProgram.push_back(oldIt->first);
+      ++removed;
+      ++oldIt;
+    } else if (oldIt == oldRoutes.end() || newIt->first < oldIt->first) {
+      addOwner(client, newIt->first);
+      toProgram.push_back(newIt->first);
+      ++added;
+      ++newIt;
+    } else {
+      if (oldIt->second != newIt->second) {
+        toProgram.push_back(newIt->first);
+        ++changed;
+      }
+      ++oldIt;
+      ++newIt;
+    }
+  }
+  VLOG(1) << "syncing client " << client << ": " << added << " added, "
+          << changed << " changed, " << removed << " removed";
+
+  // program() looks up the winning nexthops, so the new set has to be in
+  // place first.  Undoing this is just another sync, back to the old set.
+  auto prevRoutes = std::make_shared<RouteSet>(std::move(oldRoutes));
+  undo_.push_back([=]() {
+    syncClient(client, std::move(*prevRoutes), nullptr);
+  });
+  oldRoutes = std::move(routes);
+  if (fib) {
+    for (const auto& prefix : toProgram) {
+      program(prefix, fib);
+    }
+  }
+}
+
+void ClientRib::rollback() {
+  if (undo_.empty()) {
+    return;
+  }
+  LOG(INFO) << "rolling back " << undo_.size() << " client RIB changes";
+  // Whatever the undo functions log about themselves is thrown away with
+  // the rest.
+  auto undo = std::move(undo_);
+  for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+    (*it)();
+  }
+  undo_.clear();
+}
+
+void ClientRib::programAll(RouteUpdater* fib) const {
+  for (const auto& entry : owners_) {
+    program(entry.first, fib);
+  }
+}
+
+const ClientRib::RouteSet* ClientRib::getClientRoutes(ClientID client) const {
+  auto it = clients_.find(client);
+  if (it == clients_.end()) {
+    return nullptr;
+  }
+  return &it->second.routes;
+}
+
+const ClientRib::ClientID* ClientRib::getWinner(const Prefix& prefix) const {
+  auto it = owners_.find(prefix);
+  if (it == owners_.end()) {
+    return nullptr;
+  }
+  return getWinner(it->second);
+}
+
+const ClientRib::ClientID* ClientRib::getWinner(const Owners& owners) const {
+  // Owners are sorted by client ID, so on a tie the first one seen wins.
+  const ClientID* winner = nullptr;
+  uint32_t winnerDistance = 0;
+  for (const auto& client : owners) {
+    auto distance = getAdminDistance(client);
+    if (!winner || distance < winnerDistance) {
+      winner = &client;
+      winnerDistance = distance;
+    }
+  }
+  return winner;
+}
+
+void ClientRib::addOwner(ClientID client, const Prefix& prefix) {
+  owners_[prefix].insert(client);
+}
+
+void ClientRib::removeOwner(ClientID client, const Prefix& prefix) {
+  auto it = owners_.find(prefix);
+  if (it == owners_.end()) {
+    return;
+  }
+  it->second.erase(client);
+  if (it->second.empty()) {
+    owners_.erase(it);
+  }
+}
+
+void ClientRib::program(const Prefix& prefix, RouteUpdater* fib) const {
+  auto* winner = getWinner(prefix);
+  if (!winner) {
+    fib->delRoute(prefix.vrf, prefix.network, prefix.mask);
+    return;
+  }
+  const auto& routes = clients_.find(*winner)->second.routes;
+  const auto& nexthops = routes.find(prefix)->second;
+  if (nexthops.empty()) {
+    fib->addRoute(prefix.vrf, prefix.network, prefix.mask,
+                  RouteForwardAction::DROP);
+  } else {
+    // RouteUpdater leaves the route alone if it is already the same
+    fib->addRoute(prefix.vrf, prefix.network, prefix.mask, nexthops);
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,166 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/types.h"
+#include "fboss/agent/state/RouteTypes.h"
+
+#include <folly/IPAddress.h>
+#include <boost/container/flat_set.hpp>
+
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class RouteUpdater;
+
+/*
+ * ClientRib keeps track of the unicast routes each routing client has
+ * added over thrift, keyed by the clientId the client passes in, and
+ * decides which client's route goes into the FIB for each prefix.
+ *
+ * Each client has an admin distance. When several clients have a route for
+ * the same prefix, the one with the lowest admin distance wins, with ties
+ * going to the lowest client ID. Only the winning route is programmed.
+ *
+ * The update functions take a RouteUpdater, and apply to it only the FIB
+ * changes that result from the update: i.e. prefixes whose winning route
+ * was added, changed or withdrawn. In particular syncClient() only walks
+ * the client's old and new route sets, rather than rebuilding the whole
+ * FIB.
+ *
+ * ClientRib lives outside the SwitchState, so it must not get ahead of the
+ * FIB when a state update fails. Changes are logged until commit() is
+ * called, once the new route tables have been built, and a failed update
+ * calls rollback() to undo everything since the last commit().
+ *
+ * ClientRib is not thread safe. SwSwitch only accesses it from state
+ * update functions, which always run on the update thread.
+ */
+class ClientRib {
+ public:
+  typedef int16_t ClientID;
+  enum : uint32_t {
+    // Used for clients that have no admin distance configured
+    kDefaultAdminDistance = 100,
+  };
+
+  struct Prefix {
+    Prefix(RouterID vrf, const folly::IPAddress& addr, uint8_t len)
+      : vrf(vrf), network(addr.mask(len)), mask(len) {}
+
+    bool operator<(const Prefix& other) const {
+      return std::tie(vrf, network, mask) <
+        std::tie(other.vrf, other.network, other.mask);
+    }
+    bool operator==(const Prefix& other) const {
+      return vrf == other.vrf && network == other.network &&
+        mask == other.mask;
+    }
+
+    RouterID vrf;
+    folly::IPAddress network;
+    uint8_t mask;
+  };
+
+  /*
+   * A client's routes. Routes with no nexthops are drop routes.
+   */
+  typedef std::map<Prefix, RouteNextHops> RouteSet;
+
+  ClientRib() {}
+
+  /*
+   * Change the admin distance of a client, reprogramming any of its
+   * prefixes that win or lose as a result. As with syncClient(), fib may be
+   * null.
+   */
+  void setAdminDistance(ClientID client, uint32_t distance,
+                        RouteUpdater* fib);
+  uint32_t getAdminDistance(ClientID client) const;
+
+  /*
+   * Set the admin distance of every client we know about from the config,
+   * clients that aren't listed getting kDefaultAdminDistance.
+   */
+  void setAdminDistances(const std::map<ClientID, int32_t>& distances,
+                         RouteUpdater* fib);
+
+  void addRoute(ClientID client, const Prefix& prefix,
+                RouteNextHops nexthops, RouteUpdater* fib);
+  void delRoute(ClientID client, const Prefix& prefix, RouteUpdater* fib);
+
+  /*
+   * Replace all of a client's routes with the given set.
+   *
+   * fib may be null, in which case only the ClientRib itself is updated.
+   * This is used when the FIB is being rebuilt from scratch, and the routes
+   * will be added with programAll() afterwards.
+   */
+  void syncClient(ClientID client, RouteSet routes, RouteUpdater* fib);
+
+  /*
+   * Add the winning route for every prefix to the FIB.
+   */
+  void programAll(RouteUpdater* fib) const;
+
+  const RouteSet* getClientRoutes(ClientID client) const;
+
+  /*
+   * Return the client whose route for the prefix is in the FIB, or nullptr
+   * if no client has a route for it.
+   */
+  const ClientID* getWinner(const Prefix& prefix) const;
+
+  /*
+   * Keep the changes made since the last commit().
+   */
+  void commit() {
+    undo_.clear();
+  }
+
+  /*
+   * Undo the changes made since the last commit().
+   */
+  void rollback();
+
+ private:
+  struct Client {
+    uint32_t adminDistance{kDefaultAdminDistance};
+    RouteSet routes;
+  };
+  typedef boost::container::flat_set<ClientID> Owners;
+
+  // Forbidden copy constructor and assignment operator
+  ClientRib(ClientRib const &) = delete;
+  ClientRib& operator=(ClientRib const &) = delete;
+
+  Client* getClient(ClientID client);
+  const ClientID* getWinner(const Owners& owners) const;
+  void addOwner(ClientID client, const Prefix& prefix);
+  void removeOwner(ClientID client, const Prefix& prefix);
+
+  /*
+   * Program the current winner for a prefix into the FIB, or remove the
+   * prefix from the FIB if no client has a route for it any more.
+   */
+  void program(const Prefix& prefix, RouteUpdater* fib) const;
+
+  std::map<ClientID, Client> clients_;
+  // Which clients have a route for each prefix
+  std::map<Prefix, Owners> owners_;
+  // How to undo each change since the last commit(), oldest first
+  std::vector<std::function<void()>> undo_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <vector>
+
+#include "fboss/agent/state/NodeMapDelta.h"
+
+namespace facebook { namespace fboss {
+
+/*
+ * DeltaList is a NodeMapDelta that has been walked once, with the changes
+ * saved in a flat vector.
+ *
+ * Walking a NodeMapDelta compares every node in the old and new maps, which
+ * is expensive for large maps such as the route tables. StateDelta builds a
+ * DeltaList the first time a sub-delta is requested, so that the HwSwitch
+ * and every StateObserver iterate the same list instead of redoing the
+ * comparison.
+ *
+ * DeltaList can be used anywhere a NodeMapDelta can, including with the
+ * DeltaFunctions helpers.
+ */
+template<typename NODE, typename VALUE = DeltaValue<NODE>>
+class DeltaList {
+ public:
+  typedef NODE Node;
+  typedef VALUE value_type;
+  typedef typename std::vector<VALUE>::const_iterator Iterator;
+
+  DeltaList() {}
+
+  template<typename Delta>
+  explicit DeltaList(const Delta& delta) {
+    for (const auto& entry : delta) {
+      changes_.emplace_back(entry.getOld(), entry.getNew());
+    }
+  }
+
+  DeltaList(DeltaList&&) = default;
+  DeltaList& operator=(DeltaList&&) = default;
+
+  Iterator begin() const {
+    return changes_.begin();
+  }
+  Iterator end() const {
+    return changes_.end();
+  }
+
+  size_t size() const {
+    return changes_.size();
+  }
+  bool empty() const {
+    return changes_.empty();
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  DeltaList(DeltaList const &) = delete;
+  DeltaList& operator=(DeltaList const &) = delete;
+
+  std::vector<VALUE> changes_;
+};
+
+}} // facebook::fboss
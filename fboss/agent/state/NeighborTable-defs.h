@@ -48,7 +48,7 @@ void NeighborTable<IPADDR, ENTRY, SUBCLASS>::addEntry(
     InterfaceID intfID) {
   CHECK(!this->isPublished());
   auto entry = std::make_shared<Entry>(ip, mac, port, intfID);
-  this->addNode(entry);
+  addNode(entry);
 }
 
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
@@ -58,12 +58,11 @@ void NeighborTable<IPADDR, ENTRY, SUBCLASS>::updateEntry(
     PortID port,
     InterfaceID intfID) {
   CHECK(!this->isPublished());
-  auto& nodes = this->writableNodes();
-  auto it = nodes.find(ip);
-  if (it == nodes.end()) {
+  auto oldEntry = this->getNodeIf(ip);
+  if (!oldEntry) {
     throw FbossError("ARP entry for ", ip, " does not exist");
   }
-  auto entry = it->second->clone();
+  auto entry = oldEntry->clone();
   if (entry->isPending()) {
     this->decNPending();
   }
@@ -71,7 +70,7 @@ void NeighborTable<IPADDR, ENTRY, SUBCLASS>::updateEntry(
   entry->setPort(port);
   entry->setIntfID(intfID);
   entry->setPending(false);
-  it->second = entry;
+  updateNode(entry);
 }
 
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
@@ -80,51 +79,122 @@ void NeighborTable<IPADDR, ENTRY, SUBCLASS>::addPendingEntry(
     InterfaceID intfID) {
   CHECK(!this->isPublished());
   auto pendingEntry = std::make_shared<Entry>(ip, intfID, PENDING);
-  this->addNode(pendingEntry);
+  addNode(pendingEntry);
   this->incNPending();
- }
+}
 
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
 bool NeighborTable<IPADDR, ENTRY, SUBCLASS>::
 setEntriesPendingForPort(PortID port) {
   CHECK(!this->isPublished());
-  // Need a reverse iterator because removing an element from a flat_map
-  // invalidates all iterators after the element removed
-  bool modified = false;
-  auto entryIt = this->rbegin();
-  while (entryIt != this->rend()) {
-    auto entry = *entryIt++;
-    if (entry->getPort() == port) {
-      VLOG(4) << "Marking entry pending for " << entry->getIP().str()
-        << " on port " << port;
-      auto ip = entry->getIP();
-      auto intfId = entry->getIntfID();
-      this->removeNode(entry);
-      addPendingEntry(ip, intfId);
-      modified = true;
-    }
+  const auto& index = this->getExtraFields().portIndex;
+  auto indexIt = index.find(port);
+  if (indexIt == index.end()) {
+    return false;
   }
-  return modified;
+  // Copy the addresses, since the loop below modifies the index
+  auto ips = indexIt->second;
+  for (const auto& ip : ips) {
+    VLOG(4) << "Marking entry pending for " << ip.first.str()
+      << " on port " << port;
+    auto entry = removeNode(ip.first);
+    addPendingEntry(ip.first, entry->getIntfID());
+  }
+  return true;
 }
 
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
 bool NeighborTable<IPADDR, ENTRY, SUBCLASS>::prunePendingEntries() {
   CHECK(!this->isPublished());
 
-  // Need a reverse iterator because removing an element from a flat_map
-  // invalidates all iterators after the element removed
-  bool modified = false;
-  auto entryIt = this->rbegin();
-  while (entryIt != this->rend()) {
-    auto entry = *entryIt++;
+  // Removing an entry invalidates all iterators, so find the pending
+  // entries first
+  std::vector<AddressType> pending;
+  for (const auto& entry : *this) {
     if (entry->isPending()) {
-      VLOG(4) << "Removing pending neighbor entry for " << entry->getIP().str();
-      this->removeNode(entry);
-      modified = true;
+      pending.push_back(entry->getIP());
     }
   }
+  for (const auto& ip : pending) {
+    VLOG(4) << "Removing pending neighbor entry for " << ip.str();
+    removeNode(ip);
+  }
   this->setNPending(0);
-  return modified;
+  return !pending.empty();
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+void NeighborTable<IPADDR, ENTRY, SUBCLASS>::addNode(
+    const std::shared_ptr<Entry>& entry) {
+  Parent::addNode(entry);
+  addToPortIndex(entry);
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+void NeighborTable<IPADDR, ENTRY, SUBCLASS>::updateNode(
+    const std::shared_ptr<Entry>& entry) {
+  auto old = this->getNodeIf(entry->getIP());
+  Parent::updateNode(entry);
+  removeFromPortIndex(old);
+  addToPortIndex(entry);
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+void NeighborTable<IPADDR, ENTRY, SUBCLASS>::removeNode(
+    const std::shared_ptr<Entry>& entry) {
+  // Use the entry actually in the table, in case the one passed in is stale
+  removeNode(entry->getIP());
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+std::shared_ptr<ENTRY> NeighborTable<IPADDR, ENTRY, SUBCLASS>::removeNode(
+    const AddressType& ip) {
+  auto entry = Parent::removeNode(ip);
+  removeFromPortIndex(entry);
+  return entry;
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+std::shared_ptr<ENTRY> NeighborTable<IPADDR, ENTRY, SUBCLASS>::removeNodeIf(
+    const AddressType& ip) {
+  auto entry = Parent::removeNodeIf(ip);
+  if (entry) {
+    removeFromPortIndex(entry);
+  }
+  return entry;
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+std::shared_ptr<SUBCLASS> NeighborTable<IPADDR, ENTRY, SUBCLASS>::
+fromFollyDynamic(const folly::dynamic& json) {
+  auto table = Parent::fromFollyDynamic(json);
+  // Deserializing the extra fields reset the index
+  auto& index = table->writableExtraFields().portIndex;
+  for (const auto& entry : *table) {
+    index[entry->getPort()].insert(std::make_pair(entry->getIP(), true));
+  }
+  return table;
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+void NeighborTable<IPADDR, ENTRY, SUBCLASS>::addToPortIndex(
+    const std::shared_ptr<Entry>& entry) {
+  this->writableExtraFields().portIndex[entry->getPort()].insert(
+      std::make_pair(entry->getIP(), true));
+}
+
+template<typename IPADDR, typename ENTRY, typename SUBCLASS>
+void NeighborTable<IPADDR, ENTRY, SUBCLASS>::removeFromPortIndex(
+    const std::shared_ptr<Entry>& entry) {
+  auto& index = this->writableExtraFields().portIndex;
+  if (!index.count(entry->getPort())) {
+    return;
+  }
+  auto& ips = index[entry->getPort()];
+  ips.erase(entry->getIP());
+  if (ips.empty()) {
+    index.erase(entry->getPort());
+  }
 }
 
 }} // facebook::fboss
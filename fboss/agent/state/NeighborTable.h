@@ -12,6 +12,7 @@
 #include <folly/MacAddress.h>
 #include "fboss/agent/state/NeighborEntry.h"
 #include "fboss/agent/state/NodeMap.h"
+#include "fboss/agent/state/PersistentMap.h"
 #include <folly/dynamic.h>
 #include <folly/json.h>
 
@@ -24,11 +25,23 @@ namespace facebook { namespace fboss {
 class SwitchState;
 class Vlan;
 
+template<typename IPADDR>
 struct NeighborTableFields {
   template<typename Fn> void forEachChild(Fn fn) {}
   bool pendingEntries{false};
   int nPending{0};
 
+  /*
+   * The IPs of the entries on each port, so that a port going down doesn't
+   * require scanning the whole table.  It is derived from the entries, so
+   * it isn't serialized; NeighborTable::fromFollyDynamic() rebuilds it.
+   *
+   * It uses PersistentMaps like the table itself, so that cloning the table
+   * stays cheap.  The values of an AddressSet are unused.
+   */
+  typedef PersistentMap<IPADDR, bool> AddressSet;
+  PersistentMap<PortID, AddressSet> portIndex;
+
   folly::dynamic toFollyDynamic() const {
     folly::dynamic ntable = folly::dynamic::object;
     ntable[kNPending] = nPending;
@@ -51,7 +64,10 @@ template<typename IPADDR, typename ENTRY>
 struct NeighborTableTraits {
   typedef IPADDR KeyType;
   typedef ENTRY Node;
-  typedef NeighborTableFields ExtraFields;
+  typedef NeighborTableFields<IPADDR> ExtraFields;
+  // Neighbor tables can hold many thousands of entries and change one entry
+  // at a time, so they use a copy-on-write tree instead of a flat_map.
+  typedef PersistentMap<IPADDR, std::shared_ptr<ENTRY>> NodeContainer;
 
   static KeyType getKey(const std::shared_ptr<Node>& entry) {
     return entry->getIP();
@@ -61,12 +77,13 @@ struct NeighborTableTraits {
 /*
  * A map of IP --> MAC for the IP addresses of other nodes on a VLAN.
  *
- * TODO: We should switch from NodeMap to PrefixMap when the new PrefixMap
- * implementation is ready.
+ * The entries are stored in a PersistentMap, so cloning a published table
+ * and changing one entry costs O(log N) rather than O(N).
  *
- * Any change to a NodeMap is O(N), so it is really only suitable for small
- * maps that do not change frequently.  Our new PrefixMap implementation will
- * allow us to perform cheaper copy-on-write updates.
+ * The table keeps an index of its entries by port.  NeighborTable hides
+ * the NodeMap functions that add, update or remove nodes with versions
+ * that keep the index up to date, so the table must not be modified
+ * through a pointer to its NodeMap base class.
  */
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
 class NeighborTable
@@ -104,6 +121,29 @@ class NeighborTable
    */
   bool setEntriesPendingForPort(PortID port);
 
+  /*
+   * Return whether any entries are on the given port.  This is a lookup in
+   * the port index, so callers can check it before cloning the table.
+   */
+  bool hasEntriesForPort(PortID port) const {
+    return this->getExtraFields().portIndex.count(port) > 0;
+  }
+
+  /*
+   * These replace the NodeMap functions of the same name, to maintain the
+   * port index.
+   */
+  void addNode(const std::shared_ptr<Entry>& entry);
+  void updateNode(const std::shared_ptr<Entry>& entry);
+  void removeNode(const std::shared_ptr<Entry>& entry);
+  std::shared_ptr<Entry> removeNode(const AddressType& ip);
+  std::shared_ptr<Entry> removeNodeIf(const AddressType& ip);
+
+  static std::shared_ptr<SUBCLASS> fromFollyDynamic(const folly::dynamic& json);
+  static std::shared_ptr<SUBCLASS> fromJson(const folly::fbstring& jsonStr) {
+    return fromFollyDynamic(folly::parseJson(jsonStr));
+  }
+
   bool hasPendingEntries() {
     auto nPending = this->getExtraFields().nPending;
     CHECK(nPending >= 0);
@@ -125,6 +165,8 @@ class NeighborTable
   void setNPending(int nPending) {
     this->writableExtraFields().nPending = nPending;
   }
+  void addToPortIndex(const std::shared_ptr<Entry>& entry);
+  void removeFromPortIndex(const std::shared_ptr<Entry>& entry);
 
 };
 
@@ -148,7 +148,8 @@ class NodeBase {
  *
  * Fields structures must provided a forEachChild() template method, which
  * calls the specified function on child node stored in the fields.  This is
- * used to implement publish().
+ * used to implement publish(), so it may skip children that are known to
+ * be published already.
  *
  * For an example of how to use NodeBaseT, see Vlan.h or Port.h.
  */
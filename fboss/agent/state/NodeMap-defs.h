@@ -64,11 +64,12 @@ template <typename MapTypeT, typename TraitsT>
 void
 NodeMapT<MapTypeT, TraitsT>::updateNode(const std::shared_ptr<Node>& node) {
   auto& nodes = writableNodes();
-  auto it = nodes.find(TraitsT::getKey(node));
-  if (it == nodes.end()) {
-    throw FbossError("node ID ", TraitsT::getKey(node), " does not exist");
+  auto key = TraitsT::getKey(node);
+  if (nodes.find(key) == nodes.end()) {
+    throw FbossError("node ID ", key, " does not exist");
   }
-  it->second = node;
+  // Not all containers have mutable iterators, so go through operator[]
+  nodes[key] = node;
 }
 
 template <typename MapTypeT, typename TraitsT>
@@ -16,6 +16,45 @@
 
 namespace facebook { namespace fboss {
 
+/*
+ * The container a NodeMapT stores its nodes in.
+ *
+ * This is a flat_map unless the traits define a NodeContainer type.  Large
+ * maps that change often can use a PersistentMap instead, so that modifying
+ * a published map doesn't copy every entry.
+ */
+template <typename TraitsT, typename = void>
+struct NodeMapContainer {
+  typedef boost::container::flat_map<typename TraitsT::KeyType,
+                                     std::shared_ptr<typename TraitsT::Node>>
+    type;
+};
+
+template <typename T>
+struct NodeMapVoid {
+  typedef void type;
+};
+
+template <typename TraitsT>
+struct NodeMapContainer<
+    TraitsT, typename NodeMapVoid<typename TraitsT::NodeContainer>::type> {
+  typedef typename TraitsT::NodeContainer type;
+};
+
+/*
+ * Call fn on each node in a NodeMap container that may not be published yet.
+ *
+ * Containers that know which of their entries are new since they were last
+ * published, such as PersistentMap, provide an overload of this that skips
+ * the rest.  Other containers visit every node.
+ */
+template <typename Container, typename Fn>
+void forEachUnpublished(Container& nodes, Fn fn) {
+  for (const auto& nodePtr : nodes) {
+    fn(nodePtr.second.get());
+  }
+}
+
 /*
  * NodeMapFields defines the fields contained inside a NodeMapT instantiation
  */
@@ -24,19 +63,18 @@ struct NodeMapFields {
   typedef typename TraitsT::KeyType KeyType;
   typedef typename TraitsT::Node Node;
   typedef typename TraitsT::ExtraFields ExtraFields;
-  typedef boost::container::flat_map<KeyType, std::shared_ptr<Node>>
-    NodeContainer;
+  typedef typename NodeMapContainer<TraitsT>::type NodeContainer;
 
   NodeMapFields() {}
   NodeMapFields(const NodeMapFields& other, NodeContainer nodes)
     : nodes(std::move(nodes)),
       extra(other.extra) {}
 
+  // Only used by publish(), so children that are known to be published
+  // already may be skipped.
   template<typename Fn>
   void forEachChild(Fn fn) {
-    for (const auto& nodePtr : nodes) {
-      fn(nodePtr.second.get());
-    }
+    forEachUnpublished(nodes, fn);
     extra.forEachChild(fn);
   }
 
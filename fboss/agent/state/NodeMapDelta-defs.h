@@ -29,12 +29,7 @@ NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::Iterator(
     newMap_(newMap),
     value_(nullNode_, nullNode_) {
   // Advance to the first difference
-  while (oldIt_ != oldMap_->end() &&
-         newIt_ != newMap_->end() &&
-         *oldIt_ == *newIt_) {
-    ++oldIt_;
-    ++newIt_;
-  }
+  skipUnchanged();
   updateValue();
 }
 
@@ -102,13 +97,24 @@ void NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::advance() {
   }
 
   // Advance past any unchanged nodes.
-  while (oldIt_ != oldMap_->end() &&
-         newIt_ != newMap_->end() &&
-         *oldIt_ == *newIt_) {
+  skipUnchanged();
+  updateValue();
+}
+
+template<typename MAP, typename VALUE, typename MAPPOINTERTRAITS>
+void NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::skipUnchanged() {
+  while (oldIt_ != oldMap_->end() && newIt_ != newMap_->end()) {
+    // If the maps share storage, skip the shared parts wholesale rather
+    // than comparing them one node at a time.
+    if (oldIt_.skipShared(&newIt_)) {
+      continue;
+    }
+    if (*oldIt_ != *newIt_) {
+      return;
+    }
     ++oldIt_;
     ++newIt_;
   }
-  updateValue();
 }
 
 }} // facebook::fboss
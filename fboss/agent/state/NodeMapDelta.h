@@ -186,6 +186,7 @@ class NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator {
   typedef typename MapType::Traits Traits;
 
   void advance();
+  void skipUnchanged();
   void updateValue();
 
   InnerIter oldIt_;
@@ -11,6 +11,16 @@
 
 #include <boost/container/flat_map.hpp>
 
+/*
+ * Containers whose copies can share storage, such as PersistentMap, provide
+ * an overload of this that moves two iterators past the entries they share.
+ * Other containers have nothing to skip.
+ */
+template <typename IteratorT>
+bool skipSharedEntries(IteratorT* a, IteratorT* b) {
+  return false;
+}
+
 /*
  * NodeMapIterator is a very small wrapper around flat_map::const_iterator.
  *
@@ -53,6 +63,14 @@ class NodeMapIterator : public std::iterator<std::forward_iterator_tag,
     return it_ != other.it_;
   }
 
+  /*
+   * Advance this iterator and other past any entries that their containers
+   * share.  Returns true if anything was skipped.
+   */
+  bool skipShared(NodeMapIterator* other) {
+    return skipSharedEntries(&it_, &other->it_);
+  }
+
  private:
   typename NodeContainer::const_iterator it_;
 };
@@ -0,0 +1,513 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+template<typename K, typename V>
+struct PersistentMapNode {
+  typedef std::pair<K, V> value_type;
+
+  explicit PersistentMapNode(bool leaf) : leaf(leaf) {}
+
+  size_t count() const {
+    return leaf ? values.size() : children.size();
+  }
+
+  bool leaf;
+  // Set once everything under this node has been published, and cleared
+  // whenever the node is modified.  See PersistentMap::forEachUnpublished().
+  bool published{false};
+  // Leaf nodes only: the entries, sorted by key
+  std::vector<value_type> values;
+  // Internal nodes only: seps[i] is the smallest key under children[i + 1]
+  std::vector<K> seps;
+  std::vector<std::shared_ptr<PersistentMapNode>> children;
+};
+
+template<typename K, typename V, uint32_t kFanout>
+class PersistentMap;
+
+/*
+ * An iterator over a PersistentMap.
+ *
+ * The iterator holds the path from the root to the current leaf, so it stays
+ * valid as long as the map it came from isn't modified.
+ */
+template<typename K, typename V, uint32_t kFanout>
+class PersistentMapIterator
+  : public std::iterator<std::bidirectional_iterator_tag,
+                         const std::pair<K, V>> {
+ public:
+  typedef std::pair<K, V> value_type;
+
+  PersistentMapIterator() {}
+
+  const value_type& operator*() const {
+    const auto& level = path_[depth_ - 1];
+    return level.node->values[level.idx];
+  }
+  const value_type* operator->() const {
+    return &operator*();
+  }
+
+  PersistentMapIterator& operator++() {
+    advance(depth_ - 1);
+    return *this;
+  }
+  PersistentMapIterator operator++(int) {
+    PersistentMapIterator tmp(*this);
+    ++*this;
+    return tmp;
+  }
+  PersistentMapIterator& operator--() {
+    retreat();
+    return *this;
+  }
+  PersistentMapIterator operator--(int) {
+    PersistentMapIterator tmp(*this);
+    --*this;
+    return tmp;
+  }
+
+  bool operator==(const PersistentMapIterator& other) const {
+    if (depth_ == 0 || other.depth_ == 0) {
+      return depth_ == other.depth_;
+    }
+    const auto& a = path_[depth_ - 1];
+    const auto& b = other.path_[other.depth_ - 1];
+    return a.node == b.node && a.idx == b.idx;
+  }
+  bool operator!=(const PersistentMapIterator& other) const {
+    return !operator==(other);
+  }
+
+  /*
+   * If a and b are at the same position in a subtree that both of their
+   * maps share, move both of them past the largest such subtree and return
+   * true.  This lets NodeMapDelta skip over the unchanged parts of two
+   * versions of a map without comparing every entry.
+   */
+  friend bool skipSharedEntries(PersistentMapIterator* a,
+                                PersistentMapIterator* b) {
+    int shared = -1;
+    auto levels = std::min(a->depth_, b->depth_);
+    for (int h = 0; h < levels; ++h) {
+      const auto& la = a->path_[a->depth_ - 1 - h];
+      const auto& lb = b->path_[b->depth_ - 1 - h];
+      if (la.node != lb.node || la.idx != lb.idx) {
+        break;
+      }
+      shared = h;
+    }
+    if (shared < 0) {
+      return false;
+    }
+    a->skip(a->depth_ - 1 - shared);
+    b->skip(b->depth_ - 1 - shared);
+    return true;
+  }
+
+ private:
+  typedef PersistentMapNode<K, V> Node;
+  struct Level {
+    const Node* node;
+    uint32_t idx;
+  };
+  enum : uint32_t {
+    // Every node but the root is at least a quarter full, so this is
+    // enough for many more entries than we will ever have.
+    kMaxDepth = 12,
+  };
+
+  explicit PersistentMapIterator(const Node* root) : root_(root) {}
+
+  void push(const Node* node, uint32_t idx) {
+    CHECK_LT(depth_, kMaxDepth);
+    path_[depth_++] = Level{node, idx};
+  }
+
+  void descendLeft(const Node* node) {
+    while (true) {
+      push(node, 0);
+      if (node->leaf) {
+        return;
+      }
+      node = node->children[0].get();
+    }
+  }
+
+  void descendRight(const Node* node) {
+    while (true) {
+      push(node, node->count() - 1);
+      if (node->leaf) {
+        return;
+      }
+      node = node->children.back().get();
+    }
+  }
+
+  /*
+   * Move to the next position of the node at path_[level], dropping
+   * everything below it.
+   */
+  void advance(int level) {
+    depth_ = level + 1;
+    while (depth_ > 0) {
+      auto& cur = path_[depth_ - 1];
+      if (++cur.idx < cur.node->count()) {
+        if (!cur.node->leaf) {
+          descendLeft(cur.node->children[cur.idx].get());
+        }
+        return;
+      }
+      --depth_;
+    }
+  }
+
+  /*
+   * Move past the whole subtree at path_[level].
+   */
+  void skip(int level) {
+    if (level == 0) {
+      depth_ = 0;
+    } else {
+      advance(level - 1);
+    }
+  }
+
+  void retreat() {
+    if (depth_ == 0) {
+      CHECK(root_);
+      descendRight(root_);
+      return;
+    }
+    while (depth_ > 0) {
+      auto& cur = path_[depth_ - 1];
+      if (cur.idx > 0) {
+        --cur.idx;
+        if (!cur.node->leaf) {
+          descendRight(cur.node->children[cur.idx].get());
+        }
+        return;
+      }
+      --depth_;
+    }
+    LOG(FATAL) << "decremented past the beginning of a PersistentMap";
+  }
+
+  const Node* root_{nullptr};
+  std::array<Level, kMaxDepth> path_;
+  uint32_t depth_{0};
+
+  friend class PersistentMap<K, V, kFanout>;
+};
+
+/*
+ * PersistentMap is a sorted map with the subset of the flat_map interface
+ * that NodeMapT needs, implemented as a copy-on-write B+ tree.
+ *
+ * Copying a PersistentMap only copies a pointer to the root, and the copies
+ * share all of their nodes.  A modification copies just the nodes on the
+ * path from the root to the leaf it changes, and only those that are still
+ * shared, so it costs O(kFanout * log(n)) instead of the O(n) of copying a
+ * flat_map.  This makes it suitable for large NodeMaps that change one
+ * entry at a time, such as the ARP and NDP tables.
+ *
+ * Unshared nodes are modified in place.  As with any NodeMap container, a
+ * PersistentMap must not be modified once it is visible to other threads,
+ * and modifications invalidate all iterators.
+ */
+template<typename K, typename V, uint32_t kFanout = 32>
+class PersistentMap {
+ public:
+  typedef K key_type;
+  typedef V mapped_type;
+  typedef std::pair<K, V> value_type;
+  typedef PersistentMapIterator<K, V, kFanout> const_iterator;
+  typedef const_iterator iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+  typedef const_reverse_iterator reverse_iterator;
+
+  PersistentMap() {}
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const_iterator begin() const {
+    const_iterator it(root_.get());
+    if (root_) {
+      it.descendLeft(root_.get());
+    }
+    return it;
+  }
+  const_iterator end() const {
+    return const_iterator(root_.get());
+  }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  const_iterator find(const K& key) const {
+    const_iterator it(root_.get());
+    const Node* node = root_.get();
+    if (!node) {
+      return it;
+    }
+    while (!node->leaf) {
+      auto idx = childIndex(node, key);
+      it.push(node, idx);
+      node = node->children[idx].get();
+    }
+    auto pos = leafIndex(node, key);
+    if (pos == node->values.size() || key < node->values[pos].first) {
+      return end();
+    }
+    it.push(node, pos);
+    return it;
+  }
+
+  size_t count(const K& key) const {
+    return find(key) == end() ? 0 : 1;
+  }
+
+  std::pair<const_iterator, bool> insert(const value_type& value) {
+    auto it = find(value.first);
+    if (it != end()) {
+      return std::make_pair(it, false);
+    }
+    if (!root_) {
+      root_ = std::make_shared<Node>(true);
+    }
+    insertInto(&root_, value);
+    if (root_->count() > kFanout) {
+      auto newRoot = std::make_shared<Node>(false);
+      K sep;
+      auto right = split(root_.get(), &sep);
+      newRoot->children.push_back(std::move(root_));
+      newRoot->children.push_back(std::move(right));
+      newRoot->seps.push_back(std::move(sep));
+      root_ = std::move(newRoot);
+    }
+    ++size_;
+    return std::make_pair(find(value.first), true);
+  }
+
+  template<typename... Args>
+  std::pair<const_iterator, bool> emplace(Args&&... args) {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+
+  V& operator[](const K& key) {
+    if (find(key) == end()) {
+      insert(value_type(key, V()));
+    }
+    Node* node = mutableNode(&root_);
+    while (!node->leaf) {
+      node = mutableNode(&node->children[childIndex(node, key)]);
+    }
+    return node->values[leafIndex(node, key)].second;
+  }
+
+  size_t erase(const K& key) {
+    if (find(key) == end()) {
+      return 0;
+    }
+    eraseFrom(&root_, key);
+    if (root_->count() == 0) {
+      root_.reset();
+    } else if (!root_->leaf && root_->count() == 1) {
+      root_ = root_->children[0];
+    }
+    --size_;
+    return 1;
+  }
+  void erase(const_iterator it) {
+    K key = it->first;
+    erase(key);
+  }
+
+  void clear() {
+    root_.reset();
+    size_ = 0;
+  }
+
+  /*
+   * Call fn on every entry that may have been added or changed since the
+   * last call, and remember that they have all been seen.
+   *
+   * This is what lets NodeMapT::publish() only publish the nodes that are
+   * new in this version of the map: every tree node a modification copies
+   * or changes starts out unpublished, while the subtrees shared with
+   * published versions of the map are skipped without being walked.  So
+   * publishing a clone with a few changes costs O(kFanout * log(n)) per
+   * change.
+   */
+  template<typename Fn>
+  void forEachUnpublished(Fn fn) {
+    if (root_) {
+      visitUnpublished(root_.get(), fn);
+    }
+  }
+
+ private:
+  typedef PersistentMapNode<K, V> Node;
+  enum : uint32_t {
+    kMinFill = kFanout / 4,
+  };
+  static_assert(kMinFill >= 2, "PersistentMap fanout is too small");
+
+  static uint32_t childIndex(const Node* node, const K& key) {
+    return std::upper_bound(node->seps.begin(), node->seps.end(), key) -
+      node->seps.begin();
+  }
+
+  static uint32_t leafIndex(const Node* node, const K& key) {
+    return std::lower_bound(
+        node->values.begin(), node->values.end(), key,
+        [](const value_type& v, const K& k) { return v.first < k; }) -
+      node->values.begin();
+  }
+
+  /*
+   * Return the node *ptr points to, first replacing it with a copy if it is
+   * shared with another map.
+   */
+  static Node* mutableNode(std::shared_ptr<Node>* ptr) {
+    if (ptr->use_count() != 1) {
+      *ptr = std::make_shared<Node>(**ptr);
+    }
+    (*ptr)->published = false;
+    return ptr->get();
+  }
+
+  template<typename Fn>
+  static void visitUnpublished(Node* node, Fn& fn) {
+    if (node->published) {
+      return;
+    }
+    if (node->leaf) {
+      for (auto& value : node->values) {
+        fn(value);
+      }
+    } else {
+      for (auto& child : node->children) {
+        visitUnpublished(child.get(), fn);
+      }
+    }
+    node->published = true;
+  }
+
+  /*
+   * Move the upper half of an overfull node into a new node, storing the
+   * smallest key of the new node in *sep.
+   */
+  static std::shared_ptr<Node> split(Node* node, K* sep) {
+    auto right = std::make_shared<Node>(node->leaf);
+    auto half = node->count() / 2;
+    if (node->leaf) {
+      right->values.assign(node->values.begin() + half, node->values.end());
+      node->values.resize(half);
+      *sep = right->values[0].first;
+    } else {
+      right->children.assign(node->children.begin() + half,
+                             node->children.end());
+      right->seps.assign(node->seps.begin() + half, node->seps.end());
+      *sep = node->seps[half - 1];
+      node->children.resize(half);
+      node->seps.resize(half - 1);
+    }
+    return right;
+  }
+
+  static void insertInto(std::shared_ptr<Node>* ptr, const value_type& value) {
+    auto* node = mutableNode(ptr);
+    if (node->leaf) {
+      node->values.insert(node->values.begin() + leafIndex(node, value.first),
+                          value);
+      return;
+    }
+    auto idx = childIndex(node, value.first);
+    insertInto(&node->children[idx], value);
+    if (node->children[idx]->count() > kFanout) {
+      K sep;
+      auto right = split(mutableNode(&node->children[idx]), &sep);
+      node->children.insert(node->children.begin() + idx + 1,
+                            std::move(right));
+      node->seps.insert(node->seps.begin() + idx, std::move(sep));
+    }
+  }
+
+  static void eraseFrom(std::shared_ptr<Node>* ptr, const K& key) {
+    auto* node = mutableNode(ptr);
+    if (node->leaf) {
+      node->values.erase(node->values.begin() + leafIndex(node, key));
+      return;
+    }
+    auto idx = childIndex(node, key);
+    eraseFrom(&node->children[idx], key);
+    if (node->children[idx]->count() < kMinFill && node->children.size() > 1) {
+      rebalance(node, idx > 0 ? idx - 1 : idx);
+    }
+  }
+
+  /*
+   * Merge children idx and idx + 1 of node, or if they don't fit in one
+   * node, split their entries evenly between them.
+   */
+  static void rebalance(Node* node, uint32_t idx) {
+    auto* left = mutableNode(&node->children[idx]);
+    const auto& right = node->children[idx + 1];
+    if (left->leaf) {
+      left->values.insert(left->values.end(), right->values.begin(),
+                          right->values.end());
+    } else {
+      left->seps.push_back(node->seps[idx]);
+      left->seps.insert(left->seps.end(), right->seps.begin(),
+                        right->seps.end());
+      left->children.insert(left->children.end(), right->children.begin(),
+                            right->children.end());
+    }
+    if (left->count() <= kFanout) {
+      node->children.erase(node->children.begin() + idx + 1);
+      node->seps.erase(node->seps.begin() + idx);
+      return;
+    }
+    node->children[idx + 1] = split(left, &node->seps[idx]);
+  }
+
+  std::shared_ptr<Node> root_;
+  size_t size_{0};
+};
+
+template<typename K, typename V, uint32_t kFanout, typename Fn>
+void forEachUnpublished(PersistentMap<K, V, kFanout>& map, Fn fn) {
+  map.forEachUnpublished([&](std::pair<K, V>& value) {
+    fn(value.second.get());
+  });
+}
+
+}} // facebook::fboss
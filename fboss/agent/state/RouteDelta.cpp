@@ -13,6 +13,59 @@
 
 namespace facebook { namespace fboss {
 
+namespace {
+
+/*
+ * Box both RIBs into NodeMaps and walk the differences between them.
+ */
+template<typename AddrT>
+DeltaList<Route<AddrT>> computeRoutesDelta(
+    const RouteTableRib<AddrT>* oldRib,
+    const RouteTableRib<AddrT>* newRib) {
+  using NodeMapRib = RouteTableRibNodeMap<AddrT>;
+  using RoutesMapDelta = NodeMapDelta<NodeMapRib,
+        DeltaValue<typename NodeMapRib::Node>,
+        MapUniquePointerTraits<NodeMapRib>>;
+
+  if (oldRib == newRib) {
+    // e.g. only the other address family changed in this table
+    return DeltaList<Route<AddrT>>();
+  }
+  std::unique_ptr<NodeMapRib> oldMap, newMap;
+  if (oldRib) {
+    oldMap.reset(new NodeMapRib());
+    oldMap->addRoutes(*oldRib);
+  }
+  if (newRib) {
+    newMap.reset(new NodeMapRib());
+    newMap->addRoutes(*newRib);
+  }
+  return DeltaList<Route<AddrT>>(
+      RoutesMapDelta(std::move(oldMap), std::move(newMap)));
+}
+
+} // unnamed namespace
+
+const RouteTablesDelta::RoutesV4Delta&
+RouteTablesDelta::getRoutesV4Delta() const {
+  std::call_once(routes_->v4Once, [this] {
+    routes_->v4 = computeRoutesDelta<folly::IPAddressV4>(
+        getOld() ? getOld()->getRibV4().get() : nullptr,
+        getNew() ? getNew()->getRibV4().get() : nullptr);
+  });
+  return routes_->v4;
+}
+
+const RouteTablesDelta::RoutesV6Delta&
+RouteTablesDelta::getRoutesV6Delta() const {
+  std::call_once(routes_->v6Once, [this] {
+    routes_->v6 = computeRoutesDelta<folly::IPAddressV6>(
+        getOld() ? getOld()->getRibV6().get() : nullptr,
+        getNew() ? getNew()->getRibV6().get() : nullptr);
+  });
+  return routes_->v6;
+}
+
 template class NodeMapDelta<RouteTableMap, RouteTablesDelta>;
 
 }}
@@ -9,53 +9,58 @@
  */
 #pragma once
 
+#include <memory>
+#include <mutex>
+
+#include "fboss/agent/state/DeltaList.h"
 #include "fboss/agent/state/NodeMapDelta.h"
+#include "fboss/agent/state/Route.h"
 #include "fboss/agent/state/RouteTableRib.h"
 #include "fboss/agent/state/RouteTable.h"
 #include "fboss/agent/state/RouteTableMap.h"
 
-
 namespace facebook { namespace fboss {
 
+/*
+ * The change to a single RouteTable.
+ *
+ * The route-level deltas are computed the first time they are requested and
+ * then saved, so that all copies of this RouteTablesDelta share them. This
+ * is safe to call from multiple threads at once.
+ */
 class RouteTablesDelta : public DeltaValue<RouteTable> {
  public:
   using NodeMapRibV4 = RouteTableRibNodeMap<folly::IPAddressV4>;
   using NodeMapRibV6 = RouteTableRibNodeMap<folly::IPAddressV6>;
-  using RoutesV4Delta = NodeMapDelta<NodeMapRibV4,
-        DeltaValue<NodeMapRibV4::Node>,
-        MapUniquePointerTraits<NodeMapRibV4>>;
-  using RoutesV6Delta = NodeMapDelta<NodeMapRibV6,
-        DeltaValue<NodeMapRibV6::Node>,
-        MapUniquePointerTraits<NodeMapRibV6>>;
-
-  using DeltaValue<RouteTable>::DeltaValue;
-
-  RoutesV4Delta getRoutesV4Delta() const {
-    std::unique_ptr<NodeMapRibV4> oldRib, newRib;
-    if (getOld()) {
-      oldRib.reset(new NodeMapRibV4());
-      oldRib->addRoutes(*(getOld()->getRibV4()));
-    }
-    if (getNew()) {
-      newRib.reset(new NodeMapRibV4());
-      newRib->addRoutes(*(getNew()->getRibV4()));
-    }
-    return RoutesV4Delta(std::move(oldRib), std::move(newRib));
-  }
-  RoutesV6Delta getRoutesV6Delta()  const {
-    std::unique_ptr<NodeMapRibV6> oldRib, newRib;
-    if (getOld()) {
-      oldRib.reset(new NodeMapRibV6());
-      oldRib->addRoutes(*(getOld()->getRibV6()));
-    }
-    if (getNew()) {
-      newRib.reset(new NodeMapRibV6());
-      newRib->addRoutes(*(getNew()->getRibV6()));
-    }
-    return RoutesV6Delta(std::move(oldRib), std::move(newRib));
+  using RoutesV4Delta = DeltaList<RouteV4>;
+  using RoutesV6Delta = DeltaList<RouteV6>;
+
+  RouteTablesDelta(const std::shared_ptr<RouteTable>& o,
+                   const std::shared_ptr<RouteTable>& n)
+    : DeltaValue<RouteTable>(o, n),
+      routes_(std::make_shared<Routes>()) {}
+
+  void reset(const std::shared_ptr<RouteTable>& o,
+             const std::shared_ptr<RouteTable>& n) {
+    DeltaValue<RouteTable>::reset(o, n);
+    routes_ = std::make_shared<Routes>();
   }
+
+  const RoutesV4Delta& getRoutesV4Delta() const;
+  const RoutesV6Delta& getRoutesV6Delta() const;
+
+ private:
+  struct Routes {
+    std::once_flag v4Once;
+    std::once_flag v6Once;
+    RoutesV4Delta v4;
+    RoutesV6Delta v6;
+  };
+
+  std::shared_ptr<Routes> routes_;
 };
 
 typedef NodeMapDelta<RouteTableMap, RouteTablesDelta> RTMapDelta;
+typedef DeltaList<RouteTable, RouteTablesDelta> RouteTablesDeltaList;
 
 }}
@@ -40,18 +40,35 @@ NodeMapDelta<PortMap> StateDelta::getPortsDelta() const {
                                new_->getPorts().get());
 }
 
-VlanMapDelta StateDelta::getVlansDelta() const {
-  return VlanMapDelta(old_->getVlans().get(), new_->getVlans().get());
+const VlanDeltaList& StateDelta::getVlansDelta() const {
+  std::call_once(vlansOnce_, [this] {
+    vlansDelta_ = VlanDeltaList(
+        VlanMapDelta(old_->getVlans().get(), new_->getVlans().get()));
+  });
+  return vlansDelta_;
 }
 
-NodeMapDelta<InterfaceMap> StateDelta::getIntfsDelta() const {
-  return NodeMapDelta<InterfaceMap>(old_->getInterfaces().get(),
-                                    new_->getInterfaces().get());
+const InterfaceDeltaList& StateDelta::getIntfsDelta() const {
+  std::call_once(intfsOnce_, [this] {
+    intfsDelta_ = InterfaceDeltaList(NodeMapDelta<InterfaceMap>(
+        old_->getInterfaces().get(), new_->getInterfaces().get()));
+  });
+  return intfsDelta_;
 }
 
-RTMapDelta StateDelta::getRouteTablesDelta() const {
-  return RTMapDelta(old_->getRouteTables().get(),
-                    new_->getRouteTables().get());
+const RouteTablesDeltaList& StateDelta::getRouteTablesDelta() const {
+  std::call_once(routeTablesOnce_, [this] {
+    routeTablesDelta_ = RouteTablesDeltaList(RTMapDelta(
+        old_->getRouteTables().get(), new_->getRouteTables().get()));
+  });
+  return routeTablesDelta_;
+}
+
+void StateDelta::prefetchRoutes() const {
+  for (const auto& rtDelta : getRouteTablesDelta()) {
+    rtDelta.getRoutesV4Delta();
+    rtDelta.getRoutesV6Delta();
+  }
 }
 
 NodeMapDelta<AclMap> StateDelta::getAclsDelta() const {
@@ -11,9 +11,11 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
 
 #include "fboss/agent/state/AclMap.h"
 #include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/DeltaList.h"
 #include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/PortMap.h"
 #include "fboss/agent/state/NodeMapDelta.h"
@@ -24,9 +26,19 @@ namespace facebook { namespace fboss {
 
 class SwitchState;
 
+typedef DeltaList<Vlan, VlanDelta> VlanDeltaList;
+typedef DeltaList<Interface> InterfaceDeltaList;
+
 /*
  * StateDelta contains code for examining the differences between two
  * SwitchStates.
+ *
+ * The VLAN, interface and route table deltas are computed once, the first
+ * time they are requested, and the resulting change lists are shared by all
+ * later callers: the HwSwitch and every StateObserver see the same
+ * StateDelta for an update. The getters are safe to call concurrently, so
+ * prefetchRoutes() can compute the route deltas on another thread while the
+ * first consumer gets on with something else.
  */
 class StateDelta {
  public:
@@ -45,11 +57,17 @@ class StateDelta {
   }
 
   NodeMapDelta<PortMap> getPortsDelta() const;
-  VlanMapDelta getVlansDelta() const;
-  NodeMapDelta<InterfaceMap> getIntfsDelta() const;
-  RTMapDelta getRouteTablesDelta() const;
+  const VlanDeltaList& getVlansDelta() const;
+  const InterfaceDeltaList& getIntfsDelta() const;
+  const RouteTablesDeltaList& getRouteTablesDelta() const;
   NodeMapDelta<AclMap> getAclsDelta() const;
 
+  /*
+   * Compute the route table delta, including the per-table route deltas,
+   * so that later calls to getRouteTablesDelta() don't have to.
+   */
+  void prefetchRoutes() const;
+
  private:
   // Forbidden copy constructor and assignment operator
   StateDelta(StateDelta const &) = delete;
@@ -57,6 +75,13 @@ class StateDelta {
 
   std::shared_ptr<SwitchState> old_;
   std::shared_ptr<SwitchState> new_;
+
+  mutable std::once_flag vlansOnce_;
+  mutable std::once_flag intfsOnce_;
+  mutable std::once_flag routeTablesOnce_;
+  mutable VlanDeltaList vlansDelta_;
+  mutable InterfaceDeltaList intfsDelta_;
+  mutable RouteTablesDeltaList routeTablesDelta_;
 };
 
 }} // facebook::fboss
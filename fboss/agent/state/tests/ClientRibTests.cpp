@@ -0,0 +1,226 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/ClientRib.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const RouterID kRid(0);
+const ClientRib::ClientID kBgp = 0;
+const ClientRib::ClientID kOpenr = 1;
+
+ClientRib::Prefix prefix(const std::string& addr, uint8_t len) {
+  return ClientRib::Prefix(kRid, IPAddress(addr), len);
+}
+
+RouteNextHops nexthops(const std::string& nh) {
+  RouteNextHops nhops;
+  nhops.emplace(IPAddress(nh));
+  return nhops;
+}
+
+shared_ptr<RouteV4> findRoute(const shared_ptr<RouteTableMap>& tables,
+                              const std::string& addr, uint8_t len) {
+  auto table = tables->getRouteTableIf(kRid);
+  if (!table) {
+    return nullptr;
+  }
+  return table->getRibV4()->exactMatch(
+      RoutePrefixV4{IPAddressV4(addr), len});
+}
+
+} // unnamed namespace
+
+TEST(ClientRib, AdminDistance) {
+  ClientRib rib;
+  auto tables = make_shared<SwitchState>()->getRouteTables();
+
+  RouteUpdater u1(tables);
+  rib.setAdminDistance(kBgp, 20, &u1);
+  rib.setAdminDistance(kOpenr, 10, &u1);
+  rib.addRoute(kBgp, prefix("10.0.0.0", 24), nexthops("1.1.1.1"), &u1);
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  auto route = findRoute(tables1, "10.0.0.0", 24);
+  ASSERT_NE(nullptr, route);
+  EXPECT_TRUE(route->isSame(nexthops("1.1.1.1")));
+  tables1->publish();
+
+  // The client with the lower admin distance takes over the prefix
+  RouteUpdater u2(tables1);
+  rib.addRoute(kOpenr, prefix("10.0.0.0", 24), nexthops("2.2.2.2"), &u2);
+  auto tables2 = u2.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  EXPECT_TRUE(findRoute(tables2, "10.0.0.0", 24)->isSame(nexthops("2.2.2.2")));
+  EXPECT_EQ(kOpenr, *rib.getWinner(prefix("10.0.0.0", 24)));
+  tables2->publish();
+
+  // A change to the losing route doesn't touch the FIB
+  RouteUpdater u3(tables2);
+  rib.addRoute(kBgp, prefix("10.0.0.0", 24), nexthops("3.3.3.3"), &u3);
+  EXPECT_EQ(nullptr, u3.updateDone());
+
+  // Withdrawing the winner falls back to the other client's route
+  RouteUpdater u4(tables2);
+  rib.delRoute(kOpenr, prefix("10.0.0.0", 24), &u4);
+  auto tables4 = u4.updateDone();
+  ASSERT_NE(nullptr, tables4);
+  EXPECT_TRUE(findRoute(tables4, "10.0.0.0", 24)->isSame(nexthops("3.3.3.3")));
+  EXPECT_EQ(kBgp, *rib.getWinner(prefix("10.0.0.0", 24)));
+  tables4->publish();
+
+  // And withdrawing the last one removes the prefix
+  RouteUpdater u5(tables4);
+  rib.delRoute(kBgp, prefix("10.0.0.0", 24), &u5);
+  auto tables5 = u5.updateDone();
+  ASSERT_NE(nullptr, tables5);
+  EXPECT_EQ(nullptr, findRoute(tables5, "10.0.0.0", 24));
+  EXPECT_EQ(nullptr, rib.getWinner(prefix("10.0.0.0", 24)));
+}
+
+TEST(ClientRib, SyncClient) {
+  ClientRib rib;
+  auto tables = make_shared<SwitchState>()->getRouteTables();
+
+  ClientRib::RouteSet routes;
+  routes[prefix("10.0.0.0", 24)] = nexthops("1.1.1.1");
+  routes[prefix("10.0.1.0", 24)] = nexthops("1.1.1.1");
+  routes[prefix("10.0.2.0", 24)] = RouteNextHops();
+  RouteUpdater u1(tables);
+  rib.syncClient(kBgp, routes, &u1);
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  EXPECT_NE(nullptr, findRoute(tables1, "10.0.0.0", 24));
+  EXPECT_NE(nullptr, findRoute(tables1, "10.0.1.0", 24));
+  EXPECT_TRUE(findRoute(tables1, "10.0.2.0", 24)->isDrop());
+  tables1->publish();
+
+  // Re-syncing the same routes, as a restarted daemon would, changes nothing
+  RouteUpdater u2(tables1);
+  rib.syncClient(kBgp, routes, &u2);
+  EXPECT_EQ(nullptr, u2.updateDone());
+
+  // Only the real differences make it to the FIB
+  auto unchanged = findRoute(tables1, "10.0.0.0", 24);
+  routes.erase(prefix("10.0.1.0", 24));
+  routes[prefix("10.0.2.0", 24)] = nexthops("2.2.2.2");
+  routes[prefix("10.0.3.0", 24)] = nexthops("2.2.2.2");
+  RouteUpdater u3(tables1);
+  rib.syncClient(kBgp, routes, &u3);
+  auto tables3 = u3.updateDone();
+  ASSERT_NE(nullptr, tables3);
+  EXPECT_EQ(unchanged, findRoute(tables3, "10.0.0.0", 24));
+  EXPECT_EQ(nullptr, findRoute(tables3, "10.0.1.0", 24));
+  EXPECT_TRUE(findRoute(tables3, "10.0.2.0", 24)->isSame(nexthops("2.2.2.2")));
+  EXPECT_NE(nullptr, findRoute(tables3, "10.0.3.0", 24));
+  EXPECT_EQ(3, rib.getClientRoutes(kBgp)->size());
+}
+
+TEST(ClientRib, SyncDoesNotAffectOtherClients) {
+  ClientRib rib;
+  auto tables = make_shared<SwitchState>()->getRouteTables();
+
+  RouteUpdater u1(tables);
+  rib.addRoute(kOpenr, prefix("10.0.0.0", 24), nexthops("1.1.1.1"), &u1);
+  rib.addRoute(kBgp, prefix("10.0.1.0", 24), nexthops("2.2.2.2"), &u1);
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  tables1->publish();
+
+  // An empty sync withdraws only that client's routes
+  RouteUpdater u2(tables1);
+  rib.syncClient(kBgp, ClientRib::RouteSet(), &u2);
+  auto tables2 = u2.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  EXPECT_NE(nullptr, findRoute(tables2, "10.0.0.0", 24));
+  EXPECT_EQ(nullptr, findRoute(tables2, "10.0.1.0", 24));
+}
+
+TEST(ClientRib, Rollback) {
+  ClientRib rib;
+  auto tables = make_shared<SwitchState>()->getRouteTables();
+
+  RouteUpdater u1(tables);
+  rib.addRoute(kBgp, prefix("10.0.0.0", 24), nexthops("1.1.1.1"), &u1);
+  rib.addRoute(kBgp, prefix("10.0.1.0", 24), nexthops("1.1.1.1"), &u1);
+  rib.addRoute(kOpenr, prefix("10.0.1.0", 24), nexthops("2.2.2.2"), &u1);
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  tables1->publish();
+  rib.commit();
+
+  // A link local prefix makes the update fail partway through
+  RouteUpdater u2(tables1);
+  rib.setAdminDistance(kBgp, 200, &u2);
+  rib.addRoute(kBgp, prefix("10.0.0.0", 24), nexthops("3.3.3.3"), &u2);
+  rib.delRoute(kBgp, prefix("10.0.1.0", 24), &u2);
+  rib.syncClient(kOpenr, ClientRib::RouteSet(), &u2);
+  rib.addRoute(kBgp, prefix("10.0.2.0", 24), nexthops("1.1.1.1"), &u2);
+  EXPECT_THROW(rib.addRoute(kBgp, prefix("fe80::", 64), nexthops("1.1.1.1"),
+                            &u2),
+               FbossError);
+  rib.rollback();
+
+  // Everything is back the way the FIB has it
+  EXPECT_EQ(ClientRib::kDefaultAdminDistance, rib.getAdminDistance(kBgp));
+  const auto& bgpRoutes = *rib.getClientRoutes(kBgp);
+  ASSERT_EQ(2, bgpRoutes.size());
+  EXPECT_EQ(nexthops("1.1.1.1"), bgpRoutes.at(prefix("10.0.0.0", 24)));
+  EXPECT_EQ(nexthops("1.1.1.1"), bgpRoutes.at(prefix("10.0.1.0", 24)));
+  EXPECT_EQ(1, rib.getClientRoutes(kOpenr)->size());
+  EXPECT_EQ(kBgp, *rib.getWinner(prefix("10.0.1.0", 24)));
+  EXPECT_EQ(nullptr, rib.getWinner(prefix("10.0.2.0", 24)));
+  EXPECT_EQ(nullptr, rib.getWinner(prefix("fe80::", 64)));
+
+  // So a resync with the same routes still has nothing to do
+  ClientRib::RouteSet routes = bgpRoutes;
+  RouteUpdater u3(tables1);
+  rib.syncClient(kBgp, routes, &u3);
+  EXPECT_EQ(nullptr, u3.updateDone());
+}
+
+TEST(ClientRib, SetAdminDistances) {
+  ClientRib rib;
+  auto tables = make_shared<SwitchState>()->getRouteTables();
+
+  RouteUpdater u1(tables);
+  rib.setAdminDistance(kBgp, 20, &u1);
+  rib.setAdminDistance(kOpenr, 10, &u1);
+  rib.addRoute(kBgp, prefix("10.0.0.0", 24), nexthops("1.1.1.1"), &u1);
+  rib.addRoute(kOpenr, prefix("10.0.0.0", 24), nexthops("2.2.2.2"), &u1);
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  tables1->publish();
+  EXPECT_EQ(kOpenr, *rib.getWinner(prefix("10.0.0.0", 24)));
+
+  // A new config re-ranks the routes both clients already have
+  std::map<ClientRib::ClientID, int32_t> distances = {{kBgp, 5}};
+  RouteUpdater u2(tables1);
+  rib.setAdminDistances(distances, &u2);
+  auto tables2 = u2.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  EXPECT_EQ(kBgp, *rib.getWinner(prefix("10.0.0.0", 24)));
+  EXPECT_TRUE(findRoute(tables2, "10.0.0.0", 24)->isSame(nexthops("1.1.1.1")));
+  EXPECT_EQ(ClientRib::kDefaultAdminDistance, rib.getAdminDistance(kOpenr));
+}
@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ApplyThriftConfig.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/test/TestUtils.h"
+#include "fboss/agent/hw/mock/MockPlatform.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/ArpResponseTable.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/gen-cpp/switch_config_types.h"
+
+#include <folly/Conv.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+using folly::to;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const int kNumVlans = 10;
+
+/*
+ * VLANs 1 to kNumVlans, each with one port and one interface on it.
+ */
+cfg::SwitchConfig makeConfig() {
+  cfg::SwitchConfig config;
+  config.defaultVlan = 1;
+  config.ports.resize(kNumVlans);
+  config.vlans.resize(kNumVlans);
+  config.vlanPorts.resize(kNumVlans);
+  config.interfaces.resize(kNumVlans);
+  for (int idx = 0; idx < kNumVlans; ++idx) {
+    int id = idx + 1;
+    config.ports[idx].logicalID = id;
+    config.ports[idx].state = cfg::PortState::UP;
+    config.ports[idx].ingressVlan = id;
+    config.vlans[idx].id = id;
+    config.vlans[idx].name = to<std::string>("Vlan", id);
+    config.vlans[idx].intfID = id;
+    config.vlans[idx].__isset.intfID = true;
+    config.vlanPorts[idx].vlanID = id;
+    config.vlanPorts[idx].logicalPort = id;
+    auto* intf = &config.interfaces[idx];
+    intf->intfID = id;
+    intf->vlanID = id;
+    intf->mac = "00:02:00:11:22:33";
+    intf->__isset.mac = true;
+    intf->ipAddresses.push_back(to<std::string>("10.0.", id, ".1/24"));
+  }
+  config.acls.resize(1);
+  config.acls[0].id = 100;
+  config.acls[0].action = cfg::AclAction::DENY;
+  config.acls[0].srcIp = "10.0.0.0/8";
+  config.acls[0].__isset.srcIp = true;
+  config.__isset.acls = true;
+  return config;
+}
+
+shared_ptr<SwitchState> makeInitialState() {
+  auto state = make_shared<SwitchState>();
+  for (int id = 1; id <= kNumVlans; ++id) {
+    state->registerPort(PortID(id), to<std::string>("port", id));
+  }
+  return state;
+}
+
+/*
+ * Apply newConfig on top of the state built from prevConfig, both with and
+ * without telling applyThriftConfig() what the previous config was, and
+ * check that the two results are identical.
+ */
+shared_ptr<SwitchState> applyBothWays(MockPlatform* platform,
+                                      shared_ptr<SwitchState>& state,
+                                      const cfg::SwitchConfig& prevConfig,
+                                      const cfg::SwitchConfig& newConfig) {
+  auto full = publishAndApplyConfig(state, &newConfig, platform);
+  auto incremental = publishAndApplyConfig(state, &newConfig, platform,
+                                           &prevConfig);
+  EXPECT_EQ(full == nullptr, incremental == nullptr);
+  if (full && incremental) {
+    EXPECT_EQ(full->toFollyDynamic(), incremental->toFollyDynamic());
+  }
+  return incremental;
+}
+
+} // unnamed namespace
+
+TEST(IncrementalConfig, unchangedConfig) {
+  MockPlatform platform;
+  auto stateV0 = makeInitialState();
+  auto config = makeConfig();
+  auto stateV1 = publishAndApplyConfig(stateV0, &config, &platform);
+  ASSERT_NE(nullptr, stateV1);
+
+  EXPECT_EQ(nullptr, publishAndApplyConfig(stateV1, &config, &platform,
+                                           &config));
+}
+
+TEST(IncrementalConfig, portChange) {
+  MockPlatform platform;
+  auto stateV0 = makeInitialState();
+  auto configV1 = makeConfig();
+  auto stateV1 = publishAndApplyConfig(stateV0, &configV1, &platform);
+  ASSERT_NE(nullptr, stateV1);
+
+  auto configV2 = configV1;
+  configV2.ports[3].state = cfg::PortState::DOWN;
+  auto stateV2 = applyBothWays(&platform, stateV1, configV1, configV2);
+  ASSERT_NE(nullptr, stateV2);
+  EXPECT_EQ(cfg::PortState::DOWN,
+            stateV2->getPorts()->getPort(PortID(4))->getState());
+  // Nothing outside of the ports was touched
+  EXPECT_EQ(stateV1->getVlans(), stateV2->getVlans());
+  EXPECT_EQ(stateV1->getInterfaces(), stateV2->getInterfaces());
+  EXPECT_EQ(stateV1->getRouteTables(), stateV2->getRouteTables());
+  EXPECT_EQ(stateV1->getAcls(), stateV2->getAcls());
+}
+
+TEST(IncrementalConfig, interfaceChange) {
+  MockPlatform platform;
+  auto stateV0 = makeInitialState();
+  auto configV1 = makeConfig();
+  auto stateV1 = publishAndApplyConfig(stateV0, &configV1, &platform);
+  ASSERT_NE(nullptr, stateV1);
+
+  // The VLAN's neighbor response table follows the interface address
+  auto configV2 = configV1;
+  configV2.interfaces[4].ipAddresses[0] = "10.1.5.1/24";
+  auto stateV2 = applyBothWays(&platform, stateV1, configV1, configV2);
+  ASSERT_NE(nullptr, stateV2);
+  auto arpResponses =
+    stateV2->getVlans()->getVlan(VlanID(5))->getArpResponseTable();
+  EXPECT_TRUE(arpResponses->getEntry(IPAddressV4("10.1.5.1")).hasValue());
+  EXPECT_FALSE(arpResponses->getEntry(IPAddressV4("10.0.5.1")).hasValue());
+  EXPECT_EQ(stateV1->getPorts(), stateV2->getPorts());
+  EXPECT_EQ(stateV1->getAcls(), stateV2->getAcls());
+}
+
+TEST(IncrementalConfig, vlanAndAclChange) {
+  MockPlatform platform;
+  auto stateV0 = makeInitialState();
+  auto configV1 = makeConfig();
+  auto stateV1 = publishAndApplyConfig(stateV0, &configV1, &platform);
+  ASSERT_NE(nullptr, stateV1);
+
+  auto configV2 = configV1;
+  configV2.vlans[2].name = "renamed";
+  configV2.acls.clear();
+  auto stateV2 = applyBothWays(&platform, stateV1, configV1, configV2);
+  ASSERT_NE(nullptr, stateV2);
+  EXPECT_EQ("renamed", stateV2->getVlans()->getVlan(VlanID(3))->getName());
+  EXPECT_EQ(0, stateV2->getAcls()->size());
+  EXPECT_EQ(stateV1->getPorts(), stateV2->getPorts());
+  EXPECT_EQ(stateV1->getInterfaces(), stateV2->getInterfaces());
+
+  // A VLAN the interfaces still refer to can't go away, even though the
+  // interfaces themselves did not change
+  auto configV3 = configV2;
+  configV3.vlans.pop_back();
+  EXPECT_THROW(publishAndApplyConfig(stateV2, &configV3, &platform,
+                                     &configV2), FbossError);
+}
+
+TEST(IncrementalConfig, portChangedOutsideConfig) {
+  MockPlatform platform;
+  auto stateV0 = makeInitialState();
+  auto config = makeConfig();
+  auto stateV1 = publishAndApplyConfig(stateV0, &config, &platform);
+  ASSERT_NE(nullptr, stateV1);
+
+  // Disable a port the way ThriftHandler::setPortState() does
+  stateV1->publish();
+  auto stateV2 = stateV1;
+  stateV2->getPorts()->getPort(PortID(4))->modify(&stateV2)
+    ->setState(cfg::PortState::DOWN);
+  ASSERT_NE(stateV1, stateV2);
+
+  // Reapplying the unchanged config brings it back up
+  auto stateV3 = applyBothWays(&platform, stateV2, config, config);
+  ASSERT_NE(nullptr, stateV3);
+  EXPECT_EQ(cfg::PortState::UP,
+            stateV3->getPorts()->getPort(PortID(4))->getState());
+  EXPECT_EQ(stateV2->getVlans(), stateV3->getVlans());
+  EXPECT_EQ(stateV2->getInterfaces(), stateV3->getInterfaces());
+}
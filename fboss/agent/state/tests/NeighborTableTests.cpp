@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/SwSwitch.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const MacAddress kMac("02:00:00:00:00:01");
+const InterfaceID kIntf(1);
+
+} // unnamed namespace
+
+TEST(NeighborTable, PortIndex) {
+  auto table = make_shared<ArpTable>();
+  table->addEntry(IPAddressV4("10.0.0.1"), kMac, PortID(1), kIntf);
+  table->addEntry(IPAddressV4("10.0.0.2"), kMac, PortID(1), kIntf);
+  table->addEntry(IPAddressV4("10.0.0.3"), kMac, PortID(2), kIntf);
+  EXPECT_TRUE(table->hasEntriesForPort(PortID(1)));
+  EXPECT_TRUE(table->hasEntriesForPort(PortID(2)));
+  EXPECT_FALSE(table->hasEntriesForPort(PortID(3)));
+
+  // Moving an entry moves it in the index too
+  table->updateEntry(IPAddressV4("10.0.0.3"), kMac, PortID(3), kIntf);
+  EXPECT_FALSE(table->hasEntriesForPort(PortID(2)));
+  EXPECT_TRUE(table->hasEntriesForPort(PortID(3)));
+
+  table->removeNode(IPAddressV4("10.0.0.3"));
+  EXPECT_FALSE(table->hasEntriesForPort(PortID(3)));
+
+  EXPECT_TRUE(table->setEntriesPendingForPort(PortID(1)));
+  EXPECT_FALSE(table->hasEntriesForPort(PortID(1)));
+  EXPECT_TRUE(table->getEntry(IPAddressV4("10.0.0.1"))->isPending());
+  EXPECT_TRUE(table->getEntry(IPAddressV4("10.0.0.2"))->isPending());
+  EXPECT_FALSE(table->setEntriesPendingForPort(PortID(1)));
+
+  // Pending entries are indexed under port 0, and go away when pruned
+  EXPECT_TRUE(table->hasEntriesForPort(PortID(0)));
+  EXPECT_TRUE(table->prunePendingEntries());
+  EXPECT_FALSE(table->hasEntriesForPort(PortID(0)));
+  EXPECT_EQ(0, table->size());
+}
+
+TEST(NeighborTable, PortIndexSerialization) {
+  auto table = make_shared<ArpTable>();
+  table->addEntry(IPAddressV4("10.0.0.1"), kMac, PortID(1), kIntf);
+  table->addPendingEntry(IPAddressV4("10.0.0.2"), kIntf);
+
+  auto table2 = ArpTable::fromFollyDynamic(table->toFollyDynamic());
+  EXPECT_TRUE(table2->hasEntriesForPort(PortID(1)));
+  EXPECT_TRUE(table2->hasEntriesForPort(PortID(0)));
+  EXPECT_TRUE(table2->setEntriesPendingForPort(PortID(1)));
+  EXPECT_TRUE(table2->getEntry(IPAddressV4("10.0.0.1"))->isPending());
+}
+
+TEST(NeighborTable, PortDownOnlyModifiesAffectedVlans) {
+  auto state = make_shared<SwitchState>();
+  for (int i = 1; i <= 3; ++i) {
+    auto vlan = make_shared<Vlan>(VlanID(i), "vlan");
+    auto arpTable = make_shared<ArpTable>();
+    arpTable->addEntry(IPAddressV4("10.0.0.1"), kMac, PortID(i), kIntf);
+    vlan->setArpTable(arpTable);
+    state->addVlan(vlan);
+  }
+  state->publish();
+
+  EXPECT_EQ(nullptr, SwSwitch::setNeighborsPendingForPort(state, PortID(9)));
+
+  auto newState = SwSwitch::setNeighborsPendingForPort(state, PortID(2));
+  ASSERT_NE(nullptr, newState);
+  auto oldVlans = state->getVlans();
+  auto newVlans = newState->getVlans();
+  EXPECT_EQ(oldVlans->getVlan(VlanID(1)), newVlans->getVlan(VlanID(1)));
+  EXPECT_EQ(oldVlans->getVlan(VlanID(3)), newVlans->getVlan(VlanID(3)));
+  auto vlan2 = newVlans->getVlan(VlanID(2));
+  EXPECT_NE(oldVlans->getVlan(VlanID(2)), vlan2);
+  EXPECT_TRUE(vlan2->getArpTable()->getEntry(
+        IPAddressV4("10.0.0.1"))->isPending());
+}
@@ -0,0 +1,473 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/PersistentMap.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/state/ArpEntry.h"
+#include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/NeighborEntry-defs.h"
+#include "fboss/agent/state/NodeMap-defs.h"
+#include "fboss/agent/state/NodeMapDelta.h"
+#include "fboss/agent/state/NodeMapDelta-defs.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+// A small fanout, so that the tests exercise deep trees
+typedef PersistentMap<int, int, 8> TestMap;
+
+void checkSame(const std::map<int, int>& expected, const TestMap& map) {
+  ASSERT_EQ(expected.size(), map.size());
+  auto it = map.begin();
+  for (const auto& entry : expected) {
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(entry.first, it->first);
+    EXPECT_EQ(entry.second, it->second);
+    ++it;
+  }
+  EXPECT_TRUE(it == map.end());
+
+  auto rit = map.rbegin();
+  for (auto eit = expected.rbegin(); eit != expected.rend(); ++eit) {
+    ASSERT_TRUE(rit != map.rend());
+    EXPECT_EQ(eit->first, rit->first);
+    EXPECT_EQ(eit->second, rit->second);
+    ++rit;
+  }
+  EXPECT_TRUE(rit == map.rend());
+}
+
+/*
+ * Two NodeMaps holding the same entries, one in each kind of container.
+ */
+template<typename Container>
+struct TestArpMapTraits : public NodeMapTraits<IPAddressV4, ArpEntry> {
+  typedef Container NodeContainer;
+
+  static IPAddressV4 getKey(const shared_ptr<ArpEntry>& entry) {
+    return entry->getIP();
+  }
+};
+typedef TestArpMapTraits<boost::container::flat_map<
+  IPAddressV4, shared_ptr<ArpEntry>>> FlatArpMapTraits;
+typedef TestArpMapTraits<PersistentMap<
+  IPAddressV4, shared_ptr<ArpEntry>>> PersistentArpMapTraits;
+
+class FlatArpMap : public NodeMapT<FlatArpMap, FlatArpMapTraits> {
+ public:
+  FlatArpMap() {}
+
+ private:
+  using NodeMapT::NodeMapT;
+  friend class CloneAllocator;
+};
+
+class PersistentArpMap
+  : public NodeMapT<PersistentArpMap, PersistentArpMapTraits> {
+ public:
+  PersistentArpMap() {}
+
+ private:
+  using NodeMapT::NodeMapT;
+  friend class CloneAllocator;
+};
+
+shared_ptr<ArpEntry> makeEntry(uint32_t n, PortID port = PortID(1)) {
+  return make_shared<ArpEntry>(IPAddressV4::fromLongHBO(0x0a000000 | n),
+                               MacAddress("02:00:00:00:00:01"), port,
+                               InterfaceID(1));
+}
+
+template<typename MapT>
+std::vector<std::pair<uint32_t, uint32_t>> getChanges(
+    const shared_ptr<MapT>& oldMap, const shared_ptr<MapT>& newMap) {
+  std::vector<std::pair<uint32_t, uint32_t>> changes;
+  NodeMapDelta<MapT> delta(oldMap.get(), newMap.get());
+  for (const auto& entry : delta) {
+    auto oldEntry = entry.getOld();
+    auto newEntry = entry.getNew();
+    changes.emplace_back(oldEntry ? oldEntry->getIP().toLongHBO() : 0,
+                         newEntry ? newEntry->getIP().toLongHBO() : 0);
+  }
+  return changes;
+}
+
+IPAddressV4 makeIP(uint32_t n) {
+  return IPAddressV4::fromLongHBO(0x0a000000 | n);
+}
+
+/*
+ * The generic NodeMap tests run once with each container.
+ */
+template<typename MapT>
+class NodeMapTest : public ::testing::Test {};
+typedef ::testing::Types<FlatArpMap, PersistentArpMap> ArpMapTypes;
+
+} // unnamed namespace
+
+TYPED_TEST_CASE(NodeMapTest, ArpMapTypes);
+
+namespace facebook { namespace fboss {
+FBOSS_INSTANTIATE_NODE_MAP(FlatArpMap, FlatArpMapTraits);
+FBOSS_INSTANTIATE_NODE_MAP(PersistentArpMap, PersistentArpMapTraits);
+}}
+
+TEST(PersistentMap, InsertErase) {
+  std::map<int, int> expected;
+  TestMap map;
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> keys(0, 2000);
+  for (int i = 0; i < 20000; ++i) {
+    auto key = keys(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(expected.erase(key), map.erase(key));
+    } else {
+      auto ret = map.insert(std::make_pair(key, i));
+      EXPECT_EQ(expected.insert(std::make_pair(key, i)).second, ret.second);
+      EXPECT_EQ(expected[key], ret.first->second);
+    }
+    if (i % 1000 == 0) {
+      checkSame(expected, map);
+    }
+  }
+  checkSame(expected, map);
+
+  for (const auto& entry : expected) {
+    auto it = map.find(entry.first);
+    ASSERT_TRUE(it != map.end());
+    EXPECT_EQ(entry.second, it->second);
+  }
+  EXPECT_TRUE(map.find(-1) == map.end());
+  EXPECT_TRUE(map.find(2001) == map.end());
+
+  for (const auto& entry : expected) {
+    map.erase(entry.first);
+  }
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+}
+
+TEST(PersistentMap, CopiesAreIndependent) {
+  std::map<int, int> expected;
+  TestMap map;
+  for (int i = 0; i < 1000; ++i) {
+    map.insert(std::make_pair(i, i));
+    expected[i] = i;
+  }
+
+  auto copy = map;
+  std::map<int, int> expectedCopy = expected;
+  for (int i = 0; i < 1000; i += 7) {
+    copy.erase(i);
+    expectedCopy.erase(i);
+  }
+  copy[3] = 42;
+  expectedCopy[3] = 42;
+  copy.insert(std::make_pair(5000, 1));
+  expectedCopy[5000] = 1;
+
+  checkSame(expected, map);
+  checkSame(expectedCopy, copy);
+}
+
+TEST(PersistentMap, SkipShared) {
+  TestMap map;
+  for (int i = 0; i < 1000; ++i) {
+    map.insert(std::make_pair(i, i));
+  }
+  auto copy = map;
+  copy[500] = -1;
+
+  // Walking the two maps in step only has to look at a few entries on each
+  // side of the one that changed.
+  auto a = map.begin();
+  auto b = copy.begin();
+  int compared = 0;
+  std::vector<int> diffs;
+  while (a != map.end() && b != copy.end()) {
+    if (skipSharedEntries(&a, &b)) {
+      continue;
+    }
+    ++compared;
+    if (*a != *b) {
+      diffs.push_back(a->first);
+    }
+    ++a;
+    ++b;
+  }
+  EXPECT_TRUE(a == map.end());
+  EXPECT_TRUE(b == copy.end());
+  EXPECT_EQ(std::vector<int>{500}, diffs);
+  EXPECT_LE(compared, 8);
+}
+
+TYPED_TEST(NodeMapTest, AddGetRemove) {
+  auto map = make_shared<TypeParam>();
+  EXPECT_EQ(0, map->getGeneration());
+  EXPECT_FALSE(map->isPublished());
+  EXPECT_EQ(0, map->size());
+
+  for (uint32_t i = 1; i <= 4; ++i) {
+    map->addNode(makeEntry(i));
+  }
+  EXPECT_EQ(4, map->size());
+  EXPECT_EQ(makeIP(1), map->getNode(makeIP(1))->getIP());
+  EXPECT_EQ(makeIP(4), map->getNodeIf(makeIP(4))->getIP());
+
+  // Adding a duplicate entry should fail
+  EXPECT_THROW(map->addNode(makeEntry(2, PortID(2))), FbossError);
+  EXPECT_EQ(PortID(1), map->getNode(makeIP(2))->getPort());
+
+  // Looking up, updating or removing missing entries should fail
+  EXPECT_THROW(map->getNode(makeIP(5)), FbossError);
+  EXPECT_EQ(nullptr, map->getNodeIf(makeIP(5)));
+  EXPECT_THROW(map->updateNode(makeEntry(5)), FbossError);
+  EXPECT_THROW(map->removeNode(makeIP(5)), FbossError);
+  EXPECT_THROW(map->removeNode(makeEntry(5)), FbossError);
+  EXPECT_EQ(nullptr, map->removeNodeIf(makeIP(5)));
+  EXPECT_EQ(4, map->size());
+
+  map->updateNode(makeEntry(3, PortID(2)));
+  EXPECT_EQ(PortID(2), map->getNode(makeIP(3))->getPort());
+
+  auto removed = map->getNode(makeIP(1));
+  EXPECT_EQ(removed, map->removeNode(makeIP(1)));
+  map->removeNode(makeEntry(2));
+  EXPECT_NE(nullptr, map->removeNodeIf(makeIP(4)));
+  EXPECT_EQ(1, map->size());
+  EXPECT_EQ(nullptr, map->getNodeIf(makeIP(1)));
+  EXPECT_EQ(nullptr, map->getNodeIf(makeIP(2)));
+  EXPECT_EQ(PortID(2), map->getNode(makeIP(3))->getPort());
+}
+
+TYPED_TEST(NodeMapTest, IterateOrder) {
+  // NodeMapDelta relies on the map iterating in sorted key order, whatever
+  // order the entries were added in.
+  auto map = make_shared<TypeParam>();
+  std::vector<uint32_t> keys{99, 37, 88, 4, 500, 1};
+  for (auto key : keys) {
+    map->addNode(makeEntry(key));
+  }
+  map->publish();
+
+  std::sort(keys.begin(), keys.end());
+  auto it = map->begin();
+  for (auto key : keys) {
+    ASSERT_NE(map->end(), it);
+    EXPECT_EQ(makeIP(key), (*it)->getIP());
+    ++it;
+  }
+  EXPECT_EQ(map->end(), it);
+
+  auto rit = map->rbegin();
+  for (auto kit = keys.rbegin(); kit != keys.rend(); ++kit) {
+    ASSERT_NE(map->rend(), rit);
+    EXPECT_EQ(makeIP(*kit), (*rit)->getIP());
+    ++rit;
+  }
+  EXPECT_EQ(map->rend(), rit);
+}
+
+TYPED_TEST(NodeMapTest, PublishAndClone) {
+  auto map1 = make_shared<TypeParam>();
+  for (uint32_t i = 1; i <= 100; ++i) {
+    map1->addNode(makeEntry(i));
+  }
+  auto entry = map1->getNode(makeIP(50));
+
+  // Publishing the map should also mark all of its entries as published
+  map1->publish();
+  EXPECT_TRUE(map1->isPublished());
+  EXPECT_TRUE(entry->isPublished());
+
+  // A clone can be modified without affecting the original
+  auto map2 = map1->clone();
+  EXPECT_FALSE(map2->isPublished());
+  EXPECT_EQ(1, map2->getGeneration());
+  map2->removeNode(makeIP(50));
+  map2->addNode(makeEntry(200));
+  EXPECT_EQ(100, map2->size());
+  EXPECT_EQ(100, map1->size());
+  EXPECT_EQ(entry, map1->getNode(makeIP(50)));
+  EXPECT_EQ(nullptr, map1->getNodeIf(makeIP(200)));
+
+  // Modifying the published map should crash
+  ASSERT_DEATH(map1->addNode(makeEntry(300)),
+               "Check failed: !isPublished()");
+}
+
+TYPED_TEST(NodeMapTest, Serialization) {
+  auto map = make_shared<TypeParam>();
+  for (uint32_t i = 1; i <= 100; ++i) {
+    map->addNode(makeEntry(i, PortID(1 + i % 4)));
+  }
+  auto map2 = TypeParam::fromFollyDynamic(map->toFollyDynamic());
+  ASSERT_EQ(map->size(), map2->size());
+  auto it2 = map2->begin();
+  for (const auto& entry : *map) {
+    ASSERT_NE(map2->end(), it2);
+    EXPECT_EQ(entry->getIP(), (*it2)->getIP());
+    EXPECT_EQ(entry->getMac(), (*it2)->getMac());
+    EXPECT_EQ(entry->getPort(), (*it2)->getPort());
+    EXPECT_EQ(entry->getIntfID(), (*it2)->getIntfID());
+    ++it2;
+  }
+}
+
+TYPED_TEST(NodeMapTest, Delta) {
+  auto map1 = make_shared<TypeParam>();
+  for (uint32_t i = 1; i <= 500; ++i) {
+    map1->addNode(makeEntry(i));
+  }
+  map1->publish();
+
+  auto map2 = map1->clone();
+  map2->removeNode(makeIP(10));
+  map2->updateNode(makeEntry(200, PortID(2)));
+  map2->addNode(makeEntry(1000));
+  EXPECT_EQ(500, map2->size());
+
+  std::vector<std::pair<uint32_t, uint32_t>> expected{
+    {0x0a00000a, 0},
+    {0x0a0000c8, 0x0a0000c8},
+    {0, 0x0a0003e8},
+  };
+  EXPECT_EQ(expected, getChanges(map1, map2));
+
+  std::vector<std::pair<uint32_t, uint32_t>> reversed{
+    {0, 0x0a00000a},
+    {0x0a0000c8, 0x0a0000c8},
+    {0x0a0003e8, 0},
+  };
+  EXPECT_EQ(reversed, getChanges(map2, map1));
+  EXPECT_TRUE(getChanges(map1, map1).empty());
+
+  // And the original is untouched
+  EXPECT_EQ(PortID(1), map1->getNode(makeIP(200))->getPort());
+  EXPECT_NE(nullptr, map1->getNodeIf(makeIP(10)));
+}
+
+TYPED_TEST(NodeMapTest, DeltaFunctions) {
+  auto map1 = make_shared<TypeParam>();
+  for (uint32_t i = 1; i <= 500; ++i) {
+    map1->addNode(makeEntry(i));
+  }
+  map1->publish();
+
+  auto map2 = map1->clone();
+  for (uint32_t i = 1; i <= 500; i += 50) {
+    map2->updateNode(makeEntry(i, PortID(2)));
+  }
+  map2->removeNode(makeIP(7));
+  map2->removeNode(makeIP(500));
+  map2->addNode(makeEntry(0));
+  map2->addNode(makeEntry(250000));
+  map2->publish();
+
+  std::set<uint32_t> changed;
+  std::set<uint32_t> added;
+  std::set<uint32_t> removed;
+  NodeMapDelta<TypeParam> delta(map1.get(), map2.get());
+  DeltaFunctions::forEachChanged(
+      delta,
+      [&] (const shared_ptr<ArpEntry>& oldEntry,
+           const shared_ptr<ArpEntry>& newEntry) {
+        EXPECT_EQ(oldEntry->getIP(), newEntry->getIP());
+        EXPECT_NE(oldEntry, newEntry);
+        EXPECT_TRUE(changed.insert(oldEntry->getIP().toLongHBO()).second);
+      },
+      [&] (const shared_ptr<ArpEntry>& entry) {
+        EXPECT_TRUE(added.insert(entry->getIP().toLongHBO()).second);
+      },
+      [&] (const shared_ptr<ArpEntry>& entry) {
+        EXPECT_TRUE(removed.insert(entry->getIP().toLongHBO()).second);
+      });
+
+  std::set<uint32_t> expectedChanged;
+  for (uint32_t i = 1; i <= 500; i += 50) {
+    expectedChanged.insert(0x0a000000 | i);
+  }
+  EXPECT_EQ(expectedChanged, changed);
+  EXPECT_EQ((std::set<uint32_t>{0x0a000000, 0x0a03d090}), added);
+  EXPECT_EQ((std::set<uint32_t>{0x0a000007, 0x0a0001f4}), removed);
+}
+
+TEST(PersistentMap, ForEachUnpublished) {
+  TestMap map;
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = i;
+  }
+  uint32_t visited = 0;
+  auto count = [&](std::pair<int, int>&) { ++visited; };
+  map.forEachUnpublished(count);
+  EXPECT_EQ(1000, visited);
+
+  // Nothing has changed since
+  visited = 0;
+  map.forEachUnpublished(count);
+  EXPECT_EQ(0, visited);
+  TestMap copy(map);
+  copy.forEachUnpublished(count);
+  EXPECT_EQ(0, visited);
+
+  // Only the leaf holding a changed entry is visited again, in both a copy
+  // and a map that isn't shared with anything
+  copy[500] = 0;
+  copy.forEachUnpublished(count);
+  EXPECT_GT(visited, 0);
+  EXPECT_LE(visited, 8);
+  visited = 0;
+  copy.erase(10);
+  copy.forEachUnpublished(count);
+  EXPECT_GT(visited, 0);
+  EXPECT_LE(visited, 16);
+  visited = 0;
+  copy.insert(std::make_pair(2000, 0));
+  copy.forEachUnpublished(count);
+  EXPECT_GT(visited, 0);
+  EXPECT_LE(visited, 16);
+  visited = 0;
+  map.forEachUnpublished(count);
+  EXPECT_EQ(0, visited);
+}
+
+TEST(PersistentMap, PublishNewEntries) {
+  auto map1 = make_shared<PersistentArpMap>();
+  for (uint32_t i = 1; i <= 500; ++i) {
+    map1->addNode(makeEntry(i));
+  }
+  map1->publish();
+  EXPECT_TRUE(map1->getNode(IPAddressV4::fromLongHBO(0x0a000001))
+      ->isPublished());
+
+  auto map2 = map1->clone();
+  map2->updateNode(makeEntry(200, PortID(2)));
+  map2->addNode(makeEntry(1000));
+  auto changed = map2->getNode(IPAddressV4::fromLongHBO(0x0a0000c8));
+  auto added = map2->getNode(IPAddressV4::fromLongHBO(0x0a0003e8));
+  EXPECT_FALSE(changed->isPublished());
+  EXPECT_FALSE(added->isPublished());
+  map2->publish();
+  EXPECT_TRUE(changed->isPublished());
+  EXPECT_TRUE(added->isPublished());
+}
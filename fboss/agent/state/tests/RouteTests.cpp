@@ -912,7 +912,7 @@ TEST(Route, changedRoutesPostUpdate) {
   nexthops.emplace(IPAddress("1.1.1.10")); // resolved by intf 1
   nexthops.emplace(IPAddress("2::2"));     // resolved by intf 2
 
-  auto numChangedRoutes = [=] (const RTMapDelta& delta) {
+  auto numChangedRoutes = [=] (const RouteTablesDeltaList& delta) {
     auto cnt = 0;
     for (auto itr = delta.begin(); itr != delta.end(); ++itr) {
       const auto& v4Delta = itr->getRoutesV4Delta();
@@ -1004,6 +1004,42 @@ TEST(Route, changedRoutesPostUpdate) {
   stateV3->publish();
 }
 
+TEST(Route, deltaComputedOnce) {
+  auto stateV1 = make_shared<SwitchState>();
+  stateV1->publish();
+  auto rid = RouterID(0);
+  RouteUpdater u1(stateV1->getRouteTables());
+  u1.addRoute(rid, IPAddress("10.1.1.0"), 24, DROP);
+  u1.addRoute(rid, IPAddress("2001::0"), 48, DROP);
+  auto stateV2 = stateV1->clone();
+  stateV2->resetRouteTables(u1.updateDone());
+
+  StateDelta delta(stateV1, stateV2);
+  delta.prefetchRoutes();
+
+  // Every caller gets the same saved change lists
+  const auto& tablesDelta = delta.getRouteTablesDelta();
+  EXPECT_EQ(&tablesDelta, &delta.getRouteTablesDelta());
+  ASSERT_EQ(1, tablesDelta.size());
+  const auto& tableDelta = *delta.getRouteTablesDelta().begin();
+  const auto& v4Delta = tableDelta.getRoutesV4Delta();
+  const auto& v6Delta = tableDelta.getRoutesV6Delta();
+  EXPECT_EQ(&v4Delta, &tablesDelta.begin()->getRoutesV4Delta());
+  EXPECT_EQ(&v6Delta, &tablesDelta.begin()->getRoutesV6Delta());
+  EXPECT_EQ(&delta.getIntfsDelta(), &delta.getIntfsDelta());
+  EXPECT_EQ(&delta.getVlansDelta(), &delta.getVlansDelta());
+
+  // Only added routes, one per address family
+  ASSERT_EQ(1, v4Delta.size());
+  EXPECT_FALSE(v4Delta.begin()->getOld());
+  EXPECT_EQ(IPAddressV4("10.1.1.0"),
+            v4Delta.begin()->getNew()->prefix().network);
+  ASSERT_EQ(1, v6Delta.size());
+  EXPECT_FALSE(v6Delta.begin()->getOld());
+  EXPECT_EQ(IPAddressV6("2001::0"),
+            v6Delta.begin()->getNew()->prefix().network);
+}
+
 TEST(Route, dropRoutes) {
   auto stateV1 = make_shared<SwitchState>();
   stateV1->publish();
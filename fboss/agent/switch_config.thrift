@@ -360,4 +360,11 @@ struct SwitchConfig {
   // The order of AclEntry does _not_ determine its priority.
   // Highest priority entry comes with smallest ID.
   15: optional list<AclEntry> acls = []
+  /*
+   * Admin distance of each routing client, keyed by the clientId passed to
+   * the route programming APIs. When several clients add a route for the
+   * same prefix, the one with the lowest admin distance is programmed.
+   * Clients that are not listed here get an admin distance of 100.
+   */
+  16: map<i16, i32> clientIdToAdminDistance = {}
 }
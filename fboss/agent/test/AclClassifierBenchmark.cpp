@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include "fboss/agent/AclClassifier.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/AclMap.h"
+
+#include <random>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const uint8_t kPrefixLens[] = {16, 24, 32};
+const uint16_t kPorts[] = {22, 53, 80, 443, 8080};
+
+/*
+ * numEntries entries of the usual shape of an edge filter: a source or
+ * destination prefix, a protocol and a destination port, with a handful of
+ * different prefix lengths.
+ */
+shared_ptr<AclMap> makeAcls(uint32_t numEntries, std::mt19937* gen) {
+  auto acls = make_shared<AclMap>();
+  for (uint32_t id = 1; id <= numEntries; ++id) {
+    auto entry = make_shared<AclEntry>(AclEntryID(id));
+    entry->setAction(id % 2 ? cfg::AclAction::DENY : cfg::AclAction::PERMIT);
+    auto ip = IPAddressV4::fromLongHBO(0x0a000000 | ((*gen)() & 0xffffff));
+    auto network = IPAddress::createNetwork(
+        folly::to<std::string>(ip.str(), "/", kPrefixLens[(*gen)() % 3]));
+    if ((*gen)() % 2) {
+      entry->setSrcIp(network);
+    } else {
+      entry->setDstIp(network);
+    }
+    entry->setProto((*gen)() % 2 ? IP_PROTO_TCP : IP_PROTO_UDP);
+    entry->setL4DstPort(kPorts[(*gen)() % 5]);
+    acls->addEntry(entry);
+  }
+  return acls;
+}
+
+std::vector<AclClassifier::Fields> makePackets(std::mt19937* gen) {
+  std::vector<AclClassifier::Fields> packets(1024);
+  for (auto& fields : packets) {
+    fields.srcIp = IPAddressV4::fromLongHBO(0x0a000000 | ((*gen)() & 0xffffff));
+    fields.dstIp = IPAddressV4::fromLongHBO(0x0a000000 | ((*gen)() & 0xffffff));
+    fields.proto = IP_PROTO_TCP;
+    fields.l4SrcPort = 1024 + (*gen)() % 1024;
+    fields.l4DstPort = kPorts[(*gen)() % 5];
+  }
+  return packets;
+}
+
+bool linearMatch(const AclMap& acls, const AclClassifier::Fields& fields) {
+  for (const auto& entry : acls) {
+    auto srcIp = entry->getSrcIp();
+    auto dstIp = entry->getDstIp();
+    if ((srcIp.first.empty() ||
+         fields.srcIp.inSubnet(srcIp.first, srcIp.second)) &&
+        (dstIp.first.empty() ||
+         fields.dstIp.inSubnet(dstIp.first, dstIp.second)) &&
+        entry->getProto() == fields.proto &&
+        entry->getL4DstPort() == fields.l4DstPort) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void classify(size_t numIters, uint32_t numEntries) {
+  std::unique_ptr<AclClassifier> classifier;
+  std::vector<AclClassifier::Fields> packets;
+  BENCHMARK_SUSPEND {
+    std::mt19937 gen(numEntries);
+    classifier.reset(new AclClassifier(makeAcls(numEntries, &gen)));
+    packets = makePackets(&gen);
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    folly::doNotOptimizeAway(
+        classifier->match(packets[n % packets.size()]));
+  }
+}
+
+void linearScan(size_t numIters, uint32_t numEntries) {
+  shared_ptr<AclMap> acls;
+  std::vector<AclClassifier::Fields> packets;
+  BENCHMARK_SUSPEND {
+    std::mt19937 gen(numEntries);
+    acls = makeAcls(numEntries, &gen);
+    packets = makePackets(&gen);
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    folly::doNotOptimizeAway(linearMatch(*acls, packets[n % packets.size()]));
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(linearScan, 64);
+BENCHMARK_RELATIVE_PARAM(classify, 64);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(linearScan, 1024);
+BENCHMARK_RELATIVE_PARAM(classify, 1024);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(linearScan, 8192);
+BENCHMARK_RELATIVE_PARAM(classify, 8192);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/AclClassifier.h"
+
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <folly/Conv.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::IPAddress;
+using folly::io::Cursor;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const uint8_t kSyn = 0x02;
+const uint8_t kAck = 0x10;
+
+shared_ptr<AclEntry> makeEntry(uint32_t id, cfg::AclAction action) {
+  auto entry = make_shared<AclEntry>(AclEntryID(id));
+  entry->setAction(action);
+  return entry;
+}
+
+AclClassifier::Fields makeFields(const std::string& src,
+                                 const std::string& dst,
+                                 uint8_t proto = IP_PROTO_TCP,
+                                 uint16_t srcPort = 1000,
+                                 uint16_t dstPort = 80,
+                                 uint8_t tcpFlags = kAck) {
+  AclClassifier::Fields fields;
+  fields.srcIp = IPAddress(src);
+  fields.dstIp = IPAddress(dst);
+  fields.proto = proto;
+  fields.l4SrcPort = srcPort;
+  fields.l4DstPort = dstPort;
+  fields.tcpFlags = tcpFlags;
+  return fields;
+}
+
+/*
+ * What the classifier replaces: check every entry, in ID order.
+ */
+const AclEntry* linearMatch(const shared_ptr<AclMap>& acls,
+                            const AclClassifier::Fields& fields) {
+  for (const auto& entry : *acls) {
+    auto srcIp = entry->getSrcIp();
+    auto dstIp = entry->getDstIp();
+    if (!srcIp.first.empty() &&
+        (srcIp.first.isV4() != fields.srcIp.isV4() ||
+         !fields.srcIp.inSubnet(srcIp.first, srcIp.second))) {
+      continue;
+    }
+    if (!dstIp.first.empty() &&
+        (dstIp.first.isV4() != fields.dstIp.isV4() ||
+         !fields.dstIp.inSubnet(dstIp.first, dstIp.second))) {
+      continue;
+    }
+    if ((entry->getL4SrcPort() && entry->getL4SrcPort() != fields.l4SrcPort) ||
+        (entry->getL4DstPort() && entry->getL4DstPort() != fields.l4DstPort) ||
+        (entry->getProto() && entry->getProto() != fields.proto)) {
+      continue;
+    }
+    uint8_t mask = entry->getTcpFlagsMask();
+    if ((entry->getTcpFlags() & mask) != (fields.tcpFlags & mask)) {
+      continue;
+    }
+    return entry.get();
+  }
+  return nullptr;
+}
+
+} // unnamed namespace
+
+TEST(AclClassifier, empty) {
+  AclClassifier classifier(make_shared<AclMap>());
+  EXPECT_TRUE(classifier.empty());
+  auto fields = makeFields("10.0.0.1", "10.0.0.2");
+  EXPECT_EQ(nullptr, classifier.match(fields));
+  EXPECT_EQ(cfg::AclAction::PERMIT, classifier.getAction(fields));
+}
+
+TEST(AclClassifier, priority) {
+  auto acls = make_shared<AclMap>();
+  // Permit web traffic from 10.1/16, deny everything else from 10/8
+  auto web = makeEntry(10, cfg::AclAction::PERMIT);
+  web->setSrcIp(IPAddress::createNetwork("10.1.0.0/16"));
+  web->setProto(IP_PROTO_TCP);
+  web->setL4DstPort(80);
+  acls->addEntry(web);
+  auto deny = makeEntry(20, cfg::AclAction::DENY);
+  deny->setSrcIp(IPAddress::createNetwork("10.0.0.0/8"));
+  acls->addEntry(deny);
+  // Shadowed by entry 20 for everything but non-TCP traffic
+  auto udp = makeEntry(30, cfg::AclAction::PERMIT);
+  udp->setSrcIp(IPAddress::createNetwork("10.0.0.0/8"));
+  udp->setProto(IP_PROTO_UDP);
+  acls->addEntry(udp);
+  // No addresses: applies to both IPv4 and IPv6
+  auto ssh = makeEntry(40, cfg::AclAction::DENY);
+  ssh->setL4DstPort(22);
+  acls->addEntry(ssh);
+
+  AclClassifier classifier(acls);
+  EXPECT_EQ(4, classifier.getNumEntries());
+  EXPECT_EQ(4, classifier.getNumTuples());
+
+  auto match = [&](const AclClassifier::Fields& fields) {
+    auto entry = classifier.match(fields);
+    return entry ? static_cast<uint32_t>(entry->getID()) : 0;
+  };
+  EXPECT_EQ(10, match(makeFields("10.1.2.3", "1.1.1.1")));
+  EXPECT_EQ(20, match(makeFields("10.2.2.3", "1.1.1.1")));
+  EXPECT_EQ(20, match(makeFields("10.1.2.3", "1.1.1.1", IP_PROTO_TCP,
+                                 1000, 443)));
+  EXPECT_EQ(20, match(makeFields("10.1.2.3", "1.1.1.1", IP_PROTO_UDP)));
+  EXPECT_EQ(40, match(makeFields("11.0.0.1", "1.1.1.1", IP_PROTO_TCP,
+                                 1000, 22)));
+  EXPECT_EQ(40, match(makeFields("2401:db00::1", "2401:db00::2",
+                                 IP_PROTO_TCP, 1000, 22)));
+  EXPECT_EQ(0, match(makeFields("11.0.0.1", "1.1.1.1")));
+  // An IPv4 entry never matches IPv6 traffic
+  EXPECT_EQ(0, match(makeFields("::ffff:10.1.2.3", "::1")));
+
+  EXPECT_EQ(cfg::AclAction::DENY,
+            classifier.getAction(makeFields("10.2.2.3", "1.1.1.1")));
+  EXPECT_EQ(cfg::AclAction::PERMIT,
+            classifier.getAction(makeFields("11.0.0.1", "1.1.1.1")));
+}
+
+TEST(AclClassifier, tcpFlags) {
+  auto acls = make_shared<AclMap>();
+  // Deny connection attempts (SYN without ACK) to 10/8
+  auto syn = makeEntry(1, cfg::AclAction::DENY);
+  syn->setDstIp(IPAddress::createNetwork("10.0.0.0/8"));
+  syn->setProto(IP_PROTO_TCP);
+  syn->setTcpFlags(kSyn);
+  syn->setTcpFlagsMask(kSyn | kAck);
+  acls->addEntry(syn);
+  AclClassifier classifier(acls);
+
+  EXPECT_NE(nullptr, classifier.match(
+      makeFields("1.1.1.1", "10.0.0.1", IP_PROTO_TCP, 1000, 80, kSyn)));
+  EXPECT_NE(nullptr, classifier.match(
+      makeFields("1.1.1.1", "10.0.0.1", IP_PROTO_TCP, 1000, 80, kSyn | 0x8)));
+  EXPECT_EQ(nullptr, classifier.match(
+      makeFields("1.1.1.1", "10.0.0.1", IP_PROTO_TCP, 1000, 80, kSyn | kAck)));
+  EXPECT_EQ(nullptr, classifier.match(
+      makeFields("1.1.1.1", "10.0.0.1", IP_PROTO_TCP, 1000, 80, kAck)));
+}
+
+TEST(AclClassifier, parsePacket) {
+  // IPv4 TCP SYN from 10.0.0.1:1234 to 10.0.0.2:80, with an options word
+  uint8_t v4[] = {
+    0x46, 0x00, 0x00, 0x2c, 0x00, 0x00, 0x40, 0x00, 0x40, 0x06, 0x00, 0x00,
+    0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00, 0x00, 0x02, 0x01, 0x01, 0x01, 0x01,
+    0x04, 0xd2, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x50, 0x02, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+  };
+  auto buf = IOBuf::wrapBuffer(v4, sizeof(v4));
+  AclClassifier::Fields fields;
+  ASSERT_TRUE(AclClassifier::parsePacket(Cursor(buf.get()), ETHERTYPE_IPV4,
+                                         &fields));
+  EXPECT_EQ(IPAddress("10.0.0.1"), fields.srcIp);
+  EXPECT_EQ(IPAddress("10.0.0.2"), fields.dstIp);
+  EXPECT_EQ(IP_PROTO_TCP, fields.proto);
+  EXPECT_EQ(1234, fields.l4SrcPort);
+  EXPECT_EQ(80, fields.l4DstPort);
+  EXPECT_EQ(kSyn, fields.tcpFlags);
+
+  // Truncated in the TCP header
+  auto truncated = IOBuf::wrapBuffer(v4, 30);
+  EXPECT_FALSE(AclClassifier::parsePacket(Cursor(truncated.get()),
+                                          ETHERTYPE_IPV4, &fields));
+  EXPECT_FALSE(AclClassifier::parsePacket(Cursor(buf.get()), ETHERTYPE_ARP,
+                                          &fields));
+
+  // IPv6 UDP from 2401:db00::1:5353 to ff02::fb:5353
+  uint8_t v6[48] = {
+    0x60, 0x00, 0x00, 0x00, 0x00, 0x08, 0x11, 0xff,
+    0x24, 0x01, 0xdb, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01,
+    0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xfb,
+    0x14, 0xe9, 0x14, 0xe9, 0x00, 0x08, 0x00, 0x00,
+  };
+  auto buf6 = IOBuf::wrapBuffer(v6, sizeof(v6));
+  AclClassifier::Fields fields6;
+  ASSERT_TRUE(AclClassifier::parsePacket(Cursor(buf6.get()), ETHERTYPE_IPV6,
+                                         &fields6));
+  EXPECT_EQ(IPAddress("2401:db00::1"), fields6.srcIp);
+  EXPECT_EQ(IPAddress("ff02::fb"), fields6.dstIp);
+  EXPECT_EQ(IP_PROTO_UDP, fields6.proto);
+  EXPECT_EQ(5353, fields6.l4SrcPort);
+  EXPECT_EQ(5353, fields6.l4DstPort);
+  EXPECT_EQ(0, fields6.tcpFlags);
+}
+
+TEST(AclClassifier, matchesLinearScan) {
+  std::mt19937 gen(1);
+  auto rand = [&](uint32_t max) {
+    return std::uniform_int_distribution<uint32_t>(0, max - 1)(gen);
+  };
+  const uint8_t kPrefixLens[] = {0, 8, 16, 24, 32};
+  const uint16_t kPorts[] = {0, 22, 53, 80, 443};
+  const uint8_t kProtos[] = {0, IP_PROTO_TCP, IP_PROTO_UDP};
+
+  // Addresses from a small space, so that entries and packets overlap
+  auto randomIp = [&]() {
+    return folly::IPAddressV4::fromLongHBO(
+        0x0a000000 | (rand(4) << 16) | (rand(4) << 8) | rand(4));
+  };
+
+  auto acls = make_shared<AclMap>();
+  for (uint32_t id = 1; id <= 2000; ++id) {
+    auto entry = makeEntry(id, rand(2) ? cfg::AclAction::PERMIT :
+                           cfg::AclAction::DENY);
+    if (rand(4)) {
+      entry->setSrcIp(IPAddress::createNetwork(folly::to<std::string>(
+          randomIp().str(), "/", kPrefixLens[rand(5)])));
+    }
+    if (rand(2)) {
+      entry->setDstIp(IPAddress::createNetwork(folly::to<std::string>(
+          randomIp().str(), "/", kPrefixLens[rand(5)])));
+    }
+    entry->setL4SrcPort(rand(8) ? 0 : kPorts[rand(5)]);
+    entry->setL4DstPort(kPorts[rand(5)]);
+    entry->setProto(kProtos[rand(3)]);
+    if (!rand(8)) {
+      entry->setTcpFlags(kSyn);
+      entry->setTcpFlagsMask(kSyn | kAck);
+    }
+    acls->addEntry(entry);
+  }
+  AclClassifier classifier(acls);
+
+  for (int i = 0; i < 10000; ++i) {
+    AclClassifier::Fields fields;
+    fields.srcIp = randomIp();
+    fields.dstIp = randomIp();
+    fields.proto = kProtos[1 + rand(2)];
+    fields.l4SrcPort = kPorts[rand(5)];
+    fields.l4DstPort = kPorts[rand(5)];
+    if (fields.proto == IP_PROTO_TCP) {
+      fields.tcpFlags = rand(2) ? kSyn : kSyn | kAck;
+    }
+    ASSERT_EQ(linearMatch(acls, fields), classifier.match(fields))
+      << fields.srcIp << " -> " << fields.dstIp << " proto "
+      << int(fields.proto) << " ports " << fields.l4SrcPort << " -> "
+      << fields.l4DstPort;
+  }
+}
+
+TEST(AclClassifier, swSwitchFollowsState) {
+  auto sw = createMockSw(make_shared<SwitchState>());
+  // No classifier at all until there are ACLs to apply
+  EXPECT_EQ(nullptr, sw->getAclClassifier());
+
+  auto addAcl = [](const shared_ptr<SwitchState>& state) {
+    auto newState = state->clone();
+    newState->addAcl(makeEntry(1, cfg::AclAction::DENY));
+    return newState;
+  };
+  sw->updateStateBlocking("add acl", addAcl);
+  auto classifier = sw->getAclClassifier();
+  ASSERT_NE(nullptr, classifier);
+  EXPECT_EQ(1, classifier->getNumEntries());
+  EXPECT_EQ(cfg::AclAction::DENY,
+            classifier->getAction(makeFields("10.0.0.1", "10.0.0.2")));
+  // The same classifier until the ACLs change
+  EXPECT_EQ(classifier.get(), sw->getAclClassifier().get());
+
+  auto removeAcls = [](const shared_ptr<SwitchState>& state) {
+    auto newState = state->clone();
+    newState->resetAcls(make_shared<AclMap>());
+    return newState;
+  };
+  sw->updateStateBlocking("remove acls", removeAcls);
+  EXPECT_EQ(nullptr, sw->getAclClassifier());
+}
@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include "fboss/agent/state/ArpEntry.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/NeighborEntry-defs.h"
+#include "fboss/agent/state/NodeMap-defs.h"
+#include "fboss/agent/state/NodeMapDelta.h"
+#include "fboss/agent/state/NodeMapDelta-defs.h"
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+/*
+ * An ARP table stored in a flat_map, the way all NodeMaps used to be, to
+ * compare against ArpTable's PersistentMap.
+ */
+struct FlatArpTableTraits : public NodeMapTraits<IPAddressV4, ArpEntry> {
+  static IPAddressV4 getKey(const shared_ptr<ArpEntry>& entry) {
+    return entry->getIP();
+  }
+};
+
+class FlatArpTable : public NodeMapT<FlatArpTable, FlatArpTableTraits> {
+ public:
+  FlatArpTable() {}
+
+ private:
+  using NodeMapT::NodeMapT;
+  friend class CloneAllocator;
+};
+
+const MacAddress kMac("02:00:00:00:00:01");
+
+shared_ptr<ArpEntry> makeEntry(uint32_t n) {
+  return make_shared<ArpEntry>(IPAddressV4::fromLongHBO(0x0a000000 | n),
+                               kMac, PortID(1 + n % 32), InterfaceID(1));
+}
+
+template<typename TableT>
+shared_ptr<TableT> makeTable(uint32_t numEntries) {
+  auto table = make_shared<TableT>();
+  for (uint32_t n = 0; n < numEntries; ++n) {
+    table->addNode(makeEntry(2 * n));
+  }
+  table->publish();
+  return table;
+}
+
+/*
+ * Learn one new neighbor per iteration: clone the published table, add the
+ * entry and publish the result, as the ARP handler does.
+ */
+template<typename TableT>
+void learn(size_t numIters, uint32_t numEntries) {
+  shared_ptr<TableT> table;
+  BENCHMARK_SUSPEND {
+    table = makeTable<TableT>(numEntries);
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    auto newTable = table->clone();
+    newTable->addNode(makeEntry(2 * (n % numEntries) + 1));
+    newTable->publish();
+    folly::doNotOptimizeAway(newTable);
+  }
+  BENCHMARK_SUSPEND {
+    table.reset();
+  }
+}
+
+/*
+ * Compute the delta between a table and a copy with one entry changed, as
+ * the HwSwitch does when the new state is applied.
+ */
+template<typename TableT>
+void delta(size_t numIters, uint32_t numEntries) {
+  shared_ptr<TableT> oldTable;
+  shared_ptr<TableT> newTable;
+  BENCHMARK_SUSPEND {
+    oldTable = makeTable<TableT>(numEntries);
+    newTable = oldTable->clone();
+    newTable->updateNode(makeEntry(numEntries));
+    newTable->publish();
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    NodeMapDelta<TableT> delta(oldTable.get(), newTable.get());
+    for (const auto& entry : delta) {
+      folly::doNotOptimizeAway(entry);
+    }
+  }
+  BENCHMARK_SUSPEND {
+    oldTable.reset();
+    newTable.reset();
+  }
+}
+
+void flatLearn(size_t numIters, uint32_t numEntries) {
+  learn<FlatArpTable>(numIters, numEntries);
+}
+void persistentLearn(size_t numIters, uint32_t numEntries) {
+  learn<ArpTable>(numIters, numEntries);
+}
+void flatDelta(size_t numIters, uint32_t numEntries) {
+  delta<FlatArpTable>(numIters, numEntries);
+}
+void persistentDelta(size_t numIters, uint32_t numEntries) {
+  delta<ArpTable>(numIters, numEntries);
+}
+
+} // unnamed namespace
+
+namespace facebook { namespace fboss {
+FBOSS_INSTANTIATE_NODE_MAP(FlatArpTable, FlatArpTableTraits);
+}}
+
+BENCHMARK_PARAM(flatLearn, 100);
+BENCHMARK_RELATIVE_PARAM(persistentLearn, 100);
+BENCHMARK_PARAM(flatLearn, 1000);
+BENCHMARK_RELATIVE_PARAM(persistentLearn, 1000);
+BENCHMARK_PARAM(flatLearn, 20000);
+BENCHMARK_RELATIVE_PARAM(persistentLearn, 20000);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(flatDelta, 1000);
+BENCHMARK_RELATIVE_PARAM(persistentDelta, 1000);
+BENCHMARK_PARAM(flatDelta, 20000);
+BENCHMARK_RELATIVE_PARAM(persistentDelta, 20000);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
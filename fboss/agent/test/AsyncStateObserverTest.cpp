@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Memory.h>
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/AsyncStateObserver.h"
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using folly::make_unique;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+unique_ptr<SwSwitch> setupSwitch() {
+  MacAddress localMac("02:00:01:00:00:01");
+  auto sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10),
+                                  false);
+  sw->init();
+  return sw;
+}
+
+void bumpState(SwSwitch* sw) {
+  sw->updateStateBlocking("bump", [](const shared_ptr<SwitchState>& state) {
+    return state->clone();
+  });
+}
+
+/*
+ * Records every delta it sees. The first update blocks until release()
+ * is called, which lets the tests make the observer fall behind.
+ */
+class RecordingObserver : public StateObserver {
+ public:
+  RecordingObserver() : released_(release_.get_future().share()) {}
+
+  void stateUpdated(const StateDelta& delta) override {
+    released_.wait();
+    std::lock_guard<std::mutex> guard(lock_);
+    threadId_ = std::this_thread::get_id();
+    deltas_.emplace_back(delta.oldState(), delta.newState());
+  }
+
+  void release() {
+    release_.set_value();
+  }
+
+  std::vector<std::pair<shared_ptr<SwitchState>, shared_ptr<SwitchState>>>
+  getDeltas() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return deltas_;
+  }
+
+  std::thread::id getThreadId() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return threadId_;
+  }
+
+ private:
+  std::promise<void> release_;
+  std::shared_future<void> released_;
+  std::thread::id threadId_;
+  std::mutex lock_;
+  std::vector<std::pair<shared_ptr<SwitchState>, shared_ptr<SwitchState>>>
+    deltas_;
+};
+
+} // unnamed namespace
+
+TEST(AsyncStateObserver, SlowObserverDoesNotBlockUpdates) {
+  auto sw = setupSwitch();
+  RecordingObserver observer;
+  sw->registerAsyncStateObserver(&observer, "recorder", 2);
+
+  auto initial = sw->getState();
+  // None of these can complete if the observer runs on the update thread,
+  // since it doesn't return until released.
+  for (int i = 0; i < 10; ++i) {
+    bumpState(sw.get());
+  }
+  auto last = sw->getState();
+
+  observer.release();
+  sw->unregisterStateObserver(&observer);
+
+  // Unregistering drains the queue, so the observer has seen an unbroken
+  // chain of deltas from the initial state to the final one, but fewer
+  // than the number of updates since it fell behind.
+  auto deltas = observer.getDeltas();
+  ASSERT_FALSE(deltas.empty());
+  EXPECT_LT(deltas.size(), 10);
+  EXPECT_EQ(initial, deltas.front().first);
+  for (size_t i = 1; i < deltas.size(); ++i) {
+    EXPECT_EQ(deltas[i - 1].second, deltas[i].first);
+  }
+  EXPECT_EQ(last, deltas.back().second);
+  EXPECT_NE(std::this_thread::get_id(), observer.getThreadId());
+}
+
+TEST(AsyncStateObserver, Coalesce) {
+  RecordingObserver observer;
+  auto async = make_unique<AsyncStateObserver>(&observer, "recorder", 3);
+
+  std::vector<shared_ptr<SwitchState>> states;
+  states.push_back(std::make_shared<SwitchState>());
+  for (int i = 0; i < 6; ++i) {
+    states.push_back(states.back()->clone());
+    async->stateUpdated(StateDelta(states[i], states[i + 1]));
+  }
+
+  // At most the first update has been picked up by the observer thread,
+  // which is now blocked in the observer. The rest overflowed the queue at
+  // least once and were merged.
+  EXPECT_GE(async->getCoalescedCount(), 2);
+  EXPECT_LE(async->getPendingCount(), 3);
+
+  // Destroying the wrapper delivers whatever is still queued.
+  observer.release();
+  async.reset();
+
+  auto deltas = observer.getDeltas();
+  ASSERT_LE(2, deltas.size());
+  EXPECT_GT(6, deltas.size());
+  EXPECT_EQ(states.front(), deltas.front().first);
+  for (size_t i = 1; i < deltas.size(); ++i) {
+    EXPECT_EQ(deltas[i - 1].second, deltas[i].first);
+  }
+  EXPECT_EQ(states.back(), deltas.back().second);
+}
+
+TEST(AsyncStateObserver, NoLagOnceDrained) {
+  RecordingObserver observer;
+  auto async = make_unique<AsyncStateObserver>(&observer, "lagtest", 1);
+
+  auto oldState = std::make_shared<SwitchState>();
+  auto newState = oldState->clone();
+  async->stateUpdated(StateDelta(oldState, newState));
+
+  // Let the update age before it is delivered, so that publishing the age
+  // of the update just delivered would show up as a non-zero lag.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  observer.release();
+  async.reset();
+
+  ASSERT_EQ(1, observer.getDeltas().size());
+  auto prefix = SwitchStats::kCounterPrefix + "state_observer.lagtest.";
+  EXPECT_EQ(0, fbData->getCounter(prefix + "lag_ms"));
+  EXPECT_EQ(0, fbData->getCounter(prefix + "pending"));
+}
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Memory.h>
+#include "fboss/agent/ApplyThriftConfig.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/gen-cpp/switch_config_types.h"
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using folly::make_unique;
+using folly::to;
+using std::make_shared;
+using std::shared_ptr;
+using std::unique_ptr;
+
+DEFINE_int32(config_vlans, 4000,
+             "Number of VLANs, ports and interfaces in the benchmark config");
+
+namespace {
+
+// Global state used by the benchmarks
+unique_ptr<SimPlatform> platform;
+cfg::SwitchConfig baseConfig;
+shared_ptr<SwitchState> baseState;
+
+/*
+ * One port, VLAN and interface per id, with a v4 and a v6 address on each
+ * interface.
+ */
+cfg::SwitchConfig makeConfig(int numVlans) {
+  cfg::SwitchConfig config;
+  config.defaultVlan = 1;
+  config.ports.resize(numVlans);
+  config.vlans.resize(numVlans);
+  config.vlanPorts.resize(numVlans);
+  config.interfaces.resize(numVlans);
+  for (int idx = 0; idx < numVlans; ++idx) {
+    int id = idx + 1;
+    config.ports[idx].logicalID = id;
+    config.ports[idx].state = cfg::PortState::UP;
+    config.ports[idx].ingressVlan = id;
+    config.vlans[idx].id = id;
+    config.vlans[idx].name = to<std::string>("Vlan", id);
+    config.vlans[idx].intfID = id;
+    config.vlans[idx].__isset.intfID = true;
+    config.vlanPorts[idx].vlanID = id;
+    config.vlanPorts[idx].logicalPort = id;
+    auto* intf = &config.interfaces[idx];
+    intf->intfID = id;
+    intf->vlanID = id;
+    intf->ipAddresses.push_back(
+        to<std::string>("10.", id >> 8, ".", id & 0xff, ".1/24"));
+    intf->ipAddresses.push_back(to<std::string>("2401:db00:", id, "::1/64"));
+  }
+  return config;
+}
+
+void init() {
+  platform = make_unique<SimPlatform>(MacAddress("02:00:01:00:00:01"),
+                                      FLAGS_config_vlans);
+  baseConfig = makeConfig(FLAGS_config_vlans);
+  auto state = make_shared<SwitchState>();
+  for (int id = 1; id <= FLAGS_config_vlans; ++id) {
+    state->registerPort(PortID(id), to<std::string>("port", id));
+  }
+  state->publish();
+  baseState = applyThriftConfig(state, &baseConfig, platform.get());
+  CHECK(baseState);
+  baseState->publish();
+}
+
+/*
+ * Reapply the base config with a single port's state flipped, as a config
+ * push that disables one port would.
+ */
+void reapply(size_t numIters, bool incremental) {
+  cfg::SwitchConfig config;
+  BENCHMARK_SUSPEND {
+    config = baseConfig;
+    config.ports[0].state = cfg::PortState::DOWN;
+  }
+  const cfg::SwitchConfig* prevConfig = incremental ? &baseConfig : nullptr;
+  for (size_t n = 0; n < numIters; ++n) {
+    folly::doNotOptimizeAway(
+        applyThriftConfig(baseState, &config, platform.get(), prevConfig));
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_NAMED_PARAM(reapply, Full, false);
+BENCHMARK_RELATIVE_NAMED_PARAM(reapply, Incremental, true);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  init();
+  folly::runBenchmarks();
+  baseState.reset();
+  platform.reset();
+  return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <boost/cast.hpp>
+
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include "fboss/agent/DHCPv4Handler.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/UDPHeader.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/hw/sim/SimSwitch.h"
+#include "fboss/agent/packet/DHCPv4Packet.h"
+#include "fboss/agent/packet/DHCPv6Packet.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/IPv4Hdr.h"
+#include "fboss/agent/packet/IPv6Hdr.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using folly::io::Cursor;
+using folly::io::RWPrivateCursor;
+using folly::make_unique;
+using std::make_shared;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+const MacAddress kLocalMac("02:00:01:00:00:01");
+const MacAddress kClientMac("02:00:00:00:00:02");
+const IPAddressV4 kSwitchIP("10.0.0.1");
+const IPAddressV4 kClientIP("10.0.0.10");
+const IPAddressV4 kDhcpV4Relay("20.20.20.20");
+const IPAddressV6 kSwitchIPv6("2401:db00::1");
+const IPAddressV6 kDhcpV6Relay("2401:db00:2::2");
+
+// Global state used by the benchmarks
+unique_ptr<SwSwitch> sw;
+unique_ptr<MockRxPacket> dhcpV4Discover;
+unique_ptr<MockRxPacket> dhcpV4Offer;
+unique_ptr<MockRxPacket> dhcpV6Solicit;
+
+unique_ptr<SwSwitch> setupSwitch() {
+  auto sw = make_unique<SwSwitch>(make_unique<SimPlatform>(kLocalMac, 10));
+  sw->init();
+
+  auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+
+    // Add VLAN 1, and ports 1-9 which belong to it, relaying DHCP requests
+    auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+    state->addVlan(vlan1);
+    for (int idx = 1; idx < 10; ++idx) {
+      vlan1->addPort(PortID(idx), false);
+    }
+    vlan1->setDhcpV4Relay(kDhcpV4Relay);
+    vlan1->setDhcpV6Relay(kDhcpV6Relay);
+    // Add Interface 1 to VLAN 1
+    auto intf1 = make_shared<Interface>
+      (InterfaceID(1), RouterID(0), VlanID(1),
+       "interface1", kLocalMac, 9000);
+    Interface::Addresses addrs1;
+    addrs1.emplace(IPAddress(kSwitchIP), 24);
+    addrs1.emplace(IPAddress(kSwitchIPv6), 64);
+    intf1->setAddresses(addrs1);
+    state->addIntf(intf1);
+    return state;
+  };
+
+  sw->updateStateBlocking("setup", updateFn);
+  return sw;
+}
+
+void writeIPHdr(const IPv4Hdr& ipHdr, RWPrivateCursor* cursor) {
+  ipHdr.write(cursor);
+}
+
+void writeIPHdr(const IPv6Hdr& ipHdr, RWPrivateCursor* cursor) {
+  ipHdr.serialize(cursor);
+}
+
+/*
+ * Build a received packet on port 1, VLAN 1, with the UDP checksum filled in
+ * as a real client or server would.
+ */
+template<typename IPHDR, typename BodyFn>
+unique_ptr<MockRxPacket> makeUDPPacket(MacAddress dstMac, MacAddress srcMac,
+    const IPHDR& ipHdr, uint16_t ipHdrSize, uint16_t etherType,
+    const UDPHeader& udpHdr, BodyFn writeBody) {
+  auto buf = IOBuf::create(18 + ipHdrSize + udpHdr.length);
+  buf->append(18 + ipHdrSize + udpHdr.length);
+  RWPrivateCursor cursor(buf.get());
+  TxPacket::writeEthHeader(&cursor, dstMac, srcMac, VlanID(1), etherType);
+  writeIPHdr(ipHdr, &cursor);
+  cursor.writeBE<uint16_t>(udpHdr.srcPort);
+  cursor.writeBE<uint16_t>(udpHdr.dstPort);
+  cursor.writeBE<uint16_t>(udpHdr.length);
+  RWPrivateCursor csumCursor(cursor);
+  cursor.skip(2);
+  Cursor payloadStart(cursor);
+  writeBody(&cursor);
+  csumCursor.writeBE<uint16_t>(udpHdr.computeChecksum(ipHdr, payloadStart));
+
+  auto pkt = make_unique<MockRxPacket>(std::move(buf));
+  pkt->setSrcPort(PortID(1));
+  pkt->setSrcVlan(VlanID(1));
+  return pkt;
+}
+
+unique_ptr<MockRxPacket> makeDHCPv4Packet(MacAddress dstMac,
+    MacAddress srcMac, IPAddressV4 srcIp, IPAddressV4 dstIp,
+    uint16_t srcPort, uint16_t dstPort, const DHCPv4Packet& dhcpPkt) {
+  UDPHeader udpHdr(srcPort, dstPort, UDPHeader::size() + dhcpPkt.size());
+  IPv4Hdr ipHdr(4, IPv4Hdr::minSize() / 4, 0, 0,
+      IPv4Hdr::minSize() + udpHdr.length, 0, false, false, 0, 64,
+      IP_PROTO::IP_PROTO_UDP, 0, srcIp, dstIp);
+  ipHdr.computeChecksum();
+  return makeUDPPacket(dstMac, srcMac, ipHdr,
+      IPv4Hdr::minSize(), ETHERTYPE_IPV4, udpHdr,
+      [&](RWPrivateCursor* cursor) { dhcpPkt.write(cursor); });
+}
+
+DHCPv4Packet makeDHCPv4(uint8_t op, uint8_t msgType) {
+  DHCPv4Packet dhcpPkt;
+  dhcpPkt.op = op;
+  dhcpPkt.htype = 1;
+  dhcpPkt.hlen = MacAddress::SIZE;
+  dhcpPkt.hops = 0;
+  dhcpPkt.xid = IPAddressV4("10.10.10.1");
+  dhcpPkt.secs = 0;
+  dhcpPkt.flags = 0;
+  dhcpPkt.chaddr.fill(0);
+  memcpy(dhcpPkt.chaddr.data(), kClientMac.bytes(), MacAddress::SIZE);
+  dhcpPkt.sname.fill(0);
+  dhcpPkt.file.fill(0);
+  dhcpPkt.dhcpCookie.assign(DHCPv4Packet::kOptionsCookie,
+      DHCPv4Packet::kOptionsCookie + DHCPv4Packet::kOptionsCookieSize);
+  dhcpPkt.appendOption(DHCPv4Handler::DHCP_MESSAGE_TYPE, 1, &msgType);
+  return dhcpPkt;
+}
+
+void init() {
+  // Initialize the switch
+  sw = setupSwitch();
+
+  // A DHCP discover from a client, which gets agent options added
+  auto discover = makeDHCPv4(DHCPv4Handler::BOOTREQUEST, 1);
+  const uint8_t hostName[] = {'h', 'o', 's', 't', '1'};
+  discover.appendOption(12, sizeof(hostName), hostName);
+  discover.appendOption(DHCPv4Handler::END, 0, nullptr);
+  discover.padToMinLength();
+  dhcpV4Discover = makeDHCPv4Packet(MacAddress::BROADCAST, kClientMac,
+      IPAddressV4("0.0.0.0"), IPAddressV4("255.255.255.255"),
+      DHCPv4Handler::kBootPCPort, DHCPv4Handler::kBootPSPort, discover);
+
+  // The server's offer, which gets them stripped again
+  auto offer = makeDHCPv4(DHCPv4Handler::BOOTREPLY, 2);
+  offer.yiaddr = kClientIP;
+  offer.giaddr = kSwitchIP;
+  const uint8_t agentOptions[] = {DHCPv4Handler::AGENT_CIRCUIT_ID, 4,
+    10, 0, 0, 1};
+  offer.appendOption(DHCPv4Handler::DHCP_AGENT_OPTIONS,
+      sizeof(agentOptions), agentOptions);
+  offer.appendOption(DHCPv4Handler::END, 0, nullptr);
+  offer.padToMinLength();
+  dhcpV4Offer = makeDHCPv4Packet(kLocalMac, MacAddress("02:00:00:00:00:03"),
+      kDhcpV4Relay, kSwitchIP,
+      DHCPv4Handler::kBootPSPort, DHCPv4Handler::kBootPSPort, offer);
+
+  // A DHCPv6 solicit, which gets wrapped in a relay forward message
+  DHCPv6Packet solicit(DHCPv6_SOLICIT, 0x123456);
+  const uint8_t clientId[] = {0, 3, 0, 1, 2, 0, 0, 0, 0, 2};
+  solicit.appendOption(1, sizeof(clientId), clientId);
+  const uint8_t elapsedTime[] = {0, 0};
+  solicit.appendOption(8, sizeof(elapsedTime), elapsedTime);
+  IPv6Hdr ipv6Hdr(IPAddressV6("fe80::2:ff:fe00:2"), IPAddressV6("ff02::1:2"));
+  ipv6Hdr.nextHeader = IP_PROTO_UDP;
+  ipv6Hdr.trafficClass = 0x00;
+  ipv6Hdr.hopLimit = 1;
+  UDPHeader udpHdr(DHCPv6Packet::DHCP6_CLIENT_UDPPORT,
+      DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
+      UDPHeader::size() + solicit.computePacketLength());
+  ipv6Hdr.payloadLength = udpHdr.length;
+  dhcpV6Solicit = makeUDPPacket(MacAddress("33:33:00:01:00:02"), kClientMac,
+      ipv6Hdr, IPv6Hdr::SIZE, ETHERTYPE_IPV6, udpHdr,
+      [&](RWPrivateCursor* cursor) { solicit.write(cursor); });
+}
+
+void relayPackets(const MockRxPacket& pkt, size_t numIters) {
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    sim->resetTxCount();
+  }
+
+  // Send the packet to the switch numIters times
+  for (size_t n = 0; n < numIters; ++n) {
+    sw->packetReceived(pkt.clone());
+  }
+
+  BENCHMARK_SUSPEND {
+    // Make sure the SwSwitch relayed 1 packet for each iteration
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    CHECK_EQ(sim->getTxCount(), numIters);
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK(DHCPv4Request, numIters) {
+  relayPackets(*dhcpV4Discover, numIters);
+}
+
+BENCHMARK(DHCPv4Reply, numIters) {
+  relayPackets(*dhcpV4Offer, numIters);
+}
+
+BENCHMARK(DHCPv6Solicit, numIters) {
+  relayPackets(*dhcpV6Solicit, numIters);
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  // As in ArpBenchmark, set up the switch once up front rather than inside
+  // the benchmark functions, since the packet handling code is cheap enough
+  // that the overhead of BENCHMARK_SUSPEND would distort the results.
+  init();
+
+  folly::runBenchmarks();
+  return 0;
+}
@@ -190,6 +190,27 @@ unique_ptr<MockRxPacket> makeDHCPPacket(
   return pkt;
 }
 
+/*
+ * makeDHCPPacket() leaves out the UDP checksum.  Fill it in, along with the
+ * UDP length to match, the way a client would.
+ */
+void setUDPChecksum(MockRxPacket* pkt) {
+  const size_t udpOffset = 18 + IPv4Hdr::minSize();
+  auto* buf = pkt->buf();
+  Cursor c(buf);
+  c.skip(18);
+  IPv4Hdr ipHdr(c);
+  UDPHeader udpHdr;
+  udpHdr.parse(&c);
+  udpHdr.length = buf->length() - udpOffset;
+  ipHdr.length = IPv4Hdr::minSize() + udpHdr.length;
+  udpHdr.csum = udpHdr.computeChecksum(ipHdr, c);
+  folly::io::RWPrivateCursor rwCursor(buf);
+  rwCursor.skip(udpOffset + 4);
+  rwCursor.writeBE<uint16_t>(udpHdr.length);
+  rwCursor.writeBE<uint16_t>(udpHdr.csum);
+}
+
 struct Option {
   uint8_t op{0};
   uint8_t optLen{0};
@@ -231,6 +252,10 @@ TxMatchFn checkDHCPPkt(MacAddress dstMac, VlanID vlan,
     }
     UDPHeader udpHdr;
     udpHdr.parse(&c);
+    if (udpHdr.csum != udpHdr.computeChecksum(ipHdr, c)) {
+      throw FbossError("expected UDP checksum to be ",
+          udpHdr.computeChecksum(ipHdr, c), "; got ", udpHdr.csum);
+    }
     if (udpHdr.srcPort != srcPort) {
       throw FbossError("expected source port to be ", srcPort,
           "; got ", udpHdr.srcPort);
@@ -412,6 +437,54 @@ TEST(DHCPv4HandlerTest, DHCPReply) {
   counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.pkts.sum", 1);
 }
 
+TEST(DHCPv4HandlerTest, DHCPRequestChecksumUpdated) {
+  auto sw = setupSwitch();
+  auto senderMac = kClientMac.toString();
+  std::replace(senderMac.begin(), senderMac.end(), ':', ' ');
+  // DHCP discover with a host name option, so that the options don't end
+  // on a word boundary
+  const string dhcpMsgTypeOpt = "35  01  01";
+  const string hostName = "0c  03  61  62  63";
+
+  EXPECT_HW_CALL(sw, stateChanged(_)).Times(0);
+  EXPECT_PLATFORM_CALL(sw, getLocalMac()).
+    WillRepeatedly(Return(kPlatformMac));
+
+  // checkDHCPPkt() makes sure the updated checksum is right
+  EXPECT_PKT(sw, "DHCP request", checkDHCPReq());
+
+  auto dhcpPkt = makeDHCPPacket(senderMac, "ff ff ff ff ff ff", "00 01",
+      "00 00 00 00", "ff ff ff ff", "00 43", "00 44", "01", dhcpMsgTypeOpt,
+      hostName);
+  setUDPChecksum(dhcpPkt.get());
+  sw->packetReceived(dhcpPkt->clone());
+}
+
+TEST(DHCPv4HandlerTest, DHCPReplyChecksumUpdated) {
+  auto sw = setupSwitch();
+  auto senderMac = kPlatformMac.toString();
+  std::replace(senderMac.begin(), senderMac.end(), ':', ' ');
+  auto targetMac = kClientMac.toString();
+  std::replace(targetMac.begin(), targetMac.end(), ':', ' ');
+  // DHCP offer, with an odd length agent option to strip
+  const string dhcpMsgTypeOpt = "35  01  02";
+  const string agentOption = "52  03  01  01  0a";
+  const string yiaddr = "0a 00 00 0a";
+
+  EXPECT_HW_CALL(sw, stateChanged(_)).Times(0);
+  EXPECT_PLATFORM_CALL(sw, getLocalMac()).
+    WillRepeatedly(Return(kPlatformMac));
+
+  // checkDHCPPkt() makes sure the updated checksum is right
+  EXPECT_PKT(sw, "DHCP reply", checkDHCPReply());
+
+  auto dhcpPkt = makeDHCPPacket(senderMac, targetMac, "00 01",
+      "14 14 14 14", "0a 00 00 01", "00 44", "00 43", "02", dhcpMsgTypeOpt,
+      agentOption, yiaddr);
+  setUDPChecksum(dhcpPkt.get());
+  sw->packetReceived(dhcpPkt->clone());
+}
+
 TEST(DHCPv4HandlerTest, DHCPBadRequest) {
   auto sw = setupSwitch();
   VlanID vlanID(1);
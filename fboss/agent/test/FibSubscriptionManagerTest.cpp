@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/FibSubscriptionManager.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using facebook::network::toBinaryAddress;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using std::shared_ptr;
+
+namespace {
+
+IpPrefix ipPrefix(const IPAddress& ip, int length) {
+  IpPrefix result;
+  result.ip = toBinaryAddress(ip);
+  result.prefixLength = length;
+  return result;
+}
+
+shared_ptr<SwitchState> updateRoutes(
+    const shared_ptr<SwitchState>& state,
+    std::function<void(RouteUpdater*)> fn) {
+  RouteUpdater updater(state->getRouteTables());
+  fn(&updater);
+  auto newState = state->clone();
+  newState->resetRouteTables(updater.updateDone());
+  newState->publish();
+  return newState;
+}
+
+} // unnamed namespace
+
+TEST(FibSubscriptionManager, RouteChanges) {
+  auto state = testStateA();
+  state->publish();
+
+  RouteNextHops nexthops;
+  nexthops.emplace(IPAddress("10.0.0.22"));
+  auto newState = updateRoutes(state, [&](RouteUpdater* updater) {
+    updater->addRoute(RouterID(0), IPAddress("10.2.0.0"), 16, nexthops);
+    updater->addRoute(RouterID(1), IPAddress("10.3.0.0"), 16, nexthops);
+    updater->delRoute(RouterID(0), IPAddress("10.1.1.0"), 24);
+  });
+
+  StateDelta delta(state, newState);
+  auto batches = FibSubscriptionManager::getRouteChanges(delta);
+  ASSERT_EQ(1, batches.size());
+  ASSERT_EQ(2, batches[0].size());
+
+  const auto& vrf0 = batches[0][0];
+  EXPECT_EQ(0, vrf0.vrf);
+  ASSERT_EQ(1, vrf0.updated.size());
+  EXPECT_EQ(ipPrefix(IPAddress("10.2.0.0"), 16), vrf0.updated[0].dest);
+  ASSERT_EQ(1, vrf0.updated[0].nextHopAddrs.size());
+  EXPECT_EQ(toBinaryAddress(IPAddress("10.0.0.22")),
+            vrf0.updated[0].nextHopAddrs[0]);
+  ASSERT_EQ(1, vrf0.deleted.size());
+  EXPECT_EQ(ipPrefix(IPAddress("10.1.1.0"), 24), vrf0.deleted[0]);
+
+  const auto& vrf1 = batches[0][1];
+  EXPECT_EQ(1, vrf1.vrf);
+  ASSERT_EQ(1, vrf1.updated.size());
+  EXPECT_EQ(ipPrefix(IPAddress("10.3.0.0"), 16), vrf1.updated[0].dest);
+  EXPECT_TRUE(vrf1.deleted.empty());
+
+  // Nothing changed, nothing to send
+  StateDelta noChange(newState, newState);
+  EXPECT_TRUE(FibSubscriptionManager::getRouteChanges(noChange).empty());
+}
+
+TEST(FibSubscriptionManager, LargeDeltaIsBatched) {
+  auto state = testStateA();
+  state->publish();
+
+  const uint32_t numRoutes = FibSubscriptionManager::kMaxRoutesPerUpdate + 5;
+  RouteNextHops nexthops;
+  nexthops.emplace(IPAddress("10.0.0.22"));
+  auto newState = updateRoutes(state, [&](RouteUpdater* updater) {
+    for (uint32_t n = 0; n < numRoutes; ++n) {
+      updater->addRoute(RouterID(0),
+                        IPAddress(IPAddressV4::fromLongHBO(0x14000000 | n)),
+                        32, nexthops);
+    }
+  });
+
+  StateDelta delta(state, newState);
+  auto batches = FibSubscriptionManager::getRouteChanges(delta);
+  ASSERT_EQ(2, batches.size());
+  size_t total = 0;
+  for (const auto& batch : batches) {
+    size_t batchSize = 0;
+    for (const auto& changes : batch) {
+      EXPECT_EQ(0, changes.vrf);
+      batchSize += changes.updated.size() + changes.deleted.size();
+    }
+    EXPECT_LE(batchSize, FibSubscriptionManager::kMaxRoutesPerUpdate);
+    total += batchSize;
+  }
+  EXPECT_EQ(numRoutes, total);
+}
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include <folly/SpinLock.h>
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using folly::make_unique;
+using std::shared_ptr;
+using std::unique_ptr;
+
+DEFINE_bool(concurrent_updates, false,
+            "Publish a new SwitchState every millisecond while the "
+            "readers are running");
+
+namespace {
+
+unique_ptr<SwSwitch> sw;
+
+/*
+ * What getState() used to do: a spinlock around a shared_ptr copy.
+ * Kept here so the two read paths can be compared side by side.
+ */
+class LockedState {
+ public:
+  explicit LockedState(shared_ptr<SwitchState> state)
+    : state_(std::move(state)) {}
+
+  shared_ptr<SwitchState> get() const {
+    folly::SpinLockGuard guard(lock_);
+    return state_;
+  }
+
+ private:
+  shared_ptr<SwitchState> state_;
+  mutable folly::SpinLock lock_;
+};
+unique_ptr<LockedState> lockedState;
+
+/*
+ * Split numIters getState() calls across numThreads reader threads.
+ */
+template<typename GetFn>
+void runReaders(size_t numIters, size_t numThreads, GetFn getFn) {
+  std::atomic<bool> stop{false};
+  std::thread updater;
+  BENCHMARK_SUSPEND {
+    if (FLAGS_concurrent_updates) {
+      updater = std::thread([&] {
+        while (!stop.load()) {
+          sw->updateStateBlocking("bump", [](const shared_ptr<SwitchState>& s) {
+            return s->clone();
+          });
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+    }
+  }
+
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < numThreads; ++t) {
+    readers.emplace_back([&] {
+      for (size_t n = 0; n < numIters / numThreads; ++n) {
+        folly::doNotOptimizeAway(getFn());
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  BENCHMARK_SUSPEND {
+    stop = true;
+    if (updater.joinable()) {
+      updater.join();
+    }
+  }
+}
+
+void getState(size_t numIters, size_t numThreads) {
+  runReaders(numIters, numThreads, [] { return sw->getState(); });
+}
+
+void getLockedState(size_t numIters, size_t numThreads) {
+  runReaders(numIters, numThreads, [] { return lockedState->get(); });
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(getLockedState, 1);
+BENCHMARK_RELATIVE_PARAM(getState, 1);
+BENCHMARK_PARAM(getLockedState, 4);
+BENCHMARK_RELATIVE_PARAM(getState, 4);
+BENCHMARK_PARAM(getLockedState, 16);
+BENCHMARK_RELATIVE_PARAM(getState, 16);
+BENCHMARK_PARAM(getLockedState, 32);
+BENCHMARK_RELATIVE_PARAM(getState, 32);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  MacAddress localMac("02:00:01:00:00:01");
+  sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10), false);
+  sw->init();
+  lockedState = make_unique<LockedState>(sw->getState());
+
+  folly::runBenchmarks();
+
+  lockedState.reset();
+  sw.reset();
+  return 0;
+}
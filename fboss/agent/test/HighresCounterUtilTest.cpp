@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HighresCounterUtil.h"
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Conv.h>
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <folly/ScopeGuard.h>
+#include <unistd.h>
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+
+void addSample(CounterPublication* pub, int64_t seconds, int64_t ns,
+               int64_t rx, int64_t tx) {
+  pub->times.emplace_back(
+      apache::thrift::FragileConstructor::FRAGILE, seconds, ns);
+  pub->counters["interface_rate::rx"].push_back(rx);
+  pub->counters["interface_rate::tx"].push_back(tx);
+}
+
+CounterPublication roundTrip(ColumnarCounterEncoder* encoder,
+                             ColumnarCounterDecoder* decoder,
+                             const CounterPublication& pub) {
+  CounterPublication encoded = pub;
+  encoder->encode(&encoded);
+  EXPECT_TRUE(encoded.__isset.columnar);
+  EXPECT_TRUE(encoded.times.empty());
+  EXPECT_TRUE(encoded.counters.empty());
+
+  CounterPublication decoded = encoded;
+  decoder->decode(&decoded);
+  return decoded;
+}
+
+// Replaces the contents of the file, keeping the same inode
+void rewrite(int fd, folly::StringPiece contents) {
+  folly::checkUnixError(ftruncate(fd, 0), "failed to truncate file");
+  folly::checkUnixError(
+      folly::pwriteFull(fd, contents.data(), contents.size(), 0),
+      "failed to write file");
+}
+
+std::string netDev(int64_t eth0Rx, int64_t eth0Tx,
+                   int64_t eth1Rx, int64_t eth1Tx) {
+  return folly::to<std::string>(
+      "Inter-|   Receive                            "
+      "                    |  Transmit\n",
+      " face |bytes    packets errs drop fifo frame compressed multicast"
+      "|bytes    packets errs drop fifo colls carrier compressed\n",
+      "    lo: 5000000    1000    0    0    0     0          0         0 "
+      " 5000000    1000    0    0    0     0       0          0\n",
+      "  eth0: ", eth0Rx, "    1000    0    0    0     0          0      "
+      "   0 ", eth0Tx, "    1000    0    0    0     0       0          0\n",
+      "  eth1:", eth1Rx, "    1000    0    0    0     0          0         0"
+      " ", eth1Tx, "    1000    0    0    0     0       0          0\n");
+}
+
+}
+
+TEST(InterfaceRateSampler, sample) {
+  char tmpPath[] = "fbossNetDevTest.XXXXXX";
+  int tmpFD = mkstemp(tmpPath);
+  folly::checkUnixError(tmpFD, "failed to create temporary file");
+  SCOPE_EXIT {
+    close(tmpFD);
+    unlink(tmpPath);
+  };
+  rewrite(tmpFD, netDev(100, 200, 1000, 2000));
+
+  InterfaceRateSampler sampler({"rx", "tx", "bogus"}, tmpPath);
+  EXPECT_EQ(2, sampler.numCounters());
+
+  // Only the ethN interfaces are counted
+  CounterPublication pub;
+  sampler.sample(&pub);
+  std::vector<int64_t> rx = {1100};
+  std::vector<int64_t> tx = {2200};
+  EXPECT_EQ(rx, pub.counters[InterfaceRateSampler::kRxBytesCounterFullName]);
+  EXPECT_EQ(tx, pub.counters[InterfaceRateSampler::kTxBytesCounterFullName]);
+
+  // The file is kept open, and read again from the start for every sample
+  rewrite(tmpFD, netDev(123456789012, 5, 1, 0));
+  sampler.sample(&pub);
+  rx.push_back(123456789013);
+  tx.push_back(5);
+  EXPECT_EQ(rx, pub.counters[InterfaceRateSampler::kRxBytesCounterFullName]);
+  EXPECT_EQ(tx, pub.counters[InterfaceRateSampler::kTxBytesCounterFullName]);
+}
+
+TEST(ColumnarCounters, roundTrip) {
+  ColumnarCounterEncoder encoder;
+  ColumnarCounterDecoder decoder;
+
+  CounterPublication pub;
+  pub.hostname = "switch";
+  addSample(&pub, 100, 999999000, 0, -1);
+  addSample(&pub, 101, 1000, 1500, std::numeric_limits<int64_t>::max());
+  addSample(&pub, 101, 1100, 1400, std::numeric_limits<int64_t>::min());
+  addSample(&pub, 101, 1250, 1400, 0);
+
+  auto decoded = roundTrip(&encoder, &decoder, pub);
+  EXPECT_EQ(pub.hostname, decoded.hostname);
+  EXPECT_EQ(pub.times, decoded.times);
+  EXPECT_EQ(pub.counters, decoded.counters);
+}
+
+TEST(ColumnarCounters, idsSentOnce) {
+  ColumnarCounterEncoder encoder;
+  ColumnarCounterDecoder decoder;
+
+  CounterPublication pub;
+  addSample(&pub, 1, 0, 10, 20);
+  CounterPublication first = pub;
+  encoder.encode(&first);
+  EXPECT_EQ(2, first.columnar.newIds.size());
+
+  CounterPublication second = pub;
+  encoder.encode(&second);
+  EXPECT_TRUE(second.columnar.newIds.empty());
+  EXPECT_EQ(first.columnar.values, second.columnar.values);
+
+  // The second publication can only be decoded once the IDs are known
+  CounterPublication copy = second;
+  EXPECT_THROW(decoder.decode(&copy), FbossError);
+  decoder.decode(&first);
+  decoder.decode(&second);
+  EXPECT_EQ(pub.counters, second.counters);
+
+  // Counters seen later get new IDs in the publication they first appear in
+  pub.counters["dumb_counter::foo"].push_back(1);
+  CounterPublication third = pub;
+  encoder.encode(&third);
+  ASSERT_EQ(1, third.columnar.newIds.size());
+  EXPECT_EQ("dumb_counter::foo", third.columnar.newIds.begin()->second);
+  decoder.decode(&third);
+  EXPECT_EQ(pub.counters, third.counters);
+}
+
+TEST(ColumnarCounters, compact) {
+  ColumnarCounterEncoder encoder;
+
+  // Regularly spaced samples of slowly growing counters should take a
+  // byte or two per value
+  CounterPublication pub;
+  for (int i = 0; i < 1000; ++i) {
+    addSample(&pub, 1000 + i / 1000, (i % 1000) * 1000000,
+              1000000000 + i * 100, 2000000000 + i * 10);
+  }
+  encoder.encode(&pub);
+  EXPECT_GT(1100, pub.columnar.times.size());
+  for (const auto& column : pub.columnar.values) {
+    EXPECT_GT(2100, column.second.size());
+  }
+}
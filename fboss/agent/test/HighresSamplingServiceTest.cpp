@@ -0,0 +1,210 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HighresCounterSubscriptionHandler.h"
+
+#include <folly/Memory.h>
+#include <folly/io/async/EventBase.h>
+
+#include <future>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::EventBase;
+using folly::make_unique;
+using std::chrono::milliseconds;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+
+namespace {
+
+/*
+ * Returns the number of times it has been sampled for every counter, and
+ * keeps count of the number of rounds in total.
+ */
+class CountingSampler : public HighresSampler {
+ public:
+  CountingSampler(const std::set<string>& counters,
+                  std::atomic<int>* numRounds)
+      : counters_(counters), numRounds_(numRounds) {}
+
+  void sample(CounterPublication* pub) override {
+    int round = ++*numRounds_;
+    for (const auto& counter : counters_) {
+      pub->counters[counter].push_back(round);
+    }
+  }
+  int numCounters() const override { return counters_.size(); }
+
+ private:
+  std::set<string> counters_;
+  std::atomic<int>* numRounds_;
+};
+
+/*
+ * Keeps the publications instead of sending them to a client.
+ */
+class TestSender : public SampleSender {
+ public:
+  TestSender(shared_ptr<Signal> killSwitch, EventBase* evb, int numCounters)
+      : SampleSender(nullptr, std::move(killSwitch), evb, numCounters) {}
+
+  void publish(unique_ptr<CounterPublication> pub) override {
+    pubs.push_back(std::move(*pub));
+  }
+
+  // Only touched from the event base thread
+  std::vector<CounterPublication> pubs;
+};
+
+class HighresSamplingServiceTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    evbThread_ = std::thread([this]() { evb_.loopForever(); });
+  }
+
+  void TearDown() override {
+    service_.reset();
+    evb_.terminateLoopSoon();
+    evbThread_.join();
+  }
+
+  // Builds one CountingSampler for all the counters, once the test has let
+  // the sampling thread start
+  int getSamplers(HighresSamplerList* samplers,
+                  const std::set<string>& counters) {
+    start_.wait();
+    ++numSamplerBuilds_;
+    samplers->push_back(make_unique<CountingSampler>(counters, &numRounds_));
+    return counters.size();
+  }
+
+  shared_ptr<TestSender> subscribe(const std::set<string>& counters,
+                                   int64_t count,
+                                   milliseconds interval,
+                                   shared_ptr<Signal> killSwitch = nullptr) {
+    CounterSubscribeRequest req;
+    req.counters = counters;
+    req.maxTime = 60;
+    req.maxCount = count;
+    req.intervalInNs = std::chrono::nanoseconds(interval).count();
+    req.batchSize = 4;
+    req.sleepMethod = SleepMethod::NANOSLEEP;
+    if (!killSwitch) {
+      killSwitch = make_shared<Signal>();
+    }
+
+    auto sender = make_shared<TestSender>(killSwitch, &evb_, counters.size());
+    service_->subscribe(
+        make_unique<SampleProducer>(sender, killSwitch, &evb_, req,
+                                    counters.size()),
+        false);
+    return sender;
+  }
+
+  void waitForSubscriptions() {
+    for (int i = 0; i < 10000 && service_->getNumSubscriptions() > 0; ++i) {
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    ASSERT_EQ(0, service_->getNumSubscriptions());
+    // Let the queued publications through
+    evb_.runInEventBaseThreadAndWait([]() {});
+  }
+
+  // The values a subscriber got for a counter, across publications
+  static std::vector<int64_t> getValues(const TestSender& sender,
+                                        const string& counter) {
+    std::vector<int64_t> values;
+    for (const auto& pub : sender.pubs) {
+      auto it = pub.counters.find(counter);
+      if (it != pub.counters.end()) {
+        EXPECT_EQ(pub.times.size(), it->second.size());
+        values.insert(values.end(), it->second.begin(), it->second.end());
+      }
+    }
+    return values;
+  }
+
+  EventBase evb_;
+  std::thread evbThread_;
+  std::promise<void> startPromise_;
+  std::shared_future<void> start_{startPromise_.get_future().share()};
+  std::atomic<int> numSamplerBuilds_{0};
+  std::atomic<int> numRounds_{0};
+  unique_ptr<HighresSamplingService> service_{
+    make_unique<HighresSamplingService>(
+        [this](HighresSamplerList* samplers, const std::set<string>& counters) {
+          return getSamplers(samplers, counters);
+        })};
+};
+
+}
+
+TEST_F(HighresSamplingServiceTest, sharedRounds) {
+  // Hold the sampling thread back until everyone has subscribed, so that all
+  // subscriptions start on the same tick
+  auto both = subscribe({"test::a", "test::b"}, 10, milliseconds(2));
+  auto a = subscribe({"test::a"}, 10, milliseconds(2));
+  auto b = subscribe({"test::b"}, 10, milliseconds(2));
+  startPromise_.set_value();
+  waitForSubscriptions();
+
+  // Every counter was sampled once per tick for everyone
+  EXPECT_EQ(10, numRounds_.load());
+  std::vector<int64_t> expected = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(expected, getValues(*both, "test::a"));
+  EXPECT_EQ(expected, getValues(*both, "test::b"));
+  EXPECT_EQ(expected, getValues(*a, "test::a"));
+  EXPECT_EQ(expected, getValues(*b, "test::b"));
+
+  // Subscribers only get what they asked for, in batches
+  EXPECT_TRUE(getValues(*a, "test::b").empty());
+  EXPECT_TRUE(getValues(*b, "test::a").empty());
+  ASSERT_EQ(3, a->pubs.size());
+  EXPECT_EQ(4, a->pubs[0].times.size());
+  EXPECT_EQ(2, a->pubs[2].times.size());
+}
+
+TEST_F(HighresSamplingServiceTest, finestInterval) {
+  auto fast = subscribe({"test::a"}, 8, milliseconds(2));
+  auto slow = subscribe({"test::a"}, 2, milliseconds(10));
+  startPromise_.set_value();
+  waitForSubscriptions();
+
+  // Both subscribers are fed from the same rounds
+  auto fastValues = getValues(*fast, "test::a");
+  auto slowValues = getValues(*slow, "test::a");
+  EXPECT_EQ(8, fastValues.size());
+  ASSERT_EQ(2, slowValues.size());
+  EXPECT_EQ(1, slowValues[0]);
+  EXPECT_GE(8, slowValues[1]);
+  EXPECT_LE(8, numRounds_.load());
+}
+
+TEST_F(HighresSamplingServiceTest, killSwitch) {
+  auto killSwitch = make_shared<Signal>();
+  auto killed = subscribe({"test::a"}, 1000000, milliseconds(1), killSwitch);
+  auto other = subscribe({"test::b"}, 5, milliseconds(1));
+  startPromise_.set_value();
+  killSwitch->set();
+  waitForSubscriptions();
+
+  // Once nobody wants test::a any more, the samplers are rebuilt without it
+  EXPECT_GT(10, getValues(*killed, "test::a").size());
+  EXPECT_EQ(5, getValues(*other, "test::b").size());
+  EXPECT_LE(2, numSamplerBuilds_.load());
+
+  // The service starts up again for new subscriptions
+  auto again = subscribe({"test::a"}, 3, milliseconds(1));
+  waitForSubscriptions();
+  EXPECT_EQ(3, getValues(*again, "test::a").size());
+}
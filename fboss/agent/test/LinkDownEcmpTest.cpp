@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <boost/cast.hpp>
+
+#include <folly/Memory.h>
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/hw/sim/SimSwitch.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using folly::make_unique;
+using std::make_shared;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+const RouterID kRid(0);
+
+unique_ptr<SwSwitch> setupSwitch() {
+  MacAddress localMac("02:00:01:00:00:01");
+  auto sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10),
+                                  false);
+  sw->init();
+
+  auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+
+    // Add VLAN 1, and ports 1-9 which belong to it.
+    auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+    state->addVlan(vlan1);
+    for (int idx = 1; idx < 10; ++idx) {
+      vlan1->addPort(PortID(idx), false);
+    }
+    // Add Interface 1 to VLAN 1
+    auto intf1 = make_shared<Interface>
+      (InterfaceID(1), kRid, VlanID(1),
+       "interface1", MacAddress("02:00:01:00:00:01"), 9000);
+    Interface::Addresses addrs1;
+    addrs1.emplace(IPAddress("10.0.0.1"), 24);
+    intf1->setAddresses(addrs1);
+    state->addIntf(intf1);
+
+    // Two nexthops, learned on ports 1 and 2
+    auto arpTable = vlan1->getArpTable();
+    arpTable->addEntry(IPAddressV4("10.0.0.10"),
+                       MacAddress("00:02:00:00:00:10"),
+                       PortID(1), InterfaceID(1));
+    arpTable->addEntry(IPAddressV4("10.0.0.11"),
+                       MacAddress("00:02:00:00:00:11"),
+                       PortID(2), InterfaceID(1));
+
+    // And an ECMP route over both of them
+    RouteUpdater updater(state->getRouteTables());
+    updater.addInterfaceAndLinkLocalRoutes(state->getInterfaces());
+    RouteNextHops nhops;
+    nhops.emplace(IPAddress("10.0.0.10"));
+    nhops.emplace(IPAddress("10.0.0.11"));
+    updater.addRoute(kRid, IPAddress("20.0.0.0"), 16, nhops);
+    state->resetRouteTables(updater.updateDone());
+    return state;
+  };
+
+  sw->updateStateBlocking("setup", updateFn);
+  return sw;
+}
+
+RouteForwardNexthops ecmpNexthops() {
+  RouteForwardNexthops nhops;
+  nhops.emplace(InterfaceID(1), IPAddress("10.0.0.10"));
+  nhops.emplace(InterfaceID(1), IPAddress("10.0.0.11"));
+  return nhops;
+}
+
+} // unnamed namespace
+
+TEST(LinkDownEcmp, PrunedBeforeSwReconvergence) {
+  auto sw = setupSwitch();
+  sw->initialConfigApplied();
+  sw->fibSynced();
+  auto sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+
+  auto members = sim->getEcmpMembers(kRid, ecmpNexthops());
+  ASSERT_EQ(2, members.size());
+
+  // Hold up the update thread, so the software side can't reconverge
+  // while we look at the hardware state.
+  std::promise<void> unblock;
+  auto blocked = unblock.get_future().share();
+  sw->updateState("block", [blocked](const shared_ptr<SwitchState>&) {
+    blocked.wait();
+    return shared_ptr<SwitchState>();
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  sim->linkStateChanged(PortID(1), false);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  // The port must be gone from the ECMP group as soon as the linkscan
+  // event has been handled, without waiting for a state update.
+  members = sim->getEcmpMembers(kRid, ecmpNexthops());
+  EXPECT_EQ(1, members.size());
+  EXPECT_EQ(members.end(), members.find(PortID(1)));
+  EXPECT_NE(members.end(), members.find(PortID(2)));
+  EXPECT_FALSE(sim->isPortUp(PortID(1)));
+  EXPECT_EQ(PortID(1), sw->getState()->getVlans()->getVlan(VlanID(1))
+      ->getArpTable()->getEntry(IPAddressV4("10.0.0.10"))->getPort());
+  LOG(INFO) << "link down to ECMP rebalance took " << elapsed.count() << "us";
+
+  // Let the software reconverge. The neighbor on port 1 becomes pending,
+  // and the ECMP group must not pick port 1 back up.
+  unblock.set_value();
+  waitForStateUpdates(sw.get());
+  EXPECT_TRUE(sw->getState()->getVlans()->getVlan(VlanID(1))
+      ->getArpTable()->getEntry(IPAddressV4("10.0.0.10"))->isPending());
+  members = sim->getEcmpMembers(kRid, ecmpNexthops());
+  EXPECT_EQ(1, members.size());
+  EXPECT_EQ(members.end(), members.find(PortID(1)));
+}
+
+TEST(LinkDownEcmp, GroupsFollowState) {
+  auto sw = setupSwitch();
+  auto sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+
+  // A neighbor moving to another port moves its ECMP member with it
+  sw->updateStateBlocking("move neighbor",
+      [](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+    auto vlan = state->getVlans()->getVlan(VlanID(1)).get();
+    auto arpTable = vlan->getArpTable()->modify(&vlan, &state);
+    arpTable->updateEntry(IPAddressV4("10.0.0.11"),
+                          MacAddress("00:02:00:00:00:11"),
+                          PortID(3), InterfaceID(1));
+    return state;
+  });
+  auto members = sim->getEcmpMembers(kRid, ecmpNexthops());
+  EXPECT_EQ(2, members.size());
+  EXPECT_NE(members.end(), members.find(PortID(1)));
+  EXPECT_NE(members.end(), members.find(PortID(3)));
+
+  // And the group goes away with the last route using it
+  sw->updateStateBlocking("delete route",
+      [](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+    RouteUpdater updater(state->getRouteTables());
+    updater.delRoute(kRid, IPAddress("20.0.0.0"), 16);
+    state->resetRouteTables(updater.updateDone());
+    return state;
+  });
+  EXPECT_TRUE(sim->getEcmpMembers(kRid, ecmpNexthops()).empty());
+}
@@ -0,0 +1,154 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include "fboss/agent/lldp/LinkNeighbor.h"
+#include "fboss/agent/lldp/LinkNeighborDB.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using std::chrono::seconds;
+
+DEFINE_int32(num_ports, 128, "Number of ports with a neighbor");
+DEFINE_int32(num_readers, 1,
+             "Threads calling getNeighbors() while the updates run");
+
+namespace {
+
+/*
+ * What LinkNeighborDB used to do: one map of every neighbor behind a single
+ * mutex, with a full scan to prune on every update.  Kept here so the two
+ * can be compared side by side.
+ */
+class LockedNeighborDB {
+ public:
+  void update(const LinkNeighbor& neighbor) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    for (auto& portEntry : byLocalPort_) {
+      auto& map = portEntry.second;
+      auto it = map.begin();
+      while (it != map.end()) {
+        auto current = it++;
+        if (current->second.isExpired(now)) {
+          map.erase(current);
+        }
+      }
+    }
+    byLocalPort_[neighbor.getLocalPort()][neighbor.getChassisId()] = neighbor;
+  }
+
+  std::vector<LinkNeighbor> getNeighbors() {
+    std::vector<LinkNeighbor> results;
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (const auto& portEntry : byLocalPort_) {
+      for (const auto& entry : portEntry.second) {
+        results.push_back(entry.second);
+      }
+    }
+    return results;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<PortID, std::map<std::string, LinkNeighbor>> byLocalPort_;
+};
+
+std::vector<LinkNeighbor> makeNeighbors() {
+  std::vector<LinkNeighbor> neighbors;
+  for (int port = 1; port <= FLAGS_num_ports; ++port) {
+    LinkNeighbor n;
+    n.setProtocol(LinkProtocol::LLDP);
+    n.setLocalPort(PortID(port));
+    n.setLocalVlan(VlanID(1));
+    n.setMac(MacAddress("00:11:22:33:44:55"));
+    n.setChassisId(folly::to<std::string>("neighbor", port),
+                   LldpChassisIdType::LOCALLY_ASSIGNED);
+    n.setPortId("1/1", LldpPortIdType::LOCALLY_ASSIGNED);
+    n.setSystemName(folly::to<std::string>("neighbor", port));
+    n.setTTL(seconds(120));
+    neighbors.push_back(n);
+  }
+  return neighbors;
+}
+
+/*
+ * Apply numIters updates, spread across numWriters threads as if they were
+ * frames received on different ports, while FLAGS_num_readers threads keep
+ * reading the whole DB.
+ */
+template<typename DB>
+void runUpdates(size_t numIters, size_t numWriters) {
+  DB db;
+  std::vector<LinkNeighbor> neighbors;
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> readers;
+  BENCHMARK_SUSPEND {
+    neighbors = makeNeighbors();
+    for (const auto& neighbor : neighbors) {
+      db.update(neighbor);
+    }
+    for (int r = 0; r < FLAGS_num_readers; ++r) {
+      readers.emplace_back([&] {
+        while (!stop.load()) {
+          folly::doNotOptimizeAway(db.getNeighbors());
+        }
+      });
+    }
+  }
+
+  std::vector<std::thread> writers;
+  for (size_t t = 0; t < numWriters; ++t) {
+    writers.emplace_back([&, t] {
+      for (size_t n = t; n < numIters; n += numWriters) {
+        db.update(neighbors[n % neighbors.size()]);
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  BENCHMARK_SUSPEND {
+    stop = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+  }
+}
+
+void lockedUpdates(size_t numIters, size_t numWriters) {
+  runUpdates<LockedNeighborDB>(numIters, numWriters);
+}
+
+void stripedUpdates(size_t numIters, size_t numWriters) {
+  runUpdates<LinkNeighborDB>(numIters, numWriters);
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(lockedUpdates, 1);
+BENCHMARK_RELATIVE_PARAM(stripedUpdates, 1);
+BENCHMARK_PARAM(lockedUpdates, 4);
+BENCHMARK_RELATIVE_PARAM(stripedUpdates, 4);
+BENCHMARK_PARAM(lockedUpdates, 16);
+BENCHMARK_RELATIVE_PARAM(stripedUpdates, 16);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -25,6 +25,7 @@
 #include "fboss/agent/LldpManager.h"
 
 #include <boost/cast.hpp>
+#include <set>
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 using ::testing::AtLeast;
@@ -109,6 +110,47 @@ TEST(LldpManagerTest, LldpSend) {
   lldpManager.sendLldpOnAllPorts(false);
 }
 
+/*
+ * Record the port ID TLV of every LLDP frame sent.
+ */
+TxMatchFn recordPortIds(std::set<std::string>* portIds) {
+  return [=](const TxPacket* pkt) {
+    Cursor c(pkt->buf());
+    // Ethernet header with a VLAN tag, then the chassis ID TLV
+    c.skip(18);
+    c.skip(2 + LldpManager::CHASSIS_TLV_LENGTH);
+    auto portTlv = c.readBE<uint16_t>();
+    EXPECT_EQ(LldpManager::PORT_TLV_TYPE,
+              portTlv >> LldpManager::TLV_TYPE_LEFT_SHIFT_OFFSET);
+    auto length = portTlv & 0x1ff;
+    c.skip(1);
+    portIds->insert(c.readFixedString(length - 1));
+  };
+}
+
+TEST(LldpManagerTest, FrameReencodedOnPortChange) {
+  auto sw = setupSwitch();
+  std::set<std::string> portIds;
+  EXPECT_HW_CALL(sw, sendPacketOutOfPort_(TxPacketMatcher::createMatcher(
+                  "Lldp PDU", recordPortIds(&portIds)))).Times(AtLeast(1));
+  LldpManager lldpManager(sw.get());
+  lldpManager.sendLldpOnAllPorts(false);
+  EXPECT_EQ(1, portIds.count("port1"));
+
+  sw->updateStateBlocking("rename port",
+                          [](const shared_ptr<SwitchState>& state) {
+    auto newState = state;
+    auto port = state->getPorts()->getPort(PortID(1))->modify(&newState);
+    port->setName("renamedPort1");
+    return newState;
+  });
+  portIds.clear();
+  lldpManager.sendLldpOnAllPorts(false);
+  EXPECT_EQ(0, portIds.count("port1"));
+  EXPECT_EQ(1, portIds.count("renamedPort1"));
+  EXPECT_EQ(1, portIds.count("port2"));
+}
+
 TEST(LldpManagerTest, NotEnabledTest) {
   // Setup switch without flags enabling LLDP, and
   // send an LLDP frame nevertheless. Used to segfault
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+DEFINE_int32(num_vlans, 64, "Number of VLANs in the benchmark state");
+
+namespace {
+
+const MacAddress kMac("02:00:00:00:00:01");
+const PortID kDownPort(1);
+
+/*
+ * Build a state with FLAGS_num_vlans VLANs, each with entriesPerVlan ARP and
+ * NDP entries spread over ports 2-33.  Only the first VLAN has neighbors on
+ * the port that goes down.
+ */
+shared_ptr<SwitchState> makeState(uint32_t entriesPerVlan) {
+  auto state = make_shared<SwitchState>();
+  for (int v = 1; v <= FLAGS_num_vlans; ++v) {
+    auto vlan = make_shared<Vlan>(VlanID(v), "vlan");
+    auto arpTable = make_shared<ArpTable>();
+    auto ndpTable = make_shared<NdpTable>();
+    InterfaceID intf(v);
+    for (uint32_t i = 0; i < entriesPerVlan; ++i) {
+      PortID port(2 + i % 32);
+      if (v == 1 && i == 0) {
+        port = kDownPort;
+      }
+      arpTable->addEntry(IPAddressV4::fromLongHBO(0x0a000000 | i), kMac,
+                         port, intf);
+      IPAddressV6 ip6(folly::sformat("2401:db00::{:x}:{:x}",
+                                     i >> 16, i & 0xffff));
+      ndpTable->addEntry(ip6, kMac, port, intf);
+    }
+    vlan->setArpTable(arpTable);
+    vlan->setNdpTable(ndpTable);
+    state->addVlan(vlan);
+  }
+  state->publish();
+  return state;
+}
+
+void portDown(size_t numIters, uint32_t entriesPerVlan) {
+  shared_ptr<SwitchState> state;
+  BENCHMARK_SUSPEND {
+    state = makeState(entriesPerVlan);
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    folly::doNotOptimizeAway(
+        SwSwitch::setNeighborsPendingForPort(state, kDownPort));
+  }
+  BENCHMARK_SUSPEND {
+    state.reset();
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(portDown, 16);
+BENCHMARK_PARAM(portDown, 256);
+BENCHMARK_PARAM(portDown, 4096);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
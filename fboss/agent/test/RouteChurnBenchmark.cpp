@@ -0,0 +1,418 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/Memory.h>
+#include <folly/String.h>
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/ThriftHandler.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace facebook::fboss;
+using facebook::network::toBinaryAddress;
+using facebook::network::toIPAddress;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using folly::StringPiece;
+using folly::make_unique;
+using std::make_shared;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+
+DEFINE_int32(churn_table_size, 100000,
+             "Number of routes in the full table the churn is applied to");
+DEFINE_int32(churn_v6_percent, 25,
+             "Percentage of the synthetic routes that are IPv6");
+DEFINE_int32(churn_burst_size, 1000,
+             "Number of routes withdrawn and re-announced in each burst");
+DEFINE_int32(churn_seed, 1, "Seed for the synthetic churn");
+DEFINE_string(churn_replay_file, "",
+              "Replay the churn recorded in this file instead of a synthetic "
+              "one.  Each block of lines, ended by a blank line, is one "
+              "update.  Lines are \"add <prefix>/<len> <nexthop>...\" or "
+              "\"del <prefix>/<len>\", and a block starting with \"sync\" "
+              "replaces the whole table with its routes");
+
+namespace {
+
+const MacAddress kLocalMac("02:00:01:00:00:01");
+const int16_t kClientID = 1;
+
+/*
+ * One thrift call's worth of route changes.
+ */
+struct ChurnUpdate {
+  enum Op {
+    ADD,
+    DELETE,
+    SYNC,
+  };
+
+  Op op{ADD};
+  vector<UnicastRoute> routes;
+  vector<IpPrefix> prefixes;
+};
+
+/*
+ * Time taken to apply each update, in the order they were applied.
+ */
+struct Latencies {
+  void add(std::chrono::steady_clock::duration elapsed) {
+    samples.push_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+        .count());
+  }
+
+  void report(StringPiece name) {
+    if (samples.empty()) {
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    uint64_t total = 0;
+    for (auto sample : samples) {
+      total += sample;
+    }
+    auto percentile = [&](size_t pct) {
+      return samples[std::min(samples.size() - 1,
+                              samples.size() * pct / 100)];
+    };
+    LOG(INFO) << name << ": " << samples.size() << " updates, "
+              << (total ? samples.size() * 1000000.0 / total : 0.0)
+              << " updates/s, p50 " << percentile(50) << "us, p99 "
+              << percentile(99) << "us, max " << samples.back() << "us";
+  }
+
+  vector<uint64_t> samples;
+};
+
+// Global state used by the benchmarks
+unique_ptr<SwSwitch> sw;
+unique_ptr<ThriftHandler> handler;
+vector<UnicastRoute> fullTable;
+vector<ChurnUpdate> churn;
+size_t nextUpdate{0};
+Latencies syncLatencies;
+Latencies churnLatencies;
+
+/*
+ * VLAN 1 with ports 1-9, and an interface on it that all the nexthops are
+ * on, so that every route resolves.
+ *
+ * The switch is a SimSwitch, so the times include programming its
+ * forwarding tables as well as the RIB and state updates.  SimSwitch only
+ * touches the routes and ECMP groups in each delta, so that part grows with
+ * the size of the update rather than of the table, as it would on hardware.
+ */
+unique_ptr<SwSwitch> setupSwitch() {
+  auto sw = make_unique<SwSwitch>(make_unique<SimPlatform>(kLocalMac, 10));
+  sw->init();
+
+  auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+    auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+    state->addVlan(vlan1);
+    for (int idx = 1; idx < 10; ++idx) {
+      vlan1->addPort(PortID(idx), false);
+    }
+    auto intf1 = make_shared<Interface>
+      (InterfaceID(1), RouterID(0), VlanID(1),
+       "interface1", kLocalMac, 9000);
+    Interface::Addresses addrs1;
+    addrs1.emplace(IPAddress("10.0.0.1"), 24);
+    addrs1.emplace(IPAddress("2401:db00::1"), 64);
+    intf1->setAddresses(addrs1);
+    state->addIntf(intf1);
+    return state;
+  };
+
+  sw->updateStateBlocking("setup", updateFn);
+  sw->initialConfigApplied();
+  waitForStateUpdates(sw.get());
+  return sw;
+}
+
+IpPrefix makePrefix(const IPAddress& ip, uint8_t length) {
+  IpPrefix prefix;
+  prefix.ip = toBinaryAddress(ip);
+  prefix.prefixLength = length;
+  return prefix;
+}
+
+UnicastRoute makeRoute(const IPAddress& ip, uint8_t length,
+                       const vector<IPAddress>& nexthops) {
+  UnicastRoute route;
+  route.dest = makePrefix(ip, length);
+  for (const auto& nexthop : nexthops) {
+    route.nextHopAddrs.push_back(toBinaryAddress(nexthop));
+  }
+  return route;
+}
+
+/*
+ * A full table of /24s and /48s, each with one or two of four nexthops,
+ * and bursts that withdraw FLAGS_churn_burst_size random routes from it and
+ * then announce them again, half of them with different nexthops.
+ */
+void makeSyntheticChurn() {
+  std::mt19937 gen(FLAGS_churn_seed);
+  vector<vector<IPAddress>> v4Nexthops{
+    {IPAddress("10.0.0.10")},
+    {IPAddress("10.0.0.11")},
+    {IPAddress("10.0.0.10"), IPAddress("10.0.0.11")},
+    {IPAddress("10.0.0.12"), IPAddress("10.0.0.13")},
+  };
+  vector<vector<IPAddress>> v6Nexthops{
+    {IPAddress("2401:db00::10")},
+    {IPAddress("2401:db00::11")},
+    {IPAddress("2401:db00::10"), IPAddress("2401:db00::11")},
+    {IPAddress("2401:db00::12"), IPAddress("2401:db00::13")},
+  };
+
+  uint32_t numV6 = uint64_t(FLAGS_churn_table_size) *
+    FLAGS_churn_v6_percent / 100;
+  uint32_t numV4 = FLAGS_churn_table_size - numV6;
+  vector<size_t> nexthopIndex;
+  for (uint32_t n = 0; n < numV4; ++n) {
+    nexthopIndex.push_back(gen() % v4Nexthops.size());
+    auto ip = IPAddressV4::fromLongHBO(0x14000000 + (n << 8));
+    fullTable.push_back(makeRoute(ip, 24, v4Nexthops[nexthopIndex.back()]));
+  }
+  for (uint32_t n = 0; n < numV6; ++n) {
+    nexthopIndex.push_back(gen() % v6Nexthops.size());
+    auto ip = IPAddressV6(folly::sformat("2401:db01:{:x}:{:x}::",
+                                         n >> 16, n & 0xffff));
+    fullTable.push_back(makeRoute(ip, 48, v6Nexthops[nexthopIndex.back()]));
+  }
+  if (fullTable.empty()) {
+    return;
+  }
+
+  // Each burst leaves the table as it found it, so the churn can be
+  // replayed over and over.
+  size_t burstSize = std::min<size_t>(FLAGS_churn_burst_size,
+                                      fullTable.size());
+  for (int burst = 0; burst < 64; ++burst) {
+    ChurnUpdate withdraw;
+    withdraw.op = ChurnUpdate::DELETE;
+    ChurnUpdate announce;
+    announce.op = ChurnUpdate::ADD;
+    ChurnUpdate restore;
+    restore.op = ChurnUpdate::ADD;
+    for (size_t n = 0; n < burstSize; ++n) {
+      size_t idx = gen() % fullTable.size();
+      const auto& route = fullTable[idx];
+      withdraw.prefixes.push_back(route.dest);
+      if (n % 2) {
+        announce.routes.push_back(route);
+        continue;
+      }
+      const auto& nexthops = idx < numV4 ? v4Nexthops : v6Nexthops;
+      auto other = makeRoute(toIPAddress(route.dest.ip),
+                             route.dest.prefixLength,
+                             nexthops[(nexthopIndex[idx] + 1) %
+                                      nexthops.size()]);
+      announce.routes.push_back(std::move(other));
+      restore.routes.push_back(route);
+    }
+    churn.push_back(std::move(withdraw));
+    churn.push_back(std::move(announce));
+    churn.push_back(std::move(restore));
+  }
+}
+
+folly::CIDRNetwork parsePrefix(StringPiece str) {
+  return IPAddress::createNetwork(str.str());
+}
+
+/*
+ * Read the churn recorded in FLAGS_churn_replay_file.  The full table is
+ * the first block if it is a sync, and empty otherwise.
+ */
+void loadChurn() {
+  std::string contents;
+  if (!folly::readFile(FLAGS_churn_replay_file.c_str(), contents)) {
+    throw FbossError("unable to read ", FLAGS_churn_replay_file);
+  }
+  vector<StringPiece> lines;
+  folly::split('\n', contents, lines);
+  // A blank line at the end finishes the last block
+  lines.push_back(StringPiece());
+
+  ChurnUpdate adds;
+  ChurnUpdate dels;
+  dels.op = ChurnUpdate::DELETE;
+  bool inSync = false;
+  auto finishBlock = [&]() {
+    if (inSync) {
+      if (churn.empty() && fullTable.empty()) {
+        fullTable = std::move(adds.routes);
+      } else {
+        adds.op = ChurnUpdate::SYNC;
+        churn.push_back(std::move(adds));
+      }
+    } else {
+      if (!adds.routes.empty()) {
+        churn.push_back(std::move(adds));
+      }
+      if (!dels.prefixes.empty()) {
+        churn.push_back(std::move(dels));
+      }
+    }
+    adds = ChurnUpdate();
+    dels = ChurnUpdate();
+    dels.op = ChurnUpdate::DELETE;
+    inSync = false;
+  };
+
+  for (auto line : lines) {
+    line = folly::trimWhitespace(line);
+    if (line.empty()) {
+      finishBlock();
+      continue;
+    }
+    if (line.startsWith("#")) {
+      continue;
+    }
+    vector<StringPiece> fields;
+    folly::split(' ', line, fields, true);
+    if (fields[0] == "sync") {
+      inSync = true;
+    } else if (fields[0] == "add" && fields.size() >= 3) {
+      auto prefix = parsePrefix(fields[1]);
+      vector<IPAddress> nexthops;
+      for (size_t n = 2; n < fields.size(); ++n) {
+        nexthops.emplace_back(fields[n]);
+      }
+      adds.routes.push_back(makeRoute(prefix.first, prefix.second, nexthops));
+    } else if (fields[0] == "del" && fields.size() == 2 && !inSync) {
+      auto prefix = parsePrefix(fields[1]);
+      dels.prefixes.push_back(makePrefix(prefix.first, prefix.second));
+    } else {
+      throw FbossError("bad churn line: ", line);
+    }
+  }
+}
+
+template<typename T>
+unique_ptr<vector<T>> copyOf(const vector<T>& items) {
+  return make_unique<vector<T>>(items);
+}
+
+void applyUpdate(const ChurnUpdate& update) {
+  switch (update.op) {
+    case ChurnUpdate::ADD:
+      handler->addUnicastRoutes(kClientID, copyOf(update.routes));
+      break;
+    case ChurnUpdate::DELETE:
+      handler->deleteUnicastRoutes(kClientID, copyOf(update.prefixes));
+      break;
+    case ChurnUpdate::SYNC:
+      handler->syncFib(kClientID, copyOf(update.routes));
+      break;
+  }
+}
+
+void init() {
+  sw = setupSwitch();
+  handler = make_unique<ThriftHandler>(sw.get());
+  if (FLAGS_churn_replay_file.empty()) {
+    makeSyntheticChurn();
+  } else {
+    loadChurn();
+  }
+  // The initial sync also marks the FIB synced, which the incremental
+  // route calls need.
+  handler->syncFib(kClientID, copyOf(fullTable));
+  LOG(INFO) << "loaded " << fullTable.size() << " routes and "
+            << churn.size() << " churn updates";
+}
+
+} // unnamed namespace
+
+/*
+ * Sync the full table, replacing a table of the same size each time.  Half
+ * the runs add a nexthop to every route, so that every route is changed;
+ * the other half sync the original table back.
+ */
+BENCHMARK(FullTableSync, numIters) {
+  ChurnUpdate moved;
+  BENCHMARK_SUSPEND {
+    moved.op = ChurnUpdate::SYNC;
+    moved.routes = fullTable;
+    for (auto& route : moved.routes) {
+      auto ip = toIPAddress(route.dest.ip);
+      route.nextHopAddrs.push_back(toBinaryAddress(
+          ip.isV4() ? IPAddress("10.0.0.14") : IPAddress("2401:db00::14")));
+    }
+  }
+  for (size_t n = 0; n < numIters; ++n) {
+    auto start = std::chrono::steady_clock::now();
+    if (n % 2 == 0) {
+      applyUpdate(moved);
+    } else {
+      handler->syncFib(kClientID, copyOf(fullTable));
+    }
+    syncLatencies.add(std::chrono::steady_clock::now() - start);
+  }
+  BENCHMARK_SUSPEND {
+    if (numIters % 2) {
+      handler->syncFib(kClientID, copyOf(fullTable));
+    }
+  }
+}
+
+/*
+ * Apply one churn update per iteration, wrapping around to the start of
+ * the churn when it runs out.
+ */
+BENCHMARK(RouteChurn, numIters) {
+  CHECK(!churn.empty()) << "no churn to replay";
+  for (size_t n = 0; n < numIters; ++n) {
+    const auto& update = churn[nextUpdate];
+    nextUpdate = (nextUpdate + 1) % churn.size();
+    auto start = std::chrono::steady_clock::now();
+    applyUpdate(update);
+    churnLatencies.add(std::chrono::steady_clock::now() - start);
+  }
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  // Loading a full table takes far longer than any single update, so do it
+  // once up front rather than inside the benchmarks.
+  init();
+
+  folly::runBenchmarks();
+
+  // folly reports the mean time per update; the tail is what matters for
+  // convergence, so report that as well.
+  syncLatencies.report("FullTableSync");
+  churnLatencies.report("RouteChurn");
+
+  handler.reset();
+  sw.reset();
+  return 0;
+}
@@ -46,10 +46,35 @@ class SffTransceiver : public TransceiverImpl {
   folly::StringPiece getName() override;
   int getNum() override;
 
+  int getNumReads() const {
+    return reads_;
+  }
+  int getBytesRead() const {
+    return bytesRead_;
+  }
+  int getNumWrites() const {
+    return writes_;
+  }
+  int getNumPowerWrites() const {
+    return powerWrites_;
+  }
+  void setFailReads(bool fail) {
+    failReads_ = fail;
+  }
+  void setFailReadAt(int offset) {
+    failOffset_ = offset;
+  }
+
  private:
   int module_;
   std::string moduleName_;
   int page_{0};
+  int reads_{0};
+  int bytesRead_{0};
+  int writes_{0};
+  int powerWrites_{0};
+  bool failReads_{false};
+  int failOffset_{-1};
 };
 
 static uint8_t pageLower[] = {
@@ -120,6 +145,12 @@ int SffTransceiver::readTransceiver(int dataAddress, int offset,
                                     int len, uint8_t* fieldValue) {
   int read = 0;
   EXPECT_EQ(0x50, dataAddress);
+  ++reads_;
+  if (failReads_ || offset == failOffset_) {
+    // What WedgeQsfp does when the I2C read fails
+    return -1;
+  }
+  bytesRead_ += len;
   if (offset < QsfpModule::MAX_QSFP_PAGE_SIZE) {
     read = len;
     if (QsfpModule::MAX_QSFP_PAGE_SIZE - offset < len) {
@@ -143,12 +174,18 @@ int SffTransceiver::writeTransceiver(int dataAddress, int offset,
                             int len, uint8_t* fieldValue) {
   /*
    * This obviously depends on the transceiver parsing code only
-   * using the write function to change the page to query.
+   * using the write function to change the page to query, or to
+   * override low power mode.
    * That seems like a reasonable assumption to get this going.
    */
 
-  EXPECT_EQ(offset, 127);
   EXPECT_EQ(len, 1);
+  ++writes_;
+  if (offset == 93) {
+    ++powerWrites_;
+    return len;
+  }
+  EXPECT_EQ(offset, 127);
   page_ = *fieldValue;
   return len;
 }
@@ -189,4 +226,202 @@ TEST(SffTest, simpleRead) {
   EXPECT_FALSE(info.channels[1].sensors.txBias.flags.alarm.low);
 }
 
+TEST(SffTest, pollReadsDynamicBytesOnly) {
+  int idx = 1;
+  std::unique_ptr<SffTransceiver> qsfpImpl =
+    folly::make_unique<SffTransceiver>(idx);
+  auto impl = qsfpImpl.get();
+  std::unique_ptr<QsfpModule> qsfp =
+    folly::make_unique<QsfpModule>(std::move(qsfpImpl));
+
+  // Insertion reads the lower page and both upper pages
+  qsfp->detectTransceiver();
+  EXPECT_EQ(3, impl->getNumReads());
+  EXPECT_EQ(3 * QsfpModule::MAX_QSFP_PAGE_SIZE, impl->getBytesRead());
+  EXPECT_EQ(2, impl->getNumWrites());
+
+  // Polling only refreshes the monitoring bytes, but picks up changes in
+  // them
+  uint8_t oldTemp = pageLower[22];
+  pageLower[22] = 0x20;
+  qsfp->updateTransceiverInfoFields();
+  EXPECT_EQ(4, impl->getNumReads());
+  EXPECT_GT(QsfpModule::MAX_QSFP_PAGE_SIZE,
+            impl->getBytesRead() - 3 * QsfpModule::MAX_QSFP_PAGE_SIZE);
+  EXPECT_EQ(2, impl->getNumWrites());
+
+  TransceiverInfo info;
+  qsfp->getTransceiverInfo(info);
+  pageLower[22] = oldTemp;
+  EXPECT_DOUBLE_EQ(32.015625, info.sensor.temp.value);
+  EXPECT_EQ("FACETEST", info.vendor.name);
+  EXPECT_DOUBLE_EQ(75.0, info.thresholds.temp.alarm.high);
+
+  // A different identifier means a different module, so everything is
+  // read again
+  uint8_t oldId = pageLower[0];
+  pageLower[0] = 0x11;
+  qsfp->updateTransceiverInfoFields();
+  pageLower[0] = oldId;
+  EXPECT_EQ(8, impl->getNumReads());
+  EXPECT_EQ(4, impl->getNumWrites());
+}
+
+TEST(SffTest, swappedModuleIsCustomized) {
+  std::unique_ptr<SffTransceiver> qsfpImpl =
+    folly::make_unique<SffTransceiver>(1);
+  auto impl = qsfpImpl.get();
+  std::unique_ptr<QsfpModule> qsfp =
+    folly::make_unique<QsfpModule>(std::move(qsfpImpl));
+  qsfp->detectTransceiver();
+  EXPECT_EQ(0, impl->getNumPowerWrites());
+
+  // Swap in a high power module between two presence checks
+  uint8_t oldId = pageLower[0];
+  uint8_t oldExtId = page0[1];
+  pageLower[0] = 0x11;
+  page0[1] = 0x13;
+  qsfp->updateTransceiverInfoFields();
+  pageLower[0] = oldId;
+  page0[1] = oldExtId;
+  EXPECT_EQ(1, impl->getNumPowerWrites());
+  EXPECT_EQ(5, impl->getNumWrites());
+
+  // The next poll picks up the power control bytes that were changed
+  auto reads = impl->getNumReads();
+  pageLower[0] = 0x11;
+  qsfp->updateTransceiverInfoFields();
+  pageLower[0] = oldId;
+  EXPECT_EQ(reads + 2, impl->getNumReads());
+}
+
+TEST(SffTest, failedPollInvalidatesCache) {
+  std::unique_ptr<SffTransceiver> qsfpImpl =
+    folly::make_unique<SffTransceiver>(1);
+  auto impl = qsfpImpl.get();
+  std::unique_ptr<QsfpModule> qsfp =
+    folly::make_unique<QsfpModule>(std::move(qsfpImpl));
+  qsfp->detectTransceiver();
+
+  // A failed read must not leave whatever was in the buffer in the cache
+  impl->setFailReads(true);
+  qsfp->updateTransceiverInfoFields();
+  TransceiverInfo info;
+  qsfp->getTransceiverInfo(info);
+  EXPECT_TRUE(info.present);
+  EXPECT_FALSE(info.__isset.vendor);
+  EXPECT_FALSE(info.__isset.sensor);
+
+  // Once reads work again, everything is read back in
+  impl->setFailReads(false);
+  auto reads = impl->getNumReads();
+  qsfp->updateTransceiverInfoFields();
+  EXPECT_EQ(reads + 3, impl->getNumReads());
+  TransceiverInfo newInfo;
+  qsfp->getTransceiverInfo(newInfo);
+  EXPECT_EQ("FACETEST", newInfo.vendor.name);
+}
+
+TEST(SffTest, failedPageReadInvalidatesCache) {
+  std::unique_ptr<SffTransceiver> qsfpImpl =
+    folly::make_unique<SffTransceiver>(1);
+  auto impl = qsfpImpl.get();
+  std::unique_ptr<QsfpModule> qsfp =
+    folly::make_unique<QsfpModule>(std::move(qsfpImpl));
+
+  // The upper page reads fail on insertion, so nothing is cached
+  impl->setFailReadAt(128);
+  qsfp->detectTransceiver();
+  TransceiverInfo info;
+  qsfp->getTransceiverInfo(info);
+  EXPECT_TRUE(info.present);
+  EXPECT_FALSE(info.__isset.vendor);
+  EXPECT_FALSE(info.__isset.sensor);
+
+  // And the static pages are read again on the next refresh
+  impl->setFailReadAt(-1);
+  auto reads = impl->getNumReads();
+  qsfp->updateTransceiverInfoFields();
+  EXPECT_EQ(reads + 3, impl->getNumReads());
+  TransceiverInfo newInfo;
+  qsfp->getTransceiverInfo(newInfo);
+  EXPECT_EQ("FACETEST", newInfo.vendor.name);
+}
+
+/*
+ * Holds on to each asynchronous read until complete() is called, as a
+ * busy I2C scheduler would.
+ */
+class QueuedSffTransceiver : public SffTransceiver {
+ public:
+  explicit QueuedSffTransceiver(int module) : SffTransceiver(module) {}
+
+  folly::Future<std::vector<uint8_t>> readTransceiverAsync(
+      int dataAddress, int offset, int len) override {
+    queued_.emplace_back();
+    auto& read = queued_.back();
+    read.dataAddress = dataAddress;
+    read.offset = offset;
+    read.len = len;
+    return read.promise.getFuture();
+  }
+
+  size_t getNumQueued() const {
+    return queued_.size();
+  }
+  void complete() {
+    for (auto& read : queued_) {
+      std::vector<uint8_t> data(read.len);
+      readTransceiver(read.dataAddress, read.offset, read.len, data.data());
+      read.promise.setValue(std::move(data));
+    }
+    queued_.clear();
+  }
+
+ private:
+  struct QueuedRead {
+    int dataAddress{0};
+    int offset{0};
+    int len{0};
+    folly::Promise<std::vector<uint8_t>> promise;
+  };
+  std::vector<QueuedRead> queued_;
+};
+
+TEST(SffTest, pollsAreQueuedBeforeWaiting) {
+  std::vector<QueuedSffTransceiver*> impls;
+  std::vector<std::unique_ptr<QsfpModule>> qsfps;
+  for (int idx = 1; idx <= 4; ++idx) {
+    auto qsfpImpl = folly::make_unique<QueuedSffTransceiver>(idx);
+    impls.push_back(qsfpImpl.get());
+    qsfps.push_back(folly::make_unique<QsfpModule>(std::move(qsfpImpl)));
+    qsfps.back()->detectTransceiver();
+  }
+
+  // Every module's poll is in flight before any of them is waited on
+  for (auto& qsfp : qsfps) {
+    qsfp->startUpdateTransceiverInfoFields();
+  }
+  for (auto impl : impls) {
+    EXPECT_EQ(1, impl->getNumQueued());
+    EXPECT_EQ(3, impl->getNumReads());
+  }
+
+  // And what was read is what the update uses, without reading again
+  uint8_t oldTemp = pageLower[22];
+  pageLower[22] = 0x20;
+  for (auto impl : impls) {
+    impl->complete();
+  }
+  pageLower[22] = oldTemp;
+  for (size_t n = 0; n < qsfps.size(); ++n) {
+    qsfps[n]->updateTransceiverInfoFields();
+    EXPECT_EQ(4, impls[n]->getNumReads());
+    EXPECT_EQ(0, impls[n]->getNumQueued());
+    TransceiverInfo info;
+    qsfps[n]->getTransceiverInfo(info);
+    EXPECT_DOUBLE_EQ(32.015625, info.sensor.temp.value);
+  }
+}
+
 } // namespace facebook::fboss
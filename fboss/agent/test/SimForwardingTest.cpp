@@ -0,0 +1,352 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/sim/SimForwarding.h"
+
+#include "fboss/agent/HighresCounterUtil.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/sim/SimSwitch.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/IPv4Hdr.h"
+#include "fboss/agent/packet/PktUtil.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <folly/Memory.h>
+#include <folly/io/Cursor.h>
+#include <gtest/gtest.h>
+
+#include <set>
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using folly::io::Cursor;
+using folly::io::RWPrivateCursor;
+using folly::make_unique;
+using std::make_shared;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+const RouterID kRid(0);
+const MacAddress kRouterMac("02:00:01:00:00:01");
+const MacAddress kNhop1Mac("00:02:00:00:00:10");
+const MacAddress kNhop2Mac("00:02:00:00:00:11");
+const MacAddress kHostMac("00:02:00:00:00:20");
+
+/*
+ * VLAN 1 on ports 1-9, interface 1 on it with 10.0.0.1/24, two neighbors
+ * on ports 1 and 2, and an ECMP route to 20.0.0.0/16 over both of them.
+ */
+shared_ptr<SwitchState> makeState() {
+  auto state = make_shared<SwitchState>();
+  auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+  state->addVlan(vlan1);
+  for (int idx = 1; idx < 10; ++idx) {
+    vlan1->addPort(PortID(idx), false);
+  }
+  auto intf1 = make_shared<Interface>
+    (InterfaceID(1), kRid, VlanID(1), "interface1", kRouterMac, 9000);
+  Interface::Addresses addrs1;
+  addrs1.emplace(IPAddress("10.0.0.1"), 24);
+  intf1->setAddresses(addrs1);
+  state->addIntf(intf1);
+
+  auto arpTable = vlan1->getArpTable();
+  arpTable->addEntry(IPAddressV4("10.0.0.10"), kNhop1Mac,
+                     PortID(1), InterfaceID(1));
+  arpTable->addEntry(IPAddressV4("10.0.0.11"), kNhop2Mac,
+                     PortID(2), InterfaceID(1));
+
+  RouteUpdater updater(state->getRouteTables());
+  updater.addInterfaceAndLinkLocalRoutes(state->getInterfaces());
+  RouteNextHops nhops;
+  nhops.emplace(IPAddress("10.0.0.10"));
+  nhops.emplace(IPAddress("10.0.0.11"));
+  updater.addRoute(kRid, IPAddress("20.0.0.0"), 16, nhops);
+  state->resetRouteTables(updater.updateDone());
+  state->publish();
+  return state;
+}
+
+unique_ptr<MockRxPacket> makeUDPPacket(MacAddress dstMac, MacAddress srcMac,
+    IPAddressV4 srcIp, IPAddressV4 dstIp, uint16_t srcPort, uint8_t ttl = 64,
+    PortID port = PortID(3)) {
+  const uint16_t bodyLength = 8;
+  IPv4Hdr ipHdr(srcIp, dstIp, IP_PROTO_UDP, bodyLength);
+  ipHdr.ttl = ttl;
+  ipHdr.computeChecksum();
+
+  auto buf = IOBuf::create(18 + IPv4Hdr::minSize() + bodyLength);
+  buf->append(18 + IPv4Hdr::minSize() + bodyLength);
+  RWPrivateCursor cursor(buf.get());
+  TxPacket::writeEthHeader(&cursor, dstMac, srcMac, VlanID(1),
+                           ETHERTYPE_IPV4);
+  ipHdr.write(&cursor);
+  cursor.writeBE<uint16_t>(srcPort);
+  cursor.writeBE<uint16_t>(53);
+  cursor.writeBE<uint16_t>(bodyLength);
+  cursor.writeBE<uint16_t>(0);
+
+  auto pkt = make_unique<MockRxPacket>(std::move(buf));
+  pkt->setSrcPort(port);
+  pkt->setSrcVlan(VlanID(1));
+  return pkt;
+}
+
+unique_ptr<MockRxPacket> makeRoutedPacket(IPAddressV4 dstIp,
+                                          uint16_t srcPort = 1000,
+                                          uint8_t ttl = 64) {
+  return makeUDPPacket(kRouterMac, kHostMac, IPAddressV4("10.0.0.20"),
+                       dstIp, srcPort, ttl);
+}
+
+} // unnamed namespace
+
+TEST(SimForwarding, Switching) {
+  SimForwarding fwd;
+  auto empty = make_shared<SwitchState>();
+  fwd.stateChanged(StateDelta(empty, makeState()));
+  SimForwarding::PortSet downPorts;
+
+  const MacAddress macA("00:02:00:00:00:0a");
+  const MacAddress macB("00:02:00:00:00:0b");
+  auto decision = fwd.forward(
+      makeUDPPacket(macB, macA, IPAddressV4("10.0.0.30"),
+                    IPAddressV4("10.0.0.31"), 1000, 64, PortID(4)).get(),
+      downPorts);
+  EXPECT_EQ(SimForwarding::FLOOD, decision.action);
+  EXPECT_FALSE(decision.copyToCpu);
+
+  // macA was learned on port 4, so the reply is switched there
+  decision = fwd.forward(
+      makeUDPPacket(macA, macB, IPAddressV4("10.0.0.31"),
+                    IPAddressV4("10.0.0.30"), 1000, 64, PortID(5)).get(),
+      downPorts);
+  EXPECT_EQ(SimForwarding::SWITCH, decision.action);
+  EXPECT_EQ(PortID(4), decision.port);
+  EXPECT_EQ(VlanID(1), decision.vlan);
+
+  // Neighbors are in the MAC table without any traffic from them
+  decision = fwd.forward(
+      makeUDPPacket(kNhop1Mac, macB, IPAddressV4("10.0.0.31"),
+                    IPAddressV4("10.0.0.10"), 1000, 64, PortID(5)).get(),
+      downPorts);
+  EXPECT_EQ(SimForwarding::SWITCH, decision.action);
+  EXPECT_EQ(PortID(1), decision.port);
+
+  // Broadcasts are flooded and copied to the CPU
+  decision = fwd.forward(
+      makeUDPPacket(MacAddress::BROADCAST, macB, IPAddressV4("10.0.0.31"),
+                    IPAddressV4("10.0.0.255"), 1000, 64, PortID(5)).get(),
+      downPorts);
+  EXPECT_EQ(SimForwarding::FLOOD, decision.action);
+  EXPECT_TRUE(decision.copyToCpu);
+
+  // Once the link goes down, macA is flooded again
+  fwd.flushPort(PortID(4));
+  decision = fwd.forward(
+      makeUDPPacket(macA, macB, IPAddressV4("10.0.0.31"),
+                    IPAddressV4("10.0.0.30"), 1000, 64, PortID(5)).get(),
+      downPorts);
+  EXPECT_EQ(SimForwarding::FLOOD, decision.action);
+
+  // Ports outside the VLAN are filtered on ingress
+  decision = fwd.forward(
+      makeUDPPacket(macA, macB, IPAddressV4("10.0.0.31"),
+                    IPAddressV4("10.0.0.30"), 1000, 64, PortID(10)).get(),
+      downPorts);
+  EXPECT_EQ(SimForwarding::DROP, decision.action);
+}
+
+TEST(SimForwarding, Routing) {
+  SimForwarding fwd;
+  auto empty = make_shared<SwitchState>();
+  fwd.stateChanged(StateDelta(empty, makeState()));
+  SimForwarding::PortSet downPorts;
+
+  auto pkt = makeRoutedPacket(IPAddressV4("20.0.1.1"));
+  auto decision = fwd.forward(pkt.get(), downPorts);
+  ASSERT_EQ(SimForwarding::ROUTE, decision.action);
+  EXPECT_EQ(VlanID(1), decision.vlan);
+
+  // The packet has been rewritten for the nexthop it is sent to
+  Cursor cursor(pkt->buf());
+  auto dstMac = PktUtil::readMac(&cursor);
+  EXPECT_EQ(decision.port == PortID(1) ? kNhop1Mac : kNhop2Mac, dstMac);
+  EXPECT_EQ(kRouterMac, PktUtil::readMac(&cursor));
+  cursor.skip(6);
+  Cursor ipStart(cursor);
+  IPv4Hdr ipHdr(cursor);
+  EXPECT_EQ(63, ipHdr.ttl);
+  EXPECT_EQ(0, PktUtil::internetChecksum(ipStart, IPv4Hdr::minSize()));
+
+  // Flows are spread over both ECMP members
+  std::set<PortID> ports;
+  for (uint16_t srcPort = 1000; srcPort < 1064; ++srcPort) {
+    decision = fwd.forward(
+        makeRoutedPacket(IPAddressV4("20.0.1.1"), srcPort).get(), downPorts);
+    ASSERT_EQ(SimForwarding::ROUTE, decision.action);
+    ports.insert(decision.port);
+  }
+  EXPECT_EQ(2, ports.size());
+
+  // Down ports are never picked
+  downPorts.insert(PortID(1));
+  for (uint16_t srcPort = 1000; srcPort < 1064; ++srcPort) {
+    decision = fwd.forward(
+        makeRoutedPacket(IPAddressV4("20.0.1.1"), srcPort).get(), downPorts);
+    ASSERT_EQ(SimForwarding::ROUTE, decision.action);
+    EXPECT_EQ(PortID(2), decision.port);
+  }
+
+  // Directly connected neighbors are routed to from the host table
+  decision = fwd.forward(
+      makeRoutedPacket(IPAddressV4("10.0.0.11")).get(), downPorts);
+  EXPECT_EQ(SimForwarding::ROUTE, decision.action);
+  EXPECT_EQ(PortID(2), decision.port);
+}
+
+TEST(SimForwarding, PuntAndDrop) {
+  SimForwarding fwd;
+  auto empty = make_shared<SwitchState>();
+  auto state = makeState();
+  fwd.stateChanged(StateDelta(empty, state));
+  SimForwarding::PortSet downPorts;
+
+  auto forward = [&](IPAddressV4 dst, uint8_t ttl) {
+    return fwd.forward(makeRoutedPacket(dst, 1000, ttl).get(), downPorts)
+      .action;
+  };
+  // Our own address
+  EXPECT_EQ(SimForwarding::PUNT, forward(IPAddressV4("10.0.0.1"), 64));
+  // TTL expiring
+  EXPECT_EQ(SimForwarding::PUNT, forward(IPAddressV4("20.0.1.1"), 1));
+  // A connected neighbor that has not been resolved yet
+  EXPECT_EQ(SimForwarding::PUNT, forward(IPAddressV4("10.0.0.50"), 64));
+  // No route at all
+  EXPECT_EQ(SimForwarding::DROP, forward(IPAddressV4("30.0.0.1"), 64));
+
+  // Once the route is gone, its traffic is dropped as well
+  RouteUpdater updater(state->getRouteTables());
+  updater.delRoute(kRid, IPAddress("20.0.0.0"), 16);
+  auto newState = state->clone();
+  newState->resetRouteTables(updater.updateDone());
+  newState->publish();
+  fwd.stateChanged(StateDelta(state, newState));
+  EXPECT_EQ(SimForwarding::DROP, forward(IPAddressV4("20.0.1.1"), 64));
+}
+
+TEST(SimForwarding, Acls) {
+  SimForwarding fwd;
+  auto empty = make_shared<SwitchState>();
+  auto state = makeState();
+  fwd.stateChanged(StateDelta(empty, state));
+  SimForwarding::PortSet downPorts;
+
+  // Deny DNS to 20.0.1.0/24 from anywhere
+  auto newState = state->clone();
+  auto acls = make_shared<AclMap>();
+  auto entry = make_shared<AclEntry>(AclEntryID(1));
+  entry->setAction(cfg::AclAction::DENY);
+  entry->setDstIp(IPAddress::createNetwork("20.0.1.0/24"));
+  entry->setL4DstPort(53);
+  acls->addEntry(entry);
+  newState->resetAcls(acls);
+  newState->publish();
+  fwd.stateChanged(StateDelta(state, newState));
+
+  EXPECT_EQ(SimForwarding::DROP, fwd.forward(
+      makeRoutedPacket(IPAddressV4("20.0.1.1")).get(), downPorts).action);
+  // Traffic the entry does not cover is still routed
+  EXPECT_EQ(SimForwarding::ROUTE, fwd.forward(
+      makeRoutedPacket(IPAddressV4("20.0.2.1")).get(), downPorts).action);
+
+  // Once the entry is removed, the traffic flows again
+  auto finalState = newState->clone();
+  finalState->resetAcls(make_shared<AclMap>());
+  finalState->publish();
+  fwd.stateChanged(StateDelta(newState, finalState));
+  EXPECT_EQ(SimForwarding::ROUTE, fwd.forward(
+      makeRoutedPacket(IPAddressV4("20.0.1.1")).get(), downPorts).action);
+}
+
+TEST(SimSwitch, PortCounters) {
+  SimSwitch sim(nullptr, 10);
+  sim.stateChanged(StateDelta(make_shared<SwitchState>(), makeState()));
+
+  // One packet routed from port 3 out of port 1 or 2, and one dropped
+  auto routed = makeRoutedPacket(IPAddressV4("20.0.1.1"));
+  auto length = routed->getLength();
+  sim.injectPacket(std::move(routed));
+  sim.injectPacket(makeRoutedPacket(IPAddressV4("30.0.0.1")));
+
+  // And a broadcast sent out of port 5 by the CPU
+  auto tx = sim.allocatePacket(64);
+  RWPrivateCursor cursor(tx->buf());
+  TxPacket::writeEthHeader(&cursor, MacAddress::BROADCAST, kRouterMac,
+                           VlanID(1), ETHERTYPE_ARP);
+  sim.sendPacketOutOfPort(std::move(tx), PortID(5));
+
+  std::vector<HwPortCounter> counters = {
+    HwPortCounter::IN_BYTES,
+    HwPortCounter::IN_UNICAST_PKTS,
+    HwPortCounter::IN_DISCARDS,
+    HwPortCounter::OUT_BYTES,
+  };
+  std::vector<uint64_t> values(counters.size());
+  ASSERT_TRUE(sim.readPortCounters(PortID(3), counters, values.data()));
+  EXPECT_EQ(2 * length, values[0]);
+  EXPECT_EQ(2, values[1]);
+  EXPECT_EQ(1, values[2]);
+  EXPECT_EQ(0, values[3]);
+  EXPECT_FALSE(sim.readPortCounters(PortID(11), counters, values.data()));
+
+  // Unknown ports and stats are left out of the sampler
+  PortCounterSampler sampler(&sim, {
+    "port3.in_bytes",
+    "port3.in_discards",
+    "port1.out_unicast_pkts",
+    "port2.out_unicast_pkts",
+    "port5.out_broadcast_pkts",
+    "port5.out_bytes",
+    "port11.in_bytes",
+    "port3.in_frobs",
+    "in_bytes",
+  });
+  EXPECT_EQ(6, sampler.numCounters());
+
+  CounterPublication pub;
+  sampler.sample(&pub);
+  EXPECT_EQ(6, pub.counters.size());
+  auto value = [&](const std::string& name) -> int64_t {
+    const auto& samples = pub.counters.at("port_counters::" + name);
+    EXPECT_EQ(1, samples.size());
+    return samples.back();
+  };
+  EXPECT_EQ(2 * length, value("port3.in_bytes"));
+  EXPECT_EQ(1, value("port3.in_discards"));
+  EXPECT_EQ(1, value("port1.out_unicast_pkts") +
+               value("port2.out_unicast_pkts"));
+  EXPECT_EQ(1, value("port5.out_broadcast_pkts"));
+  EXPECT_EQ(64, value("port5.out_bytes"));
+}
@@ -0,0 +1,42 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StateUpdateRecorder.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+TEST(StateUpdateRecorder, OldestRecordsOverwritten) {
+  StateUpdateRecorder recorder(4);
+  EXPECT_TRUE(recorder.getRecords().empty());
+
+  for (uint32_t gen = 1; gen <= 3; ++gen) {
+    StateUpdateRecorder::Record record;
+    record.generation = gen;
+    recorder.record(record);
+  }
+  auto records = recorder.getRecords();
+  ASSERT_EQ(3, records.size());
+  for (uint32_t n = 0; n < 3; ++n) {
+    EXPECT_EQ(n + 1, records[n].generation);
+  }
+
+  // Wrap around twice, and make sure the order is still oldest first
+  for (uint32_t gen = 4; gen <= 10; ++gen) {
+    StateUpdateRecorder::Record record;
+    record.generation = gen;
+    recorder.record(record);
+  }
+  records = recorder.getRecords();
+  ASSERT_EQ(4, records.size());
+  for (uint32_t n = 0; n < 4; ++n) {
+    EXPECT_EQ(n + 7, records[n].generation);
+  }
+}
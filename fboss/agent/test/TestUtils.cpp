@@ -60,7 +60,8 @@ shared_ptr<SwitchState> publishAndApplyConfigFile(
   if (prevConfigStr.size()) {
     prevConfig.readFromJson(prevConfigStr.c_str());
   }
-  return applyThriftConfigFile(state, path, platform, &prevConfig).first;
+  return applyThriftConfigFile(state, path, platform,
+      prevConfigStr.size() ? &prevConfig : nullptr).first;
 }
 
 unique_ptr<SwSwitch> createMockSw(const shared_ptr<SwitchState>& state) {
@@ -10,6 +10,10 @@
 #include "fboss/agent/AddressUtil.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/ThriftHandler.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
 #include "fboss/agent/test/TestUtils.h"
 
 #include <folly/IPAddress.h>
@@ -90,3 +94,144 @@ TEST(ThriftTest, assertPortSpeeds) {
   EXPECT_EQ(static_cast<int>(PortSpeed::FIFTYG), 50000);
   EXPECT_EQ(static_cast<int>(PortSpeed::HUNDREDG), 100000);
 }
+
+TEST(ThriftTest, getRouteTablePage) {
+  auto sw = setupSwitch();
+  ThriftHandler handler(sw.get());
+
+  std::vector<UnicastRoute> allRoutes;
+  handler.getRouteTable(allRoutes);
+  ASSERT_GT(allRoutes.size(), 3);
+
+  auto getAllPages = [&](const RouteTablePageRequest& firstRequest) {
+    std::vector<UnicastRoute> routes;
+    RouteTablePageRequest request(firstRequest);
+    while (true) {
+      RouteTablePage page;
+      handler.getRouteTablePage(
+          page, folly::make_unique<RouteTablePageRequest>(request));
+      EXPECT_LE(page.routes.size(), request.limit);
+      routes.insert(routes.end(), page.routes.begin(), page.routes.end());
+      if (!page.__isset.next) {
+        break;
+      }
+      EXPECT_EQ(routes.back().dest, page.next.lastPrefix);
+      request.cursor = page.next;
+      request.__isset.cursor = true;
+    }
+    return routes;
+  };
+
+  // Paging through the routes gets the same ones getRouteTable() does,
+  // in the same order, however big the pages are.
+  for (int limit : {1, 2, 3, 1000}) {
+    RouteTablePageRequest request;
+    request.limit = limit;
+    EXPECT_EQ(allRoutes, getAllPages(request));
+  }
+
+  // Only routes inside the filter are returned
+  RouteTablePageRequest request;
+  request.limit = 1;
+  request.filter = ipPrefix("10.0.0.0", 8);
+  request.__isset.filter = true;
+  auto routes = getAllPages(request);
+  ASSERT_EQ(3, routes.size());
+  EXPECT_EQ(ipPrefix("10.0.0.0", 24), routes[0].dest);
+  EXPECT_EQ(ipPrefix("10.0.55.0", 24), routes[1].dest);
+  EXPECT_EQ(ipPrefix("10.1.1.0", 24), routes[2].dest);
+
+  request.filter = ipPrefix("2401:db00:2110:3055::", 64);
+  routes = getAllPages(request);
+  ASSERT_EQ(1, routes.size());
+  EXPECT_EQ(ipPrefix("2401:db00:2110:3055::", 64), routes[0].dest);
+
+  // A page that ends exactly on the last route has no cursor
+  RouteTablePage page;
+  request.limit = 1;
+  handler.getRouteTablePage(
+      page, folly::make_unique<RouteTablePageRequest>(request));
+  EXPECT_EQ(1, page.routes.size());
+  EXPECT_FALSE(page.__isset.next);
+
+  request.limit = 0;
+  EXPECT_THROW(handler.getRouteTablePage(
+      page, folly::make_unique<RouteTablePageRequest>(request)), FbossError);
+  request.limit = 10;
+  request.filter = ipPrefix("10.0.0.0", 33);
+  EXPECT_THROW(handler.getRouteTablePage(
+      page, folly::make_unique<RouteTablePageRequest>(request)), FbossError);
+}
+
+TEST(ThriftTest, getRouteTablePageAcrossVrfs) {
+  auto sw = setupSwitch();
+  ThriftHandler handler(sw.get());
+
+  std::vector<UnicastRoute> vrf0Routes;
+  handler.getRouteTable(vrf0Routes);
+
+  // A second VRF, whose v4 routes sort before the v6 routes that VRF 0
+  // ends with
+  auto addVrf1 = [](const std::shared_ptr<SwitchState>& state) {
+    RouteUpdater updater(state->getRouteTables());
+    updater.addRoute(RouterID(1), IPAddress("1.0.0.0"), 8,
+                     RouteForwardAction::DROP);
+    updater.addRoute(RouterID(1), IPAddress("2.0.0.0"), 8,
+                     RouteForwardAction::DROP);
+    updater.addRoute(RouterID(1), IPAddress("1::"), 64,
+                     RouteForwardAction::DROP);
+    auto newState = state->clone();
+    newState->resetRouteTables(updater.updateDone());
+    return newState;
+  };
+  sw->updateStateBlocking("add vrf 1", addVrf1);
+  std::vector<UnicastRoute> allRoutes;
+  handler.getRouteTable(allRoutes);
+  ASSERT_EQ(vrf0Routes.size() + 3, allRoutes.size());
+
+  // A page that ends exactly on the last route of VRF 0 resumes from
+  // there, rather than somewhere inside VRF 1
+  RouteTablePageRequest request;
+  request.limit = vrf0Routes.size();
+  RouteTablePage page;
+  handler.getRouteTablePage(
+      page, folly::make_unique<RouteTablePageRequest>(request));
+  EXPECT_EQ(vrf0Routes, page.routes);
+  ASSERT_TRUE(page.__isset.next);
+  EXPECT_EQ(0, page.next.vrf);
+  EXPECT_EQ(vrf0Routes.back().dest, page.next.lastPrefix);
+
+  request.cursor = page.next;
+  request.__isset.cursor = true;
+  RouteTablePage nextPage;
+  handler.getRouteTablePage(
+      nextPage, folly::make_unique<RouteTablePageRequest>(request));
+  std::vector<UnicastRoute> vrf1Routes(allRoutes.begin() + vrf0Routes.size(),
+                                       allRoutes.end());
+  EXPECT_EQ(vrf1Routes, nextPage.routes);
+  EXPECT_FALSE(nextPage.__isset.next);
+}
+
+TEST(ThriftTest, getStateUpdateTraces) {
+  auto sw = setupSwitch();
+  ThriftHandler handler(sw.get());
+
+  auto addVlan = [](const std::shared_ptr<SwitchState>& state) {
+    auto newState = state->clone();
+    newState->addVlan(std::make_shared<Vlan>(VlanID(4000), "vlan4000"));
+    return newState;
+  };
+  sw->updateStateBlocking("add vlan", addVlan);
+
+  std::vector<StateUpdateTrace> traces;
+  handler.getStateUpdateTraces(traces);
+  ASSERT_FALSE(traces.empty());
+  const auto& trace = traces.back();
+  EXPECT_EQ(std::vector<std::string>{"add vlan"}, trace.names);
+  EXPECT_EQ(sw->getState()->getGeneration(), trace.generation);
+  EXPECT_EQ(0, trace.routesChanged);
+  EXPECT_EQ(0, trace.neighborsChanged);
+  EXPECT_EQ(1, trace.otherNodesChanged);
+  EXPECT_GE(trace.totalUs, trace.updateFnsUs + trace.publishUs +
+            trace.hwStateChangedUs + trace.observersUs);
+}
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/TxBufferPool.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <thread>
+
+using namespace facebook::fboss;
+
+namespace {
+
+/*
+ * Hands out heap buffers, and keeps track of the ones still live so the
+ * tests can check that nothing leaks.
+ */
+class TrackingAllocator {
+ public:
+  typedef char* Buffer;
+
+  TrackingAllocator() : live_(std::make_shared<std::set<char*>>()) {}
+
+  char* allocate(uint32_t size) {
+    auto buf = new char[size];
+    live_->insert(buf);
+    return buf;
+  }
+  void free(char* buf) {
+    EXPECT_EQ(1, live_->erase(buf));
+    delete[] buf;
+  }
+
+  std::shared_ptr<std::set<char*>> live_;
+};
+
+typedef TxBufferPool<TrackingAllocator> Pool;
+
+} // unnamed namespace
+
+TEST(TxBufferPool, Reuse) {
+  TrackingAllocator alloc;
+  auto live = alloc.live_;
+  {
+    Pool pool(alloc, {128, 512}, 16);
+    uint32_t capacity;
+    auto buf = pool.get(60, &capacity);
+    EXPECT_EQ(128, capacity);
+    pool.put(buf, capacity);
+
+    // The same buffer comes back, without going to the allocator again
+    EXPECT_EQ(buf, pool.get(100, &capacity));
+    EXPECT_EQ(128, capacity);
+    EXPECT_EQ(1, pool.getAllocCount());
+
+    // Other size classes are kept apart
+    auto big = pool.get(129, &capacity);
+    EXPECT_EQ(512, capacity);
+    EXPECT_NE(buf, big);
+    EXPECT_EQ(2, pool.getAllocCount());
+    pool.put(big, capacity);
+    pool.put(buf, 128);
+    EXPECT_EQ(0, pool.getFreeCount());
+  }
+  // Destroying the pool frees everything it held on to
+  EXPECT_TRUE(live->empty());
+}
+
+TEST(TxBufferPool, Oversize) {
+  TrackingAllocator alloc;
+  auto live = alloc.live_;
+  Pool pool(alloc, {128}, 16);
+  uint32_t capacity;
+  auto buf = pool.get(9000, &capacity);
+  EXPECT_EQ(9000, capacity);
+  pool.put(buf, capacity);
+  EXPECT_EQ(1, pool.getFreeCount());
+  EXPECT_TRUE(live->empty());
+}
+
+TEST(TxBufferPool, Watermark) {
+  TrackingAllocator alloc;
+  auto live = alloc.live_;
+  Pool pool(alloc, {128}, 8, 4);
+
+  std::vector<char*> bufs;
+  uint32_t capacity;
+  for (int i = 0; i < 20; ++i) {
+    bufs.push_back(pool.get(128, &capacity));
+  }
+  EXPECT_EQ(20, pool.getAllocCount());
+  for (auto buf : bufs) {
+    pool.put(buf, capacity);
+  }
+  // At most the watermark plus one thread cache's worth is kept
+  EXPECT_LE(live->size(), 8 + 4);
+  EXPECT_EQ(20, live->size() + pool.getFreeCount());
+}
+
+TEST(TxBufferPool, Disabled) {
+  TrackingAllocator alloc;
+  auto live = alloc.live_;
+  Pool pool(alloc, {128}, 0);
+  uint32_t capacity;
+  auto buf = pool.get(64, &capacity);
+  pool.put(buf, capacity);
+  EXPECT_EQ(1, pool.getFreeCount());
+  EXPECT_TRUE(live->empty());
+}
+
+TEST(TxBufferPool, CrossThread) {
+  TrackingAllocator alloc;
+  auto live = alloc.live_;
+  Pool pool(alloc, {128}, 64, 8);
+
+  // Buffers freed by another thread, as happens with TX completions, make
+  // it back to the allocating thread through the shared list.
+  std::vector<char*> bufs;
+  uint32_t capacity;
+  for (int i = 0; i < 32; ++i) {
+    bufs.push_back(pool.get(128, &capacity));
+  }
+  std::thread freer([&] {
+    for (auto buf : bufs) {
+      pool.put(buf, capacity);
+    }
+  });
+  freer.join();
+
+  // The exiting thread handed its cache back, so nothing was freed
+  EXPECT_EQ(0, pool.getFreeCount());
+  for (int i = 0; i < 32; ++i) {
+    bufs[i] = pool.get(128, &capacity);
+  }
+  EXPECT_EQ(32, pool.getAllocCount());
+  for (auto buf : bufs) {
+    pool.put(buf, capacity);
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/hw/mock/MockTxPacket.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using folly::make_unique;
+using std::unique_ptr;
+
+namespace {
+
+unique_ptr<SwSwitch> sw;
+
+// Roughly the size of an ARP reply
+const uint32_t kPktSize = 68;
+
+/*
+ * Allocate numIters packets, keeping up to `outstanding` of them alive at
+ * once, the way packets queued for TX pile up before their completions
+ * come back.
+ */
+template<typename AllocFn>
+void runAlloc(size_t numIters, size_t outstanding, AllocFn allocFn) {
+  std::vector<unique_ptr<TxPacket>> pkts;
+  pkts.reserve(outstanding);
+  for (size_t n = 0; n < numIters; ++n) {
+    pkts.push_back(allocFn());
+    if (pkts.size() == outstanding) {
+      pkts.clear();
+    }
+  }
+}
+
+void allocDirect(size_t numIters, size_t outstanding) {
+  runAlloc(numIters, outstanding, [] {
+    return make_unique<MockTxPacket>(kPktSize);
+  });
+}
+
+void allocPooled(size_t numIters, size_t outstanding) {
+  // SimSwitch gets its packets from the pool
+  runAlloc(numIters, outstanding, [] {
+    return sw->allocatePacket(kPktSize);
+  });
+}
+
+} // unnamed namespace
+
+BENCHMARK_PARAM(allocDirect, 1);
+BENCHMARK_RELATIVE_PARAM(allocPooled, 1);
+BENCHMARK_PARAM(allocDirect, 64);
+BENCHMARK_RELATIVE_PARAM(allocPooled, 64);
+BENCHMARK_PARAM(allocDirect, 1024);
+BENCHMARK_RELATIVE_PARAM(allocPooled, 1024);
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  MacAddress localMac("02:00:01:00:00:01");
+  sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10), false);
+  sw->init();
+
+  folly::runBenchmarks();
+
+  LOG(INFO) << "TX packet pool: " << MockTxPacket::getPoolAllocCount()
+            << " buffers allocated, " << MockTxPacket::getPoolFreeCount()
+            << " freed";
+  sw.reset();
+  return 0;
+}
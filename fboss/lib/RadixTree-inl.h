@@ -90,6 +90,50 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::longestMatchImpl(const IPADDRTYPE& ipaddr,
 }
 
 
+template<typename IPADDRTYPE, typename T, typename TreeTraits>
+typename RadixTree<IPADDRTYPE, T, TreeTraits>::ConstIterator
+RadixTree<IPADDRTYPE, T, TreeTraits>::boundImpl(const IPADDRTYPE& ipaddr,
+    uint8_t masklen, bool inclusive) const {
+  auto toFind = ipaddr.mask(masklen);
+  // Where the walk carries on from if nothing in the subtree we are
+  // currently looking at sorts after the prefix being searched for.
+  const TreeNode* next = nullptr;
+  auto curNode = root_.get();
+  while (curNode) {
+    auto curMasklen = curNode->masklen();
+    uint8_t commonLen = std::min<uint32_t>(curMasklen, masklen);
+    if (toFind.mask(commonLen) != curNode->ipAddress().mask(commonLen)) {
+      // The two prefixes diverge, so the whole subtree sorts either before
+      // or after the one being searched for.
+      if (toFind < curNode->ipAddress()) {
+        return traits_.makeCItr(curNode);
+      }
+      break;
+    }
+    if (masklen < curMasklen) {
+      // Less specific than this node, so everything under it sorts after
+      return traits_.makeCItr(curNode);
+    }
+    if (masklen == curMasklen) {
+      auto itr = traits_.makeCItr(curNode);
+      if (!inclusive && itr.node() == curNode) {
+        ++itr;
+      }
+      return itr;
+    }
+    // More specific than this node, and this node sorts before it
+    if (toFind.getNthMSBit(curMasklen) == 1) {
+      curNode = curNode->right();
+    } else {
+      if (curNode->right()) {
+        next = curNode->right();
+      }
+      curNode = curNode->left();
+    }
+  }
+  return traits_.makeCItr(next);
+}
+
 template<typename IPADDRTYPE, typename T, typename TreeTraits>
 inline void  RadixTree<IPADDRTYPE, T, TreeTraits>
 ::trailAppend(VecConstIterators* trail,
@@ -509,6 +509,21 @@ class RadixTree {
           ipaddr, masklen, trail, includeNonValueNodes));
   }
 
+  /*
+   * The iterators walk the tree in preorder, which visits prefixes sorted
+   * by address and then by mask length. lowerBound returns the first value
+   * node at or after ipaddr/masklen in that order, upperBound the first one
+   * strictly after it. Neither requires ipaddr/masklen to be in the tree,
+   * so they can be used to resume a walk where an earlier one left off.
+   * NOTE: masklen must be <= ipaddr.bitCount()
+   */
+  ConstIterator lowerBound(const IPADDRTYPE& ipaddr, uint8_t masklen) const {
+    return boundImpl(ipaddr, masklen, true);
+  }
+  ConstIterator upperBound(const IPADDRTYPE& ipaddr, uint8_t masklen) const {
+    return boundImpl(ipaddr, masklen, false);
+  }
+
   // Compare 2 radix (sub) trees
   static bool radixSubTreesEqual(const TreeNode* nodeA,
       const TreeNode* nodeB);
@@ -544,6 +559,10 @@ class RadixTree {
             masklen, foundExact, includeNonValueNodes, trail));
   }
 
+  // Worker function for lowerBound and upperBound
+  ConstIterator boundImpl(const IPADDRTYPE& ipaddr, uint8_t masklen,
+      bool inclusive) const;
+
   std::unique_ptr<TreeNode> makeNode(const IPADDRTYPE& ip,
       uint8_t masklen) {
     return folly::make_unique<TreeNode>(ip, masklen, nodeDeleteCallback_);
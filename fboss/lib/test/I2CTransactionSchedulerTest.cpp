@@ -0,0 +1,217 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/lib/usb/I2CTransactionScheduler.h"
+
+#include "fboss/lib/usb/TransceiverI2CApi.h"
+#include "fboss/lib/usb/UsbError.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+using namespace facebook::fboss;
+using folly::Future;
+using folly::Unit;
+using std::vector;
+
+namespace {
+
+// Long enough that the bus is never closed for being idle mid-test
+const std::chrono::seconds kNoIdleClose(60);
+
+/*
+ * A bus of 16 modules behind two muxes, each module with 256 bytes of
+ * memory.  Records which module each transaction went to.
+ */
+class FakeI2CBus : public TransceiverI2CApi {
+ public:
+  void open() override {
+    std::unique_lock<std::mutex> g(lock_);
+    ++opens_;
+    opening_ = true;
+    cv_.notify_all();
+    cv_.wait(g, [this] { return !holdOpen_; });
+    opening_ = false;
+  }
+  void close() override {
+    std::lock_guard<std::mutex> g(lock_);
+    ++closes_;
+  }
+  void moduleRead(unsigned int module, uint8_t /* i2cAddress */,
+                  int offset, int len, uint8_t* buf) override {
+    access(module);
+    memcpy(buf, memory_[module].data() + offset, len);
+  }
+  void moduleWrite(unsigned int module, uint8_t /* i2cAddress */,
+                   int offset, int len, uint8_t* buf) override {
+    access(module);
+    memcpy(memory_[module].data() + offset, buf, len);
+  }
+  unsigned int getMux(unsigned int module) const override {
+    return (module - 1) / 8;
+  }
+
+  // Make open() block until release() is called
+  void hold() {
+    std::lock_guard<std::mutex> g(lock_);
+    holdOpen_ = true;
+  }
+  void waitForOpen() {
+    std::unique_lock<std::mutex> g(lock_);
+    cv_.wait(g, [this] { return opening_; });
+  }
+  void release() {
+    std::lock_guard<std::mutex> g(lock_);
+    holdOpen_ = false;
+    cv_.notify_all();
+  }
+
+  void setFailingModule(unsigned int module) {
+    std::lock_guard<std::mutex> g(lock_);
+    failingModule_ = module;
+  }
+  vector<unsigned int> getLog() const {
+    std::lock_guard<std::mutex> g(lock_);
+    return log_;
+  }
+  int getOpens() const {
+    std::lock_guard<std::mutex> g(lock_);
+    return opens_;
+  }
+  int getCloses() const {
+    std::lock_guard<std::mutex> g(lock_);
+    return closes_;
+  }
+
+ private:
+  void access(unsigned int module) {
+    std::lock_guard<std::mutex> g(lock_);
+    if (module == failingModule_) {
+      throw UsbError("no response from module ", module);
+    }
+    log_.push_back(module);
+  }
+
+  mutable std::mutex lock_;
+  std::condition_variable cv_;
+  bool holdOpen_{false};
+  bool opening_{false};
+  int opens_{0};
+  int closes_{0};
+  unsigned int failingModule_{0};
+  vector<unsigned int> log_;
+  std::map<unsigned int, std::array<uint8_t, 256>> memory_;
+};
+
+} // unnamed namespace
+
+TEST(I2CTransactionScheduler, readAfterWrite) {
+  FakeI2CBus bus;
+  I2CTransactionScheduler scheduler(&bus, kNoIdleClose);
+
+  uint8_t page[] = {1, 2, 3, 4};
+  auto written = scheduler.write(1, 0x50, 127, sizeof(page), page);
+  auto data = scheduler.read(1, 0x50, 127, sizeof(page)).get();
+  EXPECT_TRUE(written.isReady());
+  EXPECT_EQ(vector<uint8_t>(page, page + sizeof(page)), data);
+
+  auto stats = scheduler.getStats();
+  EXPECT_EQ(2, stats.transactions);
+  EXPECT_EQ(0, stats.failures);
+  EXPECT_EQ(1, stats.busOpens);
+}
+
+TEST(I2CTransactionScheduler, groupsByMux) {
+  FakeI2CBus bus;
+  I2CTransactionScheduler scheduler(&bus, kNoIdleClose);
+
+  // Keep the scheduler busy opening the bus for the first read, so that
+  // everything after it is queued up as a single batch.
+  bus.hold();
+  vector<Future<vector<uint8_t>>> futures;
+  futures.push_back(scheduler.read(2, 0x50, 0, 1));
+  bus.waitForOpen();
+  for (unsigned int module : {9, 1, 10, 2, 9, 3, 1, 10}) {
+    futures.push_back(scheduler.read(module, 0x50, 0, 1));
+  }
+  bus.release();
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  // The batch starts where the first read left the muxes: module 2 on the
+  // first mux.  Each module is visited once, and each mux once.
+  vector<unsigned int> expected{2, 2, 1, 1, 3, 9, 9, 10, 10};
+  EXPECT_EQ(expected, bus.getLog());
+  auto stats = scheduler.getStats();
+  EXPECT_EQ(9, stats.transactions);
+  EXPECT_EQ(2, stats.batches);
+  EXPECT_EQ(5, stats.moduleSwitches);
+  EXPECT_EQ(2, stats.muxSwitches);
+  EXPECT_EQ(1, stats.busOpens);
+}
+
+TEST(I2CTransactionScheduler, keepsModuleOrder) {
+  FakeI2CBus bus;
+  I2CTransactionScheduler scheduler(&bus, kNoIdleClose);
+
+  bus.hold();
+  auto first = scheduler.read(16, 0x50, 0, 1);
+  bus.waitForOpen();
+  // Select a page and read it, on two modules, interleaved
+  uint8_t page0 = 0;
+  uint8_t page3 = 3;
+  vector<Future<Unit>> writes;
+  writes.push_back(scheduler.write(5, 0x50, 127, 1, &page0));
+  writes.push_back(scheduler.write(4, 0x50, 127, 1, &page3));
+  auto read5 = scheduler.read(5, 0x50, 127, 1);
+  auto read4 = scheduler.read(4, 0x50, 127, 1);
+  writes.push_back(scheduler.write(5, 0x50, 127, 1, &page3));
+  auto reread5 = scheduler.read(5, 0x50, 127, 1);
+  bus.release();
+
+  EXPECT_EQ(vector<uint8_t>{0}, read5.get());
+  EXPECT_EQ(vector<uint8_t>{3}, read4.get());
+  EXPECT_EQ(vector<uint8_t>{3}, reread5.get());
+}
+
+TEST(I2CTransactionScheduler, failure) {
+  FakeI2CBus bus;
+  I2CTransactionScheduler scheduler(&bus, kNoIdleClose);
+
+  bus.setFailingModule(3);
+  EXPECT_THROW(scheduler.read(3, 0x50, 0, 1).get(), UsbError);
+  // The bus is reopened for the next transaction
+  scheduler.read(4, 0x50, 0, 1).get();
+  EXPECT_EQ(2, bus.getOpens());
+  EXPECT_EQ(1, bus.getCloses());
+  EXPECT_EQ(1, scheduler.getStats().failures);
+}
+
+TEST(I2CTransactionScheduler, closesWhenIdle) {
+  FakeI2CBus bus;
+  {
+    I2CTransactionScheduler scheduler(&bus, std::chrono::milliseconds(1));
+    scheduler.read(1, 0x50, 0, 1).get();
+    for (int i = 0; i < 1000 && bus.getCloses() == 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(1, bus.getCloses());
+
+    scheduler.read(1, 0x50, 0, 1).get();
+    EXPECT_EQ(2, bus.getOpens());
+  }
+  // And when it is destroyed
+  EXPECT_EQ(2, bus.getCloses());
+}
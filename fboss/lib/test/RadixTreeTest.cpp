@@ -1,6 +1,8 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 
 #include <memory>
+#include <random>
+#include <set>
 #include <gtest/gtest.h>
 
 #include "common/base/Random.h"
@@ -1447,3 +1449,85 @@ TEST(RadixTree, SubTreeIterator) {
   }
   EXPECT_EQ(rtree.end().subTreeIterator(), rtree.end());
 }
+
+TEST(RadixTree, Bounds4) {
+  RadixTree<IPAddressV4, int> rtree;
+  std::set<pair<uint32_t, int>> expected;
+  std::mt19937 gen(1);
+  for (int i = 0; i < 2000; ++i) {
+    int masklen = 8 + gen() % 25;
+    auto ip = IPAddressV4::fromLongHBO(0x0a000000 | (gen() & 0x00ffffff))
+      .mask(masklen);
+    if (rtree.insert(ip, masklen, i).second) {
+      expected.insert(make_pair(ip.toLongHBO(), masklen));
+    }
+  }
+
+  // Iteration order is address, then mask length
+  auto eitr = expected.begin();
+  for (const auto& node : rtree) {
+    ASSERT_TRUE(eitr != expected.end());
+    EXPECT_EQ(eitr->first, node.ipAddress().toLongHBO());
+    EXPECT_EQ(eitr->second, node.masklen());
+    ++eitr;
+  }
+  EXPECT_TRUE(eitr == expected.end());
+
+  auto checkBound = [&](RadixTree<IPAddressV4, int>::ConstIterator itr,
+      std::set<pair<uint32_t, int>>::const_iterator eitr) {
+    if (eitr == expected.end()) {
+      EXPECT_TRUE(itr.atEnd());
+    } else {
+      ASSERT_FALSE(itr.atEnd());
+      EXPECT_EQ(eitr->first, itr->ipAddress().toLongHBO());
+      EXPECT_EQ(eitr->second, itr->masklen());
+    }
+  };
+  // Look up prefixes that are in the tree, and plenty that aren't
+  for (int i = 0; i < 5000; ++i) {
+    int masklen = gen() % 33;
+    auto ip = IPAddressV4::fromLongHBO(gen() % 5 == 0 ?
+        gen() : 0x0a000000 | (gen() & 0x00ffffff)).mask(masklen);
+    auto key = make_pair(ip.toLongHBO(), masklen);
+    checkBound(rtree.lowerBound(ip, masklen), expected.lower_bound(key));
+    checkBound(rtree.upperBound(ip, masklen), expected.upper_bound(key));
+  }
+  for (const auto& key : expected) {
+    auto ip = IPAddressV4::fromLongHBO(key.first);
+    checkBound(rtree.lowerBound(ip, key.second), expected.lower_bound(key));
+    checkBound(rtree.upperBound(ip, key.second), expected.upper_bound(key));
+  }
+
+  // Walking with upperBound from the last node seen visits everything
+  size_t count = 0;
+  for (auto itr = rtree.lowerBound(IPAddressV4("0.0.0.0"), 0);
+       !itr.atEnd();
+       itr = rtree.upperBound(itr->ipAddress(), itr->masklen())) {
+    ++count;
+  }
+  EXPECT_EQ(expected.size(), count);
+}
+
+TEST(RadixTree, Bounds6) {
+  RadixTree<IPAddressV6, int> rtree;
+  for (auto prefix : {"::/0", "::/2", "4000::/2", "8000::/2", "c000::/2"}) {
+    auto subnet = IPAddress::createNetwork(prefix);
+    rtree.insert(subnet.first.asV6(), subnet.second, subnet.second);
+  }
+  auto itr = rtree.lowerBound(IPAddressV6("::"), 0);
+  EXPECT_EQ(IPAddressV6("::"), itr->ipAddress());
+  EXPECT_EQ(0, itr->masklen());
+  itr = rtree.upperBound(IPAddressV6("::"), 0);
+  EXPECT_EQ(IPAddressV6("::"), itr->ipAddress());
+  EXPECT_EQ(2, itr->masklen());
+  // ::/1 is only an internal node, so the next prefix is ::/2
+  itr = rtree.lowerBound(IPAddressV6("::"), 1);
+  EXPECT_EQ(IPAddressV6("::"), itr->ipAddress());
+  EXPECT_EQ(2, itr->masklen());
+  itr = rtree.upperBound(IPAddressV6("4000::"), 2);
+  EXPECT_EQ(IPAddressV6("8000::"), itr->ipAddress());
+  itr = rtree.lowerBound(IPAddressV6("4000::1"), 128);
+  EXPECT_EQ(IPAddressV6("8000::"), itr->ipAddress());
+  EXPECT_TRUE(rtree.upperBound(IPAddressV6("c000::"), 2).atEnd());
+  EXPECT_TRUE(rtree.lowerBound(IPAddressV6("c000::1"), 128).atEnd());
+}
@@ -30,6 +30,14 @@ void BaseWedgeI2CBus::open() {
 }
 
 void BaseWedgeI2CBus::close() {
+  // Don't leave a QSFP selected for whoever opens the bus next.  This is
+  // only best effort; close() is called while unwinding from failed reads.
+  try {
+    unselectQsfp();
+  } catch (const std::exception& ex) {
+    VLOG(1) << "failed to unselect QSFP " << selectedPort_ << ": "
+            << ex.what();
+  }
   dev_.close();
 }
 
@@ -58,8 +66,6 @@ void BaseWedgeI2CBus::moduleRead(unsigned int module, uint8_t address,
   } else {
     dev_.read(address, MutableByteRange(buf, len));
   }
-
-  unselectQsfp();
 }
 
 void BaseWedgeI2CBus::moduleWrite(unsigned int module, uint8_t address,
@@ -80,8 +86,6 @@ void BaseWedgeI2CBus::moduleWrite(unsigned int module, uint8_t address,
   output[0] = offset;
   memcpy(output + 1, buf, len);
   dev_.write(address, MutableByteRange(output, len + 1));
-
-  unselectQsfp();
 }
 
 void BaseWedgeI2CBus::selectQsfp(unsigned int port) {
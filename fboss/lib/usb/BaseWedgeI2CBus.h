@@ -20,6 +20,9 @@ namespace facebook { namespace fboss {
 /*
  * A small wrapper around CP2112 which is aware of the topology of wedge's QSFP
  * I2C bus, and can select specific QSFPs to query.
+ *
+ * A QSFP stays selected after it is accessed, so that further accesses to
+ * it don't have to switch the muxes again.  Closing the bus unselects it.
  */
 class BaseWedgeI2CBus : public TransceiverI2CApi {
 
@@ -32,10 +35,15 @@ class BaseWedgeI2CBus : public TransceiverI2CApi {
                           int offset, int len, uint8_t* buf) override;
   virtual void moduleWrite(unsigned int module, uint8_t i2cAddress,
                            int offset, int len, uint8_t* buf) override;
+  virtual unsigned int getMux(unsigned int module) const override {
+    return (module - 1) / MODULES_PER_MUX;
+  }
 
  protected:
   enum : unsigned int {
     NO_PORT = 0,
+    // Each PCA9548 switch selects one of 8 modules
+    MODULES_PER_MUX = 8,
   };
 
   virtual void initBus() = 0;
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/lib/usb/I2CTransactionScheduler.h"
+
+#include "fboss/lib/usb/TransceiverI2CApi.h"
+
+#include <folly/Try.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+using folly::Future;
+using folly::Unit;
+using std::lock_guard;
+using std::unique_lock;
+using std::vector;
+
+namespace facebook { namespace fboss {
+
+I2CTransactionScheduler::I2CTransactionScheduler(
+    TransceiverI2CApi* bus,
+    std::chrono::milliseconds idleClose)
+  : bus_(bus),
+    idleClose_(idleClose) {
+  thread_ = std::thread([this] { threadMain(); });
+}
+
+I2CTransactionScheduler::~I2CTransactionScheduler() {
+  {
+    lock_guard<std::mutex> g(lock_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+Future<vector<uint8_t>> I2CTransactionScheduler::read(unsigned int module,
+                                                      uint8_t i2cAddress,
+                                                      int offset, int len) {
+  Transaction txn;
+  txn.module = module;
+  txn.address = i2cAddress;
+  txn.offset = offset;
+  txn.data.resize(len);
+  return enqueue(std::move(txn));
+}
+
+Future<Unit> I2CTransactionScheduler::write(unsigned int module,
+                                            uint8_t i2cAddress,
+                                            int offset, int len,
+                                            const uint8_t* buf) {
+  Transaction txn;
+  txn.module = module;
+  txn.address = i2cAddress;
+  txn.offset = offset;
+  txn.isWrite = true;
+  txn.data.assign(buf, buf + len);
+  return enqueue(std::move(txn)).then([](vector<uint8_t>) {});
+}
+
+Future<vector<uint8_t>> I2CTransactionScheduler::enqueue(Transaction txn) {
+  txn.mux = bus_->getMux(txn.module);
+  auto future = txn.promise.getFuture();
+  {
+    lock_guard<std::mutex> g(lock_);
+    CHECK(!stop_);
+    queue_.push_back(std::move(txn));
+  }
+  cv_.notify_one();
+  return future;
+}
+
+I2CTransactionScheduler::Stats I2CTransactionScheduler::getStats() const {
+  Stats stats;
+  stats.transactions = transactions_.load();
+  stats.failures = failures_.load();
+  stats.batches = batches_.load();
+  stats.busOpens = busOpens_.load();
+  stats.moduleSwitches = moduleSwitches_.load();
+  stats.muxSwitches = muxSwitches_.load();
+  return stats;
+}
+
+void I2CTransactionScheduler::threadMain() {
+  unique_lock<std::mutex> g(lock_);
+  while (true) {
+    auto haveWork = [this] { return !queue_.empty() || stop_; };
+    if (busOpen_) {
+      if (!cv_.wait_for(g, idleClose_, haveWork)) {
+        g.unlock();
+        closeBus();
+        g.lock();
+        continue;
+      }
+    } else {
+      cv_.wait(g, haveWork);
+    }
+    if (queue_.empty()) {
+      // Stopping, with nothing left to do
+      break;
+    }
+
+    vector<Transaction> batch;
+    batch.swap(queue_);
+    g.unlock();
+    runBatch(std::move(batch));
+    g.lock();
+  }
+  g.unlock();
+  closeBus();
+}
+
+void I2CTransactionScheduler::runBatch(vector<Transaction> batch) {
+  ++batches_;
+
+  // Group the transactions by module, keeping the order they were submitted
+  // in for each module.  Start with the module, and the mux, that is still
+  // selected from the last batch, then go through the muxes in order.
+  typedef std::tuple<bool, unsigned int, bool, unsigned int> Key;
+  std::map<Key, vector<Transaction*>> modules;
+  for (auto& txn : batch) {
+    Key key(!haveLast_ || txn.mux != lastMux_, txn.mux,
+            !haveLast_ || txn.module != lastModule_, txn.module);
+    modules[key].push_back(&txn);
+  }
+
+  for (const auto& module : modules) {
+    for (auto* txn : module.second) {
+      run(txn);
+    }
+  }
+}
+
+void I2CTransactionScheduler::run(Transaction* txn) {
+  ++transactions_;
+  if (!haveLast_ || txn->module != lastModule_) {
+    ++moduleSwitches_;
+    if (!haveLast_ || txn->mux != lastMux_) {
+      ++muxSwitches_;
+    }
+  }
+  haveLast_ = true;
+  lastModule_ = txn->module;
+  lastMux_ = txn->mux;
+
+  auto result = folly::makeTryWith([&] {
+    if (!busOpen_) {
+      bus_->open();
+      busOpen_ = true;
+      ++busOpens_;
+    }
+    if (txn->isWrite) {
+      bus_->moduleWrite(txn->module, txn->address, txn->offset,
+                        txn->data.size(), txn->data.data());
+      txn->data.clear();
+    } else {
+      bus_->moduleRead(txn->module, txn->address, txn->offset,
+                       txn->data.size(), txn->data.data());
+    }
+    return std::move(txn->data);
+  });
+
+  if (result.hasException()) {
+    ++failures_;
+    VLOG(2) << "I2C transaction to module " << txn->module << " failed: "
+            << result.exception().what();
+    // Start over with a freshly opened bus, which also gets it verified and
+    // reset if it is wedged.
+    closeBus();
+  }
+  txn->promise.setTry(std::move(result));
+}
+
+void I2CTransactionScheduler::closeBus() {
+  haveLast_ = false;
+  if (!busOpen_) {
+    return;
+  }
+  busOpen_ = false;
+  try {
+    bus_->close();
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "error closing I2C bus: " << ex.what();
+  }
+}
+
+}} // facebook::fboss
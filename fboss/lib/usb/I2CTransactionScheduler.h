@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/futures/Future.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class TransceiverI2CApi;
+
+/*
+ * I2CTransactionScheduler queues reads and writes to the modules on a
+ * TransceiverI2CApi bus and performs them from a single thread of its own,
+ * completing each with a future.
+ *
+ * Whatever is queued by the time the thread gets to it is run as one batch.
+ * Within a batch the transactions are reordered by mux, and by module
+ * within each mux, so that the mux is switched as few times as possible.
+ * Transactions to the same module always run in the order they were
+ * submitted, so a page select followed by a read does what it should.
+ *
+ * The bus is opened for the first batch and stays open until no work has
+ * arrived for idleClose, so a caller that submits one transaction at a
+ * time doesn't pay for opening and verifying the bus on each of them.
+ */
+class I2CTransactionScheduler {
+ public:
+  struct Stats {
+    uint64_t transactions{0};
+    uint64_t failures{0};
+    uint64_t batches{0};
+    uint64_t busOpens{0};
+    // Transactions to a different module, or mux, than the one before
+    uint64_t moduleSwitches{0};
+    uint64_t muxSwitches{0};
+  };
+
+  explicit I2CTransactionScheduler(
+      TransceiverI2CApi* bus,
+      std::chrono::milliseconds idleClose = std::chrono::milliseconds(100));
+
+  /*
+   * Runs whatever is still queued, closes the bus and stops the thread.
+   */
+  ~I2CTransactionScheduler();
+
+  folly::Future<std::vector<uint8_t>> read(unsigned int module,
+                                           uint8_t i2cAddress,
+                                           int offset, int len);
+  folly::Future<folly::Unit> write(unsigned int module, uint8_t i2cAddress,
+                                   int offset, int len, const uint8_t* buf);
+
+  Stats getStats() const;
+
+ private:
+  struct Transaction {
+    unsigned int module{0};
+    unsigned int mux{0};
+    uint8_t address{0};
+    int offset{0};
+    bool isWrite{false};
+    // The data to write, or the buffer to read into
+    std::vector<uint8_t> data;
+    folly::Promise<std::vector<uint8_t>> promise;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  I2CTransactionScheduler(I2CTransactionScheduler const &) = delete;
+  I2CTransactionScheduler& operator=(I2CTransactionScheduler const &) =
+    delete;
+
+  folly::Future<std::vector<uint8_t>> enqueue(Transaction txn);
+  void threadMain();
+  void runBatch(std::vector<Transaction> batch);
+  void run(Transaction* txn);
+  void closeBus();
+
+  TransceiverI2CApi* bus_{nullptr};
+  const std::chrono::milliseconds idleClose_;
+
+  mutable std::mutex lock_;
+  std::condition_variable cv_;
+  std::vector<Transaction> queue_;
+  bool stop_{false};
+
+  // Only touched by thread_
+  bool busOpen_{false};
+  bool haveLast_{false};
+  unsigned int lastModule_{0};
+  unsigned int lastMux_{0};
+
+  std::atomic<uint64_t> transactions_{0};
+  std::atomic<uint64_t> failures_{0};
+  std::atomic<uint64_t> batches_{0};
+  std::atomic<uint64_t> busOpens_{0};
+  std::atomic<uint64_t> moduleSwitches_{0};
+  std::atomic<uint64_t> muxSwitches_{0};
+
+  std::thread thread_;
+};
+
+}} // facebook::fboss
@@ -28,6 +28,14 @@ class TransceiverI2CApi {
   virtual void moduleWrite(unsigned int module, uint8_t i2cAddress,
                            int offset, int len, uint8_t* buf) = 0;
 
+  /*
+   * Which mux a module is behind.  Modules on the same mux can be switched
+   * between with fewer writes than modules on different ones.
+   */
+  virtual unsigned int getMux(unsigned int /* module */) const {
+    return 0;
+  }
+
   // Addresses to be queried by external callers:
   enum : uint8_t {
     ADDR_QSFP = 0x50,